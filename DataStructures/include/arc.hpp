@@ -2,12 +2,19 @@
 #define ARC_H
 
 #include "node.hpp"
+#include "labelregistry.hpp"
+#include <cstddef>
+#include <limits>
+#include <string>
 
 namespace GraphTemplate {
 
 template <class T>
 class Node;
 
+template <class T>
+class Graph;
+
 template <class T>
 class Arc
 {
@@ -21,6 +28,7 @@ public:
     Node<T> *getN1() const;
     void setN1(Node<T> *value);
     bool isDirected() const;
+    bool isPooled() const;
     void setDirected(bool value);
     Node<T> *getN2() const;
     void setN2(Node<T> *value);
@@ -30,16 +38,31 @@ public:
     void setInfo(void *value);
     unsigned int getId() const;
     void setId(unsigned int value);
-    std::string getLabel() const;
+    const std::string &getLabel() const;
     void setLabel(const std::string &value);
+    unsigned int getLabelId() const;
+    unsigned int getTypeId() const;
 
 protected:
+    friend class Node<T>;
+    friend class Graph<T>;
+
     unsigned int id;
     Node<T> *n1, *n2;
-    std::string label;
+    //Ids of the label and of its type in the LabelRegistry
+    unsigned int labelId = LabelRegistry::EMPTY;
+    unsigned int typeId = LabelRegistry::EMPTY;
     bool directed;
     double weight;
     void* info;
+    //True if the arc has been allocated by Graph::addArcs: its memory belongs to the graph, and it must not be deleted
+    bool pooled = false;
+    //Positions of the arc in the graph and in the lists of arcs leaving n1 and entering n2
+    std::size_t position = std::numeric_limits<std::size_t>::max();
+    std::size_t fletchingPosition = std::numeric_limits<std::size_t>::max();
+    std::size_t tipPosition = std::numeric_limits<std::size_t>::max();
+    //Position of the arc in the list of the arcs of its type in the graph
+    std::size_t typePosition = std::numeric_limits<std::size_t>::max();
 };
 
 template<class T>
@@ -54,7 +77,7 @@ Arc<T>::Arc(Node<T> *n1, Node<T> *n2, double weight, bool directed, unsigned int
     this->id = id;
     this->n1 = n1;
     this->n2 = n2;
-    this->label = label;
+    setLabel(label);
     this->weight = weight;
     this->directed = directed;
 }
@@ -103,6 +126,12 @@ bool Arc<T>::isDirected() const
     return directed;
 }
 
+template <class T>
+bool Arc<T>::isPooled() const
+{
+    return pooled;
+}
+
 template <class T>
 void Arc<T>::setDirected(bool value)
 {
@@ -146,15 +175,27 @@ id = value;
 }
 
 template <class T>
-std::string Arc<T>::getLabel() const
+const std::string &Arc<T>::getLabel() const
 {
-return label;
+return LabelRegistry::getLabel(labelId);
 }
 
 template <class T>
 void Arc<T>::setLabel(const std::string &value)
 {
-label = value;
+LabelRegistry::intern(value, labelId, typeId);
+}
+
+template <class T>
+unsigned int Arc<T>::getLabelId() const
+{
+return labelId;
+}
+
+template <class T>
+unsigned int Arc<T>::getTypeId() const
+{
+return typeId;
 }
 
 }
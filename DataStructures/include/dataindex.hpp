@@ -0,0 +1,109 @@
+#ifndef DATAINDEX_H
+#define DATAINDEX_H
+
+#include "node.hpp"
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GraphTemplate {
+
+//True if std::hash<T> is defined
+template <class T, class = void>
+struct IsHashable : std::false_type {};
+
+template <class T>
+struct IsHashable<T, decltype(void(std::hash<T>()(std::declval<const T&>())))> : std::true_type {};
+
+/**
+ * Index of the nodes of a graph by their data. If std::hash<T> is defined, the nodes are kept in a hash table, where each data is mapped
+ * to the first node inserted with it, and looking up a node costs O(1). Otherwise nothing is stored, and the lookup scans the nodes of
+ * the graph (only operator== is required, as in the original implementation of the graph).
+ */
+template <class T, bool Hashed = IsHashable<T>::value>
+class DataIndex
+{
+public:
+    void insert(Node<T>* n)
+    {
+        if(!dataNodes.insert(std::make_pair(n->getData(), n)).second)
+            duplicateNodes++;
+    }
+
+    //Removes a node, which has already been removed from the nodes of the graph
+    void erase(Node<T>* n, const std::vector<Node<T>*>& nodes)
+    {
+        auto it = dataNodes.find(n->getData());
+        if(it != dataNodes.end() && it->second == n)
+        {
+            dataNodes.erase(it);
+            //Another node with the same data takes its place (searched only if there are such nodes)
+            if(duplicateNodes > 0)
+                for(auto other : nodes)
+                    if(other->getData() == n->getData())
+                    {
+                        dataNodes.insert(std::make_pair(other->getData(), other));
+                        duplicateNodes--;
+                        break;
+                    }
+        } else
+            duplicateNodes--;
+    }
+
+    Node<T>* find(const T& data, const std::vector<Node<T>*>&) const
+    {
+        auto it = dataNodes.find(data);
+        return it != dataNodes.end() ? it->second : nullptr;
+    }
+
+    //Copies the index of another graph, whose nodes are mapped to the nodes of this graph by map
+    template <class F>
+    void assign(const DataIndex& other, F map)
+    {
+        dataNodes.clear();
+        dataNodes.reserve(other.dataNodes.size());
+        for(const auto& entry : other.dataNodes)
+            dataNodes.insert(std::make_pair(entry.first, map(entry.second)));
+        duplicateNodes = other.duplicateNodes;
+    }
+
+    void clear()
+    {
+        dataNodes.clear();
+        duplicateNodes = 0;
+    }
+
+protected:
+    //Node of each data (the first one inserted, if several nodes have the same data)
+    std::unordered_map<T, Node<T>*> dataNodes;
+    //Number of nodes whose data is already in another node
+    std::size_t duplicateNodes = 0;
+};
+
+template <class T>
+class DataIndex<T, false>
+{
+public:
+    void insert(Node<T>*) {}
+
+    void erase(Node<T>*, const std::vector<Node<T>*>&) {}
+
+    Node<T>* find(const T& data, const std::vector<Node<T>*>& nodes) const
+    {
+        for(auto n : nodes)
+            if(n->getData() == data)
+                return n;
+        return nullptr;
+    }
+
+    template <class F>
+    void assign(const DataIndex&, F) {}
+
+    void clear() {}
+};
+
+}
+#endif // DATAINDEX_H
@@ -2,48 +2,116 @@
 #define GRAPH_H
 #include "node.hpp"
 #include "arc.hpp"
+#include "dataindex.hpp"
+#include <cctype>
 #include <iterator>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 #include <queue>
 #include <stack>
 #include <limits>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
 
 namespace GraphTemplate {
 
+/**
+ * Nodes are indexed by their data in a hash table (if std::hash<T> is defined, otherwise looking up a node scans the nodes), and each node
+ * and arc stores its position in the graph: looking up a node, and removing a node or an arc (swapping it with the last one), cost O(1). The data of a node must not change while it
+ * is in the graph. Arcs are listed in their endpoints as leaving or entering them, so the queries on the arcs of a node cost O(degree).
+ * Labels are interned in the LabelRegistry, and the arcs of each type are also listed by the graph (the label of an arc must not change
+ * while it is in the graph), so that filtering arcs by type compares integers and listing the arcs of a type costs O(arcs of the type).
+ * The traversals keep their state in arrays indexed by node position, and mark the visited nodes with the number of the visit, so that
+ * they do not need to reset the nodes: they cannot run concurrently on the same graph, except parallelBreadthFirstVisit.
+ */
 template <class T>
 class Graph
 {
 public:
+    //Minimum number of nodes of a level for expanding it with more than one thread, and of nodes for each thread
+    static constexpr std::size_t PARALLEL_LEVEL_SIZE = 4096;
+
     Graph();
+    /**
+     * @brief Graph copy constructors: the copy has its own nodes and arcs (with the same data, labels, weights and order), since nodes and
+     * arcs store their positions in the graph containing them. They are pooled: they must not be deleted, they are released with the copy
+     * (or by clearNodes and clearArcs). The info of the arcs is copied as a pointer.
+     */
     Graph(Graph<T>&);
     Graph(Graph<T>*);
     virtual ~Graph();
+    /**
+     * @brief breadthFirstVisit, depthFirstVisit methods for visiting the nodes reachable from a node. From each node the visits follow its
+     * outgoing arcs, in insertion order, and then its undirected incoming arcs (directed arcs are never followed backwards). Unlike the
+     * original implementation, which followed the arcs of a node in insertion order mixing incoming and outgoing ones, the order of the
+     * visit therefore does not depend on the order of insertion of incoming and outgoing arcs (removing an arc moves the last arc of the
+     * node lists in its place).
+     * @param root starting node of the visit
+     * @return the reached nodes, in the order of the visit
+     */
     virtual std::vector<Node<T> *> breadthFirstVisit(Node<T>* root);
     virtual std::vector<Node<T> *> depthFirstVisit(Node<T>* root);
     virtual Node<T> *breadthFirstSearch(Node<T>* root, T data);
     virtual Node<T> *depthFirstSearch(Node<T>* root, T data);
     /**
-     * @brief shortestPathSearch method for computing the shortest path between two given nodes in the graph.
-     * It is based on an approximation of the Dijkstra algorithm.
+     * @brief parallelBreadthFirstVisit method for visiting the graph breadth-first with several threads, one level at a time: the nodes of
+     * a level are split among the threads, which claim the nodes of the next level atomically. Levels smaller than PARALLEL_LEVEL_SIZE
+     * nodes are expanded by the calling thread. It does not modify the graph, so several visits can run at once.
+     * @param root starting node of the visit
+     * @param threadsNumber the maximum number of threads (0 means one per hardware thread)
+     * @return the reached nodes, level by level (the order of the nodes within a level is not deterministic)
+     */
+    std::vector<Node<T> *> parallelBreadthFirstVisit(Node<T>* root, unsigned int threadsNumber = 0) const;
+    /**
+     * @brief shortestPathSearch method for computing the shortest path between two given nodes in the graph with the Dijkstra algorithm:
+     * the path minimises the sum of the weights of its arcs (the original implementation only compared the weight of the last arc reaching
+     * each node, so its paths could be longer). Arcs are followed as in breadthFirstVisit.
      * @param source starting node of the path
      * @param destination destination of the path
-     * @param label optional parameter, allows to restrain the search to arcs having a specific label
-     * @return the found shortest path
+     * @param label optional parameter, allows to restrain the search to arcs whose label contains it (ignoring the case)
+     * @return the found shortest path, empty if the destination is not reachable
      */
     virtual std::vector<Arc<T>*> shortestPathSearch(Node<T>* source, Node<T>* destination, std::string label = "");
     virtual bool addNode(Node<T>* n);
     virtual bool addNode(T data);
+    /**
+     * @brief removeNode method that removes a node from the graph, together with its arcs (neither of them is deleted)
+     * @param n the node
+     * @return true if the node has been removed, false if it is not in the graph
+     */
     virtual bool removeNode(Node<T>* n);
     virtual bool addArc(Arc<T>* a);
     virtual bool addArc(Node<T>* n1, Node<T>* n2, double weight, bool directed);
     virtual bool removeArc(Arc<T>* a);
+    /**
+     * @brief addArcs method for adding many arcs at once (for instance when loading a graph). The arcs are allocated in a single block
+     * owned by the graph (they are pooled: they must not be deleted, they are released with the graph or by clearArcs), their labels are
+     * interned once for each distinct label, and the lists of arcs of the nodes and of the types are grown once.
+     * @param endpoints the nodes of each arc, consecutively (the first and the second node of the first arc, then of the second one, ...)
+     * @param labels the label of each arc
+     * @param weight the weight of the arcs
+     * @param directed true if the arcs are directed, false otherwise
+     * @param firstId the id of the first arc, the following ones are numbered consecutively
+     * @return the added arcs, or no arcs if a node is not in the graph (in that case the graph is not modified)
+     */
+    std::vector<Arc<T>*> addArcs(const std::vector<Node<T>*> &endpoints, const std::vector<std::string> &labels, double weight, bool directed,
+                                 unsigned int firstId = 0);
 
     std::vector<Arc<T>*> getArcsFromFletching(Node<T>* n, std::string type = "");
     std::vector<Arc<T>*> getArcsFromTip(Node<T>* n, std::string type = "");
     //Arc<T>* getArcFromEndpoints(Node<T>* n1, Node<T>* n2, std::string type = "");
     std::vector<Arc<T>*> getArcsFromEndpoints(Node<T>* n1, Node<T>* n2, std::string type = "");
+    /**
+     * @brief getTypedArcs method that returns the arcs of a type
+     * @param type the type (labels are compared ignoring the case)
+     * @return the arcs whose label is of that type
+     */
+    std::vector<Arc<T>*> getTypedArcs(std::string type) const;
     std::vector<Node<T>* > getLeaves(Node<T>*);
     void removeRedundancies();
 
@@ -52,6 +120,7 @@ public:
     void setNodes(const std::vector<Node<T> *> &value);
     void clearNodes();
     std::vector<Arc<T> *> getArcs() const;
+    std::size_t getArcsNumber() const;
     std::vector<Arc<T> *> getArcs(Node<T>* n, std::string type = "") const;
     void setArcs(const std::vector<Arc<T> *> &value);
     void clearArcs();
@@ -61,6 +130,33 @@ protected:
     unsigned int reachedArcId;
     std::vector<Node<T>*> nodes;
     std::vector<Arc<T>*> arcs;
+    //Blocks of the arcs allocated by addArcs and by the copy constructor
+    std::vector<std::shared_ptr<std::vector<Arc<T> > > > arcPools;
+    //Blocks of the nodes allocated by the copy constructor
+    std::vector<std::shared_ptr<std::vector<Node<T> > > > nodePools;
+    //Arcs of each type, indexed by type id
+    std::vector<std::vector<Arc<T>*> > typeArcs;
+    //Node of each data (see DataIndex)
+    DataIndex<T> dataNodes;
+
+    //Visit state of the traversals, indexed by node position: the nodes stamped with visitEpoch are the visited ones
+    std::vector<unsigned int> visitStamps;
+    unsigned int visitEpoch = 0;
+    //Distance of the visited nodes from the source of shortestPathSearch, and last arc of the path reaching them
+    std::vector<double> pathDistances;
+    std::vector<Arc<T>*> pathArcs;
+
+    std::vector<Arc<T>*> filterArcs(const std::vector<Arc<T>*> &arcs, std::string type) const;
+    bool contains(Node<T>* n) const;
+    void startVisit();
+    bool isMarkedVisited(Node<T>* n) const;
+    void markVisited(Node<T>* n);
+    //Calls f(arc, node) for each arc which can be followed from n (the ones leaving it and the undirected ones), with the node it leads to
+    template<class F>
+    void followArcs(Node<T>* n, F f) const;
+    void indexArcs();
+    void indexArcType(Arc<T>* a);
+    void removeArcType(Arc<T>* a);
 
     void toLowerCase(std::string&) const;
 };
@@ -73,19 +169,75 @@ Graph<T>::Graph()
 }
 
 template<class T>
-Graph<T>::Graph(Graph<T> &graph)
+Graph<T>::Graph(Graph<T> &graph) : Graph(&graph)
 {
-    this->nodes.insert(this->nodes.end(), graph.getNodes().begin(), graph.getNodes().end());
-    this->arcs.insert(this->arcs.end(), graph.getArcs().begin(), graph.getArcs().end());
+
 }
 
 template<class T>
 Graph<T>::Graph(Graph<T> *graph)
 {
-    std::vector<Node<T>*> nodes = graph->getNodes();
-    std::vector<Arc<T>*> arcs = graph->getArcs();
-    this->nodes.insert(this->nodes.end(), nodes.begin(), nodes.end());
-    this->arcs.insert(this->arcs.end(), arcs.begin(), arcs.end());
+    auto nodePool = std::make_shared<std::vector<Node<T> > >(graph->nodes.size());
+    auto arcPool = std::make_shared<std::vector<Arc<T> > >(graph->arcs.size());
+    nodes.reserve(graph->nodes.size());
+    for(std::size_t i = 0; i < graph->nodes.size(); i++)
+    {
+        Node<T>& n = (*nodePool)[i];
+        n.data = graph->nodes[i]->data;
+        n.visited = graph->nodes[i]->visited;
+        n.position = i;
+        nodes.push_back(&n);
+    }
+    //The endpoints of the arcs are found through the positions of the nodes in the copied graph
+    arcs.reserve(graph->arcs.size());
+    for(std::size_t i = 0; i < graph->arcs.size(); i++)
+    {
+        const Arc<T>* source = graph->arcs[i];
+        Arc<T>& a = (*arcPool)[i];
+        a.id = source->id;
+        a.n1 = nodes[source->n1->position];
+        a.n2 = nodes[source->n2->position];
+        a.labelId = source->labelId;
+        a.typeId = source->typeId;
+        a.directed = source->directed;
+        a.weight = source->weight;
+        a.info = source->info;
+        a.pooled = true;
+        a.position = i;
+        arcs.push_back(&a);
+    }
+    //The lists of the nodes keep their order, skipping the arcs of other graphs sharing the copied nodes
+    for(std::size_t i = 0; i < graph->nodes.size(); i++)
+    {
+        for(auto source : graph->nodes[i]->outgoingArcs)
+            if(source->position < graph->arcs.size() && graph->arcs[source->position] == source)
+            {
+                Arc<T>* a = arcs[source->position];
+                a->fletchingPosition = nodes[i]->outgoingArcs.size();
+                nodes[i]->outgoingArcs.push_back(a);
+            }
+        for(auto source : graph->nodes[i]->incomingArcs)
+            if(source->position < graph->arcs.size() && graph->arcs[source->position] == source)
+            {
+                Arc<T>* a = arcs[source->position];
+                a->tipPosition = nodes[i]->incomingArcs.size();
+                nodes[i]->incomingArcs.push_back(a);
+            }
+    }
+    typeArcs.resize(graph->typeArcs.size());
+    for(std::size_t i = 0; i < graph->typeArcs.size(); i++)
+    {
+        typeArcs[i].reserve(graph->typeArcs[i].size());
+        for(auto source : graph->typeArcs[i])
+        {
+            Arc<T>* a = arcs[source->position];
+            a->typePosition = typeArcs[i].size();
+            typeArcs[i].push_back(a);
+        }
+    }
+    dataNodes.assign(graph->dataNodes, [this](Node<T>* n){ return nodes[n->position]; });
+    nodePools.push_back(nodePool);
+    arcPools.push_back(arcPool);
 }
 
 template<class T>
@@ -97,28 +249,21 @@ template<class T>
 template<class T>
 std::vector<Node<T> *> Graph<T>::breadthFirstVisit(Node<T>* root)
 {
-    std::vector<Node<T>*> nodesList = {root};
-    std::queue<Node<T>*> Q;
-    Q.push(root);
-    root->setVisited(true);
-    while(!Q.empty()){
-        Node<T>* w = Q.front();
-        std::vector<Arc<T>*> connectedArcs = w->getArcs();
-        Q.pop();
-        for(unsigned int i = 0; i < connectedArcs.size(); i++){
-            if(w != connectedArcs[i]->getN1() && connectedArcs[i]->isDirected())
-                continue;
-            Node<T>* v = connectedArcs[i]->getOppositeNode(w);
-            if(!v->isVisited()){
-                v->setVisited(true);
+    std::vector<Node<T>*> nodesList;
+    if(!contains(root))
+        return nodesList;
+    startVisit();
+    nodesList.push_back(root);
+    markVisited(root);
+    //The list itself is the queue: nodes are expanded in the order they are reached
+    for(std::size_t i = 0; i < nodesList.size(); i++)
+        followArcs(nodesList[i], [&](Arc<T>*, Node<T>* v){
+            if(!isMarkedVisited(v))
+            {
+                markVisited(v);
                 nodesList.push_back(v);
-                Q.push(v);
             }
-        }
-    }
-
-    for(unsigned int i = 0; i < nodes.size(); i++)
-        nodes[i]->setVisited(false);
+        });
 
     return nodesList;
 }
@@ -127,29 +272,26 @@ template<class T>
 std::vector<Node<T> *> Graph<T>::depthFirstVisit(Node<T>* root)
 {
     std::vector<Node<T>*> nodesList;
-    std::stack<Node<T>*> S;
-    S.push(root);
+    if(!contains(root))
+        return nodesList;
+    startVisit();
+    std::vector<Node<T>*> S = {root};
     while(!S.empty()){
-        Node<T>* w = S.top();
-        S.pop();
-        std::vector<Arc<T>*> connectedArcs = w->getArcs();
-        if(!w->isVisited()){
-            w->setVisited(true);
+        Node<T>* w = S.back();
+        S.pop_back();
+        if(!isMarkedVisited(w)){
+            markVisited(w);
             nodesList.push_back(w);
-            for(int i = connectedArcs.size() - 1; i >= 0; i--){
-                if(w != connectedArcs[i]->getN1() && connectedArcs[i]->isDirected())
-                    continue;
-                Node<T>* v = connectedArcs[i]->getOppositeNode(w);
-                if(!v->isVisited())
-                    S.push(v);
-
-            }
+            //Neighbours are pushed in reverse order, so that they are popped in the order of the arcs
+            std::size_t top = S.size();
+            followArcs(w, [&](Arc<T>*, Node<T>* v){
+                if(!isMarkedVisited(v))
+                    S.push_back(v);
+            });
+            std::reverse(S.begin() + static_cast<long>(top), S.end());
         }
     }
 
-    for(unsigned int i = 0; i < nodes.size(); i++)
-        nodes[i]->setVisited(false);
-
     return nodesList;
 
 }
@@ -157,159 +299,178 @@ std::vector<Node<T> *> Graph<T>::depthFirstVisit(Node<T>* root)
 template<class T>
 Node<T> *Graph<T>::depthFirstSearch(Node<T> *root, T data)
 {
-    std::stack<Node<T>*> S;
-    S.push(root);
-    Node<T>* foundNode = nullptr;
+    if(!contains(root))
+        return nullptr;
+    startVisit();
+    std::vector<Node<T>*> S = {root};
 
     while(!S.empty()){
-        Node<T>* w = S.top();
-        S.pop();
-        std::vector<Arc<T>*> connectedArcs = w->getArcs();
-        if(!w->isVisited()){
-            if(w->getData() == data){
-                foundNode = w;
-                break;
-            }
-            w->setVisited(true);
-            for(int i = connectedArcs.size() - 1; i >= 0; i--){
-                if(w != connectedArcs[i]->getN1() && connectedArcs[i]->isDirected())
-                    continue;
-                Node<T>* v = connectedArcs[i]->getOppositeNode(w);
-                if(!v->isVisited())
-                    S.push(v);
-
-            }
+        Node<T>* w = S.back();
+        S.pop_back();
+        if(!isMarkedVisited(w)){
+            if(w->getData() == data)
+                return w;
+            markVisited(w);
+            std::size_t top = S.size();
+            followArcs(w, [&](Arc<T>*, Node<T>* v){
+                if(!isMarkedVisited(v))
+                    S.push_back(v);
+            });
+            std::reverse(S.begin() + static_cast<long>(top), S.end());
         }
     }
 
-    for(unsigned int i = 0; i < nodes.size(); i++)
-        nodes[i]->setVisited(false);
-
-    return foundNode;
+    return nullptr;
 }
 
 template<class T>
 Node<T> *Graph<T>::breadthFirstSearch(Node<T> *root, T data)
 {
-    std::vector<Node<T>*> nodesList = {root};
-    std::queue<Node<T>*> Q;
-    Node<T>* foundNode = nullptr;
-    Q.push(root);
-    root->setVisited(true);
-    while(!Q.empty() && foundNode == nullptr ){
-        Node<T>* w = Q.front();
-        std::vector<Arc<T>*> connectedArcs = w->getArcs();
-        Q.pop();
-        for(unsigned int i = 0; i < connectedArcs.size(); i++){
-            if(w != connectedArcs[i]->getN1() && connectedArcs[i]->isDirected())
-                continue;
-            Node<T>* v = connectedArcs[i]->getOppositeNode(w);
-            if(!v->isVisited()){
-                if(w->getData() == data){
-                    foundNode = w;
-                    break;
-                }
-                v->setVisited(true);
-                nodesList.push_back(v);
-                Q.push(v);
+    if(!contains(root))
+        return nullptr;
+    startVisit();
+    std::vector<Node<T>*> Q = {root};
+    markVisited(root);
+    for(std::size_t i = 0; i < Q.size(); i++)
+    {
+        Node<T>* w = Q[i];
+        if(w->getData() == data)
+            return w;
+        followArcs(w, [&](Arc<T>*, Node<T>* v){
+            if(!isMarkedVisited(v))
+            {
+                markVisited(v);
+                Q.push_back(v);
             }
-        }
+        });
     }
 
-    for(unsigned int i = 0; i < nodes.size(); i++)
-        nodes[i]->setVisited(false);
-
-    return foundNode;
+    return nullptr;
 }
 
 template<class T>
-Node<T>* extractNearestNode(std::vector<Node<T>*> &frontier, std::map<Node<T>*, double> distances){
-
-    double minDist = std::numeric_limits<double>::max();
-    int minPos = -1;
-    for(unsigned int i = 0; i < frontier.size(); i++){
-        if(distances[frontier[i]] < minDist){
-            minPos = static_cast<int>(i);
-            minDist = distances[frontier[i]];
+std::vector<Node<T> *> Graph<T>::parallelBreadthFirstVisit(Node<T> *root, unsigned int threadsNumber) const
+{
+    std::vector<Node<T>*> nodesList;
+    if(!contains(root))
+        return nodesList;
+    if(threadsNumber == 0)
+        threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+
+    //Each node is claimed by the first thread which reaches it
+    std::unique_ptr<std::atomic<bool>[]> reached(new std::atomic<bool>[nodes.size()]);
+    for(std::size_t i = 0; i < nodes.size(); i++)
+        reached[i].store(false, std::memory_order_relaxed);
+    reached[root->position].store(true, std::memory_order_relaxed);
+    nodesList.push_back(root);
+
+    std::vector<std::vector<Node<T>*> > nextLevels(threadsNumber);
+    auto expand = [&](unsigned int thread, std::size_t begin, std::size_t end){
+        for(std::size_t i = begin; i < end; i++)
+            followArcs(nodesList[i], [&](Arc<T>*, Node<T>* v){
+                std::atomic<bool>& flag = reached[v->position];
+                if(!flag.load(std::memory_order_relaxed) && !flag.exchange(true, std::memory_order_relaxed))
+                    nextLevels[thread].push_back(v);
+            });
+    };
+
+    std::size_t levelBegin = 0;
+    while(levelBegin < nodesList.size())
+    {
+        std::size_t levelEnd = nodesList.size();
+        std::size_t levelSize = levelEnd - levelBegin;
+        unsigned int threads = static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(threadsNumber, levelSize / PARALLEL_LEVEL_SIZE)));
+        if(threads == 1)
+            expand(0, levelBegin, levelEnd);
+        else
+        {
+            //The calling thread expands the first chunk of the level
+            std::vector<std::thread> workers;
+            for(unsigned int t = 1; t < threads; t++)
+                workers.emplace_back(expand, t, levelBegin + levelSize * t / threads, levelBegin + levelSize * (t + 1) / threads);
+            expand(0, levelBegin, levelBegin + levelSize / threads);
+            for(auto &worker : workers)
+                worker.join();
+        }
+        for(unsigned int t = 0; t < threads; t++)
+        {
+            nodesList.insert(nodesList.end(), nextLevels[t].begin(), nextLevels[t].end());
+            nextLevels[t].clear();
         }
+        levelBegin = levelEnd;
     }
 
-    Node<T>* nearest = frontier[minPos];
-
-    frontier.erase(frontier.begin() + minPos);
-
-    return nearest;
-
+    return nodesList;
 }
 
 template<class T>
 std::vector<Arc<T> *> Graph<T>::shortestPathSearch(Node<T> *source, Node<T> *destination, std::string label)
 {
-    std::string lowerCaseLabel = label;
-    toLowerCase(lowerCaseLabel);
-    std::vector<Node<T>*> frontier;
-    std::map<Node<T>*, double> distances = {{source, 0}};
-    std::map<Node<T>*, Node<T>*> predecessors = {{source, nullptr}};
     std::vector<Arc<T>*> shortestPath;
-    Node<T>* v;
-    bool v2visited = false;
-
-    if(source == destination)
+    if(source == destination || !contains(source) || !contains(destination))
         return shortestPath;
 
+    //Whether the name of each type contains the label (0 if not checked yet, 1 if it does, -1 if not): only the types of the arcs reached by
+    //the search are checked, once each, instead of checking every arc
+    std::string lowerCaseLabel = label;
+    toLowerCase(lowerCaseLabel);
+    std::vector<signed char> matchingTypes(label.compare("") != 0 ? typeArcs.size() : 0, 0);
+    auto isMatching = [&](Arc<T>* a)
+    {
+        if(label.compare("") == 0)
+            return true;
+        unsigned int typeId = a->getTypeId();
+        if(typeId >= matchingTypes.size())
+            matchingTypes.resize(typeId + 1, 0);
+        if(matchingTypes[typeId] == 0)
+            matchingTypes[typeId] = LabelRegistry::getLabel(typeId).find(lowerCaseLabel) != std::string::npos ? 1 : -1;
+        return matchingTypes[typeId] > 0;
+    };
+    startVisit();
+    if(pathDistances.size() < nodes.size())
+    {
+        pathDistances.resize(nodes.size());
+        pathArcs.resize(nodes.size());
+    }
 
-    frontier.push_back(source);
+    //Frontier entries are (distance, node position): a node improved after its insertion is inserted again, and the outdated entries are
+    //skipped when extracted
+    typedef std::pair<double, std::size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > frontier;
+    markVisited(source);
+    pathDistances[source->position] = 0;
+    pathArcs[source->position] = nullptr;
+    frontier.push(std::make_pair(0.0, source->position));
 
-    do{
-        v = extractNearestNode(frontier, distances);
-        std::vector<Node<T>*> neighbors;
-        for(unsigned int i = 0; i < v->getArcs().size(); i++)
-        {
-            Arc<T>* a = v->getArcs()[i];
-            std::string aLowerCaseLabel = a->getLabel();
-            toLowerCase(aLowerCaseLabel);
-            if((label.compare("") == 0 || aLowerCaseLabel.find(lowerCaseLabel) != std::string::npos) &&
-               (!a->isDirected() || a->getN1() == v))
+    while(!frontier.empty())
+    {
+        Entry e = frontier.top();
+        frontier.pop();
+        if(e.first > pathDistances[e.second])
+            continue;
+        Node<T>* v = nodes[e.second];
+        if(v == destination)
+            break;
+        followArcs(v, [&](Arc<T>* a, Node<T>* x){
+            if(!isMatching(a))
+                return;
+            double distance = e.first + a->getWeight();
+            if(!isMarkedVisited(x) || distance < pathDistances[x->position])
             {
-                neighbors.push_back(a->getOppositeNode(v));
-            }
-        }
-
-        for(unsigned int i = 0; i < neighbors.size(); i++)
-        {
-            Node<T>* x = neighbors[i];
-
-            typename std::map<Node<T>*, Node<T>*>::iterator pit = predecessors.find(x);
-            double distanceVX = x->getArc(v)->getWeight();
-
-            if(pit != predecessors.end()){
-                if(distances[x] > distanceVX){
-                    distances[x] = distanceVX;
-                    predecessors[x] = v;
-                }
-            } else {
-                distances.insert(std::make_pair(x, distanceVX));
-                predecessors.insert(std::make_pair(x, v));
-                frontier.push_back(x);
+                markVisited(x);
+                pathDistances[x->position] = distance;
+                pathArcs[x->position] = a;
+                frontier.push(std::make_pair(distance, x->position));
             }
-        }
-        if(v == destination)
-            v2visited = true;
-
-    } while(!v2visited && frontier.size() > 0);
+        });
+    }
 
-    if(!v2visited)
+    if(!isMarkedVisited(destination))
         return shortestPath;
 
-    Node<T>* v_ = destination;
-    v = predecessors[destination];
-    shortestPath.push_back(v->getArc(v_));
-
-    while(v != source && v != nullptr){
-        v_ = v;
-        v  = predecessors[v];
-        shortestPath.insert(shortestPath.begin(), v->getArc(v_));
-    }
+    for(Node<T>* v = destination; v != source; v = pathArcs[v->position]->getOppositeNode(v))
+        shortestPath.push_back(pathArcs[v->position]);
+    std::reverse(shortestPath.begin(), shortestPath.end());
 
     return shortestPath;
 
@@ -318,7 +479,9 @@ std::vector<Arc<T> *> Graph<T>::shortestPathSearch(Node<T> *source, Node<T> *des
 template<class T>
 bool Graph<T>::addNode(Node<T> *n)
 {
+    n->position = nodes.size();
     nodes.push_back(n);
+    dataNodes.insert(n);
     return true;
 }
 
@@ -333,13 +496,18 @@ bool Graph<T>::addNode(T data)
 template<class T>
 bool Graph<T>::removeNode(Node<T> *n)
 {
-    auto it = std::find(nodes.begin(), nodes.end(), n);
-    if(it != nodes.end())
-    {
-        nodes.erase(it);
-        return true;
-    }
-    return false;
+    if(n == nullptr || n->position >= nodes.size() || nodes[n->position] != n)
+        return false;
+    //The arcs of the node leave the graph with it (they are not deleted), so that no arc of the graph leads to a node out of it
+    for(auto a : n->getArcs())
+        removeArc(a);
+    std::size_t position = n->position;
+    nodes[position] = nodes.back();
+    nodes[position]->position = position;
+    nodes.pop_back();
+    n->position = std::numeric_limits<std::size_t>::max();
+    dataNodes.erase(n, nodes);
+    return true;
 }
 
 template<class T>
@@ -347,7 +515,9 @@ bool Graph<T>::addArc(Arc<T>* a)
 {
     a->getN1()->addArc(a);
     a->getN2()->addArc(a);
+    a->position = this->arcs.size();
     this->arcs.push_back(a);
+    indexArcType(a);
     return true;
 }
 
@@ -362,52 +532,107 @@ bool Graph<T>::addArc(Node<T> *n1, Node<T> *n2, double weight, bool directed)
 template<class T>
 bool Graph<T>::removeArc(Arc<T> *a)
 {
-    typename std::vector<Arc<T>*>::iterator it;
-    for(it = this->arcs.begin(); it != this->arcs.end(); it++)
-        if(*it == a)
-            break;
+    if(a == nullptr || a->position >= this->arcs.size() || this->arcs[a->position] != a)
+        return false;
+
+    a->getN1()->removeArc(a);
+    a->getN2()->removeArc(a);
+    std::size_t position = a->position;
+    this->arcs[position] = this->arcs.back();
+    this->arcs[position]->position = position;
+    this->arcs.pop_back();
+    a->position = std::numeric_limits<std::size_t>::max();
+    removeArcType(a);
+    return true;
 
-    if(it != this->arcs.end()){
-        (*it)->getN1()->removeArc(*it);
-        (*it)->getN2()->removeArc(*it);
-        this->arcs.erase(it);
-        return true;
+}
+
+template<class T>
+std::vector<Arc<T> *> Graph<T>::addArcs(const std::vector<Node<T> *> &endpoints, const std::vector<std::string> &labels, double weight,
+                                        bool directed, unsigned int firstId)
+{
+    std::size_t arcsNumber = labels.size();
+    std::vector<Arc<T>*> added;
+    if(endpoints.size() != 2 * arcsNumber)
+        return added;
+    for(auto n : endpoints)
+        if(!contains(n))
+            return added;
+
+    //Labels and types of the distinct labels, interned once
+    std::unordered_map<std::string, std::pair<unsigned int, unsigned int> > labelIds;
+    std::vector<std::size_t> outgoing(nodes.size(), 0), incoming(nodes.size(), 0), typed(typeArcs.size(), 0);
+    auto pool = std::make_shared<std::vector<Arc<T> > >();
+    pool->reserve(arcsNumber);
+    for(std::size_t i = 0; i < arcsNumber; i++)
+    {
+        auto it = labelIds.find(labels[i]);
+        if(it == labelIds.end())
+        {
+            std::pair<unsigned int, unsigned int> ids;
+            LabelRegistry::intern(labels[i], ids.first, ids.second);
+            it = labelIds.insert(std::make_pair(labels[i], ids)).first;
+        }
+        //The fields are set directly, skipping the lookup of the label in the registry made by the constructor
+        pool->emplace_back();
+        Arc<T>& a = pool->back();
+        a.n1 = endpoints[2 * i];
+        a.n2 = endpoints[2 * i + 1];
+        a.weight = weight;
+        a.directed = directed;
+        a.id = firstId + static_cast<unsigned int>(i);
+        a.info = nullptr;
+        a.labelId = it->second.first;
+        a.typeId = it->second.second;
+        a.pooled = true;
+        outgoing[a.n1->position]++;
+        incoming[a.n2->position]++;
+        if(a.typeId >= typed.size())
+            typed.resize(a.typeId + 1, 0);
+        typed[a.typeId]++;
     }
 
-    return false;
+    //Counting pass above, filling pass below: each list grows at most once
+    if(typeArcs.size() < typed.size())
+        typeArcs.resize(typed.size());
+    for(std::size_t i = 0; i < nodes.size(); i++)
+    {
+        if(outgoing[i] > 0)
+            nodes[i]->outgoingArcs.reserve(nodes[i]->outgoingArcs.size() + outgoing[i]);
+        if(incoming[i] > 0)
+            nodes[i]->incomingArcs.reserve(nodes[i]->incomingArcs.size() + incoming[i]);
+    }
+    for(std::size_t i = 0; i < typed.size(); i++)
+        if(typed[i] > 0)
+            typeArcs[i].reserve(typeArcs[i].size() + typed[i]);
+    arcs.reserve(arcs.size() + arcsNumber);
+    added.reserve(arcsNumber);
+    for(auto &a : *pool)
+    {
+        a.fletchingPosition = a.n1->outgoingArcs.size();
+        a.n1->outgoingArcs.push_back(&a);
+        a.tipPosition = a.n2->incomingArcs.size();
+        a.n2->incomingArcs.push_back(&a);
+        a.position = arcs.size();
+        arcs.push_back(&a);
+        indexArcType(&a);
+        added.push_back(&a);
+    }
+    arcPools.push_back(pool);
 
+    return added;
 }
 
 template<class T>
 std::vector<Arc<T> *> Graph<T>::getArcsFromFletching(Node<T> *n, std::string type)
 {
-    std::vector<Arc<T> *> arcs;
-    toLowerCase(type);
-    for(unsigned int i = 0; i < this->arcs.size(); i++)
-    {
-        std::string label = this->arcs[i]->getLabel();
-        toLowerCase(label);
-        if(this->arcs[i]->getN1() == n &&
-          (type.compare("") == 0 || type.compare(label) == 0))
-            arcs.push_back(this->arcs[i]);
-    }
-    return arcs;
+    return filterArcs(n->getOutgoingArcs(), type);
 }
 
 template<class T>
 std::vector<Arc<T> *> Graph<T>::getArcsFromTip(Node<T> *n, std::string type)
 {
-    std::vector<Arc<T> *> arcs;
-    toLowerCase(type);
-    for(unsigned int i = 0; i < this->arcs.size(); i++)
-    {
-        std::string label = this->arcs[i]->getLabel();
-        toLowerCase(label);
-        if(this->arcs[i]->getN2() == n &&
-          (type.compare("") == 0 || type.compare(label) == 0))
-            arcs.push_back(this->arcs[i]);
-    }
-    return arcs;
+    return filterArcs(n->getIncomingArcs(), type);
 }
 
 
@@ -419,19 +644,24 @@ std::vector<Arc<T> *> Graph<T>::getArcsFromEndpoints(Node<T> *n1, Node<T> *n2, s
         std::vector<Arc<T> *> empty;
         return empty;
     }
-    std::vector<Arc<T> *> arcs = n1->getArcs();
-    toLowerCase(type);
-    for(unsigned int i = 0; i < arcs.size(); i++)
-    {
-        std::string label = this->arcs[i]->getLabel();
-        toLowerCase(label);
-        if(arcs[i]->getN1() == n1 && arcs[i]->getN2() != n2 ||
-           arcs[i]->getN2() == n1 && arcs[i]->getN1() != n2 ||
-          (type.compare("") != 0 && type.compare(label) != 0))
-            arcs.erase(arcs.begin() + i--);
-    }
+    std::vector<Arc<T> *> arcs;
+    for(auto arc : n1->getOutgoingArcs())
+        if(arc->getN2() == n2)
+            arcs.push_back(arc);
+    for(auto arc : n1->getIncomingArcs())
+        if(arc->getN1() == n2)
+            arcs.push_back(arc);
+
+    return filterArcs(arcs, type);
+}
 
-    return arcs;
+template<class T>
+std::vector<Arc<T> *> Graph<T>::getTypedArcs(std::string type) const
+{
+    unsigned int typeId = LabelRegistry::findType(type);
+    if(typeId >= typeArcs.size())
+        return std::vector<Arc<T> *>();
+    return typeArcs[typeId];
 }
 
 template<class T>
@@ -466,10 +696,7 @@ void Graph<T>::removeRedundancies()
 template<class T>
 Node<T> *Graph<T>::getNodeFromData(T data)
 {
-    for(unsigned int i = 0; i < nodes.size(); i++)
-        if(nodes[i]->getData() == data)
-            return nodes[i];
-    return nullptr;
+    return dataNodes.find(data, nodes);
 }
 
 template<class T>
@@ -482,13 +709,21 @@ template<class T>
 void Graph<T>::setNodes(const std::vector<Node<T> *> &value)
 {
     this->nodes = value;
+    dataNodes.clear();
+    for(std::size_t i = 0; i < nodes.size(); i++)
+    {
+        nodes[i]->position = i;
+        dataNodes.insert(nodes[i]);
+    }
 }
 
 template<class T>
 void Graph<T>::clearNodes()
 {
     clearArcs();
-    nodes.reset();
+    nodes.clear();
+    dataNodes.clear();
+    nodePools.clear();
 }
 
 template<class T>
@@ -500,41 +735,137 @@ std::vector<Arc<T> *> Graph<T>::getArcs() const
 template<class T>
 std::vector<Arc<T> *> Graph<T>::getArcs(Node<T> *n, std::string type) const
 {
-    std::vector<Arc<T> *> arcs;
-    toLowerCase(type);
-    for(unsigned int i = 0; i < this->arcs.size(); i++)
-    {
-        std::string label = this->arcs[i]->getLabel();
-        toLowerCase(label);
-        if((this->arcs[i]->getN1() == n || this->arcs[i]->getN1() == n) &&
-           (type.compare("") == 0 || type.compare(label) == 0))
-            arcs.push_back(this->arcs[i]);
-    }
-    return arcs;
+    return filterArcs(n->getArcs(), type);
+}
+
+template<class T>
+std::size_t Graph<T>::getArcsNumber() const
+{
+    return arcs.size();
 }
 
 template<class T>
 void Graph<T>::setArcs(const std::vector<Arc<T> *> &value)
 {
+    //The pooled arcs may be among the new ones, so their blocks are kept
+    std::vector<std::shared_ptr<std::vector<Arc<T> > > > pools = arcPools;
+    clearArcs();
+    arcPools = pools;
     this->arcs = value;
+    indexArcs();
 }
 
 template<class T>
 void Graph<T>::clearArcs()
 {
+    //The arcs are not deleted, but they are detached from their endpoints (the pooled ones are released with their blocks)
+    for(auto n : nodes)
+        n->clearArcs();
     arcs.clear();
+    typeArcs.clear();
+    arcPools.clear();
 }
 
 template<class T>
 void Graph<T>::toLowerCase(std::string &s) const
 {
-    char* c_s = new char[s.size() + 1];
-    for(unsigned int i = 0; i < s.size(); i++)
+    for(auto &c : s)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+template<class T>
+std::vector<Arc<T> *> Graph<T>::filterArcs(const std::vector<Arc<T> *> &arcs, std::string type) const
+{
+    if(type.compare("") == 0)
+        return arcs;
+    std::vector<Arc<T> *> typedArcs;
+    unsigned int typeId = LabelRegistry::findType(type);
+    if(typeId == LabelRegistry::NONE)
+        return typedArcs;
+    for(auto arc : arcs)
+        if(arc->getTypeId() == typeId)
+            typedArcs.push_back(arc);
+    return typedArcs;
+}
+
+template<class T>
+bool Graph<T>::contains(Node<T> *n) const
+{
+    return n != nullptr && n->position < nodes.size() && nodes[n->position] == n;
+}
+
+template<class T>
+void Graph<T>::startVisit()
+{
+    if(visitStamps.size() < nodes.size())
+        visitStamps.resize(nodes.size(), 0);
+    visitEpoch++;
+    //When the counter wraps around, the stamps of old visits could match it again
+    if(visitEpoch == 0)
     {
-        c_s[i] = static_cast<char>(std::tolower(s[i]));
+        std::fill(visitStamps.begin(), visitStamps.end(), 0);
+        visitEpoch = 1;
     }
-    c_s[s.size()] = '\0';
-    s = c_s;
+}
+
+template<class T>
+bool Graph<T>::isMarkedVisited(Node<T> *n) const
+{
+    return visitStamps[n->position] == visitEpoch;
+}
+
+template<class T>
+void Graph<T>::markVisited(Node<T> *n)
+{
+    visitStamps[n->position] = visitEpoch;
+}
+
+template<class T>
+template<class F>
+void Graph<T>::followArcs(Node<T> *n, F f) const
+{
+    //The lists of a node may also hold arcs of other graphs sharing it: the nodes out of this graph are not reached
+    for(auto a : n->getOutgoingArcs())
+        if(contains(a->getN2()))
+            f(a, a->getN2());
+    for(auto a : n->getIncomingArcs())
+        if(!a->isDirected() && a->getN1() != n && contains(a->getN1()))
+            f(a, a->getN1());
+}
+
+template<class T>
+void Graph<T>::indexArcs()
+{
+    for(std::size_t i = 0; i < arcs.size(); i++)
+    {
+        arcs[i]->position = i;
+        arcs[i]->getN1()->addArc(arcs[i]);
+        arcs[i]->getN2()->addArc(arcs[i]);
+        indexArcType(arcs[i]);
+    }
+}
+
+template<class T>
+void Graph<T>::indexArcType(Arc<T> *a)
+{
+    if(a->typeId >= typeArcs.size())
+        typeArcs.resize(a->typeId + 1);
+    a->typePosition = typeArcs[a->typeId].size();
+    typeArcs[a->typeId].push_back(a);
+}
+
+template<class T>
+void Graph<T>::removeArcType(Arc<T> *a)
+{
+    if(a->typeId >= typeArcs.size())
+        return;
+    std::vector<Arc<T>*> &list = typeArcs[a->typeId];
+    std::size_t position = a->typePosition;
+    if(position >= list.size() || list[position] != a)
+        return;
+    list[position] = list.back();
+    list[position]->typePosition = position;
+    list.pop_back();
 }
 
 }
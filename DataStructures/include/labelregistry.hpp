@@ -0,0 +1,192 @@
+#ifndef LABELREGISTRY_H
+#define LABELREGISTRY_H
+
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GraphTemplate {
+
+/**
+ * Registry of the labels of the arcs, shared by all the graphs: each distinct label is stored once and identified by a small integer, so
+ * that arcs store two integers instead of a string and label comparisons are integer comparisons. The type of a label is the id of its
+ * lower case version (the graph queries compare labels ignoring the case), and it is stored with the label, so that interning a known label
+ * costs a single lookup. The memory used is proportional to the number of distinct labels (labels are never removed) and it is released at
+ * exit. The registry can be used from several threads: registering and searching labels by name is serialised, while reading a label by id
+ * takes no lock, since the labels are stored in chunks that never move and each id is published once its label has been written.
+ */
+class LabelRegistry
+{
+public:
+    enum : unsigned int
+    {
+        //Id of the empty label
+        EMPTY = 0,
+        NONE = std::numeric_limits<unsigned int>::max()
+    };
+
+    //Id of a label, registering it if new
+    static unsigned int intern(const std::string& label)
+    {
+        unsigned int labelId, typeId;
+        intern(label, labelId, typeId);
+        return labelId;
+    }
+
+    //Id and type of a label, registering them if new (with a single lock, the lower case version is built only for new labels)
+    static void intern(const std::string& label, unsigned int& labelId, unsigned int& typeId)
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.ids.find(label);
+        if(it != registry.ids.end())
+        {
+            labelId = it->second;
+            typeId = registry.entry(labelId).typeId;
+            return;
+        }
+        std::string lowerCaseLabel = toLowerCase(label);
+        if(lowerCaseLabel == label)
+            typeId = labelId = registry.append(label, NONE);
+        else
+        {
+            auto typeIt = registry.ids.find(lowerCaseLabel);
+            typeId = typeIt != registry.ids.end() ? typeIt->second : registry.append(lowerCaseLabel, NONE);
+            labelId = registry.append(label, typeId);
+        }
+    }
+
+    //Id of a label, NONE if it has never been registered
+    static unsigned int find(const std::string& label)
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.ids.find(label);
+        return it != registry.ids.end() ? it->second : NONE;
+    }
+
+    //Type of a label, registering it if new
+    static unsigned int internType(const std::string& label)
+    {
+        unsigned int labelId, typeId;
+        intern(label, labelId, typeId);
+        return typeId;
+    }
+
+    //Type of a label, NONE if no label of that type has ever been registered
+    static unsigned int findType(const std::string& label)
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.ids.find(label);
+        if(it != registry.ids.end())
+            return registry.entry(it->second).typeId;
+        it = registry.ids.find(toLowerCase(label));
+        return it != registry.ids.end() ? it->second : NONE;
+    }
+
+    //The label with a given id (the reference stays valid, labels are never removed). It takes no lock.
+    static const std::string& getLabel(unsigned int id)
+    {
+        Registry& registry = getRegistry();
+        //Synchronises with the publication of the entry
+        registry.size.load(std::memory_order_acquire);
+        return registry.entry(id).label;
+    }
+
+    //The number of registered labels (ids are 0, ..., size() - 1). It takes no lock.
+    static std::size_t size()
+    {
+        return getRegistry().size.load(std::memory_order_acquire);
+    }
+
+    static std::string toLowerCase(std::string s)
+    {
+        for(auto &c : s)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+protected:
+    struct Entry
+    {
+        std::string label;
+        unsigned int typeId;
+    };
+
+    //The i-th chunk holds 2^(FIRST_CHUNK_BITS + i) entries, enough chunks for any unsigned int id
+    enum : std::size_t
+    {
+        FIRST_CHUNK_BITS = 6,
+        CHUNKS = sizeof(unsigned int) * 8 - FIRST_CHUNK_BITS + 1
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, unsigned int> ids;
+        std::atomic<Entry*> chunks[CHUNKS];
+        //Number of published entries: it is increased after writing an entry, so that the readers of its id see it
+        std::atomic<std::size_t> size{0};
+
+        Registry()
+        {
+            for(auto& chunk : chunks)
+                chunk.store(nullptr);
+            append("", NONE);
+        }
+
+        ~Registry()
+        {
+            for(auto& chunk : chunks)
+                delete[] chunk.load();
+        }
+
+        //Chunk of an id and offset of its entry in the chunk
+        static void locate(unsigned int id, std::size_t& chunk, std::size_t& offset)
+        {
+            std::size_t index = static_cast<std::size_t>(id) + (static_cast<std::size_t>(1) << FIRST_CHUNK_BITS);
+            std::size_t bit = FIRST_CHUNK_BITS;
+            while(index >> (bit + 1))
+                bit++;
+            chunk = bit - FIRST_CHUNK_BITS;
+            offset = index - (static_cast<std::size_t>(1) << bit);
+        }
+
+        Entry& entry(unsigned int id)
+        {
+            std::size_t chunk, offset;
+            locate(id, chunk, offset);
+            return chunks[chunk].load(std::memory_order_acquire)[offset];
+        }
+
+        //Appends a label (called under the lock), whose type is typeId (NONE for the label itself), and returns its id
+        unsigned int append(const std::string& label, unsigned int typeId)
+        {
+            unsigned int id = static_cast<unsigned int>(size.load(std::memory_order_relaxed));
+            std::size_t chunk, offset;
+            locate(id, chunk, offset);
+            if(chunks[chunk].load(std::memory_order_relaxed) == nullptr)
+                chunks[chunk].store(new Entry[static_cast<std::size_t>(1) << (chunk + FIRST_CHUNK_BITS)], std::memory_order_release);
+            Entry& e = chunks[chunk].load(std::memory_order_relaxed)[offset];
+            e.label = label;
+            e.typeId = typeId == NONE ? id : typeId;
+            ids.insert(std::make_pair(label, id));
+            size.store(static_cast<std::size_t>(id) + 1, std::memory_order_release);
+            return id;
+        }
+    };
+
+    static Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+};
+
+}
+#endif // LABELREGISTRY_H
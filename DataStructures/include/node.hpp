@@ -3,12 +3,21 @@
 
 
 #include "arc.hpp"
+#include <cstddef>
+#include <limits>
 #include <map>
 #include <vector>
 #include <iterator>
 
 namespace GraphTemplate {
 
+template <class T>
+class Graph;
+
+/**
+ * Arcs are split in the ones leaving the node (the node is their first endpoint, also for undirected arcs) and the ones entering it.
+ * Each arc stores its position in the two lists, so that it is removed in O(1) by swapping it with the last arc of the list.
+ */
 
 template <class T>
 class Node
@@ -23,6 +32,8 @@ public:
     void setVisited(bool value);
     std::vector<Arc<T> *> getTypedArcs(std::string type) const;
     std::vector<Arc<T> *> getArcs() const;
+    const std::vector<Arc<T> *> &getOutgoingArcs() const;
+    const std::vector<Arc<T> *> &getIncomingArcs() const;
     void addArc(Arc<T>* value);
     void removeArc(Arc<T>* value);
     void setArcs(const std::vector<Arc<T> *> &value);
@@ -30,15 +41,22 @@ public:
     Arc<T>* getArc(Node<T>* n);
 
 protected:
+    friend class Graph<T>;
+
     T data;
-    std::vector<Arc<T>* > arcs;
+    std::vector<Arc<T>* > outgoingArcs;
+    std::vector<Arc<T>* > incomingArcs;
+    //Position of the node in the graph containing it
+    std::size_t position = std::numeric_limits<std::size_t>::max();
     bool visited;
+
+    static bool contains(const std::vector<Arc<T>*> &list, Arc<T>* value, std::size_t Arc<T>::* position);
+    static bool remove(std::vector<Arc<T>*> &list, Arc<T>* value, std::size_t Arc<T>::* position);
 };
 
 template<class T>
 Node<T>::Node()
 {
-    arcs.clear();
     visited = false;
 }
 
@@ -77,57 +95,108 @@ template<class T>
 std::vector<Arc<T> *> Node<T>::getTypedArcs(std::string type) const
 {
     std::vector<Arc<T> *> typedArcs;
-    for(unsigned int i = 0; i < arcs.size(); i++)
-        if(arcs[i]->label.compare(type) == 0)
-            typedArcs.push_back(arcs[i]);
+    //As in Graph, labels are compared ignoring the case
+    unsigned int typeId = LabelRegistry::findType(type);
+    if(typeId == LabelRegistry::NONE)
+        return typedArcs;
+    for(auto arc : getArcs())
+        if(arc->typeId == typeId)
+            typedArcs.push_back(arc);
+    return typedArcs;
 }
 
 template<class T>
 std::vector<Arc<T> *> Node<T>::getArcs() const
 {
+    std::vector<Arc<T> *> arcs(outgoingArcs);
+    //Loops are both leaving and entering the node, but they are reported once
+    for(auto arc : incomingArcs)
+        if(arc->getN1() != this)
+            arcs.push_back(arc);
     return arcs;
 }
 
+template<class T>
+const std::vector<Arc<T> *> &Node<T>::getOutgoingArcs() const
+{
+    return outgoingArcs;
+}
+
+template<class T>
+const std::vector<Arc<T> *> &Node<T>::getIncomingArcs() const
+{
+    return incomingArcs;
+}
+
 template<class T>
 void Node<T>::addArc(Arc<T> *value)
 {
-    arcs.push_back(value);
+    //A loop is added twice (as for its first and its second endpoint): the first time it leaves the node, the second time it enters it
+    if(value->getN1() == this && !contains(outgoingArcs, value, &Arc<T>::fletchingPosition))
+    {
+        value->fletchingPosition = outgoingArcs.size();
+        outgoingArcs.push_back(value);
+    } else if(value->getN2() == this)
+    {
+        value->tipPosition = incomingArcs.size();
+        incomingArcs.push_back(value);
+    }
 }
 
 template<class T>
 void Node<T>::removeArc(Arc<T> *value)
 {
-    typename std::vector<Arc<T>*>::iterator it;
-    for(it = this->arcs.begin(); it != this->arcs.end(); it++)
-        if(*it == value)
-            break;
-    if(it != this->arcs.end())
-        arcs.erase(it);
+    if(value->getN1() != this || !remove(outgoingArcs, value, &Arc<T>::fletchingPosition))
+        remove(incomingArcs, value, &Arc<T>::tipPosition);
 }
 
 template<class T>
 void Node<T>::setArcs(const std::vector<Arc<T> *> &value)
 {
-    arcs = value;
+    clearArcs();
+    for(auto arc : value)
+        addArc(arc);
 }
 
 template<class T>
 void Node<T>::clearArcs()
 {
-    arcs.clear();
+    outgoingArcs.clear();
+    incomingArcs.clear();
 }
 
 template<class T>
 Arc<T>* Node<T>::getArc(Node<T> *n)
 {
-    for(unsigned int i = 0; i < arcs.size(); i++)
-        if((arcs[i]->getN1() == this && arcs[i]->getN2() == n) ||
-           (arcs[i]->getN1() == n && arcs[i]->getN2() == this) )
-            return arcs[i];
+    for(auto arc : outgoingArcs)
+        if(arc->getN2() == n)
+            return arc;
+    for(auto arc : incomingArcs)
+        if(arc->getN1() == n)
+            return arc;
 
     return nullptr;
 }
 
+template<class T>
+bool Node<T>::contains(const std::vector<Arc<T> *> &list, Arc<T> *value, std::size_t Arc<T>::*position)
+{
+    std::size_t p = value->*position;
+    return p < list.size() && list[p] == value;
+}
+
+template<class T>
+bool Node<T>::remove(std::vector<Arc<T> *> &list, Arc<T> *value, std::size_t Arc<T>::*position)
+{
+    if(!contains(list, value, position))
+        return false;
+    std::size_t p = value->*position;
+    list[p] = list.back();
+    list[p]->*position = p;
+    list.pop_back();
+    return true;
+}
+
 }
 
 #endif // NODE_H
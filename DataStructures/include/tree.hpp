@@ -50,14 +50,16 @@ template<typename T>
 TreeNode<T>::TreeNode(const Node<T> *n)
 {
     this->data = n->getData();
-    this->arcs = n->getArcs();
+    this->outgoingArcs = n->getOutgoingArcs();
+    this->incomingArcs = n->getIncomingArcs();
 }
 
 template<typename T>
 TreeNode<T>::TreeNode(const TreeNode<T> *n)
 {
     this->data = n->getData();
-    this->arcs = n->getArcs();
+    this->outgoingArcs = n->getOutgoingArcs();
+    this->incomingArcs = n->getIncomingArcs();
     this->parent = n->getParent();
 }
 
@@ -66,7 +68,7 @@ bool TreeNode<T>::addParentalRelationship(Arc<T> *a)
 {
     if(!a->isDirected() || a->getN1() != this)
         return false;
-    this->arcs.push_back(a);
+    this->addArc(a);
     return true;
 }
 
@@ -137,8 +139,7 @@ void Tree<T>::setPreOrder(bool value)
 template<typename T>
 bool Tree<T>::addNode(TreeNode<T> *n)
 {
-    this->nodes.push_back(n);
-    return true;
+    return Graph<T>::addNode(n);
 }
 
 template<typename T>
@@ -160,11 +161,8 @@ bool Tree<T>::addArc(Arc<T> *a)
 {
     if(!a->isDirected())
         return false;
-    a->getN1()->addArc(a);
     static_cast<TreeNode<T>*>(a->getN2())->setParent(static_cast<TreeNode<T>*>(a->getN1()));
-    a->getN2()->addArc(a);
-    this->arcs.push_back(a);
-    return true;
+    return Graph<T>::addArc(a);
 }
 
 template<typename T>
@@ -1,36 +1,169 @@
+#include <algorithm>
 #include <iostream>
 #include <node.hpp>
 #include <graph.hpp>
 #include <vector>
 
-int main(int argc, char *argv[]){
+static int failures = 0;
 
-    GraphTemplate::Graph<int>* graph = new GraphTemplate::Graph<int>();
+static void check(bool condition, const std::string& message)
+{
+    if(!condition)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static std::vector<int> getData(const std::vector<GraphTemplate::Node<int>*>& nodes)
+{
+    std::vector<int> data;
+    for(auto n : nodes)
+        data.push_back(n->getData());
+    return data;
+}
+
+static double getCost(const std::vector<GraphTemplate::Arc<int>*>& path)
+{
+    double cost = 0;
+    for(auto a : path)
+        cost += a->getWeight();
+    return cost;
+}
+
+//Traversals after removing a node, whose arcs must leave the graph with it
+static void testRemoveNode()
+{
+    GraphTemplate::Graph<int> graph;
+    std::vector<GraphTemplate::Node<int>*> list;
+    for(unsigned int i = 0; i < 3; i++){
+        list.push_back(new GraphTemplate::Node<int>(i));
+        graph.addNode(list[i]);
+    }
+    std::vector<GraphTemplate::Arc<int>*> arcs = {
+        new GraphTemplate::Arc<int>(list[0], list[1], 1, true),
+        new GraphTemplate::Arc<int>(list[1], list[2], 1, true),
+        new GraphTemplate::Arc<int>(list[2], list[0], 1, false)};
+    for(auto a : arcs)
+        graph.addArc(a);
+    check(graph.removeNode(list[2]), "removeNode of a node of the graph");
+    check(!graph.removeNode(list[2]), "removeNode of a removed node");
+    check(graph.getArcsNumber() == 1, "removeNode removes the arcs of the node");
+    check(list[1]->getOutgoingArcs().empty() && list[0]->getIncomingArcs().empty(), "removeNode detaches the arcs from the neighbours");
+    check(graph.breadthFirstVisit(list[0]).size() == 2, "breadthFirstVisit after removeNode");
+    check(graph.depthFirstVisit(list[0]).size() == 2, "depthFirstVisit after removeNode");
+    check(graph.parallelBreadthFirstVisit(list[0]).size() == 2, "parallelBreadthFirstVisit after removeNode");
+    check(graph.breadthFirstSearch(list[0], 2) == nullptr, "breadthFirstSearch of a removed node");
+    check(graph.shortestPathSearch(list[0], list[1]).size() == 1, "shortestPathSearch after removeNode");
+    check(graph.shortestPathSearch(list[0], list[2]).empty(), "shortestPathSearch towards a removed node");
+
+    //An arc added towards a node which is not in the graph is not followed
+    GraphTemplate::Node<int>* outside = new GraphTemplate::Node<int>(3);
+    arcs.push_back(new GraphTemplate::Arc<int>(list[1], outside, 1, true));
+    graph.addArc(arcs.back());
+    check(graph.breadthFirstVisit(list[0]).size() == 2, "breadthFirstVisit does not reach nodes out of the graph");
+    graph.clearArcs();
+    for(auto a : arcs)
+        delete a;
+    for(auto n : list)
+        delete n;
+    delete outside;
+}
+
+//Traversals of a small graph mixing directed and undirected arcs. From each node, the visits follow its outgoing arcs (in insertion order)
+//and then its undirected incoming arcs: directed arcs are never followed backwards.
+static void testVisits()
+{
+    GraphTemplate::Graph<int> graph;
     std::vector<GraphTemplate::Node<int>*> list;
     for(unsigned int i = 0; i < 10; i++){
-        GraphTemplate::Node<int>* n = new GraphTemplate::Node<int>(i);
-        graph->addNode(n);
-        list.push_back(n);
+        list.push_back(new GraphTemplate::Node<int>(i));
+        graph.addNode(list[i]);
     }
+    graph.addArc(list[0], list[1], 1, true);
+    graph.addArc(list[0], list[2], 1, true);
+    graph.addArc(list[3], list[1], 1, true);
+    graph.addArc(list[1], list[4], 1, true);
+    graph.addArc(list[2], list[5], 1, false);
+    graph.addArc(list[2], list[6], 1, true);
+    graph.addArc(list[3], list[7], 1, true);
+    graph.addArc(list[4], list[5], 1, true);
+    graph.addArc(list[4], list[8], 1, true);
+    graph.addArc(list[5], list[9], 1, true);
+
+    std::vector<int> breadthFirst = getData(graph.breadthFirstVisit(list[0]));
+    check(breadthFirst == std::vector<int>({0, 1, 2, 4, 5, 6, 8, 9}), "breadthFirstVisit order");
+    check(getData(graph.depthFirstVisit(list[0])) == std::vector<int>({0, 1, 4, 5, 9, 2, 6, 8}), "depthFirstVisit order");
+    check(getData(graph.depthFirstVisit(list[5])) == std::vector<int>({5, 9, 2, 6}), "depthFirstVisit follows undirected arcs backwards");
+
+    //The order within a level is not deterministic, the reached nodes and the levels are
+    std::vector<int> parallel = getData(graph.parallelBreadthFirstVisit(list[0], 4));
+    check(parallel.size() == breadthFirst.size() && parallel[0] == 0, "parallelBreadthFirstVisit reaches as many nodes as breadthFirstVisit");
+    std::vector<int> sortedParallel = parallel, sortedBreadthFirst = breadthFirst;
+    std::sort(sortedParallel.begin(), sortedParallel.end());
+    std::sort(sortedBreadthFirst.begin(), sortedBreadthFirst.end());
+    check(sortedParallel == sortedBreadthFirst, "parallelBreadthFirstVisit reaches the nodes of breadthFirstVisit");
+    if(parallel.size() == breadthFirst.size())
+        check(std::is_permutation(parallel.begin() + 1, parallel.begin() + 3, breadthFirst.begin() + 1) &&
+              std::is_permutation(parallel.begin() + 3, parallel.begin() + 6, breadthFirst.begin() + 3),
+              "parallelBreadthFirstVisit levels");
+
+    check(graph.breadthFirstSearch(list[0], 8) == list[8], "breadthFirstSearch of a reachable node");
+    check(graph.depthFirstSearch(list[0], 7) == nullptr, "depthFirstSearch of an unreachable node");
+
+    std::vector<GraphTemplate::Arc<int>*> path = graph.shortestPathSearch(list[0], list[9]);
+    check(path.size() == 3 && path[0]->getN2() == list[2] && path[1]->getN2() == list[5] && path[2]->getN2() == list[9],
+          "shortestPathSearch path");
+    check(getCost(path) == 3, "shortestPathSearch cost");
+    check(graph.shortestPathSearch(list[9], list[0]).empty(), "shortestPathSearch does not follow directed arcs backwards");
+
+    std::vector<GraphTemplate::Arc<int>*> arcs = graph.getArcs();
+    graph.clearArcs();
+    for(auto a : arcs)
+        delete a;
+    for(auto n : list)
+        delete n;
+}
+
+//The shortest path minimises the total weight of its arcs (not the weight of the last arc reaching each node), restricted to the arcs
+//whose label contains the requested one
+static void testShortestPath()
+{
+    GraphTemplate::Graph<int> graph;
+    std::vector<GraphTemplate::Node<int>*> list;
+    for(unsigned int i = 0; i < 4; i++){
+        list.push_back(new GraphTemplate::Node<int>(i));
+        graph.addNode(list[i]);
+    }
+    std::vector<GraphTemplate::Arc<int>*> arcs = {
+        new GraphTemplate::Arc<int>(list[0], list[1], 5, false, 0, "MainRoad"),
+        new GraphTemplate::Arc<int>(list[1], list[2], 1, false, 1, "SideRoad"),
+        new GraphTemplate::Arc<int>(list[0], list[2], 3, false, 2, "Path"),
+        new GraphTemplate::Arc<int>(list[2], list[3], 2, false, 3, "road")};
+    for(auto a : arcs)
+        graph.addArc(a);
+
+    std::vector<GraphTemplate::Arc<int>*> path = graph.shortestPathSearch(list[0], list[3]);
+    check(path.size() == 2 && path[0] == arcs[2] && path[1] == arcs[3] && getCost(path) == 5, "shortestPathSearch minimises the total weight");
+    path = graph.shortestPathSearch(list[0], list[3], "ROAD");
+    check(path.size() == 3 && path[0] == arcs[0] && path[1] == arcs[1] && path[2] == arcs[3] && getCost(path) == 8,
+          "shortestPathSearch restricted to a label");
+    check(graph.shortestPathSearch(list[0], list[3], "path").empty(), "shortestPathSearch without a path with the label");
+
+    graph.clearArcs();
+    for(auto a : arcs)
+        delete a;
+    for(auto n : list)
+        delete n;
+}
+
+int main(){
 
+    testRemoveNode();
+    testVisits();
+    testShortestPath();
 
-    graph->addArc(list[0], list[1], 1, true);
-    graph->addArc(list[0], list[2], 1, true);
-    graph->addArc(list[3], list[1], 1, true);
-    graph->addArc(list[1], list[4], 1, true);
-    graph->addArc(list[2], list[5], 1, false);
-    graph->addArc(list[2], list[6], 1, true);
-    graph->addArc(list[3], list[7], 1, true);
-    graph->addArc(list[4], list[5], 1, true);
-    graph->addArc(list[4], list[8], 1, true);
-    graph->addArc(list[5], list[9], 1, true);
-    std::vector<GraphTemplate::Node<int>*> BFVList = graph->breadthFirstVisit(list[0]);
-    std::vector<GraphTemplate::Node<int>*> DFVList = graph->depthFirstVisit(list[0]);
-    std::cout << "Breadth-first visit" << std::endl;
-    for(unsigned int i = 0; i < BFVList.size(); i++)
-        std::cout << BFVList[i]->getData() << std::endl << std::flush;
-
-    std::cout << "Depth-first visit" << std::endl;
-    for(unsigned int i = 0; i < DFVList.size(); i++)
-        std::cout << DFVList[i]->getData() << std::endl << std::flush;
+    if(failures == 0)
+        std::cout << "All graph tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
 }
@@ -2,120 +2,125 @@
 
 /*
  * file: KDTree.hpp
- * author: J. Frederico Carvalho
  *
- * This is an adaptation of the KD-tree implementation in rosetta code
- *  https://rosettacode.org/wiki/K-d_tree
- * It is a reimplementation of the C code using C++.
- * It also includes a few more queries than the original
+ * Static kd-tree over 3D points. The tree is balanced and implicit: node i has children 2i+1 and 2i+2, the points of each node are a
+ * contiguous range of a permuted copy of the input (stored as separate x, y and z arrays) and only the bounding box of each node is stored.
+ * Leaves hold up to LEAF_SIZE points, whose distances from the query are computed at once with SIMD instructions when available.
+ * The construction partitions the points with nth_element, building the independent subtrees of the upper levels in parallel.
+ *
+ * The queries of the original pointer-based implementation (adapted from rosetta code, https://rosettacode.org/wiki/K-d_tree) are kept.
  *
  */
 
-#include <algorithm>
-#include <functional>
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 using point_t = std::vector< double >;
 using indexArr = std::vector< size_t >;
 using pointIndex = typename std::pair< std::vector< double >, size_t >;
-
-class KDNode {
-   public:
-    using KDNodePtr = std::shared_ptr< KDNode >;
-    size_t index;
-    point_t x;
-    KDNodePtr left;
-    KDNodePtr right;
-
-    // initializer
-    KDNode();
-    KDNode(const point_t &, const size_t &, const KDNodePtr &,
-           const KDNodePtr &);
-    KDNode(const pointIndex &, const KDNodePtr &, const KDNodePtr &);
-    ~KDNode();
-
-    // getter
-    double coord(const size_t &);
-
-    // conversions
-    explicit operator bool();
-    explicit operator point_t();
-    explicit operator size_t();
-    explicit operator pointIndex();
-};
-
-using KDNodePtr = std::shared_ptr< KDNode >;
-
-KDNodePtr NewKDNodePtr();
-
-// square euclidean distance
-inline double dist2(const point_t &, const point_t &);
-inline double dist2(const KDNodePtr &, const KDNodePtr &);
-
-// euclidean distance
-inline double dist(const point_t &, const point_t &);
-inline double dist(const KDNodePtr &, const KDNodePtr &);
-
-// Need for sorting
-class comparer {
-   public:
-    size_t idx;
-    explicit comparer(size_t idx_);
-    inline bool compare_idx(
-        const std::pair< std::vector< double >, size_t > &,  //
-        const std::pair< std::vector< double >, size_t > &   //
-    );
-};
-
 using pointIndexArr = typename std::vector< pointIndex >;
-
-inline void sort_on_idx(const pointIndexArr::iterator &,  //
-                        const pointIndexArr::iterator &,  //
-                        size_t idx);
-
 using pointVec = std::vector< point_t >;
+//Index of a point and its squared distance from a query point
+using neighbour_t = std::pair< size_t, double >;
 
 class KDTree {
-    KDNodePtr root;
-    KDNodePtr leaf;
+   public:
+    //Maximum number of points in a leaf
+    static const size_t LEAF_SIZE = 8;
 
-    KDNodePtr make_tree(const pointIndexArr::iterator &begin,  //
-                        const pointIndexArr::iterator &end,    //
-                        const size_t &length,                  //
-                        const size_t &level                    //
-    );
+    KDTree();
 
-   public:
-    KDTree() = default;
+    /**
+     * @brief KDTree constructor from a list of 3D points
+     * @param point_array the points (only the first three coordinates of each one are considered)
+     */
     explicit KDTree(pointVec point_array);
 
-   private:
-    KDNodePtr nearest_(           //
-        const KDNodePtr &branch,  //
-        const point_t &pt,        //
-        const size_t &level,      //
-        const KDNodePtr &best,    //
-        const double &best_dist   //
-    );
-
-    // default caller
-    KDNodePtr nearest_(const point_t &pt);
+    /**
+     * @brief KDTree constructor from a flat array of coordinates
+     * @param coordinates x, y and z of each point, consecutively
+     * @param pointsNumber the number of points
+     * @param threadsNumber maximum number of threads used for the construction (0 means one per hardware thread)
+     */
+    KDTree(const double* coordinates, size_t pointsNumber, unsigned int threadsNumber = 0);
+
+    /**
+     * @brief build method that (re)builds the tree over a flat array of coordinates. The array is not referenced after the construction.
+     * @param coordinates x, y and z of each point, consecutively
+     * @param pointsNumber the number of points
+     * @param threadsNumber maximum number of threads used for the construction (0 means one per hardware thread)
+     */
+    void build(const double* coordinates, size_t pointsNumber, unsigned int threadsNumber = 0);
+
+    /**
+     * @brief size method that returns the number of points indexed by the tree
+     * @return the number of points
+     */
+    size_t size() const;
+
+    /**
+     * @brief refit method that updates the tree after the points moved, keeping its structure: the coordinates are copied again and the
+     * boxes of the nodes are recomputed bottom-up. Queries stay exact, but they slow down as far as the points drift from their original
+     * arrangement.
+     * @param coordinates x, y and z of each point, consecutively (same points, in the same order, of the construction)
+     * @return the ratio between the overall extent of the leaves after the update and after the construction: the greater it is, the more
+     * the leaves overlap and a rebuild becomes convenient
+     */
+    double refit(const double* coordinates);
+
+    /**
+     * @brief nearest method that searches for the point closest to a query point
+     * @param point x, y and z of the query point
+     * @param squaredDistance if not null, it receives the squared distance of the closest point
+     * @return the index of the closest point in the input array, size() if the tree is empty
+     */
+    size_t nearest(const double* point, double* squaredDistance = nullptr) const;
+
+    /**
+     * @brief radiusSearch method that searches for the points whose distance from a query point is lower than or equal to a radius
+     * @param point x, y and z of the query point
+     * @param radius the radius
+     * @param indices it receives the indices of the found points (in no particular order), previous content is removed
+     */
+    void radiusSearch(const double* point, double radius, std::vector<size_t>& indices) const;
+
+    /**
+     * @brief knnSearch method that searches for the k points closest to a query point, optionally limited to the ones within a certain distance.
+     * Candidates are kept into a bounded max-heap built directly into the result buffer, so that no memory is allocated.
+     * @param point x, y and z of the query point
+     * @param k the maximum number of neighbours
+     * @param result caller-provided buffer of (at least) k entries, receiving the (index, squared distance) pairs of the neighbours sorted by
+     * increasing distance
+     * @param radius if non-negative, only the points whose distance is lower than or equal to radius are reported
+     * @return the number of neighbours written into result
+     */
+    size_t knnSearch(const double* point, size_t k, neighbour_t* result, double radius = -1.0) const;
+
+    /**
+     * @brief capsuleSearch method that searches for the points whose distance from a segment is lower than or equal to a radius. Nodes are
+     * pruned by their distance from the segment, so the visited points are the ones around the capsule and not the ones of the sphere enclosing it.
+     * @param a, b x, y and z of the endpoints of the segment
+     * @param radius the radius of the capsule
+     * @param indices it receives the indices of the found points (in the same relative order of radiusSearch), previous content is removed
+     */
+    void capsuleSearch(const double* a, const double* b, double radius, std::vector<size_t>& indices) const;
+
+    /**
+     * @brief corridorSearch method that searches for the points whose distance from a polyline is lower than or equal to a radius, visiting
+     * the tree once for the whole polyline (each point is reported once)
+     * @param polyline x, y and z of the vertices of the polyline, consecutively
+     * @param verticesNumber the number of vertices of the polyline (a single vertex defines a sphere)
+     * @param radius the half-width of the corridor
+     * @param indices it receives the indices of the found points (in the same relative order of radiusSearch), previous content is removed
+     */
+    void corridorSearch(const double* polyline, size_t verticesNumber, double radius, std::vector<size_t>& indices) const;
 
-   public:
     point_t nearest_point(const point_t &pt);
     size_t nearest_index(const point_t &pt);
     pointIndex nearest_pointIndex(const point_t &pt);
 
-   private:
-    pointIndexArr neighborhood_(  //
-        const KDNodePtr &branch,  //
-        const point_t &pt,        //
-        const double &rad,        //
-        const size_t &level       //
-    );
-
-   public:
     pointIndexArr neighborhood(  //
         const point_t &pt,       //
         const double &rad);
@@ -127,4 +132,37 @@ class KDTree {
     indexArr neighborhood_indices(  //
         const point_t &pt,          //
         const double &rad);
+
+   private:
+    struct Box {
+        double min[3];
+        double max[3];
+    };
+
+    //Coordinates of the points in tree order, and their indices in the input array
+    std::vector< double > xs, ys, zs;
+    std::vector< uint32_t > indices;
+    //Bounding box of each node of the implicit tree
+    std::vector< Box > boxes;
+    //Level of the leaves (the root is at level 0)
+    unsigned int depth = 0;
+    //Sum of the extents (width + height + depth) of the leaves boxes after the construction, used for measuring the effect of refits
+    double builtLeavesExtent = 0;
+
+    void buildNode(size_t node, size_t begin, size_t end, unsigned int level, const double* coordinates, uint32_t* permutation,
+                   unsigned int threadsNumber);
+
+    void refitNode(size_t node, size_t begin, size_t end, unsigned int level, double& leavesExtent);
+
+    void nearestNode(size_t node, size_t begin, size_t end, unsigned int level, const double* point, size_t& best,
+                     double& bestDistance) const;
+
+    void knnNode(size_t node, size_t begin, size_t end, unsigned int level, const double* point, size_t k, neighbour_t* heap, size_t& count,
+                 double squaredRadius) const;
+
+    void radiusNode(size_t node, size_t begin, size_t end, unsigned int level, const double* point, double squaredRadius,
+                    std::vector<size_t>& result) const;
+
+    void corridorNode(size_t node, size_t begin, size_t end, unsigned int level, const double* polyline, double radius,
+                      const uint32_t* active, size_t activeNumber, uint32_t* workspace, std::vector<size_t>& result) const;
 };
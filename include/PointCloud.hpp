@@ -0,0 +1,278 @@
+#ifndef POINTCLOUD_H
+#define POINTCLOUD_H
+
+#include "Point.hpp"
+#include "propertychannel.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <KDTree.hpp>
+
+namespace SemantisedTriangleMesh {
+
+    //Forward declaration to avoid cyclic dependencies issues
+    class TriangleMesh;
+    class ThreadPool;
+
+    /**
+     * @brief The PointCloud class manages sets of 3D points without topology (no edges nor triangles). Coordinates are stored in a flat array and
+     * per-point properties into property channels (as the vertices of TriangleMesh), so that very large clouds fit in memory. Nearest neighbours
+     * and radius queries use the same kd-tree of TriangleMesh.
+     * The vertex storage of TriangleMesh is not shared: the mesh keeps one heap-allocated Vertex per point, together with its incident edges
+     * and triangles, which is what the cloud avoids. A cloud built from a mesh holds its own copy of the coordinates (24 bytes per vertex) and
+     * of the vertex channels, which is a snapshot: later changes to the mesh are not reflected until updateFromMesh is called.
+     */
+    class PointCloud
+    {
+    public:
+        /**
+         * @brief ChunkCallback function receiving the points read from a file one chunk at a time: the coordinates of the chunk (x, y and z of each
+         * point, consecutively), the channels storing the properties of the chunk (if the file defines any) and the number of points of the chunk
+         */
+        typedef std::function<void(const double* coordinates, const std::vector<std::shared_ptr<PropertyChannel> >& channels, std::size_t pointsNumber)> ChunkCallback;
+
+        //Default number of points read at once from files
+        static const std::size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+        //Default constructor
+        PointCloud();
+        //Copy-constructor (channels are deep-copied)
+        PointCloud(const PointCloud& other);
+        //Constructor copying the vertices (and vertex channels) of a mesh (see updateFromMesh)
+        PointCloud(const std::shared_ptr<TriangleMesh>& mesh);
+        //Default destructor
+        ~PointCloud();
+
+        /**
+         * @brief getPointsNumber method that returns the number of points of the cloud
+         * @return the number of points
+         */
+        std::size_t getPointsNumber() const;
+
+        /**
+         * @brief reserve method that preallocates the memory for a certain number of points
+         * @param pointsNumber the number of points
+         */
+        void reserve(std::size_t pointsNumber);
+
+        /**
+         * @brief addPoint method that appends a point to the cloud (its channel values are initialised to 0)
+         * @param x, y, z the coordinates of the point
+         * @return the position of the new point
+         */
+        std::size_t addPoint(double x, double y, double z);
+        std::size_t addPoint(const Point& p);
+
+        /**
+         * @brief getPoint method that returns the coordinates of a point
+         * @param pos the position of the point
+         * @return the point
+         */
+        Point getPoint(std::size_t pos) const;
+
+        /**
+         * @brief setPoint method that moves a point
+         * @param pos the position of the point
+         * @param p the new coordinates
+         */
+        void setPoint(std::size_t pos, const Point& p);
+
+        /**
+         * @brief getCoordinates getter for the flat array of coordinates (x, y and z of each point, consecutively)
+         * @return the array of coordinates
+         */
+        const std::vector<double>& getCoordinates() const;
+
+        /**
+         * @brief updateFromMesh method that replaces the points and channels of the cloud with a copy of the vertices and vertex channels of a
+         * mesh, reusing the memory of the coordinates. It is the way to bring a cloud built from a mesh back in sync after the mesh changes.
+         * @param mesh the mesh
+         */
+        void updateFromMesh(const std::shared_ptr<TriangleMesh>& mesh);
+
+        /**
+         * @brief clear method that removes all the points and channels of the cloud
+         */
+        void clear();
+
+        /**
+         * @brief load method for loading a point cloud. Files with ply extension are read as ply (ascii or binary, only the vertex element is
+         * considered and its scalar properties other than coordinates are stored into channels), any other file is read as xyz (one point per
+         * line, additional columns are ignored). Points are read in chunks, so that the whole file is never kept in memory.
+         * @param filename the complete filepath of the point cloud file
+         * @param chunkSize the number of points read at once
+         * @return 0 if no error occurred during loading, -1 if the file cannot be opened, other values define a specific error (they are the
+         * same of TriangleMesh::load)
+         */
+        int load(std::string filename, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+        /**
+         * @brief stream method that reads a point cloud file chunk by chunk, without storing it. The same formats of load are supported.
+         * @param filename the complete filepath of the point cloud file
+         * @param callback function called for each chunk of points
+         * @param chunkSize the (maximum) number of points of each chunk
+         * @return 0 if no error occurred during reading, other values define a specific error (the same of load)
+         */
+        static int stream(std::string filename, const ChunkCallback& callback, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+        /**
+         * @brief save method for saving the point cloud as ply (channels are written as vertex properties) or xyz file, according to the extension
+         * @param filename the complete filepath of the file
+         * @param precision number of significant digits to be used when saving the coordinates in textual formats
+         * @param binary if true, ply files are written as binary little endian
+         * @return 0 if no error occurred during saving, 1 if the format is not supported, -1 if the file cannot be opened
+         */
+        int save(std::string filename, unsigned int precision = 5, bool binary = false);
+
+        /**
+         * @brief addPointChannel method that adds a per-point property channel to the cloud (initialised to 0 for each point).
+         * @param name the name of the channel
+         * @param type the type of the values
+         * @return the new channel (the existing one if a channel with the same name is already defined)
+         */
+        std::shared_ptr<PropertyChannel> addPointChannel(const std::string& name, ScalarType type);
+
+        /**
+         * @brief getPointChannel method that searches a per-point channel by name
+         * @param name the name of the channel
+         * @return the channel, nullptr if no channel has that name
+         */
+        std::shared_ptr<PropertyChannel> getPointChannel(const std::string& name) const;
+
+        /**
+         * @brief removePointChannel method that removes a per-point channel
+         * @param name the name of the channel
+         * @return true if the channel has been removed, false if no channel has that name
+         */
+        bool removePointChannel(const std::string& name);
+
+        /**
+         * @brief getPointChannels getter for the list of per-point channels
+         * @return the list of channels
+         */
+        const std::vector<std::shared_ptr<PropertyChannel> >& getPointChannels() const;
+
+        /**
+         * @brief getNearestNeighbours method for searching the points lying inside a sphere
+         * @param p the centre of the sphere
+         * @param radius the radius of the sphere
+         * @return the positions of the points inside the sphere
+         */
+        std::vector<std::size_t> getNearestNeighbours(const Point& p, double radius);
+
+        /**
+         * @brief searchNearestNeighbours method for searching for the k points closest to a query point, optionally within a certain radius,
+         * without allocating memory
+         * @param p the query point
+         * @param k the maximum number of neighbours
+         * @param result caller-provided buffer of (at least) k entries, receiving the (point position, squared distance) pairs of the neighbours
+         * sorted by increasing distance
+         * @param radius if positive, only the points whose distance is lower than or equal to radius are reported
+         * @return the number of neighbours written into result
+         */
+        std::size_t searchNearestNeighbours(const Point& p, std::size_t k, neighbour_t* result, double radius = 0.0);
+
+        /**
+         * @brief searchNearestNeighbours batch version of the k nearest neighbours search, running the queries in parallel
+         * @param queries the coordinates of the query points (x, y and z of each point, consecutively)
+         * @param queriesNumber the number of query points
+         * @param k the maximum number of neighbours of each query point
+         * @param results caller-provided buffer of queriesNumber * k entries: the neighbours of the i-th query point are written, sorted by
+         * increasing distance, starting from position i * k
+         * @param counts caller-provided buffer of queriesNumber entries, receiving the number of neighbours found for each query point
+         * @param radius if positive, only the points whose distance is lower than or equal to radius are reported
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void searchNearestNeighbours(const double* queries, std::size_t queriesNumber, std::size_t k, neighbour_t* results, std::size_t* counts,
+                                     double radius = 0.0, ThreadPool* pool = nullptr);
+
+        /**
+         * @brief getClosestPoint method for searching the point of the cloud closest to a query point
+         * @param p the query point
+         * @return the position of the closest point, getPointsNumber() if the cloud is empty
+         */
+        std::size_t getClosestPoint(const Point& p);
+
+        /**
+         * @brief getClosestPoints batch version of getClosestPoint, running the queries in parallel over the (read-only) kd-tree
+         * @param queries the coordinates of the query points (x, y and z of each point, consecutively)
+         * @param queriesNumber the number of query points
+         * @param indices caller-provided buffer of queriesNumber entries, receiving the position of the point closest to each query point
+         * @param squaredDistances optional caller-provided buffer of queriesNumber entries, receiving the squared distances of the closest points
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void getClosestPoints(const double* queries, std::size_t queriesNumber, std::size_t* indices, double* squaredDistances = nullptr,
+                              ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeProperties method that updates the AABB of the cloud
+         */
+        void computeProperties();
+
+        /**
+         * @brief getMin getter method for the min corner of the AABB (minX, minY, minZ)
+         * @return the corner Point
+         */
+        Point getMin() const;
+
+        /**
+         * @brief getMax getter method for the max corner of the AABB (maxX, maxY, maxZ)
+         * @return the corner Point
+         */
+        Point getMax() const;
+
+    protected:
+        /**
+         * @brief coordinates flat array of coordinates (x, y and z of each point, consecutively)
+         */
+        std::vector<double> coordinates;
+
+        /**
+         * @brief pointChannels per-point property channels, indexed by the position of the point
+         */
+        std::vector<std::shared_ptr<PropertyChannel> > pointChannels;
+
+        /**
+         * @brief kdtree data structure for speeding up spatial queries (built on demand, reset whenever points change)
+         */
+        std::shared_ptr<KDTree> kdtree;
+
+        /**
+         * @brief kdtreeMutex mutex serialising the lazy initialisation of the kd-tree when queries are issued by several threads
+         */
+        std::mutex kdtreeMutex;
+
+        /**
+         * @brief min, max min and max corner of the AABB
+         */
+        Point min, max;
+
+        /**
+         * @brief initialiseKDTree method for explicitly requesting the initialisation of the kd-tree
+         */
+        void initialiseKDTree();
+
+        /**
+         * @brief getKDTree method that returns the kd-tree, initialising it if needed. It is safe to call it from several threads at once.
+         * @return the kd-tree
+         */
+        std::shared_ptr<KDTree> getKDTree();
+
+        /**
+         * @brief readPoints support method for load and stream, reading a file chunk by chunk
+         * @param filename the complete file path
+         * @param callback function called for each chunk of points
+         * @param chunkSize the (maximum) number of points of each chunk
+         * @param expectedPoints updated before each call to the callback with the (estimated) number of points of the whole file
+         * @return error code, 0 if no error occurred
+         */
+        static int readPoints(std::string filename, const ChunkCallback& callback, std::size_t chunkSize, std::size_t& expectedPoints);
+
+        static int readPLYPoints(std::istream& stream, const ChunkCallback& callback, std::size_t chunkSize, std::size_t& expectedPoints);
+        static int readXYZPoints(std::istream& stream, std::streamoff fileSize, const ChunkCallback& callback, std::size_t chunkSize, std::size_t& expectedPoints);
+    };
+
+}
+#endif // POINTCLOUD_H
@@ -6,20 +6,37 @@
 #include "Triangle.hpp"
 #include "annotation.hpp"
 #include "graph.hpp"
+#include "meshcache.hpp"
+#include "propertychannel.hpp"
+#include "spatialhash.hpp"
 #include <memory>
 #include <KDTree.hpp>
+#include <atomic>
+#include <future>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
 
 namespace SemantisedTriangleMesh {
 
     const double EPSILON = 1e-6;
     //Enumeration of distance metrics used for shortest path computation
     enum class DistanceType {SEGMENT_DISTANCE, EUCLIDEAN_DISTANCE, COMBINED_DISTANCE};
+    //Enumeration of search strategies for point-to-point shortest paths (all of them find a shortest path)
+    enum class PathSearchStrategy {DIJKSTRA, A_STAR, BIDIRECTIONAL};
+    //Enumeration of methods for computing geodesic distance fields
+    enum class GeodesicMethod {FAST_MARCHING, HEAT_METHOD};
     //Enumeration of laplacian weights for smoothing
     enum class WeightType { Linear, Cotangent };
 
     //Forward declaration to avoid cyclic dependencies issues
     class Annotation;
+    class ThreadPool;
+    class TriangleBVH;
+    class TriangleLocator;
+    class GeodesicSolver;
 
     /**
      * @brief The TriangleMesh class allows to manage 3D triangle meshes.
@@ -27,6 +44,43 @@ namespace SemantisedTriangleMesh {
     class TriangleMesh
     {
     public:
+        /**
+         * @brief The SurfacePoint struct describes a point lying on a triangle of the mesh
+         */
+        struct SurfacePoint
+        {
+            //The triangle containing the point (nullptr if the point has not been found)
+            std::shared_ptr<Triangle> triangle;
+            //Barycentric coordinates of the point with respect to the vertices V1, V2 and V3 of the triangle
+            double barycentric[3];
+            //The point
+            Point point;
+            //Distance between the point and the query point
+            double distance;
+        };
+
+        /**
+         * @brief The PathQuery struct describes a shortest path query: its endpoints and the metric of the path
+         */
+        struct PathQuery
+        {
+            std::shared_ptr<Vertex> source, target;
+            DistanceType metric;
+        };
+
+        /**
+         * @brief The DistanceStatistics struct summarises the distances between the surface of a mesh and another mesh
+         */
+        struct DistanceStatistics
+        {
+            //Largest distance found, over samples and vertices (an estimate from below of the Hausdorff distance)
+            double max;
+            //Mean and root mean square of the distances of the surface samples (which are uniformly distributed over the area)
+            double mean, rms;
+            //Number of surface samples (vertices excluded)
+            std::size_t samplesNumber;
+        };
+
         //Default constructor
         TriangleMesh();
         //Copy-constructor (copies attributes values)
@@ -70,9 +124,10 @@ namespace SemantisedTriangleMesh {
         std::shared_ptr<Vertex> addNewVertex(Point p);
 
         /**
-         * @brief addNewVertex method that adds a new vertex to the mesh copying the attributes defined by the parameter
-         * @param v the point from which attributes will be copied
-         * @return the added vertex
+         * @brief addNewVertex method that adds a vertex to the mesh, unless a vertex with the same XY coordinates already exists (the lookup
+         * uses a hash of the XY coordinates of the vertices, so it takes constant time on average)
+         * @param v the vertex to be added
+         * @return the added vertex, or the first vertex of the mesh having the same XY coordinates
          */
         std::shared_ptr<Vertex> addNewVertex(std::shared_ptr<Vertex> v);
 
@@ -240,19 +295,91 @@ namespace SemantisedTriangleMesh {
         void removeFlaggedTriangles();
 
         /**
-         * @brief load method for loading a triangular 3D mesh. Currently only ascii-based ply file are supported.
+         * @brief load method for loading a triangular 3D mesh. The format is chosen according to the extension of the file: ply (ascii or binary),
+         * obj, off and stl (ascii or binary) files are supported (files with other extensions are read as ply). Vertex and face properties of ply
+         * files other than coordinates and vertex indices are stored into the vertex and triangle channels of the mesh. Polygonal faces are split
+         * as fans of triangles and the triangle soup of stl files is welded into an indexed mesh.
          * @param filename the complete filepath of the mesh file
          * @return 0 if no error occurred during loading, other values define a specific error (list will be produced in the future)
          */
         int load(std::string filename);
 
         /**
-         * @brief save method for saving a triangular 3D mesh. Currently only ascii-based ply file are supported.
+         * @brief save method for saving a triangular 3D mesh. The format is chosen according to the extension of the file among ply, obj, off, stl
+         * and xyz (vertices only). Vertex and triangle channels are written as properties of the corresponding elements of ply files.
          * @param filename the complete filepath of the mesh file
-         * @param precision number of decimal numbers to be used when saving the vertices coordinates
+         * @param precision number of significant digits to be used when saving the vertices coordinates in textual formats
+         * @param binary if true, ply files are written as binary little endian and stl files as binary stl, otherwise both are written as ascii
          * @return 0 if no error occurred during saving, other values define a specific error (list will be produced in the future)
          */
-        int save(std::string filename, unsigned int precision = 5);
+        int save(std::string filename, unsigned int precision = 5, bool binary = false);
+
+        /**
+         * @brief buildFromArrays method that appends to the mesh the vertices and the triangles described by two flat arrays, building the
+         * edges and the adjacency relations in linear time. Triangles referring twice to the same vertex are discarded.
+         * @param coordinates the coordinates of the vertices (x, y and z of each vertex, consecutively)
+         * @param faces the indices of the vertices of each triangle (three consecutive values for each triangle), relative to the
+         * coordinates array
+         * @return 0 if no error occurred, 9 if an edge is shared by more than two triangles, 11 if a face refers to a non-existent vertex
+         * (in both cases the mesh is left unchanged)
+         */
+        int buildFromArrays(const std::vector<double>& coordinates, const std::vector<unsigned int>& faces);
+
+        /**
+         * @brief addVertexChannel method that adds a per-vertex property channel to the mesh (initialised to 0 for each vertex).
+         * @param name the name of the channel
+         * @param type the type of the values stored into the channel
+         * @return the added channel, or the already existing one if a channel with the same name was already defined
+         */
+        std::shared_ptr<PropertyChannel> addVertexChannel(const std::string& name, ScalarType type);
+
+        /**
+         * @brief getVertexChannel method that returns a per-vertex property channel by name
+         * @param name the name of the channel
+         * @return the channel, nullptr if the mesh has no channel with such name
+         */
+        std::shared_ptr<PropertyChannel> getVertexChannel(const std::string& name) const;
+
+        /**
+         * @brief removeVertexChannel method that removes a per-vertex property channel by name
+         * @param name the name of the channel
+         * @return true if the channel has been removed, false if it was not defined
+         */
+        bool removeVertexChannel(const std::string& name);
+
+        /**
+         * @brief getVertexChannels getter for the per-vertex property channels of the mesh
+         * @return the list of channels
+         */
+        const std::vector<std::shared_ptr<PropertyChannel> >& getVertexChannels() const;
+
+        /**
+         * @brief addTriangleChannel method that adds a per-triangle property channel to the mesh (initialised to 0 for each triangle).
+         * @param name the name of the channel
+         * @param type the type of the values stored into the channel
+         * @return the added channel, or the already existing one if a channel with the same name was already defined
+         */
+        std::shared_ptr<PropertyChannel> addTriangleChannel(const std::string& name, ScalarType type);
+
+        /**
+         * @brief getTriangleChannel method that returns a per-triangle property channel by name
+         * @param name the name of the channel
+         * @return the channel, nullptr if the mesh has no channel with such name
+         */
+        std::shared_ptr<PropertyChannel> getTriangleChannel(const std::string& name) const;
+
+        /**
+         * @brief removeTriangleChannel method that removes a per-triangle property channel by name
+         * @param name the name of the channel
+         * @return true if the channel has been removed, false if it was not defined
+         */
+        bool removeTriangleChannel(const std::string& name);
+
+        /**
+         * @brief getTriangleChannels getter for the per-triangle property channels of the mesh
+         * @return the list of channels
+         */
+        const std::vector<std::shared_ptr<PropertyChannel> >& getTriangleChannels() const;
 
         /**
          * @brief removeIsolatedVertices method for removing vertices that aren't connected to any edge.
@@ -279,17 +406,116 @@ namespace SemantisedTriangleMesh {
         std::shared_ptr<Edge> searchEdgeContainingVertex(std::vector<std::shared_ptr<Edge> > list, std::shared_ptr<Vertex> v);
 
         /**
-         * @brief computeShortestPath approximate version of the famous Dijkstra algorithm for the shortest path computation. The method stops the search for better paths whenever
-         * it finds the target vertex v2
+         * @brief computeShortestPath Dijkstra algorithm for the shortest path computation over the edges of the mesh. The frontier is kept in an
+         * indexed binary heap (ties are broken by discovery order) over the positions of the vertices, and the search stops as soon as the
+         * target vertex v2 is extracted.
+         * Since the target is known, the search can be goal-directed: A* orders the frontier by the distance from the origin plus a lower
+         * bound of the distance to v2 (the straight-line one for EUCLIDEAN_DISTANCE and COMBINED_DISTANCE, none for SEGMENT_DISTANCE), while
+         * the bidirectional search grows two frontiers, from v1 and from v2, until they meet. Both expand far fewer vertices than Dijkstra
+         * when the path is short with respect to the mesh, and find a path of the same length (the vertices may differ between paths of equal length).
          * @param v1 the origin of the path
          * @param v2 the target position of the path
          * @param metric the metric to be used for the distance computation
+         * @param useHeight if not checked, distances are measured on the projection of the mesh onto the XY plane
          * @param avoidUsed if checked, gives &infin; weight to the already used arcs, to avoid intersections
          * @param directed if checked allows to reduce computation time choosing vertices in the frontier that are closer to the target in an Euclidean way
-         * (doesn't work well with very geodesically distant target vertices in high curvature meshes)
-         * @return the shortest path (as list of successive vertices) connecting v1 and v2
-         */
-        std::vector<std::shared_ptr<Vertex> > computeShortestPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const DistanceType metric, const bool useHeight, const bool directed, const bool avoidUsed);
+         * (doesn't work well with very geodesically distant target vertices in high curvature meshes). It overrides the strategy.
+         * @param strategy the search strategy
+         * @return the shortest path (as list of successive vertices, v1 excluded) connecting v1 and v2, empty if v2 cannot be reached
+         */
+        std::vector<std::shared_ptr<Vertex> > computeShortestPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const DistanceType metric, const bool useHeight, const bool directed, const bool avoidUsed,
+                                                                  const PathSearchStrategy strategy = PathSearchStrategy::DIJKSTRA);
+
+        /**
+         * @brief computeShortestPaths batch version of computeShortestPath (e.g. for joining the consecutive vertices of an outline), running
+         * the queries in parallel. Each thread reuses the same search workspace for all its queries, whose distances are invalidated by a
+         * generation counter instead of being cleared, so that a query costs only the vertices it visits.
+         * @param queries the queries
+         * @param useHeight if not checked, distances are measured on the projection of the mesh onto the XY plane
+         * @param directed if checked, the vertex of the frontier most aligned with the target is expanded (see computeShortestPath)
+         * @param avoidUsed if checked, gives &infin; weight to the already used arcs (the flags must not be changed while the queries run)
+         * @param strategy the search strategy
+         * @param pool the pool running the queries (the default one if nullptr)
+         * @return the paths (v1 excluded, as returned by computeShortestPath), in the order of the queries
+         */
+        std::vector<std::vector<std::shared_ptr<Vertex> > > computeShortestPaths(const std::vector<PathQuery>& queries, const bool useHeight, const bool directed,
+                                                                                 const bool avoidUsed,
+                                                                                 const PathSearchStrategy strategy = PathSearchStrategy::DIJKSTRA,
+                                                                                 ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeGeodesicDistances method for computing the geodesic distance of every vertex from the closest of a set of source vertices
+         * (one-to-many), measured over the surface rather than along the edges. Fast marching propagates the distances from the sources in
+         * increasing order and can stop at a maximum distance; the heat method solves two sparse linear systems, which are factorised at its
+         * first use and reused until the mesh changes, so that further fields cost two back-substitutions.
+         * @param sources the source vertices
+         * @param distances caller-provided buffer of getVerticesNumber() entries, receiving the distances (infinity for the vertices that cannot
+         * be reached, or farther than maxDistance)
+         * @param method the method
+         * @param maxDistance the distance at which fast marching stops (ignored by the heat method)
+         * @param pool the pool running the per-triangle and per-vertex steps of the heat method (the default one if nullptr)
+         * @return false if the heat method could not factorise its systems (the distances are then all infinite), true otherwise
+         */
+        bool computeGeodesicDistances(const std::vector<std::shared_ptr<Vertex> >& sources, double* distances,
+                                      const GeodesicMethod method = GeodesicMethod::FAST_MARCHING,
+                                      const double maxDistance = std::numeric_limits<double>::max(), ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeGeodesicDistances method for computing the geodesic distance of every vertex from the closest vertex involved in an
+         * annotation (its points, its polylines or its outlines)
+         * @param annotation the annotation
+         * @param distances caller-provided buffer of getVerticesNumber() entries, receiving the distances
+         * @param method the method
+         * @param maxDistance the distance at which fast marching stops (ignored by the heat method)
+         * @param pool the pool running the per-triangle and per-vertex steps of the heat method (the default one if nullptr)
+         * @return false if the heat method could not factorise its systems, true otherwise
+         */
+        bool computeGeodesicDistances(const std::shared_ptr<Annotation>& annotation, double* distances,
+                                      const GeodesicMethod method = GeodesicMethod::FAST_MARCHING,
+                                      const double maxDistance = std::numeric_limits<double>::max(), ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeGeodesicDistances batch version of computeGeodesicDistances (e.g. for a field from each point annotation), computing
+         * the fields in parallel. Fast marching is sequential within a field, so this is the way of using several cores with it; the heat
+         * method also splits the steps of each field among the threads of the pool.
+         * @param sources the source vertices of each field
+         * @param distances caller-provided buffers of getVerticesNumber() entries, one for each field, receiving the distances
+         * @param method the method
+         * @param maxDistance the distance at which fast marching stops (ignored by the heat method)
+         * @param pool the pool running the fields (the default one if nullptr)
+         * @return false if the heat method could not factorise its systems, true otherwise
+         */
+        bool computeGeodesicDistances(const std::vector<std::vector<std::shared_ptr<Vertex> > >& sources, const std::vector<double*>& distances,
+                                      const GeodesicMethod method = GeodesicMethod::FAST_MARCHING,
+                                      const double maxDistance = std::numeric_limits<double>::max(), ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeGeodesicPath method for computing the exact shortest path over the surface between two vertices (not constrained to the
+         * edges, unlike computeShortestPath), by window propagation. Only the triangles that may be crossed by a path shorter than the one
+         * along the edges are explored, up to maxTriangles of them.
+         * @param v1, v2 the endpoints
+         * @param path it receives the points of the path, from v1 to v2: the endpoints, the crossings with the edges and the vertices where
+         * the path bends
+         * @param maxTriangles the maximum number of triangles explored (if 0, GeodesicSolver::MAX_PATH_TRIANGLES)
+         * @param exact if not nullptr, it receives false if the exploration has been cut by maxTriangles (the path is then the shortest one
+         * found, which may be longer than the geodesic), true otherwise
+         * @return the length of the path (infinity if v2 cannot be reached)
+         */
+        double computeGeodesicPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, std::vector<Point>& path, std::size_t maxTriangles = 0,
+                                   bool* exact = nullptr);
+
+        /**
+         * @brief traceStraightestGeodesic method for tracing the straightest geodesic leaving a point of the surface in a direction (for
+         * instance along a ridge): the path goes straight across the triangles, unfolding each one onto the previous, and leaves the vertices
+         * it passes through with the same angle on both sides. Unlike the directed mode of computeShortestPath, it is not constrained to the
+         * edges, and its cost is proportional to the number of crossed triangles.
+         * @param start the start point, with its triangle and barycentric coordinates (e.g. as returned by getClosestSurfacePoint)
+         * @param direction the direction, projected onto the plane of the triangle
+         * @param length the length of the path
+         * @param tracedLength if not nullptr, it receives the length of the traced path, shorter than length if the boundary has been reached
+         * @return the points of the path: the start point, the crossings with the edges and the vertices, and the end point
+         */
+        std::vector<Point> traceStraightestGeodesic(const SurfacePoint& start, const Vector& direction, double length, double* tracedLength = nullptr);
 
         /**
          * @brief getAnnotations getter method for the annotations associated to the mesh.
@@ -361,12 +587,39 @@ namespace SemantisedTriangleMesh {
         /**
          * @brief getNearestNeighbours method for searching for the maxNumber nearest neighbours to a query point p inside a certain sphere with a certain radius
          * @param p the query point
-         * @param maxNumber optional parameter for limiting the number of neighbours to be returned
+         * @param maxNumber optional parameter for limiting the number of neighbours to be returned. When it is given, the vertices are sorted by
+         * increasing distance and a non-positive radius means that the search is not limited to a sphere
          * @param radius optional parameter for taking only the vertices beneath a certain distance
          * @return the list of selected vertices
          */
         std::vector<std::shared_ptr<Vertex> > getNearestNeighbours(Point p, uint maxNumber = -1, double radius = 0.0);
 
+        /**
+         * @brief searchNearestNeighbours method for searching for the k nearest neighbours to a query point, optionally within a certain radius,
+         * without allocating memory
+         * @param p the query point
+         * @param k the maximum number of neighbours
+         * @param result caller-provided buffer of (at least) k entries, receiving the (vertex position, squared distance) pairs of the neighbours
+         * sorted by increasing distance
+         * @param radius if positive, only the vertices whose distance is lower than or equal to radius are reported
+         * @return the number of neighbours written into result
+         */
+        std::size_t searchNearestNeighbours(const Point& p, std::size_t k, neighbour_t* result, double radius = 0.0);
+
+        /**
+         * @brief searchNearestNeighbours batch version of the k nearest neighbours search, running the queries in parallel
+         * @param queries the coordinates of the query points (x, y and z of each point, consecutively)
+         * @param queriesNumber the number of query points
+         * @param k the maximum number of neighbours of each query point
+         * @param results caller-provided buffer of queriesNumber * k entries: the neighbours of the i-th query point are written, sorted by
+         * increasing distance, starting from position i * k
+         * @param counts caller-provided buffer of queriesNumber entries, receiving the number of neighbours found for each query point
+         * @param radius if positive, only the vertices whose distance is lower than or equal to radius are reported
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void searchNearestNeighbours(const double* queries, std::size_t queriesNumber, std::size_t k, neighbour_t* results, std::size_t* counts,
+                                     double radius = 0.0, ThreadPool* pool = nullptr);
+
         /**
          * @brief getClosestPoint method for searching for the maxNumber nearest neighbours inside a certain sphere with a certain radius
          * I'm considering to merge this method with getNearestNeighbours
@@ -375,8 +628,188 @@ namespace SemantisedTriangleMesh {
          */
         std::shared_ptr<Vertex> getClosestPoint(const Point& p);
 
+        /**
+         * @brief getClosestSurfacePoint method for searching the point of the surface (not necessarily a vertex) closest to a query point.
+         * The search uses a bounding volume hierarchy over the triangles, built on demand and rebuilt whenever the mesh changes.
+         * @param p the query point
+         * @return the closest point, with its triangle and barycentric coordinates (the triangle is nullptr if the mesh has no triangles)
+         */
+        SurfacePoint getClosestSurfacePoint(const Point& p);
+
+        /**
+         * @brief getClosestSurfacePoints batch version of getClosestSurfacePoint, running the queries in parallel
+         * @param queries the coordinates of the query points (x, y and z of each point, consecutively)
+         * @param queriesNumber the number of query points
+         * @param trianglesPositions caller-provided buffer of queriesNumber entries, receiving the position of the triangle containing the closest
+         * point (getTrianglesNumber() if the mesh has no triangles)
+         * @param barycentrics caller-provided buffer of 3 * queriesNumber entries, receiving the barycentric coordinates of the closest points
+         * @param squaredDistances optional caller-provided buffer of queriesNumber entries, receiving the squared distances of the closest points
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void getClosestSurfacePoints(const double* queries, std::size_t queriesNumber, std::size_t* trianglesPositions, double* barycentrics,
+                                     double* squaredDistances = nullptr, ThreadPool* pool = nullptr);
+
+        /**
+         * @brief castRay method for searching the first intersection between a ray and the mesh
+         * @param origin the origin of the ray
+         * @param direction the direction of the ray
+         * @param maxDistance only intersections closer than maxDistance to the origin are considered
+         * @return the intersection, with its triangle and barycentric coordinates. The distance is measured from the origin along the ray, the
+         * triangle is nullptr if the ray does not hit the mesh.
+         */
+        SurfacePoint castRay(const Point& origin, const Vector& direction, double maxDistance = std::numeric_limits<double>::max());
+
+        /**
+         * @brief getRayIntersections method for searching all the intersections between a ray and the mesh
+         * @param origin the origin of the ray
+         * @param direction the direction of the ray
+         * @param maxDistance only intersections closer than maxDistance to the origin are considered
+         * @return the intersections sorted by increasing distance from the origin
+         */
+        std::vector<SurfacePoint> getRayIntersections(const Point& origin, const Vector& direction, double maxDistance = std::numeric_limits<double>::max());
+
+        /**
+         * @brief intersectsRay method that checks whether a ray hits the mesh (it stops at the first intersection found, so it is cheaper than
+         * castRay for visibility tests)
+         * @param origin the origin of the ray
+         * @param direction the direction of the ray
+         * @param maxDistance only intersections closer than maxDistance to the origin are considered
+         * @return true if the ray hits the mesh, false otherwise
+         */
+        bool intersectsRay(const Point& origin, const Vector& direction, double maxDistance = std::numeric_limits<double>::max());
+
+        /**
+         * @brief intersectsSegment method that checks whether a segment crosses the mesh
+         * @param a, b the endpoints of the segment
+         * @return true if the segment crosses the mesh, false otherwise
+         */
+        bool intersectsSegment(const Point& a, const Point& b);
+
+        /**
+         * @brief castRays batch version of castRay, running the queries in parallel
+         * @param origins the coordinates of the origins of the rays (x, y and z of each origin, consecutively)
+         * @param directions the coordinates of the directions of the rays (x, y and z of each direction, consecutively)
+         * @param raysNumber the number of rays
+         * @param trianglesPositions caller-provided buffer of raysNumber entries, receiving the position of the hit triangle of each ray
+         * (getTrianglesNumber() if the ray does not hit the mesh)
+         * @param distances caller-provided buffer of raysNumber entries, receiving the distances of the hits from the origins
+         * @param barycentrics optional caller-provided buffer of 3 * raysNumber entries, receiving the barycentric coordinates of the hits
+         * @param maxDistance only intersections closer than maxDistance to the origins are considered
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void castRays(const double* origins, const double* directions, std::size_t raysNumber, std::size_t* trianglesPositions, double* distances,
+                      double* barycentrics = nullptr, double maxDistance = std::numeric_limits<double>::max(), ThreadPool* pool = nullptr);
+
+        /**
+         * @brief intersectSegments batch version of intersectsSegment, running the queries in parallel
+         * @param endpoints the coordinates of the endpoints of the segments (x, y and z of the first and then of the second endpoint of each
+         * segment, consecutively)
+         * @param segmentsNumber the number of segments
+         * @param results caller-provided buffer of segmentsNumber entries, receiving 1 for the segments crossing the mesh and 0 for the others
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void intersectSegments(const double* endpoints, std::size_t segmentsNumber, unsigned char* results, ThreadPool* pool = nullptr);
+
+        /**
+         * @brief locatePoint method for searching the triangle lying above or below a point, meaning the one containing the projection of the
+         * point onto the XY plane, as needed on terrain-like meshes (DEMs). The search uses a grid over the XY projection of the triangles,
+         * built on demand and rebuilt whenever the mesh changes.
+         * @param p the query point (its Z is only used for the distance)
+         * @return the point of the surface having the same X and Y of p, with its triangle and barycentric coordinates. The distance is the
+         * vertical one between p and the surface, the triangle is nullptr if no triangle contains the projection of p.
+         */
+        SurfacePoint locatePoint(const Point& p);
+
+        /**
+         * @brief interpolateHeight method for computing the height of the surface at a point of the XY plane
+         * @param x, y the coordinates of the point
+         * @param z it receives the height interpolated from the vertices of the triangle containing (x, y), if any
+         * @return true if a triangle contains (x, y), false otherwise
+         */
+        bool interpolateHeight(double x, double y, double& z);
+
+        /**
+         * @brief locatePoints batch version of locatePoint, running the queries in parallel. Consecutive queries are assumed to be spatially
+         * coherent (as the cells of a raster), so the triangle found for a point is tested first for the next one.
+         * @param queries the coordinates of the query points in the XY plane (x and y of each point, consecutively)
+         * @param queriesNumber the number of query points
+         * @param trianglesPositions caller-provided buffer of queriesNumber entries, receiving the position of the triangle containing each
+         * point (getTrianglesNumber() if no triangle contains it)
+         * @param heights optional caller-provided buffer of queriesNumber entries, receiving the height of the surface at each point (NaN if no
+         * triangle contains it)
+         * @param barycentrics optional caller-provided buffer of 3 * queriesNumber entries, receiving the barycentric coordinates of the points
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void locatePoints(const double* queries, std::size_t queriesNumber, std::size_t* trianglesPositions, double* heights = nullptr,
+                          double* barycentrics = nullptr, ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeDistanceTo method for measuring the one-sided distance from the surface of this mesh to another mesh. The surface is
+         * sampled uniformly with respect to the area (the samples of each triangle are drawn from a generator seeded by its position, so that
+         * the result does not depend on the number of threads), and the vertices are evaluated as well. Each point is projected onto the other
+         * mesh through its bounding volume hierarchy, in parallel.
+         * @param other the mesh the distances are measured to
+         * @param samplesNumber the number of surface samples (if 0, ten per triangle)
+         * @param channelName if not empty, the distance of each vertex from the other mesh is stored into the vertex channel with this name
+         * (created as FLOAT64 if not already defined; if it is already defined with another type, nothing is computed)
+         * @param pool the pool running the queries (the default one if nullptr)
+         * @return the statistics of the distances (max is infinite if the other mesh has no triangles, and all of them are NaN, with no
+         * samples, if the channel is not FLOAT64)
+         */
+        DistanceStatistics computeDistanceTo(const std::shared_ptr<TriangleMesh>& other, std::size_t samplesNumber = 0,
+                                             const std::string& channelName = "", ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeSymmetricDistance method for measuring the symmetric distance between two meshes, combining the one-sided distances in
+         * both directions: max is the (estimated) Hausdorff distance, mean and rms are computed over the samples of both surfaces
+         * @param first, second the meshes
+         * @param samplesNumber the number of surface samples of each mesh (if 0, ten per triangle)
+         * @param channelName if not empty, the distance of each vertex from the other mesh is stored into the vertex channel with this name,
+         * in both meshes
+         * @param pool the pool running the queries (the default one if nullptr)
+         * @return the statistics of the distances (all NaN if the channel is not FLOAT64 in either mesh, see computeDistanceTo)
+         */
+        static DistanceStatistics computeSymmetricDistance(const std::shared_ptr<TriangleMesh>& first, const std::shared_ptr<TriangleMesh>& second,
+                                                           std::size_t samplesNumber = 0, const std::string& channelName = "",
+                                                           ThreadPool* pool = nullptr);
+
+        /**
+         * @brief getClosestPoints batch version of getClosestPoint, running the queries in parallel over the (read-only) kd-tree
+         * @param queries the coordinates of the query points (x, y and z of each point, consecutively)
+         * @param queriesNumber the number of query points
+         * @param indices caller-provided buffer of queriesNumber entries, receiving the position of the vertex closest to each query point
+         * @param squaredDistances optional caller-provided buffer of queriesNumber entries, receiving the squared distances of the closest vertices
+         * @param pool the pool running the queries (the default one if nullptr)
+         */
+        void getClosestPoints(const double* queries, std::size_t queriesNumber, std::size_t* indices, double* squaredDistances = nullptr,
+                              ThreadPool* pool = nullptr);
+
+        /**
+         * @brief getVerticesCloseToLine method for searching the vertices closer than a threshold to the line through a and b, within the
+         * sphere centred in the midpoint of ab whose radius is the length of ab
+         * @param a, b two points of the line
+         * @param threshold the maximum distance from the line (if 0, one tenth of the length of ab)
+         * @return the found vertices
+         */
         std::vector<std::shared_ptr<Vertex> > getVerticesCloseToLine(const Point& a, const Point& b, double threshold = 0.0);
 
+        /**
+         * @brief getVerticesInCapsule method for searching the vertices whose distance from a segment is lower than or equal to a radius
+         * @param a, b the endpoints of the segment
+         * @param radius the radius of the capsule
+         * @return the found vertices
+         */
+        std::vector<std::shared_ptr<Vertex> > getVerticesInCapsule(const Point& a, const Point& b, double radius);
+
+        /**
+         * @brief getVerticesInCorridor method for searching the vertices whose distance from a polyline (e.g. a road centreline) is lower than
+         * or equal to a radius. The kd-tree is visited once for the whole polyline.
+         * @param polyline the vertices of the polyline
+         * @param radius the half-width of the corridor
+         * @return the found vertices (each one is reported once)
+         */
+        std::vector<std::shared_ptr<Vertex> > getVerticesInCorridor(const std::vector<Point>& polyline, double radius);
+
         /**
          * @brief regionGrowing method for applying a region growing on the mesh's surface inside a contour given a seed triangle
          * @param contour the contour
@@ -400,6 +833,47 @@ namespace SemantisedTriangleMesh {
          */
         void smooth(WeightType type, uint iterations, double step);
 
+        /**
+         * @brief notifyPositionsChanged method to be called after moving vertices of the mesh through the Point interface (a Point reference,
+         * the compound operators such as +=), so that spatial queries are answered on the new positions. The setters of Vertex call it
+         * implicitly. The kd-tree is refitted at the next query.
+         */
+        void notifyPositionsChanged();
+
+        /**
+         * @brief notifyVerticesChanged method to be called after adding or removing vertices without using the methods of the mesh. The kd-tree
+         * is rebuilt at the next query.
+         */
+        void notifyVerticesChanged();
+
+        /**
+         * @brief notifyTopologyChanged method to be called after adding or removing edges or triangles without using the methods of the mesh.
+         * The structures over the triangles (hierarchy, grid, adjacency lists, geodesic solver) are rebuilt at the next query, the kd-tree
+         * over the vertices is kept.
+         */
+        void notifyTopologyChanged();
+
+        /**
+         * @brief getPositionsGeneration getter for the counter of vertices movements, increased whenever vertices are moved by the mesh or
+         * notifyPositionsChanged is called
+         * @return the current generation of the positions
+         */
+        std::size_t getPositionsGeneration() const;
+
+        /**
+         * @brief getVerticesGeneration getter for the counter of changes of the set of vertices, increased whenever vertices are added or
+         * removed by the mesh or notifyVerticesChanged is called
+         * @return the current generation of the vertices
+         */
+        std::size_t getVerticesGeneration() const;
+
+        /**
+         * @brief getTopologyGeneration getter for the counter of topological changes, increased whenever edges or triangles are added or
+         * removed by the mesh or notifyTopologyChanged is called
+         * @return the current generation of the topology
+         */
+        std::size_t getTopologyGeneration() const;
+
         /**
          * @brief getMin getter method for the min corner of the AABB (minX, minY, minZ)
          * @return the corner Point
@@ -417,12 +891,24 @@ namespace SemantisedTriangleMesh {
          * be defined as a set of one ore more relations between two annotations.
          * @param a1 the first annotation of the relation
          * @param a2 the second annotation of the relation
-         * @param relationshipType the type of the relation (currently can be free text)
+         * @param relationshipType the type of the relation (currently can be free text). Types are interned, so each distinct type is stored
+         * once and the relations of an annotation can be filtered by type in O(degree).
          * @param directed true if the arc is directed, false otherwise.
-         * @return
+         * @return true if the relation has been added, false if one of the annotations is not in the graph
          */
         bool addAnnotationsRelationship(std::shared_ptr<Annotation> a1, std::shared_ptr<Annotation> a2, std::string relationshipType, bool directed = false);
 
+        /**
+         * @brief addAnnotationsRelationships method for adding many relations at once (for instance when loading them from a file). The arcs are
+         * allocated from a pool owned by the relationships graph and the adjacency of the annotations is grown once, so the cost is linear in
+         * the number of relations, instead of a lookup and an allocation for each of them.
+         * @param relationships the first annotation, the second annotation and the type of each relation
+         * @param directed true if the arcs are directed, false otherwise.
+         * @return true if the relations have been added, false if one of the annotations is not in the graph (then none is added)
+         */
+        bool addAnnotationsRelationships(const std::vector<std::tuple<std::shared_ptr<Annotation>, std::shared_ptr<Annotation>, std::string> > &relationships,
+                                         bool directed = false);
+
         /**
          * @brief removeRelationship method for removing an arc from the relationships graph. The arc is found as the one connecting two nodes containing
          * the parameter annotations as data and with a certain type
@@ -489,9 +975,90 @@ namespace SemantisedTriangleMesh {
         std::vector<std::shared_ptr<Annotation> > annotations;
 
         /**
-         * @brief kdtree data structure for speeding up spatial queries
+         * @brief positionsGeneration, verticesGeneration, topologyGeneration counters of the changes of, respectively, the positions of the
+         * vertices, the set of vertices and the sets of edges and triangles. The first one is shared with the vertices, which increase it
+         * when moved through their setters.
+         */
+        std::shared_ptr<std::atomic<std::size_t> > positionsGeneration = std::make_shared<std::atomic<std::size_t> >(0);
+        std::atomic<std::size_t> verticesGeneration{0}, topologyGeneration{0};
+
+        /**
+         * @brief kdtree data structure for speeding up spatial queries, with the generations of the positions and vertices it indexes
+         */
+        MeshCache<KDTree, 2> kdtree;
+
+        /**
+         * @brief kdtreeRebuild kd-tree being rebuilt in background (if valid), because the refitted one became too loose, with the
+         * generations of the positions and vertices it indexes (both guarded by the mutex of the cached kd-tree)
+         */
+        std::future<std::shared_ptr<KDTree> > kdtreeRebuild;
+        MeshCache<KDTree, 2>::Generations kdtreeRebuildGenerations;
+
+        //Ratio between the extent of the leaves of a refitted kd-tree and the one after construction beyond which a rebuild is started
+        static constexpr double KDTREE_REBUILD_RATIO = 2.0;
+
+        /**
+         * @brief xyHash hash of the XY coordinates of the vertices (the insertion index of each point is the position of the vertex), used for
+         * detecting coincident vertices. It is rebuilt when vertices are moved or removed, and kept up to date when they are added.
+         */
+        SpatialHash<2> xyHash;
+        bool xyHashValid = false;
+        std::size_t xyHashPositionsGeneration = 0, xyHashVerticesGeneration = 0;
+
+        /**
+         * @brief bvh bounding volume hierarchy over the triangles, for closest point queries (built on demand)
+         */
+        MeshCache<TriangleBVH, 3> bvh;
+
+        /**
+         * @brief locator grid over the XY projection of the triangles, for 2.5D point location queries (built on demand)
+         */
+        MeshCache<TriangleLocator, 3> locator;
+
+        /**
+         * @brief VertexAdjacency compressed adjacency lists of the vertices: the neighbours of the i-th vertex (in the order of Vertex::getVV)
+         * are neighbours[offsets[i]], ..., neighbours[offsets[i + 1] - 1]
+         */
+        struct VertexAdjacency
+        {
+            std::vector<uint32_t> offsets, neighbours;
+        };
+
+        /**
+         * @brief adjacency cached adjacency lists, for the graph searches over the edges (built on demand)
+         */
+        MeshCache<VertexAdjacency, 2> adjacency;
+
+        /**
+         * @brief vertexPositions cached position of each vertex in the list of vertices, used once the ids no longer match the positions
+         * (ids are not renumbered when vertices are removed). Built on demand.
+         */
+        MeshCache<std::unordered_map<const Vertex*, uint32_t>, 1> vertexPositions;
+
+        /**
+         * @brief trianglePositions cached position of each triangle in the list of triangles, as for the vertices
+         */
+        MeshCache<std::unordered_map<const Triangle*, uint32_t>, 1> trianglePositions;
+
+        /**
+         * @brief PathSearchWorkspace distances, parents and frontiers of a shortest path search, reused across searches (defined in the source file)
          */
-        std::shared_ptr<KDTree> kdtree;
+        struct PathSearchWorkspace;
+
+        /**
+         * @brief idleWorkspaces search workspaces not in use, kept for the following searches
+         */
+        std::vector<std::unique_ptr<PathSearchWorkspace> > idleWorkspaces;
+
+        /**
+         * @brief workspacesMutex mutex protecting the list of idle workspaces
+         */
+        std::mutex workspacesMutex;
+
+        /**
+         * @brief geodesicSolver solver of the geodesic distance fields, holding the factorisations of the heat method (built on demand)
+         */
+        MeshCache<GeodesicSolver, 3> geodesicSolver;
 
         /**
          * @brief min, max min and max corner of the AABB, meaning the points with, respectively, lowest and highest X, Y and Z value
@@ -503,40 +1070,207 @@ namespace SemantisedTriangleMesh {
          */
         double minEdgeLength, maxEdgeLength;
 
+        /**
+         * @brief vertexChannels, triangleChannels per-element property channels, indexed by the position of the element in the corresponding list
+         */
+        std::vector<std::shared_ptr<PropertyChannel> > vertexChannels, triangleChannels;
+
         /**
          * @brief relationshipsGraph graph encoding the relations among annotations of the mesh
          */
         std::shared_ptr<GraphTemplate::Graph<std::shared_ptr<Annotation> > > relationshipsGraph;
 
         /**
-         * @brief loadPLY method for loading the mesh from a .ply file.
+         * @brief loadPLY method for loading the mesh from a .ply file (ascii, binary little endian or binary big endian). Any scalar property of
+         * vertices and faces is stored into a channel, faces with more than three vertices are triangulated as fans.
          * @param filename the complete file path
          * @return error code, 0 if no error occurred. Other values define a specific error (list will be produced in the future)
          */
         int loadPLY(std::string filename);
 
+        /**
+         * @brief loadOBJ method for loading the mesh from a .obj file. Only vertex positions and faces are considered (texture coordinates,
+         * normals and grouping statements are ignored), polygonal faces are triangulated as fans.
+         * @param filename the complete file path
+         * @return error code, 0 if no error occurred. Other values define a specific error (list will be produced in the future)
+         */
+        int loadOBJ(std::string filename);
+
+        /**
+         * @brief loadOFF method for loading the mesh from an ascii .off file (additional per-vertex and per-face values, such as colours, are ignored).
+         * Polygonal faces are triangulated as fans.
+         * @param filename the complete file path
+         * @return error code, 0 if no error occurred. Other values define a specific error (list will be produced in the future)
+         */
+        int loadOFF(std::string filename);
+
+        /**
+         * @brief loadSTL method for loading the mesh from an ascii or binary .stl file. Coincident corners of the triangles are welded into
+         * shared vertices. Non-zero attribute words of binary files are stored into the "attribute" triangle channel.
+         * @param filename the complete file path
+         * @return error code, 0 if no error occurred. Other values define a specific error (list will be produced in the future)
+         */
+        int loadSTL(std::string filename);
+
+        /**
+         * @brief savePLY, saveOBJ, saveOFF, saveSTL and saveXYZ methods writing the mesh onto an already opened stream in the corresponding format
+         * @param stream the output stream
+         * @param binary whether the binary variant of the format has to be written
+         */
+        void savePLY(std::ostream& stream, bool binary);
+        void saveOBJ(std::ostream& stream);
+        void saveOFF(std::ostream& stream);
+        void saveSTL(std::ostream& stream, bool binary);
+        void saveXYZ(std::ostream& stream);
+
         /**
          * @brief initialiseKDTree method for explicitly requesting the initialisation of the kd-tree
          */
         void initialiseKDTree();
 
         /**
-         * @brief extractNearestVertex support method for the Dijkstra algorithm. Given a list of vertices in the frontier, it extracts the "closest" one,
-         * in terms of the value contained into the list of distances
-         * @param frontier the list of vertices to be checked
-         * @param distances the list of distances corresponding to the vertices in frontier
-         * @return the closest vertex
+         * @brief getKDTree method that returns the kd-tree, initialising it if needed. If vertices moved since its construction, the tree is
+         * refitted (and a rebuild is started in background when the refit makes it too loose), if vertices have been added or removed it
+         * is rebuilt. It is safe to call it from several threads at once, but not while the mesh is being edited.
+         * @return the kd-tree
          */
-        int extractNearestVertex(std::vector<uint> &frontier, std::map<uint, double> distances);
+        std::shared_ptr<KDTree> getKDTree();
+
+        /**
+         * @brief getBVH method that returns the hierarchy over the triangles, (re)building it if the mesh changed since its construction.
+         * It is safe to call it from several threads at once, but not while the mesh is being edited.
+         * @return the hierarchy
+         */
+        std::shared_ptr<TriangleBVH> getBVH();
+
+        /**
+         * @brief getLocator method that returns the grid over the XY projection of the triangles, (re)building it if the mesh changed since its
+         * construction. It is safe to call it from several threads at once, but not while the mesh is being edited.
+         * @return the grid
+         */
+        std::shared_ptr<TriangleLocator> getLocator();
+
+        /**
+         * @brief getVertexAdjacency method that returns the adjacency lists of the vertices, (re)building them if vertices, edges or triangles
+         * have been added or removed since their construction. It is safe to call it from several threads at once, but not while the mesh is
+         * being edited.
+         * @return the adjacency lists
+         */
+        std::shared_ptr<VertexAdjacency> getVertexAdjacency();
+
+        /**
+         * @brief getVertexPosition method that returns the position of a vertex in the list of vertices, i.e. its row in the cached structures
+         * (adjacency lists, solvers). The id is tried first, the map of the positions is (re)built only if the id does not match. It is safe
+         * to call it from several threads at once, but not while the mesh is being edited.
+         * @param v the vertex
+         * @return the position, or the maximum uint32_t if the vertex is not in the mesh
+         */
+        uint32_t getVertexPosition(const std::shared_ptr<Vertex>& v);
+
+        /**
+         * @brief getTrianglePosition method that returns the position of a triangle in the list of triangles (see getVertexPosition)
+         * @param t the triangle
+         * @return the position, or the maximum uint32_t if the triangle is not in the mesh
+         */
+        uint32_t getTrianglePosition(const std::shared_ptr<Triangle>& t);
+
+        /**
+         * @brief getGeodesicSolver method that returns the solver of the geodesic distance fields, (re)building it if the mesh changed since its
+         * construction. It is safe to call it from several threads at once, but not while the mesh is being edited.
+         * @return the solver
+         */
+        std::shared_ptr<GeodesicSolver> getGeodesicSolver();
+
+        /**
+         * @brief appendVertex support method that appends a vertex to the list of vertices, updating channels, generations and XY hash
+         * @param v the vertex
+         * @return the appended vertex
+         */
+        std::shared_ptr<Vertex> appendVertex(std::shared_ptr<Vertex> v);
+
+        /**
+         * @brief initialiseXYHash method that (re)builds the hash of the XY coordinates of the vertices
+         * @param cellSize the size of the cells of the hash (if 0, it is computed from the extent and the number of vertices)
+         */
+        void initialiseXYHash(double cellSize = 0.0);
+
+        /**
+         * @brief searchCoincidentVertex method that searches for the first vertex coinciding with a point (their distance is lower than
+         * Point::EPSILON) in the XY plane or in 3D
+         * @param p the point
+         * @param compareZ if true, the Z coordinate is considered too
+         * @return the position of the vertex, -1 if no vertex coincides with the point
+         */
+        int searchCoincidentVertex(const Point& p, bool compareZ);
+
+        /**
+         * @brief flattenCoordinates support method returning the coordinates of the vertices as a flat array (x, y and z of each vertex)
+         * @return the array of coordinates
+         */
+        std::vector<double> flattenCoordinates() const;
+
+        /**
+         * @brief flattenFaces support method returning the triangles as a flat array of vertex positions (the three corners of each triangle)
+         * @return the array of vertex positions
+         */
+        std::vector<unsigned int> flattenFaces() const;
 
         /**
          * @brief extractStraightestVertex support method for the Dijkstra algorithm. Given a list of vertices in the frontier, it extracts the one which is most in the direction of the target
          * @param frontier the list of vertices to be checked
          * @param start the previous vertex (for computing direction)
          * @param direction the vector defining the direction
+         * @param useHeight if not checked, the directions towards the vertices of the frontier are projected onto the XY plane
          * @return the closest vertex
          */
-        int extractStraightestVertex(std::vector<uint> &frontier, std::shared_ptr<Vertex> start, Vector direction);
+        int extractStraightestVertex(std::vector<uint> &frontier, std::shared_ptr<Vertex> start, Vector direction, bool useHeight = true);
+
+        /**
+         * @brief searchShortestPath support method for computeShortestPath, running the search with a given edge weight. The weight is a
+         * policy class (one for each metric, with the projection onto the XY plane decided at compile time), so that the inner loop does not
+         * branch on the metric and never modifies the coordinates of the vertices. Besides the weight of moving from a vertex to a neighbour,
+         * it provides the lower bound of the distance between two vertices used as A* heuristic.
+         * @param source, target the positions of the origin and the target of the path
+         * @param weight the edge weight policy
+         * @param useHeight whether the directions of the directed mode are measured in 3D (otherwise on the XY plane)
+         * @param directed if checked, the vertex of the frontier most aligned with the target is expanded (see computeShortestPath)
+         * @param avoidUsed if checked, vertices flagged as used are reachable only at infinite distance
+         * @param strategy the search strategy (ignored in directed mode)
+         * @param workspace the workspace of the search, reset by the method
+         * @param path it receives the positions of the vertices of the path, source excluded
+         * @return true if the target has been reached, false otherwise
+         */
+        template <class Weight>
+        bool searchShortestPath(uint32_t source, uint32_t target, const Weight& weight, bool useHeight, bool directed, bool avoidUsed,
+                                PathSearchStrategy strategy, PathSearchWorkspace& workspace, std::vector<uint32_t>& path);
+
+        /**
+         * @brief searchBidirectionalPath support method for searchShortestPath, running the bidirectional Dijkstra algorithm: the two frontiers
+         * are expanded alternately (the one with the lowest key first), until the sum of their lowest keys reaches the length of the best path
+         * joining them found so far
+         */
+        template <class Weight>
+        bool searchBidirectionalPath(uint32_t source, uint32_t target, const Weight& weight, bool avoidUsed, PathSearchWorkspace& workspace,
+                                     std::vector<uint32_t>& path);
+
+        /**
+         * @brief findShortestPath support method for computeShortestPath and computeShortestPaths, running a query in a given workspace
+         */
+        std::vector<std::shared_ptr<Vertex> > findShortestPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const DistanceType metric, const bool useHeight,
+                                                                const bool directed, const bool avoidUsed, const PathSearchStrategy strategy,
+                                                                PathSearchWorkspace& workspace);
+
+        /**
+         * @brief acquireWorkspace method that takes an idle search workspace, or creates a new one if none is idle
+         * @return the workspace
+         */
+        std::unique_ptr<PathSearchWorkspace> acquireWorkspace();
+
+        /**
+         * @brief releaseWorkspace method that gives back a workspace taken with acquireWorkspace
+         * @param workspace the workspace
+         */
+        void releaseWorkspace(std::unique_ptr<PathSearchWorkspace> workspace);
     };
 
 }
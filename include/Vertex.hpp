@@ -5,6 +5,7 @@
 #include "Edge.hpp"
 #include "Triangle.hpp"
 #include "CommonDefinitions.hpp"
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -72,6 +73,39 @@ namespace SemantisedTriangleMesh {
          */
         void setId(std::string newId);
 
+        /**
+         * @brief Set the coordinates of the vertex, increasing the positions generation of the mesh it belongs to (if any).
+         * @param p The point whose coordinates will be copied to this vertex.
+         */
+        void setPosition(const Point& p);
+
+        /**
+         * @brief Set the x-coordinate of the vertex, increasing the positions generation of the mesh it belongs to (if any).
+         * @param newX The new x-coordinate to set for the vertex.
+         */
+        void setX(const double& newX);
+
+        /**
+         * @brief Set the y-coordinate of the vertex, increasing the positions generation of the mesh it belongs to (if any).
+         * @param newY The new y-coordinate to set for the vertex.
+         */
+        void setY(const double& newY);
+
+        /**
+         * @brief Set the z-coordinate of the vertex, increasing the positions generation of the mesh it belongs to (if any).
+         * @param newZ The new z-coordinate to set for the vertex.
+         */
+        void setZ(const double& newZ);
+
+        /**
+         * @brief Set the counter increased when the vertex is moved through its setters. The mesh sets its own counter of the positions
+         * when the vertex is added to it, so that its spatial structures are updated at the next query. Moving the vertex through the
+         * Point interface (a Point reference, the compound operators) does not increase it: TriangleMesh::notifyPositionsChanged is
+         * required in that case.
+         * @param newPositionsGeneration The counter (nullptr for detaching the vertex).
+         */
+        void setPositionsGeneration(const std::shared_ptr<std::atomic<std::size_t> > &newPositionsGeneration);
+
         /**
          * @brief Get the first outgoing edge of the vertex.
          * @return A shared pointer to the first outgoing edge of the vertex.
@@ -223,6 +257,7 @@ namespace SemantisedTriangleMesh {
         std::shared_ptr<Edge> e0;
         std::vector<void*> information;
         std::vector<FlagType> associated_flags;
+        std::shared_ptr<std::atomic<std::size_t> > positionsGeneration;
     };
 }
 #endif // VERTEX_H
@@ -7,6 +7,9 @@
 #include "Vertex.hpp"
 
 namespace SemantisedTriangleMesh {
+
+    class TriangleMesh;
+
     /**
      * @class GeodesicMeasure
      * @brief Represents a geodesic measure attribute associated with an annotation.
@@ -35,6 +38,21 @@ namespace SemantisedTriangleMesh {
          */
         void setPoints(const std::vector<std::shared_ptr<SemantisedTriangleMesh::Vertex>>& newPoints);
 
+        /**
+         * @brief Compute the measure on a mesh, as the length of the exact surface geodesics joining the consecutive points (or, if no point
+         * has been set, the vertices whose positions are the measure points' IDs). The value of the attribute is set to the length.
+         * @param mesh The mesh the points belong to.
+         * @param maxTriangles The maximum number of triangles explored for each geodesic (if 0, GeodesicSolver::MAX_PATH_TRIANGLES).
+         * @return The length of the measure (infinity if some point cannot be reached from the previous one).
+         */
+        double computeMeasure(const std::shared_ptr<SemantisedTriangleMesh::TriangleMesh>& mesh, std::size_t maxTriangles = 0);
+
+        /**
+         * @brief Get the polyline traced on the surface by the last computation of the measure.
+         * @return A constant reference to the points of the polyline.
+         */
+        const std::vector<SemantisedTriangleMesh::Point>& getPath() const;
+
         /**
          * @brief Print the main information related to the geodesic measure (points).
          * @param os The stream onto which the information should be written.
@@ -49,6 +67,7 @@ namespace SemantisedTriangleMesh {
 
     protected:
         std::vector<std::shared_ptr<SemantisedTriangleMesh::Vertex>> points; // The vector of points defining the geodesic measure
+        std::vector<SemantisedTriangleMesh::Point> path; // The polyline traced on the surface by computeMeasure
     };
 
 }
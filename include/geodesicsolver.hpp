@@ -0,0 +1,157 @@
+#ifndef GEODESICSOLVER_H
+#define GEODESICSOLVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    class ThreadPool;
+
+    /**
+     * @class GeodesicSolver
+     * @brief Solver computing geodesic distance fields over a triangle mesh from a set of source vertices (one-to-many distances).
+     *
+     * Two methods are offered. Fast marching propagates a front from the sources in order of increasing distance, updating each vertex from
+     * the triangles around it (the front is locally planar inside each triangle, when it does not cross the opposite edge the update falls
+     * back to the edges): it is exact along the edges, first order accurate elsewhere, and can stop at a maximum distance.
+     * The heat method (Crane, Weischedel and Wardetzky, "Geodesics in heat") diffuses heat from the sources for a short time, normalises
+     * the gradient of the temperature and recovers the distance solving a Poisson equation. The two sparse systems depend only on the
+     * geometry, so they are factorised once (on the first heat query) and every further query costs two back-substitutions.
+     * Exact point-to-point geodesics are computed by window propagation (Mitchell, Mount and Papadimitriou; Chen and Han, with the
+     * filtering rules of Xin and Wang), restricted to the triangles that can be crossed by a path shorter than the one along the edges.
+     * Straightest geodesics (Polthier and Schmies) are traced from a point and a direction, unfolding each triangle onto the previous one.
+     * The solver copies the geometry: it must be rebuilt when the mesh changes.
+     */
+    class GeodesicSolver
+    {
+    public:
+        //Diffusion time of the heat method, as a multiple of the squared mean edge length
+        static constexpr double HEAT_TIME_FACTOR = 1.0;
+        //Default maximum number of triangles of the region explored by computeGeodesicPath
+        static constexpr std::size_t MAX_PATH_TRIANGLES = 500000;
+
+        GeodesicSolver();
+
+        /**
+         * @brief GeodesicSolver constructor
+         * @param coordinates x, y and z of each vertex, consecutively
+         * @param verticesNumber the number of vertices
+         * @param faces the indices of the three corners of each triangle, consecutively
+         * @param trianglesNumber the number of triangles
+         */
+        GeodesicSolver(const double* coordinates, std::size_t verticesNumber, const unsigned int* faces, std::size_t trianglesNumber);
+
+        ~GeodesicSolver();
+
+        /**
+         * @brief build method that (re)builds the solver, discarding the factorisations of the heat method
+         * @param coordinates x, y and z of each vertex, consecutively
+         * @param verticesNumber the number of vertices
+         * @param faces the indices of the three corners of each triangle, consecutively
+         * @param trianglesNumber the number of triangles
+         */
+        void build(const double* coordinates, std::size_t verticesNumber, const unsigned int* faces, std::size_t trianglesNumber);
+
+        /**
+         * @brief getVerticesNumber method that returns the number of vertices of the solver
+         * @return the number of vertices
+         */
+        std::size_t getVerticesNumber() const;
+
+        /**
+         * @brief fastMarching method that computes the distance field with the fast marching method. Several fields can be computed at once
+         * from different threads.
+         * @param sources the positions of the source vertices (distance 0)
+         * @param distances caller-provided buffer of getVerticesNumber() entries, receiving the distance of each vertex from the closest source
+         * (infinity for the vertices beyond maxDistance or not connected to any source)
+         * @param maxDistance the front stops at this distance
+         */
+        void fastMarching(const std::vector<uint32_t>& sources, double* distances, double maxDistance = std::numeric_limits<double>::max()) const;
+
+        /**
+         * @brief heatMethod method that computes the distance field with the heat method. The first call factorises the systems, the following
+         * ones (also from different threads) reuse the factorisations.
+         * @param sources the positions of the source vertices
+         * @param distances caller-provided buffer of getVerticesNumber() entries, receiving the distance of each vertex from the closest source
+         * (shifted so that the sources have distance 0 on average, negative values are clamped to 0)
+         * @param pool the pool running the per-triangle and per-vertex steps (the default one if nullptr)
+         * @return false if the systems could not be factorised (the distances are then all infinite), true otherwise
+         */
+        bool heatMethod(const std::vector<uint32_t>& sources, double* distances, ThreadPool* pool = nullptr);
+
+        /**
+         * @brief computeGeodesicPath method that computes the shortest path over the surface between two vertices, which crosses the triangles
+         * along straight lines and bends only at saddle or boundary vertices. The shortest path along the edges bounds its length, so only
+         * the triangles lying within the ellipsoid whose foci are the two vertices are explored, closest ones first, up to maxTriangles. The
+         * search along the edges expands up to maxTriangles vertices as well: beyond, the region grows towards the target without a bound.
+         * Several paths can be computed at once from different threads.
+         * @param source, target the positions of the endpoints
+         * @param path it receives the points of the path (x, y and z of each point, consecutively), from source to target: the endpoints,
+         * the crossings with the edges and the vertices where the path bends
+         * @param maxTriangles the maximum number of triangles of the explored region
+         * @param exact if not nullptr, it receives true if the path is the exact geodesic, false if the region was cut by maxTriangles (the
+         * path is then the shortest one within the region, or along the edges if shorter)
+         * @return the length of the path (infinity, with an empty path, if the target cannot be reached, or is not reached within the budget)
+         */
+        double computeGeodesicPath(uint32_t source, uint32_t target, std::vector<double>& path, std::size_t maxTriangles = MAX_PATH_TRIANGLES,
+                                   bool* exact = nullptr) const;
+
+        /**
+         * @brief traceStraightestGeodesic method that walks straight over the surface from a point, for a given length. Inside a triangle the
+         * path is a segment; crossing an edge the direction is unfolded onto the next triangle, and passing through a vertex the path leaves
+         * it with the same angle on both sides (the straightest direction). The cost is proportional to the number of crossed triangles.
+         * @param face the position of the triangle containing the start point
+         * @param barycentric the barycentric coordinates of the start point with respect to the three corners of the triangle
+         * @param direction the direction of the path (x, y and z), projected onto the plane of the triangle (or, if the start point is a
+         * vertex, of the triangle around it containing the direction)
+         * @param length the length of the path
+         * @param path it receives the points of the path (x, y and z of each point, consecutively): the start point, the crossings with the
+         * edges and the vertices, and the end point
+         * @param crossedFaces if not nullptr, it receives the positions of the triangles crossed by the segments of the path, in order
+         * @return the length of the traced path, shorter than length if the path has reached the boundary of the mesh
+         */
+        double traceStraightestGeodesic(uint32_t face, const double* barycentric, const double* direction, double length, std::vector<double>& path,
+                                        std::vector<uint32_t>* crossedFaces = nullptr) const;
+
+    protected:
+        //Factorised systems of the heat method (defined in the source file, to keep the sparse solvers out of the header)
+        struct HeatSystems;
+
+        std::vector<double> coordinates;
+        std::vector<uint32_t> faces;
+        //Triangles incident to the i-th vertex are vertexTriangles[vertexTrianglesOffsets[i]], ..., vertexTriangles[vertexTrianglesOffsets[i + 1] - 1]
+        std::vector<uint32_t> vertexTrianglesOffsets, vertexTriangles;
+        double meanEdgeLength = 0;
+
+        std::shared_ptr<HeatSystems> heatSystems;
+        std::mutex heatMutex;
+
+        std::shared_ptr<HeatSystems> getHeatSystems();
+
+        //Workspace of the paths computed by computeGeodesicPath, holding arrays over the whole mesh (defined in the source file). The idle
+        //ones are kept for the following paths, so that concurrent paths use distinct workspaces and each one is allocated once.
+        struct PathWorkspace;
+        mutable std::vector<std::unique_ptr<PathWorkspace> > idleWorkspaces;
+        mutable std::mutex workspacesMutex;
+
+        std::unique_ptr<PathWorkspace> acquireWorkspace() const;
+        void releaseWorkspace(std::unique_ptr<PathWorkspace> workspace) const;
+
+        //Angle of the corner of a triangle at a vertex, and the other two corners (in the order of the triangle)
+        double cornerAngle(uint32_t face, uint32_t vertex, uint32_t& next, uint32_t& previous) const;
+
+        //The triangle around a vertex whose corner contains a direction (projected onto its plane), max() if it points outside the mesh
+        uint32_t searchFaceAroundVertex(uint32_t vertex, const double* direction) const;
+
+        //Straightest direction leaving a vertex reached by a path entering it with direction through face: the angles between the incoming
+        //and the outgoing path are the same on both sides. Returns the triangle containing the outgoing direction, NONE on the boundary.
+        uint32_t straightestDirection(uint32_t vertex, uint32_t face, double* direction) const;
+    };
+
+}
+#endif // GEODESICSOLVER_H
@@ -0,0 +1,199 @@
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @class IndexedHeap
+     * @brief Binary min-heap of elements identified by dense indices (for instance vertex positions), supporting decrease-key in O(log n).
+     *
+     * Elements with the same key are extracted in the order they were first pushed, so that searches built on it behave as a linear scan
+     * over a frontier kept in insertion order. The position of each element in the heap is stored in an array indexed by element, which is
+     * validated against the heap itself: clearing the heap costs O(1), whatever the number of elements it can index.
+     */
+    class IndexedHeap
+    {
+    public:
+        IndexedHeap() = default;
+
+        /**
+         * @brief IndexedHeap constructor
+         * @param elementsNumber the number of elements the heap can index (elements are 0, ..., elementsNumber - 1)
+         */
+        explicit IndexedHeap(std::size_t elementsNumber)
+        {
+            resize(elementsNumber);
+        }
+
+        /**
+         * @brief resize method that changes the number of elements the heap can index, emptying it
+         * @param elementsNumber the number of elements
+         */
+        void resize(std::size_t elementsNumber)
+        {
+            positions.assign(elementsNumber, 0);
+            clear();
+        }
+
+        /**
+         * @brief capacity method that returns the number of elements the heap can index
+         */
+        std::size_t capacity() const
+        {
+            return positions.size();
+        }
+
+        /**
+         * @brief clear method that empties the heap
+         */
+        void clear()
+        {
+            heap.clear();
+            counter = 0;
+        }
+
+        bool empty() const
+        {
+            return heap.empty();
+        }
+
+        std::size_t size() const
+        {
+            return heap.size();
+        }
+
+        /**
+         * @brief contains method that checks whether an element is in the heap
+         * @param element the element
+         * @return true if the element is in the heap, false otherwise
+         */
+        bool contains(uint32_t element) const
+        {
+            uint32_t position = positions[element];
+            return position < heap.size() && heap[position].element == element;
+        }
+
+        /**
+         * @brief push method that inserts an element, or lowers its key if it is already in the heap (higher keys are ignored)
+         * @param element the element
+         * @param key the key of the element
+         */
+        void push(uint32_t element, double key)
+        {
+            if(contains(element))
+            {
+                uint32_t position = positions[element];
+                if(key < heap[position].key)
+                {
+                    heap[position].key = key;
+                    siftUp(position);
+                }
+                return;
+            }
+            heap.push_back({key, counter++, element});
+            positions[element] = static_cast<uint32_t>(heap.size() - 1);
+            siftUp(heap.size() - 1);
+        }
+
+        /**
+         * @brief top method that returns the element with the lowest key (the heap must not be empty)
+         */
+        uint32_t top() const
+        {
+            return heap.front().element;
+        }
+
+        /**
+         * @brief topKey method that returns the lowest key (the heap must not be empty)
+         */
+        double topKey() const
+        {
+            return heap.front().key;
+        }
+
+        /**
+         * @brief pop method that removes the element with the lowest key (the heap must not be empty)
+         * @return the removed element
+         */
+        uint32_t pop()
+        {
+            uint32_t element = heap.front().element;
+            heap.front() = heap.back();
+            positions[heap.front().element] = 0;
+            heap.pop_back();
+            if(!heap.empty())
+                siftDown(0);
+            return element;
+        }
+
+        /**
+         * @brief getKey method that returns the key of an element in the heap
+         * @param element the element (it must be in the heap)
+         */
+        double getKey(uint32_t element) const
+        {
+            return heap[positions[element]].key;
+        }
+
+    protected:
+        struct Entry
+        {
+            double key;
+            //Insertion counter, breaking ties between equal keys
+            uint64_t order;
+            uint32_t element;
+        };
+
+        std::vector<Entry> heap;
+        std::vector<uint32_t> positions;
+        uint64_t counter = 0;
+
+        static bool lower(const Entry& a, const Entry& b)
+        {
+            return a.key < b.key || (a.key == b.key && a.order < b.order);
+        }
+
+        void siftUp(std::size_t position)
+        {
+            Entry entry = heap[position];
+            while(position > 0)
+            {
+                std::size_t parent = (position - 1) / 2;
+                if(!lower(entry, heap[parent]))
+                    break;
+                heap[position] = heap[parent];
+                positions[heap[position].element] = static_cast<uint32_t>(position);
+                position = parent;
+            }
+            heap[position] = entry;
+            positions[entry.element] = static_cast<uint32_t>(position);
+        }
+
+        void siftDown(std::size_t position)
+        {
+            Entry entry = heap[position];
+            std::size_t size = heap.size();
+            while(true)
+            {
+                std::size_t child = 2 * position + 1;
+                if(child >= size)
+                    break;
+                if(child + 1 < size && lower(heap[child + 1], heap[child]))
+                    child++;
+                if(!lower(heap[child], entry))
+                    break;
+                heap[position] = heap[child];
+                positions[heap[position].element] = static_cast<uint32_t>(position);
+                position = child;
+            }
+            heap[position] = entry;
+            positions[entry.element] = static_cast<uint32_t>(position);
+        }
+    };
+
+}
+#endif // INDEXEDHEAP_H
@@ -0,0 +1,106 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @brief The MeshCache class holds a structure derived from a mesh (a spatial index, adjacency lists, a solver...), built on demand and
+     * rebuilt when the mesh changes. The changes are tracked by GenerationsNumber counters of the mesh, and the structure is stamped with
+     * the values they had when it was built. An up to date structure is returned without locking (the stamps are checked before loading the
+     * structure, and stored after publishing a new one), while the constructions are serialised by a mutex. A new structure is published
+     * with an atomic store, so that the threads still holding the previous one keep using it safely.
+     */
+    template <class Structure, std::size_t GenerationsNumber>
+    class MeshCache
+    {
+    public:
+        typedef std::array<std::size_t, GenerationsNumber> Generations;
+
+        MeshCache()
+        {
+            for(auto& stamp : stamps)
+                stamp.store(std::numeric_limits<std::size_t>::max());
+        }
+
+        MeshCache(const MeshCache&) = delete;
+        MeshCache& operator=(const MeshCache&) = delete;
+
+        /**
+         * @brief get method that returns the structure, building it if missing or built for other generations
+         * @param current function returning the current generations of the mesh (called again under the lock)
+         * @param build function returning the new structure
+         * @return the structure
+         */
+        template <class Current, class Build>
+        std::shared_ptr<Structure> get(Current current, Build build)
+        {
+            return update(current, [&build](const std::shared_ptr<Structure>&, const Generations&){ return build(); });
+        }
+
+        /**
+         * @brief update method that returns the structure, updating it if missing or built for other generations. The update receives the
+         * structure published so far (nullptr if none) and the generations it was built for, so that it can be refitted instead of rebuilt;
+         * it must not modify it, since other threads may be using it.
+         * @param current function returning the current generations of the mesh (called again under the lock)
+         * @param rebuild function returning the new structure from the previous one
+         * @return the structure
+         */
+        template <class Current, class Rebuild>
+        std::shared_ptr<Structure> update(Current current, Rebuild rebuild)
+        {
+            if(isStamped(current()))
+            {
+                std::shared_ptr<Structure> published = std::atomic_load(&structure);
+                if(published != nullptr)
+                    return published;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            Generations generations = current();
+            std::shared_ptr<Structure> published = std::atomic_load(&structure);
+            if(published != nullptr && isStamped(generations))
+                return published;
+            Generations previous;
+            for(std::size_t i = 0; i < GenerationsNumber; i++)
+                previous[i] = stamps[i].load();
+            published = rebuild(published, previous);
+            std::atomic_store(&structure, published);
+            for(std::size_t i = 0; i < GenerationsNumber; i++)
+                stamps[i].store(generations[i]);
+            return published;
+        }
+
+        /**
+         * @brief reset method that drops the structure, so that it is built again at the next request
+         */
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::atomic_store(&structure, std::shared_ptr<Structure>());
+            for(auto& stamp : stamps)
+                stamp.store(std::numeric_limits<std::size_t>::max());
+        }
+
+    protected:
+        std::shared_ptr<Structure> structure;
+        std::mutex mutex;
+        std::array<std::atomic<std::size_t>, GenerationsNumber> stamps;
+
+        bool isStamped(const Generations& generations) const
+        {
+            for(std::size_t i = 0; i < GenerationsNumber; i++)
+                if(stamps[i].load() != generations[i])
+                    return false;
+            return true;
+        }
+    };
+
+}
+#endif // MESHCACHE_H
@@ -0,0 +1,132 @@
+#ifndef PLYFORMAT_H
+#define PLYFORMAT_H
+
+#include "propertychannel.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @brief The PLYFormat enum lists the encodings admitted for the body of a PLY file
+     */
+    enum class PLYFormat { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+
+    /**
+     * @brief The PLYProperty struct describes a property of a PLY element: a scalar or a list of scalars (with the type of its counter)
+     */
+    struct PLYProperty
+    {
+        std::string name;
+        ScalarType type = ScalarType::UNKNOWN;
+        bool isList = false;
+        ScalarType countType = ScalarType::UNKNOWN;
+    };
+
+    /**
+     * @brief The PLYElement struct describes an element of a PLY file (vertex, face or any other user-defined element)
+     */
+    struct PLYElement
+    {
+        std::string name;
+        std::size_t count = 0;
+        std::vector<PLYProperty> properties;
+
+        /**
+         * @brief findProperty method that searches a property by name
+         * @param propertyName the name of the property
+         * @return the position of the property in the element's list, -1 if it is not defined
+         */
+        int findProperty(const std::string& propertyName) const;
+    };
+
+    /**
+     * @class PLYHeader
+     * @brief Parses and writes the header of PLY files, allowing any element and any scalar or list property.
+     */
+    class PLYHeader
+    {
+    public:
+        PLYHeader();
+
+        /**
+         * @brief read method that parses the header from a stream, leaving the stream at the beginning of the body
+         * @param stream the input stream (opened in binary mode if the body may be binary)
+         * @return 0 if no error occurred, 1 if the stream is not a PLY file, 3 if a property has an unknown type,
+         * 6 if the header is not correctly closed, 10 if the body format is not supported
+         */
+        int read(std::istream& stream);
+
+        /**
+         * @brief write method that writes the header onto a stream (end_header included)
+         * @param stream the output stream
+         */
+        void write(std::ostream& stream) const;
+
+        /**
+         * @brief findElement method that searches an element by name
+         * @param elementName the name of the element
+         * @return the position of the element in the list, -1 if it is not defined
+         */
+        int findElement(const std::string& elementName) const;
+
+        PLYFormat format;
+        std::vector<std::string> comments;
+        std::vector<PLYElement> elements;
+    };
+
+    /**
+     * @class PLYValueReader
+     * @brief Reads the values stored in the body of a PLY file one by one, whatever the encoding of the file.
+     */
+    class PLYValueReader
+    {
+    public:
+        PLYValueReader(std::istream& stream, PLYFormat format);
+
+        /**
+         * @brief read method that reads the next value of the body
+         * @param type the type of the value, as declared in the header
+         * @param value the read value, converted to double
+         * @return false if the stream ended (or is not well-formed), true otherwise
+         */
+        bool read(ScalarType type, double& value);
+
+        /**
+         * @brief skipProperty method that reads and discards a property (list properties are completely skipped)
+         * @param property the property to be skipped
+         * @return false if the stream ended, true otherwise
+         */
+        bool skipProperty(const PLYProperty& property);
+
+    private:
+        std::istream& stream;
+        PLYFormat format;
+        bool swapBytes;
+    };
+
+    /**
+     * @class PLYValueWriter
+     * @brief Writes the values of the body of a PLY file one by one, converting them to the type declared in the header.
+     */
+    class PLYValueWriter
+    {
+    public:
+        PLYValueWriter(std::ostream& stream, PLYFormat format);
+
+        /**
+         * @brief write method that writes the next value of the body (ascii values are not separated, the caller writes spaces and line ends)
+         * @param type the type of the value, as declared in the header
+         * @param value the value to be written
+         */
+        void write(ScalarType type, double value);
+
+    private:
+        std::ostream& stream;
+        PLYFormat format;
+        bool swapBytes;
+    };
+
+}
+#endif // PLYFORMAT_H
@@ -0,0 +1,173 @@
+#ifndef PROPERTYCHANNEL_H
+#define PROPERTYCHANNEL_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @brief The ScalarType enum lists the scalar types that can be stored into a property channel (they are the ones admitted by the PLY format).
+     */
+    enum class ScalarType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64, UNKNOWN };
+
+    /**
+     * @brief scalarTypeFromString method that converts a type name (PLY naming, both "uchar" and "uint8" styles) into the corresponding scalar type
+     * @param name the name of the type
+     * @return the scalar type, ScalarType::UNKNOWN if the name is not recognised
+     */
+    ScalarType scalarTypeFromString(const std::string& name);
+
+    /**
+     * @brief scalarTypeToString method that returns the PLY name of a scalar type
+     * @param type the scalar type
+     * @return the name of the type
+     */
+    std::string scalarTypeToString(ScalarType type);
+
+    /**
+     * @brief scalarTypeSize method that returns the number of bytes needed for storing a value of a certain scalar type
+     * @param type the scalar type
+     * @return the size in bytes (0 for ScalarType::UNKNOWN)
+     */
+    unsigned int scalarTypeSize(ScalarType type);
+
+    /**
+     * @class PropertyChannel
+     * @brief Stores one scalar property (normals component, quality, label, etc.) for each element (vertex or triangle) of a mesh.
+     *
+     * A channel is a flat array with one entry per element, indexed by the position of the element in the mesh's lists.
+     * The abstract interface gives access to the values as doubles, while TypedPropertyChannel keeps them with their original type.
+     */
+    class PropertyChannel
+    {
+    public:
+        virtual ~PropertyChannel() {}
+
+        /**
+         * @brief create factory method that builds a channel storing values of the required type
+         * @param name the name of the channel
+         * @param type the type of the stored values
+         * @param size the initial number of elements (initialised to 0)
+         * @return the new channel, nullptr if the type is ScalarType::UNKNOWN
+         */
+        static std::shared_ptr<PropertyChannel> create(const std::string& name, ScalarType type, std::size_t size = 0);
+
+        /**
+         * @brief getName getter for the name of the channel
+         * @return the name
+         */
+        const std::string& getName() const { return name; }
+
+        /**
+         * @brief setName setter for the name of the channel
+         * @param newName the new name
+         */
+        void setName(const std::string& newName) { name = newName; }
+
+        /**
+         * @brief getType getter for the type of the values stored into the channel
+         * @return the type
+         */
+        ScalarType getType() const { return type; }
+
+        /**
+         * @brief size method that returns the number of elements of the channel
+         * @return the number of elements
+         */
+        virtual std::size_t size() const = 0;
+
+        /**
+         * @brief resize method that changes the number of elements of the channel (new elements are initialised to 0)
+         * @param newSize the new number of elements
+         */
+        virtual void resize(std::size_t newSize) = 0;
+
+        /**
+         * @brief getValue method that returns the value associated to an element, converted to double
+         * @param position the position of the element
+         * @return the value
+         */
+        virtual double getValue(std::size_t position) const = 0;
+
+        /**
+         * @brief setValue method that sets the value associated to an element, converting it from double to the type of the channel
+         * @param position the position of the element
+         * @param value the new value
+         */
+        virtual void setValue(std::size_t position, double value) = 0;
+
+        /**
+         * @brief erase method that removes the entry associated to an element, shifting the following ones
+         * @param position the position of the element
+         */
+        virtual void erase(std::size_t position) = 0;
+
+        /**
+         * @brief select method that keeps only the entries of a set of elements, in the given order
+         * @param positions the positions of the elements to be kept
+         */
+        virtual void select(const std::vector<std::size_t>& positions) = 0;
+
+        /**
+         * @brief printValue method that writes the value associated to an element in textual form (integers are never written as characters)
+         * @param stream the stream onto which the value is written
+         * @param position the position of the element
+         */
+        virtual void printValue(std::ostream& stream, std::size_t position) const = 0;
+
+        /**
+         * @brief clone method that produces a deep copy of the channel
+         * @return the copy
+         */
+        virtual std::shared_ptr<PropertyChannel> clone() const = 0;
+
+    protected:
+        PropertyChannel(const std::string& name, ScalarType type) : name(name), type(type) {}
+
+        std::string name;
+        ScalarType type;
+    };
+
+    /**
+     * @class TypedPropertyChannel
+     * @brief Property channel storing its values as a contiguous array of type T.
+     */
+    template <class T>
+    class TypedPropertyChannel : public PropertyChannel
+    {
+    public:
+        TypedPropertyChannel(const std::string& name, ScalarType type, std::size_t size = 0) : PropertyChannel(name, type), values(size, T(0)) {}
+
+        virtual std::size_t size() const override { return values.size(); }
+        virtual void resize(std::size_t newSize) override { values.resize(newSize, T(0)); }
+        virtual double getValue(std::size_t position) const override { return static_cast<double>(values[position]); }
+        virtual void setValue(std::size_t position, double value) override { values[position] = static_cast<T>(value); }
+        virtual void erase(std::size_t position) override { if(position < values.size()) values.erase(values.begin() + position); }
+        virtual void select(const std::vector<std::size_t>& positions) override
+        {
+            std::vector<T> selected;
+            selected.reserve(positions.size());
+            for(auto position : positions)
+                selected.push_back(position < values.size() ? values[position] : T(0));
+            values.swap(selected);
+        }
+        virtual void printValue(std::ostream& stream, std::size_t position) const override { stream << +values[position]; }
+        virtual std::shared_ptr<PropertyChannel> clone() const override { return std::make_shared<TypedPropertyChannel<T> >(*this); }
+
+        /**
+         * @brief getValues getter for the typed array of values
+         * @return the array of values
+         */
+        std::vector<T>& getValues() { return values; }
+        const std::vector<T>& getValues() const { return values; }
+
+    protected:
+        std::vector<T> values;
+    };
+
+}
+#endif // PROPERTYCHANNEL_H
@@ -3,10 +3,14 @@
 
 #include "Point.hpp"
 
-#include <array>
-#include <queue>
-#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace SemantisedTriangleMesh {
     template <class T>
@@ -57,32 +61,45 @@ namespace SemantisedTriangleMesh {
             }
     };
 
+    /**
+     * @class QuadTree
+     * @brief Point-region quadtree indexing the XY projection of a set of nodes. The region covered by the tree is the rectangle having
+     * topLeft as top-left corner (y grows upwards, so the rectangle spans [topLeft.x, topLeft.x + width) x [topLeft.y - height, topLeft.y)).
+     *
+     * Cells are kept in a pool (the four children of a cell are consecutive, and the blocks released by deletions are reused), while the nodes
+     * of each leaf are chained in a second pool, so that the tree performs no allocation per cell or per node once the pools have grown.
+     * Rectangle, circle, k nearest neighbours and duplicate queries share the same depth-first traversal, which visits the children of each
+     * cell in increasing order of a key computed by the query and skips the cells having a negative key.
+     * The tree does not own the nodes: they must outlive it, and their position must not change while they are indexed.
+     * Since cells are not QuadTree objects anymore, the accessors to the sub-trees and to the father of a tree (getSubTrees, getFather and
+     * setFather) have been removed: the queries below replace walking the hierarchy from outside.
+     */
     template <class T>
     class QuadTree
     {
     public:
+        //Maximum level of the cells: beyond it leaves are not split anymore, whatever the number of their nodes
+        static const unsigned int MAX_DEPTH = 48;
+
         QuadTree()
         {
-            nw = nullptr;
-            ne = nullptr;
-            sw = nullptr;
-            se = nullptr;
-            father = nullptr;
             topLeft = Point(0,0,0);
             width = 0;
             height = 0;
         }
 
-        ~QuadTree()
+        /**
+         * @brief QuadTree constructor
+         * @param topLeft the top-left corner of the covered region
+         * @param width, height the size of the covered region
+         * @param maxNodes the number of nodes beyond which a leaf is split
+         */
+        QuadTree(Point topLeft, double width, double height, int maxNodes = 8)
         {
-            if(nw != nullptr)
-            {
-                delete nw;
-                delete ne;
-                delete sw;
-                delete se;
-            }
-
+            this->topLeft = topLeft;
+            this->width = width;
+            this->height = height;
+            this->max_nodes = std::max(maxNodes, 1);
         }
 
         inline Point getTopLeft() const
@@ -90,9 +107,14 @@ namespace SemantisedTriangleMesh {
             return topLeft;
         }
 
+        /**
+         * @brief setTopLeft, setWidth and setHeight change the covered region. The nodes already inserted are re-indexed, and those falling
+         * outside the new region are dropped.
+         */
         inline void setTopLeft(Point newTopLeft)
         {
             topLeft = newTopLeft;
+            reindex();
         }
 
         double getWidth() const{
@@ -102,6 +124,7 @@ namespace SemantisedTriangleMesh {
         void setWidth(double newWidth)
         {
             width = newWidth;
+            reindex();
         }
 
         double getHeight() const
@@ -112,248 +135,691 @@ namespace SemantisedTriangleMesh {
         void setHeight(double newHeight)
         {
             height = newHeight;
+            reindex();
         }
 
-        inline const std::vector<Node<T> *> &getNodes() const
+        /**
+         * @brief getNodes method that returns the indexed nodes, in the order of the leaves
+         * @return the list of nodes
+         */
+        inline std::vector<Node<T> *> getNodes() const
         {
-            return nodes;
+            std::vector<Node<T>*> result;
+            result.reserve(nodesNumber);
+            traverse([](const Cell&){ return 0.0; }, [&result](const Entry& e){ result.push_back(e.node); });
+            return result;
         }
 
+        /**
+         * @brief setNodes method that replaces the indexed nodes with a new set, bulk loading them
+         * @param newNodes the new nodes
+         */
         inline void setNodes(const std::vector<Node<T> *> &newNodes)
         {
-            nodes = newNodes;
+            clear();
+            bulkLoad(newNodes);
         }
 
         inline int getMaxNodes() const{
             return max_nodes;
         }
 
+        /**
+         * @brief setMaxNodes changes the number of nodes beyond which a leaf is split, and re-indexes the nodes already inserted
+         */
         inline void setMaxNodes(int newMaxNodes)
         {
-            max_nodes = newMaxNodes;
+            max_nodes = std::max(newMaxNodes, 1);
+            reindex();
         }
 
-        inline std::vector<QuadTree*> getSubTrees()
+        /**
+         * @brief size method that returns the number of indexed nodes
+         */
+        inline std::size_t size() const
         {
-            std::vector<QuadTree*> subtrees = {nw, ne, sw, se};
-            return subtrees;
+            return nodesNumber;
         }
 
-        QuadTree *getFather() const
+        /**
+         * @brief getCellsNumber method that returns the number of cells in use (internal and leaves)
+         */
+        inline std::size_t getCellsNumber() const
         {
-            return father;
+            return cells.size() - 4 * freeBlocks.size();
         }
 
-        void setFather(QuadTree *newFather)
+        /**
+         * @brief clear method that removes all the nodes (the covered region is kept)
+         */
+        void clear()
         {
-            father = newFather;
+            cells.clear();
+            entries.clear();
+            freeBlocks.clear();
+            freeEntry = -1;
+            nodesNumber = 0;
         }
 
-        inline bool isLeaf()
+        /**
+         * @brief insert method that adds a node to the tree
+         * @param newNode the node
+         * @param duplicate if not nullptr, it receives the node already present at the same position, if any (nullptr otherwise), so that
+         * the caller can tell a duplicate from a node outside the region
+         * @return true if the node has been inserted, false if it falls outside the region or a node with the same position is already present
+         */
+        inline bool insert(Node<T>* newNode, Node<T>** duplicate = nullptr)
         {
-            return nw == nullptr;
+            if(duplicate != nullptr)
+                *duplicate = nullptr;
+            Point pos = newNode->getPos();
+            if(!contains(pos))
+                return false;
+            Node<T>* present = findDuplicate(*newNode);
+            if(present != nullptr)
+            {
+                if(duplicate != nullptr)
+                    *duplicate = present;
+                return false;
+            }
+            if(cells.empty())
+                cells.push_back(makeCell(topLeft.getX(), topLeft.getY() - height, topLeft.getX() + width, topLeft.getY()));
+
+            int32_t cellId = 0;
+            unsigned int level = 0;
+            cells[0].count++;
+            while(cells[cellId].children >= 0)
+            {
+                cellId = cells[cellId].children + quadrant(cells[cellId], pos.getX(), pos.getY());
+                cells[cellId].count++;
+                level++;
+            }
+            link(cellId, newEntry(newNode, pos.getX(), pos.getY()));
+            nodesNumber++;
+            if(cells[cellId].count > static_cast<uint32_t>(max_nodes))
+                split(cellId, level);
+            return true;
         }
 
-        inline void subdivide()
+        /**
+         * @brief bulkLoad method that inserts a set of nodes at once. The nodes are sorted by the Morton code of their position, so that
+         * spatially close nodes are stored close to each other, and the cells are built top-down over the sorted sequence. If the tree is empty
+         * and has no region yet (width or height equal to 0), the region is set to the bounding box of the nodes.
+         * @param newNodes the nodes to be inserted
+         * @return the number of inserted nodes (nodes outside the region and duplicates are discarded)
+         */
+        std::size_t bulkLoad(const std::vector<Node<T>*>& newNodes)
         {
-            double newWidth = width / 2;
-            double newHeight = height / 2;
-            Point newTopLeft(topLeft);
-            nw = new QuadTree();
-            ne = new QuadTree();
-            sw = new QuadTree();
-            se = new QuadTree();
-            nw->setTopLeft(newTopLeft);
-            nw->setWidth(newWidth);
-            nw->setHeight(newHeight);
-            nw->setFather(this);
-            nw->setMaxNodes(max_nodes);
-            newTopLeft.setX(topLeft.getX() + width / 2);
-            ne->setTopLeft(newTopLeft);
-            ne->setWidth(newWidth);
-            ne->setHeight(newHeight);
-            ne->setFather(this);
-            ne->setMaxNodes(max_nodes);
-            newTopLeft.setY(topLeft.getY() - height / 2);
-            se->setTopLeft(newTopLeft);
-            se->setWidth(newWidth);
-            se->setHeight(newHeight);
-            se->setFather(this);
-            se->setMaxNodes(max_nodes);
-            newTopLeft.setX(topLeft.getX());
-            sw->setTopLeft(newTopLeft);
-            sw->setWidth(newWidth);
-            sw->setHeight(newHeight);
-            sw->setFather(this);
-            sw->setMaxNodes(max_nodes);
+            if(newNodes.empty())
+                return 0;
+            if(nodesNumber == 0 && (width <= 0 || height <= 0))
+                fitRegion(newNodes);
+
+            std::vector<Entry> all;
+            all.reserve(nodesNumber + newNodes.size());
+            traverse([](const Cell&){ return 0.0; }, [&all](const Entry& e){ all.push_back(e); });
+            std::size_t previous = all.size();
+            for(auto node : newNodes)
+            {
+                Point pos = node->getPos();
+                if(contains(pos))
+                    all.push_back({node, pos.getX(), pos.getY(), -1});
+            }
 
-            for(auto node : nodes)
-                if(nw->contains(node->getPos()))
-                    nw->insert(node);
-                else if(ne->contains(node->getPos()))
-                    ne->insert(node);
-                else if(sw->contains(node->getPos()))
-                    sw->insert(node);
-                else if(se->contains(node->getPos()))
-                    se->insert(node);
-            nodes.erase(nodes.begin() + 1, nodes.end());
+            std::vector<std::pair<uint64_t, uint32_t> > codes(all.size());
+            for(std::size_t i = 0; i < all.size(); i++)
+                codes[i] = std::make_pair(mortonCode(all[i].x, all[i].y), static_cast<uint32_t>(i));
+            std::stable_sort(codes.begin(), codes.end(),
+                             [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b){ return a.first < b.first; });
+
+            //Duplicates (as for insert, nodes closer than Point::EPSILON) may straddle the boundary between Morton codes, so they are searched
+            //over a grid with spacing Point::EPSILON, where they lie in the same or in a neighbouring cell. The nodes are checked in the order
+            //of repeated insertions (the ones already present, which are kept, then the new ones as given).
+            auto cellHash = [](const std::pair<double, double>& c){ return std::hash<double>()(c.first) * 31 + std::hash<double>()(c.second); };
+            std::unordered_map<std::pair<double, double>, std::vector<uint32_t>, decltype(cellHash)> grid(all.size(), cellHash);
+            std::vector<bool> kept(all.size(), false);
+            for(std::size_t i = 0; i < all.size(); i++)
+            {
+                double cx = std::floor(all[i].x / Point::EPSILON), cy = std::floor(all[i].y / Point::EPSILON);
+                bool duplicate = false;
+                for(int dx = -1; dx <= 1 && i >= previous && !duplicate; dx++)
+                    for(int dy = -1; dy <= 1 && !duplicate; dy++)
+                    {
+                        auto it = grid.find(std::make_pair(cx + dx, cy + dy));
+                        if(it != grid.end())
+                            for(auto j : it->second)
+                                if((*all[j].node) == (*all[i].node))
+                                {
+                                    duplicate = true;
+                                    break;
+                                }
+                    }
+                if(!duplicate)
+                {
+                    kept[i] = true;
+                    grid[std::make_pair(cx, cy)].push_back(static_cast<uint32_t>(i));
+                }
+            }
+
+            std::vector<Entry> sorted;
+            sorted.reserve(all.size());
+            for(std::size_t i = 0; i < codes.size(); i++)
+                if(kept[codes[i].second])
+                    sorted.push_back(all[codes[i].second]);
+
+            std::size_t inserted = sorted.size() - previous;
+            clear();
+            entries.reserve(sorted.size());
+            cells.push_back(makeCell(topLeft.getX(), topLeft.getY() - height, topLeft.getX() + width, topLeft.getY()));
+            buildCell(0, sorted, 0, sorted.size(), 0);
+            nodesNumber = sorted.size();
+            return inserted;
         }
 
-        inline bool insert(Node<T>* newNode)
+        /**
+         * @brief remove method that removes a node from the tree. Sibling leaves whose nodes fit into a single leaf are merged back.
+         * @param node the node to be removed (it is searched by address, at its current position)
+         * @return true if the node has been removed, false if it is not in the tree
+         */
+        bool remove(Node<T>* node)
         {
-            if(!contains(newNode->getPos()))
-            {
+            Point pos = node->getPos();
+            if(cells.empty() || !contains(pos))
                 return false;
-            }
 
-            auto nit = std::find_if(nodes.begin(), nodes.end(), [newNode](Node<T>* n){ return (*n) == (*newNode);});
-            if(nw == nullptr && nit == nodes.end() && nodes.size() + 1 > max_nodes)
-                subdivide();
+            int32_t path[MAX_DEPTH + 1];
+            unsigned int level = 0;
+            path[0] = 0;
+            while(cells[path[level]].children >= 0)
+            {
+                const Cell& c = cells[path[level]];
+                path[level + 1] = c.children + quadrant(c, pos.getX(), pos.getY());
+                level++;
+            }
 
-            if(nw != nullptr)
+            Cell& leaf = cells[path[level]];
+            int32_t* previous = &leaf.head;
+            while(*previous >= 0 && entries[*previous].node != node)
+                previous = &entries[*previous].next;
+            if(*previous < 0)
+                return false;
+            int32_t removed = *previous;
+            *previous = entries[removed].next;
+            entries[removed].next = freeEntry;
+            entries[removed].node = nullptr;
+            freeEntry = removed;
+            nodesNumber--;
+
+            for(unsigned int i = 0; i <= level; i++)
+                cells[path[i]].count--;
+            //The highest internal cell of the path whose nodes fit into a single leaf absorbs its whole subtree
+            for(unsigned int i = 0; i < level; i++)
             {
-                bool retValue = false;
-                if(nw->contains(newNode->getPos()))
-                {
-                    retValue = nw->insert(newNode);
-                } else if (ne->contains(newNode->getPos()))
-                {
-                    retValue = ne->insert(newNode);
-                } else if (sw->contains(newNode->getPos()))
-                {
-                    retValue = sw->insert(newNode);
-                } else if (se->contains(newNode->getPos()))
-                {
-                    retValue = se->insert(newNode);
-                } else
+                if(cells[path[i]].count <= static_cast<uint32_t>(max_nodes))
                 {
-                    std::cerr << "Impossible case: the node is contained in the father quadrant but is contained in no sub-tree" << std::endl;
-                    return false;
+                    merge(path[i]);
+                    break;
                 }
-                if(retValue && this->nodes.size() == 0)
-                    this->nodes.push_back(newNode);
-                return retValue;
             }
+            return true;
+        }
+
+        inline bool contains(Point pos) const
+        {
+            double xDelta = pos.getX() - topLeft.getX();
+            double yDelta = pos.getY() - (topLeft.getY() - height);
+            return xDelta >= 0 && xDelta < width && yDelta >= 0 && yDelta < height;
+        }
+
+        /**
+         * @brief rectangleQuery method that searches for the nodes whose XY position lies inside an axis-aligned rectangle (borders included)
+         * @param min, max the lower-left and upper-right corners of the rectangle
+         * @return the nodes inside the rectangle, in the order of the leaves
+         */
+        std::vector<Node<T>*> rectangleQuery(Point min, Point max) const
+        {
+            double minX = min.getX(), minY = min.getY(), maxX = max.getX(), maxY = max.getY();
+            std::vector<Node<T>*> result;
+            traverse([=](const Cell& c){
+                         return (c.minX > maxX || c.maxX < minX || c.minY > maxY || c.maxY < minY) ? -1.0 : 0.0;
+                     },
+                     [&](const Entry& e){
+                         if(e.x >= minX && e.x <= maxX && e.y >= minY && e.y <= maxY)
+                             result.push_back(e.node);
+                     });
+            return result;
+        }
 
-            auto it = std::find_if(nodes.begin(), nodes.end(), [newNode](Node<T>* n){ return ((*n) == (*newNode)); });
-            if(it == nodes.end())
+        /**
+         * @brief circleQuery method that searches for the nodes whose XY position lies inside a circle (border included)
+         * @param centre the centre of the circle (its Z is ignored)
+         * @param radius the radius of the circle
+         * @return the nodes inside the circle, in the order of the leaves
+         */
+        std::vector<Node<T>*> circleQuery(Point centre, double radius) const
+        {
+            double x = centre.getX(), y = centre.getY(), squaredRadius = radius * radius;
+            std::vector<Node<T>*> result;
+            traverse([=](const Cell& c){ return cellSquaredDistance(c, x, y) > squaredRadius ? -1.0 : 0.0; },
+                     [&](const Entry& e){
+                         double dx = e.x - x, dy = e.y - y;
+                         if(dx * dx + dy * dy <= squaredRadius)
+                             result.push_back(e.node);
+                     });
+            return result;
+        }
+
+        /**
+         * @brief getKNearest method that searches for the k nodes closest to a point in the XY plane
+         * @param point the query point (its Z is ignored)
+         * @param k the number of neighbours
+         * @param maxDistance only nodes whose distance is lower than or equal to maxDistance are reported
+         * @return the neighbours sorted by increasing distance (less than k if the tree has less nodes within maxDistance)
+         */
+        std::vector<Node<T>*> getKNearest(Point point, std::size_t k, double maxDistance = std::numeric_limits<double>::max()) const
+        {
+            std::vector<std::pair<double, Node<T>*> > heap;
+            nearest(point.getX(), point.getY(), k, maxDistance, [](const Node<T>*){ return true; }, heap);
+            std::vector<Node<T>*> result(heap.size());
+            for(std::size_t i = 0; i < heap.size(); i++)
+                result[i] = heap[i].second;
+            return result;
+        }
+
+        /**
+         * @brief getClosest method that searches for the node closest to a query node in the XY plane, excluding the nodes having the same
+         * position of the query node (so that the closest other node is found when the query node is in the tree)
+         * @param queryNode the query node
+         * @return the closest node, nullptr if there is none
+         */
+        inline Node<T>* getClosest(Node<T>* queryNode) const
+        {
+            Point pos = queryNode->getPos();
+            std::vector<std::pair<double, Node<T>*> > heap;
+            nearest(pos.getX(), pos.getY(), 1, std::numeric_limits<double>::max(),
+                    [queryNode](Node<T>* n){ return (*n) != (*queryNode); }, heap);
+            return heap.empty() ? nullptr : heap[0].second;
+        }
+
+
+        void drawForMatlab(std::ofstream &stream) const
+        {
+            if(cells.empty())
             {
-                nodes.push_back(newNode);
-                return true;
+                drawRectangle(stream, topLeft.getX(), topLeft.getY() - height, topLeft.getX() + width, topLeft.getY());
+                return;
             }
-            std::cerr << "Node already present in tree" << std::endl;
-            return false;
+            drawCell(stream, 0);
+        }
 
+    private:
+        struct Cell
+        {
+            double minX, minY, maxX, maxY;
+            //Index of the first of the four children (ordered by quadrant: SW, SE, NW, NE), -1 for leaves
+            int32_t children;
+            //First node of leaves (-1 if none)
+            int32_t head;
+            //Number of nodes in the subtree
+            uint32_t count;
+        };
+
+        struct Entry
+        {
+            Node<T>* node;
+            //Position of the node, copied so that the traversal does not touch the nodes
+            double x, y;
+            //Next node of the same leaf (or next free entry), -1 if none
+            int32_t next;
+        };
 
+        Point topLeft;
+        double width, height;
+        int max_nodes = 1;
+        std::vector<Cell> cells;
+        std::vector<Entry> entries;
+        std::vector<int32_t> freeBlocks;
+        int32_t freeEntry = -1;
+        std::size_t nodesNumber = 0;
+
+        static Cell makeCell(double minX, double minY, double maxX, double maxY)
+        {
+            Cell c;
+            c.minX = minX;
+            c.minY = minY;
+            c.maxX = maxX;
+            c.maxY = maxY;
+            c.children = -1;
+            c.head = -1;
+            c.count = 0;
+            return c;
         }
 
-        inline bool contains(Point pos)
+        static inline unsigned int quadrant(const Cell& c, double x, double y)
         {
-            double xDelta = pos.getX() - topLeft.getX();
-            double yDelta = pos.getY() - (topLeft.getY() - height);
-            return xDelta >= 0 && xDelta < width && yDelta >= 0 && yDelta < height;
+            return (x >= (c.minX + c.maxX) / 2 ? 1u : 0u) | (y >= (c.minY + c.maxY) / 2 ? 2u : 0u);
+        }
+
+        static inline double cellSquaredDistance(const Cell& c, double x, double y)
+        {
+            double dx = x < c.minX ? c.minX - x : (x > c.maxX ? x - c.maxX : 0);
+            double dy = y < c.minY ? c.minY - y : (y > c.maxY ? y - c.maxY : 0);
+            return dx * dx + dy * dy;
+        }
+
+        /**
+         * @brief traverse the traversal core shared by all the queries: a depth-first visit of the cells where the children of each internal
+         * cell are visited in increasing order of key(child), and the cells with a negative key are skipped. The key of a cell is evaluated
+         * again right before visiting it, so that queries whose bound shrinks during the visit (as the k nearest neighbours) prune the
+         * remaining cells.
+         * @param key function returning the key of a cell
+         * @param visit function called for each node of the visited leaves
+         */
+        template <class CellKey, class Visitor>
+        void traverse(CellKey key, Visitor visit) const
+        {
+            if(cells.empty() || key(cells[0]) < 0)
+                return;
+            traverseCell(0, key, visit);
+        }
+
+        template <class CellKey, class Visitor>
+        void traverseCell(int32_t cellId, CellKey& key, Visitor& visit) const
+        {
+            const Cell& c = cells[cellId];
+            if(c.children < 0)
+            {
+                for(int32_t e = c.head; e >= 0; e = entries[e].next)
+                    visit(entries[e]);
+                return;
+            }
+
+            double keys[4];
+            unsigned int order[4] = {0, 1, 2, 3};
+            for(unsigned int i = 0; i < 4; i++)
+                keys[i] = cells[c.children + i].count == 0 ? -1.0 : key(cells[c.children + i]);
+            for(unsigned int i = 1; i < 4; i++)
+                for(unsigned int j = i; j > 0 && keys[order[j]] < keys[order[j - 1]]; j--)
+                    std::swap(order[j], order[j - 1]);
+            for(unsigned int i = 0; i < 4; i++)
+            {
+                int32_t child = c.children + order[i];
+                if(keys[order[i]] >= 0 && (i == 0 || key(cells[child]) >= 0))
+                    traverseCell(child, key, visit);
+            }
         }
 
-        inline Node<T>* getClosest(Node<T>* queryNode)
+        /**
+         * @brief nearest support method for the nearest neighbours queries
+         * @param accept predicate selecting the candidate nodes
+         * @param heap it receives the (squared distance, node) pairs of the neighbours sorted by increasing distance
+         */
+        template <class Predicate>
+        void nearest(double x, double y, std::size_t k, double maxDistance, Predicate accept,
+                     std::vector<std::pair<double, Node<T>*> >& heap) const
         {
-            std::vector<std::vector<QuadTree*> > E = {{this}};
-            uint i = 1;
-            do {
-                double minDist = std::numeric_limits<double>::max();
-                Node<T>* best = nullptr;
-                for(uint j = 0; j < i; j++)
+            heap.clear();
+            if(k == 0)
+                return;
+            heap.reserve(k);
+            double bound = maxDistance < std::sqrt(std::numeric_limits<double>::max()) ? maxDistance * maxDistance
+                                                                                          : std::numeric_limits<double>::max();
+            traverse([&](const Cell& c){
+                         double d = cellSquaredDistance(c, x, y);
+                         return d > bound ? -1.0 : d;
+                     },
+                     [&](const Entry& e){
+                         double dx = e.x - x, dy = e.y - y, d = dx * dx + dy * dy;
+                         if(d > bound || !accept(e.node))
+                             return;
+                         if(heap.size() == k)
+                         {
+                             if(d >= heap.front().first)
+                                 return;
+                             std::pop_heap(heap.begin(), heap.end());
+                             heap.pop_back();
+                         }
+                         heap.push_back(std::make_pair(d, e.node));
+                         std::push_heap(heap.begin(), heap.end());
+                         if(heap.size() == k)
+                             bound = heap.front().first;
+                     });
+            std::sort_heap(heap.begin(), heap.end());
+        }
+
+        //Returns a node having the same position of node (tolerance included), nullptr if there is none
+        Node<T>* findDuplicate(Node<T>& node) const
+        {
+            Point pos = node.getPos();
+            double x = pos.getX(), y = pos.getY(), squaredTolerance = Point::EPSILON * Point::EPSILON;
+            Node<T>* found = nullptr;
+            traverse([&](const Cell& c){ return found != nullptr || cellSquaredDistance(c, x, y) > squaredTolerance ? -1.0 : 0.0; },
+                     [&](const Entry& e){
+                         if(found == nullptr && (*e.node) == node)
+                             found = e.node;
+                     });
+            return found;
+        }
+
+        int32_t newEntry(Node<T>* node, double x, double y)
+        {
+            int32_t id;
+            if(freeEntry >= 0)
+            {
+                id = freeEntry;
+                freeEntry = entries[id].next;
+            } else
+            {
+                id = static_cast<int32_t>(entries.size());
+                entries.push_back(Entry());
+            }
+            entries[id].node = node;
+            entries[id].x = x;
+            entries[id].y = y;
+            entries[id].next = -1;
+            return id;
+        }
+
+        inline void link(int32_t cellId, int32_t entryId)
+        {
+            entries[entryId].next = cells[cellId].head;
+            cells[cellId].head = entryId;
+        }
+
+        //Creates the four children of a cell, reusing a released block if any, and returns the index of the first one
+        int32_t newChildren(int32_t cellId)
+        {
+            int32_t first;
+            if(!freeBlocks.empty())
+            {
+                first = freeBlocks.back();
+                freeBlocks.pop_back();
+            } else
+            {
+                first = static_cast<int32_t>(cells.size());
+                cells.resize(cells.size() + 4);
+            }
+            const Cell& c = cells[cellId];
+            double midX = (c.minX + c.maxX) / 2, midY = (c.minY + c.maxY) / 2;
+            cells[first] = makeCell(c.minX, c.minY, midX, midY);
+            cells[first + 1] = makeCell(midX, c.minY, c.maxX, midY);
+            cells[first + 2] = makeCell(c.minX, midY, midX, c.maxY);
+            cells[first + 3] = makeCell(midX, midY, c.maxX, c.maxY);
+            cells[cellId].children = first;
+            return first;
+        }
+
+        //Splits an overfull leaf, recursively if all its nodes fall in the same quadrant
+        void split(int32_t cellId, unsigned int level)
+        {
+            while(level < MAX_DEPTH && cells[cellId].count > static_cast<uint32_t>(max_nodes))
+            {
+                int32_t e = cells[cellId].head;
+                cells[cellId].head = -1;
+                int32_t first = newChildren(cellId);
+                while(e >= 0)
                 {
-                    std::vector<QuadTree*> Ej = E[j];
-                    for(uint k = 0; k < Ej.size(); k++)
-                    {
-                        auto reps = Ej[k]->getNodes();
-                        double dist = (reps[0]->getPos() - queryNode->getPos()).norm();
-                        if(*reps[0] != *queryNode && dist < minDist)
-                        {
-                            minDist = dist;
-                            best = reps[0];
-                        }
-                    }
+                    int32_t next = entries[e].next;
+                    int32_t child = first + quadrant(cells[cellId], entries[e].x, entries[e].y);
+                    link(child, e);
+                    cells[child].count++;
+                    e = next;
                 }
+                level++;
+                int32_t overfull = -1;
+                for(int32_t i = 0; i < 4; i++)
+                    if(cells[first + i].count > static_cast<uint32_t>(max_nodes))
+                        overfull = first + i;
+                if(overfull < 0)
+                    return;
+                cellId = overfull;
+            }
+        }
 
-                std::vector<QuadTree*> Ei;
-                for(uint j = 0; j < E[i - 1].size(); j++)
+        //Turns an internal cell into a leaf collecting the nodes of its subtree, and releases the cells below it
+        void merge(int32_t cellId)
+        {
+            if(cells[cellId].children < 0)
+                return;
+            int32_t head = -1;
+            collect(cellId, head);
+            cells[cellId].children = -1;
+            cells[cellId].head = head;
+        }
+
+        void collect(int32_t cellId, int32_t& head)
+        {
+            Cell& c = cells[cellId];
+            if(c.children < 0)
+            {
+                for(int32_t e = c.head; e >= 0;)
                 {
-                    if(!E[i - 1][j]->isLeaf())
-                    {
-                        auto sons = E[i - 1][j]->getSubTrees();
-                        for(uint k = 0; k < sons.size(); k++)
-                        {
-                            if(sons[k]->getNodes().size() > 0)
-                            {
-                                double dist = (sons[k]->getNodes()[0]->getPos() - queryNode->getPos()).norm();
-                                if(dist <= minDist)
-                                {
-                                    Ei.push_back(sons[k]);
-                                }
-                            }
-                        }
-                    }
+                    int32_t next = entries[e].next;
+                    entries[e].next = head;
+                    head = e;
+                    e = next;
                 }
-                E.push_back(Ei);
-
-                i++;
-            } while(E[i - 1].size() != 0);
+                return;
+            }
+            int32_t first = c.children;
+            for(int32_t i = 0; i < 4; i++)
+                collect(first + i, head);
+            freeBlocks.push_back(first);
+        }
 
-            double minDist = std::numeric_limits<double>::max();
-            Node<T>* best = nullptr;
-            for(uint j = 0; j < E.size(); j++)
+        //Builds the subtree of a cell over the range [begin, end) of nodes sorted by Morton code
+        void buildCell(int32_t cellId, std::vector<Entry>& sorted, std::size_t begin, std::size_t end, unsigned int level)
+        {
+            cells[cellId].count = static_cast<uint32_t>(end - begin);
+            if(end - begin <= static_cast<std::size_t>(max_nodes) || level >= MAX_DEPTH)
             {
-                for(uint k = 0; k < E[j].size(); k++)
+                for(std::size_t i = end; i-- > begin;)
                 {
-                    auto reps = E[j][k]->getNodes();
-                    double dist = (reps[0]->getPos() - queryNode->getPos()).norm();
-                    if(reps[0] != queryNode && dist < minDist)
-                    {
-                        minDist = dist;
-                        best = reps[0];
-                    }
+                    const Entry& e = sorted[i];
+                    link(cellId, newEntry(e.node, e.x, e.y));
                 }
+                return;
             }
 
-            return best;
+            //The Morton order sorts the nodes by quadrant, except those lying within the quantisation error of the mid lines, hence the
+            //quadrants are separated with a stable partition (which keeps the Morton order within each quadrant)
+            int32_t first = newChildren(cellId);
+            std::size_t bounds[5];
+            bounds[0] = begin;
+            for(unsigned int q = 0; q < 4; q++)
+            {
+                const Cell& c = cells[cellId];
+                auto middle = std::stable_partition(sorted.begin() + bounds[q], sorted.begin() + end,
+                                                    [&c, q](const Entry& e){ return quadrant(c, e.x, e.y) == q; });
+                bounds[q + 1] = static_cast<std::size_t>(middle - sorted.begin());
+            }
+            for(unsigned int q = 0; q < 4; q++)
+                buildCell(first + q, sorted, bounds[q], bounds[q + 1], level + 1);
         }
 
+        //Interleaves the bits of the coordinates quantised over the region (x in the even bits, y in the odd ones)
+        uint64_t mortonCode(double x, double y) const
+        {
+            const double scale = 4294967295.0;
+            double fx = width > 0 ? (x - topLeft.getX()) / width : 0;
+            double fy = height > 0 ? (y - (topLeft.getY() - height)) / height : 0;
+            uint64_t qx = static_cast<uint64_t>(std::min(std::max(fx, 0.0), 1.0) * scale);
+            uint64_t qy = static_cast<uint64_t>(std::min(std::max(fy, 0.0), 1.0) * scale);
+            return spread(qx) | (spread(qy) << 1);
+        }
 
-        void drawForMatlab(std::ofstream &stream)
+        static inline uint64_t spread(uint64_t v)
         {
-            Point topRight(topLeft.getX() + width, topLeft.getY(), 0);
-            Point bottomRight(topLeft.getX() + width, topLeft.getY() - height, 0);
-            Point bottomLeft(topLeft.getX(), topLeft.getY() - height, 0);
+            v &= 0xFFFFFFFFull;
+            v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+            v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+            v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+            v = (v | (v << 2)) & 0x3333333333333333ull;
+            v = (v | (v << 1)) & 0x5555555555555555ull;
+            return v;
+        }
+
+        //Sets the region to the bounding box of a set of nodes, slightly enlarged so that the upper borders are inside
+        void fitRegion(const std::vector<Node<T>*>& newNodes)
+        {
+            double minX = std::numeric_limits<double>::max(), minY = minX;
+            double maxX = -std::numeric_limits<double>::max(), maxY = maxX;
+            for(auto node : newNodes)
+            {
+                Point pos = node->getPos();
+                minX = std::min(minX, pos.getX());
+                maxX = std::max(maxX, pos.getX());
+                minY = std::min(minY, pos.getY());
+                maxY = std::max(maxY, pos.getY());
+            }
+            double margin = std::max({maxX - minX, maxY - minY, std::fabs(minX), std::fabs(minY), std::fabs(maxX), std::fabs(maxY), 1.0}) * 1e-9;
+            topLeft = Point(minX, maxY + margin, 0);
+            width = maxX - minX + margin;
+            height = maxY - minY + margin;
+        }
+
+        //Rebuilds the tree after a change of the region or of the leaf capacity
+        void reindex()
+        {
+            if(nodesNumber == 0)
+            {
+                clear();
+                return;
+            }
+            std::vector<Node<T>*> current = getNodes();
+            clear();
+            bulkLoad(current);
+        }
+
+        void drawRectangle(std::ofstream &stream, double minX, double minY, double maxX, double maxY) const
+        {
+            Point topLeftCorner(minX, maxY, 0);
+            Point topRight(maxX, maxY, 0);
+            Point bottomRight(maxX, minY, 0);
+            Point bottomLeft(minX, minY, 0);
             stream << "A=[" << std::endl;
-            topLeft.print(stream, BracketsType::NONE, " ");
+            topLeftCorner.print(stream, BracketsType::NONE, " ");
             topRight.print(stream, BracketsType::NONE, " ");
             bottomRight.print(stream, BracketsType::NONE, " ");
             bottomLeft.print(stream, BracketsType::NONE, " ");
-            topLeft.print(stream, BracketsType::NONE, " ");
+            topLeftCorner.print(stream, BracketsType::NONE, " ");
             stream << "];" << std::endl;
             stream << "plot(A(:,1),A(:,2));" << std::endl;
-            if(nw != nullptr)
+        }
+
+        void drawCell(std::ofstream &stream, int32_t cellId) const
+        {
+            const Cell& c = cells[cellId];
+            drawRectangle(stream, c.minX, c.minY, c.maxX, c.maxY);
+            if(c.children >= 0)
             {
-                nw->drawForMatlab(stream);
-                ne->drawForMatlab(stream);
-                se->drawForMatlab(stream);
-                sw->drawForMatlab(stream);
+                //NW, NE, SE, SW
+                drawCell(stream, c.children + 2);
+                drawCell(stream, c.children + 3);
+                drawCell(stream, c.children + 1);
+                drawCell(stream, c.children);
             }
-
-
-
         }
-    private:
-        Point topLeft;
-        double width, height;
-        QuadTree<T>* father;
-        QuadTree<T>* nw;
-        QuadTree<T>* ne;
-        QuadTree<T>* sw;
-        QuadTree<T>* se;
-        std::vector<Node<T>*> nodes;
-        int max_nodes = 1;
     };
 }
 
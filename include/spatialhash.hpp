@@ -0,0 +1,202 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @class SpatialHash
+     * @brief Uniform-grid hash of points in Dim dimensions, supporting tolerance-aware duplicate detection.
+     *
+     * Points are identified by their insertion order. The grid cells are sparse (only non-empty cells are stored) and the points falling in
+     * the same cell are chained through a flat array, so that insertions and lookups cost O(1) on average, whatever the extent of the data.
+     */
+    template <unsigned int Dim>
+    class SpatialHash
+    {
+    public:
+        /**
+         * @brief SpatialHash constructor
+         * @param cellSize the edge length of the grid cells. Lookups are faster when it is comparable to the tolerance used for the queries.
+         */
+        SpatialHash(double cellSize = 1.0)
+        {
+            this->cellSize = cellSize > 0 ? cellSize : 1.0;
+        }
+
+        /**
+         * @brief clear method that removes all the points from the hash
+         */
+        void clear()
+        {
+            points.clear();
+            next.clear();
+            heads.clear();
+        }
+
+        /**
+         * @brief reserve method that preallocates the memory for a certain number of points
+         * @param n the number of points
+         */
+        void reserve(std::size_t n)
+        {
+            points.reserve(n * Dim);
+            next.reserve(n);
+            heads.reserve(n);
+        }
+
+        /**
+         * @brief size method that returns the number of points stored into the hash
+         * @return the number of points
+         */
+        std::size_t size() const
+        {
+            return next.size();
+        }
+
+        double getCellSize() const
+        {
+            return cellSize;
+        }
+
+        /**
+         * @brief getPoint method that returns the coordinates of a stored point
+         * @param index the insertion index of the point
+         * @return a pointer to the Dim coordinates of the point
+         */
+        const double* getPoint(unsigned int index) const
+        {
+            return &points[index * Dim];
+        }
+
+        /**
+         * @brief insert method that adds a point to the hash without checking for duplicates
+         * @param point the Dim coordinates of the point
+         * @return the insertion index of the point
+         */
+        unsigned int insert(const double* point)
+        {
+            unsigned int index = static_cast<unsigned int>(next.size());
+            int64_t cell[Dim];
+            computeCell(point, cell);
+            points.insert(points.end(), point, point + Dim);
+            auto it = heads.find(cellKey(cell));
+            if(it == heads.end())
+            {
+                next.push_back(-1);
+                heads.insert(std::make_pair(cellKey(cell), static_cast<int>(index)));
+            } else
+            {
+                next.push_back(it->second);
+                it->second = static_cast<int>(index);
+            }
+            return index;
+        }
+
+        /**
+         * @brief find method that searches for the stored point with lowest insertion index lying closer than a tolerance to a query point
+         * @param point the Dim coordinates of the query point
+         * @param tolerance the tolerance (0 means that only identical points are searched)
+         * @return the insertion index of the found point, -1 if no point lies within the tolerance
+         */
+        int find(const double* point, double tolerance) const
+        {
+            int best = -1;
+            double squaredTolerance = tolerance * tolerance;
+            visitNeighbours(point, tolerance, [&](unsigned int index){
+                if(best >= 0 && static_cast<int>(index) > best)
+                    return;
+                const double* candidate = getPoint(index);
+                double squaredDistance = 0.0;
+                for(unsigned int d = 0; d < Dim; d++)
+                    squaredDistance += (candidate[d] - point[d]) * (candidate[d] - point[d]);
+                if(squaredDistance < squaredTolerance || squaredDistance == 0.0)
+                    best = static_cast<int>(index);
+            });
+            return best;
+        }
+
+        /**
+         * @brief findOrInsert method that searches for a point closer than a tolerance to the query point, inserting the query point if none is found
+         * @param point the Dim coordinates of the query point
+         * @param tolerance the tolerance
+         * @return the insertion index of the found (or inserted) point
+         */
+        unsigned int findOrInsert(const double* point, double tolerance)
+        {
+            int found = find(point, tolerance);
+            if(found >= 0)
+                return static_cast<unsigned int>(found);
+            return insert(point);
+        }
+
+        /**
+         * @brief visitNeighbours method that calls a visitor on every stored point lying in the cells that may contain points closer than a
+         * certain distance to the query point (the visitor has to check the actual distance)
+         * @param point the Dim coordinates of the query point
+         * @param distance the search distance
+         * @param visitor callable receiving the insertion index of each candidate
+         */
+        template <class Visitor>
+        void visitNeighbours(const double* point, double distance, Visitor visitor) const
+        {
+            int64_t cell[Dim], neighbour[Dim];
+            computeCell(point, cell);
+            int64_t range = distance > 0 ? static_cast<int64_t>(std::ceil(distance / cellSize)) : 0;
+            int64_t offsets[Dim];
+            for(unsigned int d = 0; d < Dim; d++)
+                offsets[d] = -range;
+            while(true)
+            {
+                for(unsigned int d = 0; d < Dim; d++)
+                    neighbour[d] = cell[d] + offsets[d];
+                auto it = heads.find(cellKey(neighbour));
+                if(it != heads.end())
+                    for(int index = it->second; index >= 0; index = next[static_cast<std::size_t>(index)])
+                        visitor(static_cast<unsigned int>(index));
+                unsigned int d = 0;
+                while(d < Dim && offsets[d] == range)
+                    offsets[d++] = -range;
+                if(d == Dim)
+                    break;
+                offsets[d]++;
+            }
+        }
+
+    private:
+        double cellSize;
+        std::vector<double> points;
+        std::vector<int> next;
+        std::unordered_map<uint64_t, int> heads;
+
+        void computeCell(const double* point, int64_t* cell) const
+        {
+            const double limit = static_cast<double>(std::numeric_limits<int32_t>::max()) * 1024.0;
+            for(unsigned int d = 0; d < Dim; d++)
+            {
+                double c = std::floor(point[d] / cellSize);
+                if(!(c > -limit))
+                    c = -limit;
+                else if(c > limit)
+                    c = limit;
+                cell[d] = static_cast<int64_t>(c);
+            }
+        }
+
+        static uint64_t cellKey(const int64_t* cell)
+        {
+            static const uint64_t primes[3] = {73856093ULL, 19349663ULL, 83492791ULL};
+            uint64_t key = 0;
+            for(unsigned int d = 0; d < Dim; d++)
+                key ^= static_cast<uint64_t>(cell[d]) * primes[d % 3] + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2);
+            return key;
+        }
+    };
+
+}
+#endif // SPATIALHASH_H
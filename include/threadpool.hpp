@@ -0,0 +1,83 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @class ThreadPool
+     * @brief Fixed set of worker threads executing queued tasks, with a parallelFor helper for splitting index ranges among them.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * @brief ThreadPool constructor
+         * @param threadsNumber the number of worker threads (0 means one per hardware thread)
+         */
+        ThreadPool(unsigned int threadsNumber = 0);
+
+        //The destructor completes the queued tasks before joining the workers
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * @brief getDefault method that returns the pool shared by the library (one worker per hardware thread, created at the first call)
+         * @return the default pool
+         */
+        static ThreadPool& getDefault();
+
+        /**
+         * @brief getThreadsNumber getter for the number of worker threads
+         * @return the number of workers
+         */
+        unsigned int getThreadsNumber() const;
+
+        /**
+         * @brief submit method that queues a task
+         * @param task the callable to be executed
+         * @return the future that will receive the result of the task
+         */
+        template <class Task>
+        auto submit(Task task) -> std::future<decltype(task())>
+        {
+            auto packaged = std::make_shared<std::packaged_task<decltype(task())()> >(task);
+            auto result = packaged->get_future();
+            enqueue([packaged](){ (*packaged)(); });
+            return result;
+        }
+
+        /**
+         * @brief parallelFor method that splits the range [begin, end) in chunks and processes them in parallel. The calling thread takes part
+         * in the computation, so the method can be safely called from inside a task of the same pool.
+         * @param begin the first index of the range
+         * @param end the index following the last one of the range
+         * @param body function called on each chunk with the chunk bounds and the slot of the executing thread (0 for the calling thread,
+         * from 1 to getThreadsNumber() for the workers), useful for indexing per-thread workspaces
+         * @param grain the number of indices of each chunk (0 means an automatic choice)
+         */
+        void parallelFor(std::size_t begin, std::size_t end, const std::function<void(std::size_t chunkBegin, std::size_t chunkEnd, unsigned int slot)>& body,
+                         std::size_t grain = 0);
+
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()> > tasks;
+        std::mutex tasksMutex;
+        std::condition_variable tasksCondition;
+        bool stopping;
+
+        void enqueue(std::function<void()> task);
+    };
+
+}
+#endif // THREADPOOL_H
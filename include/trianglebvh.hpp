@@ -0,0 +1,152 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @class TriangleBVH
+     * @brief Bounding volume hierarchy over a set of triangles, answering exact closest-point-on-surface and ray intersection queries.
+     *
+     * The hierarchy is built top-down, splitting each node along the axis of largest centroid extent at the position minimising the surface
+     * area heuristic, evaluated over a fixed number of bins. Nodes are stored in a flat array (the left child of an internal node follows it)
+     * and the corners of the triangles are copied in leaf order into separate coordinate arrays, so that leaves are scanned linearly.
+     * The structure is static: it must be rebuilt when the triangles change.
+     */
+    class TriangleBVH
+    {
+    public:
+        /**
+         * @brief The ClosestPoint struct describes the point of the surface closest to a query point
+         */
+        struct ClosestPoint
+        {
+            //Index of the triangle in the input array
+            std::size_t triangle;
+            //Barycentric coordinates of the point with respect to the three corners of the triangle, in the input order
+            double barycentric[3];
+            //Coordinates of the point
+            double point[3];
+            //Squared distance between the query point and the found point
+            double squaredDistance;
+        };
+
+        /**
+         * @brief The RayHit struct describes an intersection between a ray and a triangle
+         */
+        struct RayHit
+        {
+            //Index of the triangle in the input array
+            std::size_t triangle;
+            //Parameter of the intersection along the ray (the point is origin + t * direction)
+            double t;
+            //Barycentric coordinates of the intersection with respect to the three corners of the triangle, in the input order
+            double barycentric[3];
+        };
+
+        //Maximum number of triangles in a leaf
+        static const unsigned int LEAF_SIZE = 4;
+        //Number of bins used for evaluating the candidate splits of each node
+        static const unsigned int BINS_NUMBER = 16;
+
+        TriangleBVH();
+
+        /**
+         * @brief TriangleBVH constructor
+         * @param coordinates x, y and z of each vertex, consecutively
+         * @param faces the indices of the three corners of each triangle, consecutively
+         * @param trianglesNumber the number of triangles
+         */
+        TriangleBVH(const double* coordinates, const unsigned int* faces, std::size_t trianglesNumber);
+
+        /**
+         * @brief build method that (re)builds the hierarchy. The arrays are not referenced after the construction.
+         * @param coordinates x, y and z of each vertex, consecutively
+         * @param faces the indices of the three corners of each triangle, consecutively
+         * @param trianglesNumber the number of triangles
+         */
+        void build(const double* coordinates, const unsigned int* faces, std::size_t trianglesNumber);
+
+        /**
+         * @brief size method that returns the number of triangles of the hierarchy
+         * @return the number of triangles
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief closestPoint method that searches for the point of the triangles closest to a query point
+         * @param point x, y and z of the query point
+         * @param result it receives the closest point, if found
+         * @param maxDistance only points whose distance is lower than maxDistance are considered
+         * @return true if a point has been found, false otherwise (no triangles or none within maxDistance)
+         */
+        bool closestPoint(const double* point, ClosestPoint& result, double maxDistance = std::numeric_limits<double>::max()) const;
+
+        /**
+         * @brief firstHit method that searches for the first intersection between a ray and the triangles. Segments are rays whose direction
+         * is the difference between the endpoints, limited to tMax = 1.
+         * @param origin x, y and z of the origin of the ray
+         * @param direction x, y and z of the direction of the ray (not necessarily normalised)
+         * @param hit it receives the closest intersection, if found
+         * @param tMin, tMax only intersections whose ray parameter is in [tMin, tMax] are considered
+         * @return true if an intersection has been found, false otherwise
+         */
+        bool firstHit(const double* origin, const double* direction, RayHit& hit, double tMin = 0,
+                      double tMax = std::numeric_limits<double>::max()) const;
+
+        /**
+         * @brief anyHit method that checks whether a ray intersects any triangle, stopping at the first intersection found (useful for visibility)
+         * @param origin x, y and z of the origin of the ray
+         * @param direction x, y and z of the direction of the ray (not necessarily normalised)
+         * @param tMin, tMax only intersections whose ray parameter is in [tMin, tMax] are considered
+         * @return true if an intersection exists, false otherwise
+         */
+        bool anyHit(const double* origin, const double* direction, double tMin = 0, double tMax = std::numeric_limits<double>::max()) const;
+
+        /**
+         * @brief allHits method that searches for all the intersections between a ray and the triangles
+         * @param origin x, y and z of the origin of the ray
+         * @param direction x, y and z of the direction of the ray (not necessarily normalised)
+         * @param hits it receives the intersections sorted by increasing ray parameter (previous content is removed)
+         * @param tMin, tMax only intersections whose ray parameter is in [tMin, tMax] are considered
+         */
+        void allHits(const double* origin, const double* direction, std::vector<RayHit>& hits, double tMin = 0,
+                     double tMax = std::numeric_limits<double>::max()) const;
+
+    protected:
+        struct Node
+        {
+            double min[3];
+            double max[3];
+            //For leaves, the position of the first triangle in leaf order, for internal nodes the index of the right child
+            uint32_t offset;
+            //Number of triangles of leaves, 0 for internal nodes
+            uint32_t count;
+        };
+
+        std::vector<Node> nodes;
+        //Corners of the triangles in leaf order (a, b and c, each one split in its coordinates), and their indices in the input array
+        std::vector<double> ax, ay, az, bx, by, bz, cx, cy, cz;
+        std::vector<uint32_t> indices;
+        //Level of the deepest node (the root is at level 0)
+        unsigned int depth = 0;
+
+        std::size_t buildNode(std::vector<uint32_t>& order, const std::vector<double>& centroids, const std::vector<double>& bounds,
+                              std::size_t begin, std::size_t end, unsigned int level);
+
+        //Visits the leaves crossed by a ray in front-to-back order, until the visitor returns true. The visitor may shrink tMax.
+        template <class Visitor>
+        void traverseRay(const double* origin, const double* direction, double tMin, double& tMax, Visitor visit) const;
+
+        //Intersects a ray with count consecutive triangles starting from first, writing the ray parameters (infinity for missed triangles)
+        //and the barycentric coordinates of the second and third corner
+        void intersectLeaf(std::size_t first, std::size_t count, const double* origin, const double* direction, double tMin, double tMax,
+                           double* ts, double* us, double* vs) const;
+    };
+
+}
+#endif // TRIANGLEBVH_H
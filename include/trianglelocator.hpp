@@ -0,0 +1,98 @@
+#ifndef TRIANGLELOCATOR_H
+#define TRIANGLELOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SemantisedTriangleMesh {
+
+    /**
+     * @class TriangleLocator
+     * @brief Uniform grid over the XY projection of a set of triangles, answering 2.5D point location queries: which triangle lies above or below
+     * a point of the plane, and what is the height of the surface there. It is meant for terrain-like meshes (at most one layer of triangles
+     * over each point of the plane); where several triangles overlap, the first one found containing the point is reported.
+     *
+     * The size of the cells is chosen so that each cell is crossed by a few triangles. The triangles overlapping each cell are stored in a
+     * single array indexed by cell (compressed rows), and for each triangle the data needed for computing barycentric coordinates is
+     * precomputed, so that a query reads one row of the grid. Triangles whose projection is degenerate are not indexed.
+     * The structure is static: it must be rebuilt when the triangles change.
+     */
+    class TriangleLocator
+    {
+    public:
+        /**
+         * @brief The Location struct describes the triangle containing the projection of a query point
+         */
+        struct Location
+        {
+            //Index of the triangle in the input array
+            std::size_t triangle;
+            //Barycentric coordinates of the point with respect to the three corners of the triangle, in the input order
+            double barycentric[3];
+            //Height of the triangle at the query point, interpolated from the Z of the corners
+            double z;
+        };
+
+        //Tolerance on the barycentric coordinates, so that points on the edges (up to rounding errors) are located
+        static constexpr double TOLERANCE = 1e-9;
+        //Average number of triangles per cell the grid is sized for
+        static constexpr double TRIANGLES_PER_CELL = 2.0;
+
+        TriangleLocator();
+
+        /**
+         * @brief TriangleLocator constructor
+         * @param coordinates x, y and z of each vertex, consecutively
+         * @param faces the indices of the three corners of each triangle, consecutively
+         * @param trianglesNumber the number of triangles
+         */
+        TriangleLocator(const double* coordinates, const unsigned int* faces, std::size_t trianglesNumber);
+
+        /**
+         * @brief build method that (re)builds the grid. The arrays are not referenced after the construction.
+         * @param coordinates x, y and z of each vertex, consecutively
+         * @param faces the indices of the three corners of each triangle, consecutively
+         * @param trianglesNumber the number of triangles
+         */
+        void build(const double* coordinates, const unsigned int* faces, std::size_t trianglesNumber);
+
+        /**
+         * @brief size method that returns the number of triangles the grid was built on
+         * @return the number of triangles
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief locate method that searches for the triangle containing the projection of a point onto the XY plane
+         * @param x, y the coordinates of the point
+         * @param location it receives the triangle, the barycentric coordinates and the height, if found
+         * @param hint index of a triangle which is tested first (for instance the one found for the previous point, when the queries are
+         * spatially coherent). Values not lower than size() are ignored.
+         * @return true if a triangle has been found, false otherwise
+         */
+        bool locate(double x, double y, Location& location, std::size_t hint = SIZE_MAX) const;
+
+    protected:
+        struct TriangleData
+        {
+            //XY of the first corner and XY of the edges from the first to the second and the third corner
+            double ox, oy, e1x, e1y, e2x, e2y;
+            //Inverse of the (doubled, signed) area of the projection
+            double inverseArea;
+            //Heights of the corners
+            double z[3];
+        };
+
+        std::vector<TriangleData> data;
+        double minX = 0, minY = 0, cellSize = 1;
+        std::size_t columns = 0, rows = 0;
+        //Triangles overlapping cell i are cellTriangles[cellStart[i]], ..., cellTriangles[cellStart[i + 1] - 1]
+        std::vector<uint32_t> cellStart, cellTriangles;
+
+        //Computes the barycentric coordinates of (x, y) with respect to a triangle, returning the lowest one
+        double barycentric(std::size_t triangle, double x, double y, double* coordinates) const;
+    };
+
+}
+#endif // TRIANGLELOCATOR_H
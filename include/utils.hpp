@@ -1,7 +1,26 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 #include "Point.hpp"
+#include <algorithm>
+#include <cctype>
+#include <string>
 namespace SemantisedTriangleMesh {
 
+    /**
+     * @brief fileExtension method that extracts the extension of a file path, converted to lower case
+     * @param filename the file path
+     * @return the extension (without the dot), an empty string if the file name has no extension
+     */
+    inline std::string fileExtension(const std::string& filename)
+    {
+        std::size_t dotPos = filename.find_last_of('.');
+        std::size_t separatorPos = filename.find_last_of("/\\");
+        if(dotPos == std::string::npos || (separatorPos != std::string::npos && separatorPos > dotPos))
+            return "";
+        std::string extension = filename.substr(dotPos + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
 }
 #endif // UTILS_HPP
@@ -1,309 +1,488 @@
 /*
- * file: KDTree.hpp
- * author: J. Frederico Carvalho
+ * file: KDTree.cpp
  *
- * This is an adaptation of the KD-tree implementation in rosetta code
- * https://rosettacode.org/wiki/K-d_tree
- *
- * It is a reimplementation of the C code using C++.  It also includes a few
- * more queries than the original, namely finding all points at a distance
- * smaller than some given distance to a point.
+ * Implicit, array-laid-out kd-tree over 3D points (see KDTree.hpp).
  *
  */
 
 #include <algorithm>
 #include <cmath>
-#include <functional>
-#include <iterator>
+#include <future>
 #include <limits>
-#include <memory>
-#include <vector>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "KDTree.hpp"
 
-KDNode::KDNode() = default;
+//Subtrees with fewer points are never built by a separate thread
+static const size_t PARALLEL_BUILD_THRESHOLD = 1 << 16;
 
-KDNode::KDNode(const point_t &pt, const size_t &idx_, const KDNodePtr &left_,
-               const KDNodePtr &right_) {
-    x = pt;
-    index = idx_;
-    left = left_;
-    right = right_;
-}
-
-KDNode::KDNode(const pointIndex &pi, const KDNodePtr &left_,
-               const KDNodePtr &right_) {
-    x = pi.first;
-    index = pi.second;
-    left = left_;
-    right = right_;
+/**
+ * Squared distances between a query point and count points stored as separate coordinate arrays
+ */
+static inline void squaredDistances(const double *xs, const double *ys, const double *zs, size_t count, const double *point, double *distances) {
+    size_t i = 0;
+#if defined(__AVX__)
+    const __m256d qx = _mm256_set1_pd(point[0]);
+    const __m256d qy = _mm256_set1_pd(point[1]);
+    const __m256d qz = _mm256_set1_pd(point[2]);
+    for (; i + 4 <= count; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), qx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), qy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(zs + i), qz);
+        __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+        _mm256_storeu_pd(distances + i, d);
+    }
+#elif defined(__SSE2__)
+    const __m128d qx = _mm_set1_pd(point[0]);
+    const __m128d qy = _mm_set1_pd(point[1]);
+    const __m128d qz = _mm_set1_pd(point[2]);
+    for (; i + 2 <= count; i += 2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + i), qx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys + i), qy);
+        __m128d dz = _mm_sub_pd(_mm_loadu_pd(zs + i), qz);
+        __m128d d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        _mm_storeu_pd(distances + i, d);
+    }
+#endif
+    for (; i < count; i++) {
+        double dx = xs[i] - point[0];
+        double dy = ys[i] - point[1];
+        double dz = zs[i] - point[2];
+        distances[i] = dx * dx + dy * dy + dz * dz;
+    }
 }
 
-KDNode::~KDNode() = default;
-
-double KDNode::coord(const size_t &idx) { return x.at(idx); }
-KDNode::operator bool() { return (!x.empty()); }
-KDNode::operator point_t() { return x; }
-KDNode::operator size_t() { return index; }
-KDNode::operator pointIndex() { return pointIndex(x, index); }
-
-KDNodePtr NewKDNodePtr() {
-    KDNodePtr mynode = std::make_shared< KDNode >();
-    return mynode;
+/**
+ * Squared distance between a point and the closest (or farthest) point of a box
+ */
+template < class Box >
+static inline double boxDistance(const Box &box, const double *point) {
+    double d = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+        double delta = std::max(std::max(box.min[i] - point[i], point[i] - box.max[i]), 0.0);
+        d += delta * delta;
+    }
+    return d;
 }
 
-inline double dist2(const point_t &a, const point_t &b) {
-    double distc = 0;
-    for (size_t i = 0; i < a.size(); i++) {
-        double di = a.at(i) - b.at(i);
-        distc += di * di;
+template < class Box >
+static inline double boxFarthestDistance(const Box &box, const double *point) {
+    double d = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+        double delta = std::max(std::abs(box.min[i] - point[i]), std::abs(point[i] - box.max[i]));
+        d += delta * delta;
     }
-    return distc;
+    return d;
 }
 
-inline double dist2(const KDNodePtr &a, const KDNodePtr &b) {
-    return dist2(a->x, b->x);
+/**
+ * Squared distance between a point and the segment ab
+ */
+static inline double segmentSquaredDistance(const double *a, const double *b, const double *point) {
+    double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double ap[3] = {point[0] - a[0], point[1] - a[1], point[2] - a[2]};
+    double length = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+    double t = length > 0 ? std::min(std::max((ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2]) / length, 0.0), 1.0) : 0.0;
+    double d = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+        double delta = ap[i] - t * ab[i];
+        d += delta * delta;
+    }
+    return d;
 }
 
-inline double dist(const point_t &a, const point_t &b) {
-    return std::sqrt(dist2(a, b));
+/**
+ * Conservative test between a box and a capsule: false only if the segment ab misses the box enlarged by radius along each axis (which
+ * contains every point within radius from the box)
+ */
+template < class Box >
+static inline bool boxMayTouchCapsule(const Box &box, const double *a, const double *b, double radius) {
+    double tMin = 0, tMax = 1;
+    for (unsigned int i = 0; i < 3; i++) {
+        double min = box.min[i] - radius, max = box.max[i] + radius;
+        double d = b[i] - a[i];
+        if (d == 0) {
+            if (a[i] < min || a[i] > max)
+                return false;
+            continue;
+        }
+        double t1 = (min - a[i]) / d, t2 = (max - a[i]) / d;
+        tMin = std::max(tMin, std::min(t1, t2));
+        tMax = std::min(tMax, std::max(t1, t2));
+        if (tMin > tMax)
+            return false;
+    }
+    return true;
 }
 
-inline double dist(const KDNodePtr &a, const KDNodePtr &b) {
-    return std::sqrt(dist2(a, b));
+/**
+ * True if the whole box lies within the capsule (the capsule is convex, so checking the corners is enough)
+ */
+template < class Box >
+static inline bool boxInsideCapsule(const Box &box, const double *a, const double *b, double squaredRadius) {
+    for (unsigned int corner = 0; corner < 8; corner++) {
+        double point[3] = {(corner & 1) ? box.max[0] : box.min[0], (corner & 2) ? box.max[1] : box.min[1], (corner & 4) ? box.max[2] : box.min[2]};
+        if (segmentSquaredDistance(a, b, point) > squaredRadius)
+            return false;
+    }
+    return true;
 }
 
-comparer::comparer(size_t idx_) : idx{idx_} {};
+KDTree::KDTree() = default;
 
-inline bool comparer::compare_idx(const pointIndex &a,  //
-                                  const pointIndex &b   //
-) {
-    return (a.first.at(idx) < b.first.at(idx));  //
+KDTree::KDTree(pointVec point_array) {
+    std::vector< double > coordinates(point_array.size() * 3, 0.0);
+    for (size_t i = 0; i < point_array.size(); i++)
+        for (size_t j = 0; j < 3 && j < point_array[i].size(); j++)
+            coordinates[i * 3 + j] = point_array[i][j];
+    build(coordinates.data(), point_array.size());
 }
 
-inline void sort_on_idx(const pointIndexArr::iterator &begin,  //
-                        const pointIndexArr::iterator &end,    //
-                        size_t idx) {
-    comparer comp(idx);
-    comp.idx = idx;
+KDTree::KDTree(const double *coordinates, size_t pointsNumber, unsigned int threadsNumber) {
+    build(coordinates, pointsNumber, threadsNumber);
+}
 
-    using std::placeholders::_1;
-    using std::placeholders::_2;
+void KDTree::build(const double *coordinates, size_t pointsNumber, unsigned int threadsNumber) {
+    if (threadsNumber == 0)
+        threadsNumber = std::max(std::thread::hardware_concurrency(), 1u);
+
+    //The leaves are all at the same level, the lowest one at which they hold at most LEAF_SIZE points
+    depth = 0;
+    while ((pointsNumber + (size_t(1) << depth) - 1) >> depth > LEAF_SIZE)
+        depth++;
+    boxes.assign((size_t(1) << (depth + 1)) - 1, Box());
+
+    std::vector< uint32_t > permutation(pointsNumber);
+    for (size_t i = 0; i < pointsNumber; i++)
+        permutation[i] = static_cast< uint32_t >(i);
+    if (pointsNumber > 0)
+        buildNode(0, 0, pointsNumber, 0, coordinates, permutation.data(), threadsNumber);
+
+    xs.resize(pointsNumber);
+    ys.resize(pointsNumber);
+    zs.resize(pointsNumber);
+    for (size_t i = 0; i < pointsNumber; i++) {
+        xs[i] = coordinates[permutation[i] * size_t(3)];
+        ys[i] = coordinates[permutation[i] * size_t(3) + 1];
+        zs[i] = coordinates[permutation[i] * size_t(3) + 2];
+    }
+    indices.swap(permutation);
 
-    std::nth_element(begin, begin + std::distance(begin, end) / 2,
-                     end, std::bind(&comparer::compare_idx, comp, _1, _2));
+    builtLeavesExtent = 0;
+    if (pointsNumber > 0)
+        for (size_t node = (size_t(1) << depth) - 1; node < boxes.size(); node++)
+            for (unsigned int j = 0; j < 3; j++)
+                builtLeavesExtent += boxes[node].max[j] - boxes[node].min[j];
 }
 
-using pointVec = std::vector< point_t >;
-
-KDNodePtr KDTree::make_tree(const pointIndexArr::iterator &begin,  //
-                            const pointIndexArr::iterator &end,    //
-                            const size_t &length,                  //
-                            const size_t &level                    //
-) {
-    if (begin == end) {
-        return NewKDNodePtr();  // empty tree
+void KDTree::buildNode(size_t node, size_t begin, size_t end, unsigned int level, const double *coordinates, uint32_t *permutation,
+                       unsigned int threadsNumber) {
+    Box &box = boxes[node];
+    for (unsigned int j = 0; j < 3; j++) {
+        box.min[j] = std::numeric_limits< double >::max();
+        box.max[j] = -std::numeric_limits< double >::max();
     }
+    for (size_t i = begin; i < end; i++)
+        for (unsigned int j = 0; j < 3; j++) {
+            double c = coordinates[permutation[i] * size_t(3) + j];
+            box.min[j] = std::min(box.min[j], c);
+            box.max[j] = std::max(box.max[j], c);
+        }
+    if (level == depth)
+        return;
+
+    //Split along the largest extent of the box
+    unsigned int dimension = 0;
+    for (unsigned int j = 1; j < 3; j++)
+        if (box.max[j] - box.min[j] > box.max[dimension] - box.min[dimension])
+            dimension = j;
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(permutation + begin, permutation + middle, permutation + end, [coordinates, dimension](uint32_t a, uint32_t b) {
+        return coordinates[a * size_t(3) + dimension] < coordinates[b * size_t(3) + dimension];
+    });
+
+    if (threadsNumber > 1 && end - begin > PARALLEL_BUILD_THRESHOLD) {
+        auto left = std::async(std::launch::async, [=]() {
+            buildNode(2 * node + 1, begin, middle, level + 1, coordinates, permutation, threadsNumber / 2);
+        });
+        buildNode(2 * node + 2, middle, end, level + 1, coordinates, permutation, threadsNumber - threadsNumber / 2);
+        left.get();
+    } else {
+        buildNode(2 * node + 1, begin, middle, level + 1, coordinates, permutation, 1);
+        buildNode(2 * node + 2, middle, end, level + 1, coordinates, permutation, 1);
+    }
+}
 
-    size_t dim = begin->first.size();
+size_t KDTree::size() const { return indices.size(); }
 
-    if (length > 1) {
-        sort_on_idx(begin, end, level);
+double KDTree::refit(const double *coordinates) {
+    for (size_t i = 0; i < indices.size(); i++) {
+        xs[i] = coordinates[indices[i] * size_t(3)];
+        ys[i] = coordinates[indices[i] * size_t(3) + 1];
+        zs[i] = coordinates[indices[i] * size_t(3) + 2];
     }
+    if (indices.empty())
+        return 1.0;
+    double leavesExtent = 0;
+    refitNode(0, 0, size(), 0, leavesExtent);
+    if (builtLeavesExtent <= 0)
+        return leavesExtent > 0 ? std::numeric_limits< double >::max() : 1.0;
+    return leavesExtent / builtLeavesExtent;
+}
 
-    auto middle = begin + (length / 2);
+void KDTree::refitNode(size_t node, size_t begin, size_t end, unsigned int level, double &leavesExtent) {
+    Box &box = boxes[node];
+    if (level == depth) {
+        for (unsigned int j = 0; j < 3; j++) {
+            box.min[j] = std::numeric_limits< double >::max();
+            box.max[j] = -std::numeric_limits< double >::max();
+        }
+        for (size_t i = begin; i < end; i++) {
+            const double c[3] = {xs[i], ys[i], zs[i]};
+            for (unsigned int j = 0; j < 3; j++) {
+                box.min[j] = std::min(box.min[j], c[j]);
+                box.max[j] = std::max(box.max[j], c[j]);
+            }
+        }
+        for (unsigned int j = 0; j < 3; j++)
+            leavesExtent += box.max[j] - box.min[j];
+        return;
+    }
 
-    auto l_begin = begin;
-    auto l_end = middle;
-    auto r_begin = middle + 1;
-    auto r_end = end;
+    size_t middle = begin + (end - begin) / 2;
+    refitNode(2 * node + 1, begin, middle, level + 1, leavesExtent);
+    refitNode(2 * node + 2, middle, end, level + 1, leavesExtent);
+    const Box &left = boxes[2 * node + 1];
+    const Box &right = boxes[2 * node + 2];
+    for (unsigned int j = 0; j < 3; j++) {
+        box.min[j] = std::min(left.min[j], right.min[j]);
+        box.max[j] = std::max(left.max[j], right.max[j]);
+    }
+}
 
-    size_t l_len = length / 2;
-    size_t r_len = length - l_len - 1;
+size_t KDTree::nearest(const double *point, double *squaredDistance) const {
+    size_t best = size();
+    double bestDistance = std::numeric_limits< double >::max();
+    if (!indices.empty())
+        nearestNode(0, 0, size(), 0, point, best, bestDistance);
+    if (squaredDistance != nullptr)
+        *squaredDistance = bestDistance;
+    return best < size() ? indices[best] : size();
+}
 
-    KDNodePtr left;
-    if (l_len > 0 && dim > 0) {
-        left = make_tree(l_begin, l_end, l_len, (level + 1) % dim);
-    } else {
-        left = leaf;
+void KDTree::nearestNode(size_t node, size_t begin, size_t end, unsigned int level, const double *point, size_t &best,
+                         double &bestDistance) const {
+    if (level == depth) {
+        double distances[LEAF_SIZE];
+        squaredDistances(&xs[begin], &ys[begin], &zs[begin], end - begin, point, distances);
+        for (size_t i = 0; i < end - begin; i++)
+            if (distances[i] < bestDistance) {
+                bestDistance = distances[i];
+                best = begin + i;
+            }
+        return;
     }
-    KDNodePtr right;
-    if (r_len > 0 && dim > 0) {
-        right = make_tree(r_begin, r_end, r_len, (level + 1) % dim);
+
+    //The child whose box is closer is visited first, the other one only if it may contain a closer point
+    size_t middle = begin + (end - begin) / 2;
+    double leftDistance = boxDistance(boxes[2 * node + 1], point);
+    double rightDistance = boxDistance(boxes[2 * node + 2], point);
+    if (leftDistance <= rightDistance) {
+        if (leftDistance < bestDistance)
+            nearestNode(2 * node + 1, begin, middle, level + 1, point, best, bestDistance);
+        if (rightDistance < bestDistance)
+            nearestNode(2 * node + 2, middle, end, level + 1, point, best, bestDistance);
     } else {
-        right = leaf;
+        if (rightDistance < bestDistance)
+            nearestNode(2 * node + 2, middle, end, level + 1, point, best, bestDistance);
+        if (leftDistance < bestDistance)
+            nearestNode(2 * node + 1, begin, middle, level + 1, point, best, bestDistance);
     }
+}
 
-    // KDNode result = KDNode();
-    return std::make_shared< KDNode >(*middle, left, right);
+size_t KDTree::knnSearch(const double *point, size_t k, neighbour_t *result, double radius) const {
+    size_t count = 0;
+    if (k == 0 || indices.empty())
+        return 0;
+    double squaredRadius = radius < 0 ? std::numeric_limits< double >::max() : radius * radius;
+    knnNode(0, 0, size(), 0, point, k, result, count, squaredRadius);
+    std::sort_heap(result, result + count, [](const neighbour_t &a, const neighbour_t &b) { return a.second < b.second; });
+    for (size_t i = 0; i < count; i++)
+        result[i].first = indices[result[i].first];
+    return count;
 }
 
-KDTree::KDTree(pointVec point_array) {
-    leaf = std::make_shared< KDNode >();
-    // iterators
-    pointIndexArr arr;
-    for (size_t i = 0; i < point_array.size(); i++) {
-        arr.push_back(pointIndex(point_array.at(i), i));
+void KDTree::knnNode(size_t node, size_t begin, size_t end, unsigned int level, const double *point, size_t k, neighbour_t *heap,
+                     size_t &count, double squaredRadius) const {
+    //Until the heap is full, the bound is the radius, afterwards it is the distance of the farthest neighbour found so far
+    auto farther = [](const neighbour_t &a, const neighbour_t &b) { return a.second < b.second; };
+    if (level == depth) {
+        double distances[LEAF_SIZE];
+        squaredDistances(&xs[begin], &ys[begin], &zs[begin], end - begin, point, distances);
+        for (size_t i = 0; i < end - begin; i++) {
+            if (distances[i] > squaredRadius)
+                continue;
+            if (count < k) {
+                heap[count++] = neighbour_t(begin + i, distances[i]);
+                std::push_heap(heap, heap + count, farther);
+            } else if (distances[i] < heap[0].second) {
+                std::pop_heap(heap, heap + count, farther);
+                heap[count - 1] = neighbour_t(begin + i, distances[i]);
+                std::push_heap(heap, heap + count, farther);
+            }
+        }
+        return;
     }
 
-    auto begin = arr.begin();
-    auto end = arr.end();
-
-    size_t length = arr.size();
-    size_t level = 0;  // starting
+    size_t middle = begin + (end - begin) / 2;
+    double distances[2] = {boxDistance(boxes[2 * node + 1], point), boxDistance(boxes[2 * node + 2], point)};
+    unsigned int first = distances[0] <= distances[1] ? 0 : 1;
+    for (unsigned int c = first, visited = 0; visited < 2; c = 1 - c, visited++) {
+        double bound = count < k ? squaredRadius : heap[0].second;
+        if (distances[c] > bound || (count == k && distances[c] == bound))
+            continue;
+        if (c == 0)
+            knnNode(2 * node + 1, begin, middle, level + 1, point, k, heap, count, squaredRadius);
+        else
+            knnNode(2 * node + 2, middle, end, level + 1, point, k, heap, count, squaredRadius);
+    }
+}
 
-    root = KDTree::make_tree(begin, end, length, level);
+void KDTree::radiusSearch(const double *point, double radius, std::vector< size_t > &result) const {
+    result.clear();
+    if (!indices.empty())
+        radiusNode(0, 0, size(), 0, point, radius * radius, result);
+    for (auto &position : result)
+        position = indices[position];
 }
 
-KDNodePtr KDTree::nearest_(   //
-    const KDNodePtr &branch,  //
-    const point_t &pt,        //
-    const size_t &level,      //
-    const KDNodePtr &best,    //
-    const double &best_dist   //
-) {
-    double d, dx, dx2;
-
-    if (!bool(*branch)) {
-        return NewKDNodePtr();  // basically, null
+void KDTree::radiusNode(size_t node, size_t begin, size_t end, unsigned int level, const double *point, double squaredRadius,
+                        std::vector< size_t > &result) const {
+    const Box &box = boxes[node];
+    if (boxDistance(box, point) > squaredRadius)
+        return;
+    //Boxes completely inside the sphere are reported without computing any distance
+    if (boxFarthestDistance(box, point) <= squaredRadius) {
+        for (size_t i = begin; i < end; i++)
+            result.push_back(i);
+        return;
     }
-
-    point_t branch_pt(*branch);
-    size_t dim = branch_pt.size();
-
-    d = dist2(branch_pt, pt);
-    dx = branch_pt.at(level) - pt.at(level);
-    dx2 = dx * dx;
-
-    KDNodePtr best_l = best;
-    double best_dist_l = best_dist;
-
-    if (d < best_dist) {
-        best_dist_l = d;
-        best_l = branch;
+    if (level == depth) {
+        double distances[LEAF_SIZE];
+        squaredDistances(&xs[begin], &ys[begin], &zs[begin], end - begin, point, distances);
+        for (size_t i = 0; i < end - begin; i++)
+            if (distances[i] <= squaredRadius)
+                result.push_back(begin + i);
+        return;
     }
+    size_t middle = begin + (end - begin) / 2;
+    radiusNode(2 * node + 1, begin, middle, level + 1, point, squaredRadius, result);
+    radiusNode(2 * node + 2, middle, end, level + 1, point, squaredRadius, result);
+}
 
-    size_t next_lv = (level + 1) % dim;
-    KDNodePtr section;
-    KDNodePtr other;
+void KDTree::capsuleSearch(const double *a, const double *b, double radius, std::vector< size_t > &result) const {
+    double polyline[6] = {a[0], a[1], a[2], b[0], b[1], b[2]};
+    corridorSearch(polyline, 2, radius, result);
+}
 
-    // select which branch makes sense to check
-    if (dx > 0) {
-        section = branch->left;
-        other = branch->right;
-    } else {
-        section = branch->right;
-        other = branch->left;
-    }
+void KDTree::corridorSearch(const double *polyline, size_t verticesNumber, double radius, std::vector< size_t > &result) const {
+    result.clear();
+    if (indices.empty() || verticesNumber == 0 || radius < 0)
+        return;
+    //A single vertex is handled as a degenerate segment
+    std::vector< double > points(polyline, polyline + verticesNumber * 3);
+    if (verticesNumber == 1)
+        points.insert(points.end(), polyline, polyline + 3);
+    size_t segmentsNumber = points.size() / 3 - 1;
+
+    //Each level of the recursion keeps the segments that may still touch its node in its own slice of the workspace
+    std::vector< uint32_t > workspace((depth + 2) * segmentsNumber);
+    for (size_t i = 0; i < segmentsNumber; i++)
+        workspace[i] = static_cast< uint32_t >(i);
+    corridorNode(0, 0, size(), 0, points.data(), radius, workspace.data(), segmentsNumber, workspace.data() + segmentsNumber, result);
+    for (auto &position : result)
+        position = indices[position];
+}
 
-    // keep nearest neighbor from further down the tree
-    KDNodePtr further = nearest_(section, pt, next_lv, best_l, best_dist_l);
-    if (!further->x.empty()) {
-        double dl = dist2(further->x, pt);
-        if (dl < best_dist_l) {
-            best_dist_l = dl;
-            best_l = further;
+void KDTree::corridorNode(size_t node, size_t begin, size_t end, unsigned int level, const double *polyline, double radius,
+                          const uint32_t *active, size_t activeNumber, uint32_t *workspace, std::vector< size_t > &result) const {
+    const Box &box = boxes[node];
+    double squaredRadius = radius * radius;
+    size_t touching = 0;
+    for (size_t i = 0; i < activeNumber; i++) {
+        const double *a = &polyline[active[i] * size_t(3)];
+        if (!boxMayTouchCapsule(box, a, a + 3, radius))
+            continue;
+        //Boxes completely inside the capsule of a segment are reported without computing any distance
+        if (boxInsideCapsule(box, a, a + 3, squaredRadius)) {
+            for (size_t j = begin; j < end; j++)
+                result.push_back(j);
+            return;
         }
+        workspace[touching++] = active[i];
     }
-    // only check the other branch if it makes sense to do so
-    if (dx2 < best_dist_l) {
-        further = nearest_(other, pt, next_lv, best_l, best_dist_l);
-        if (!further->x.empty()) {
-            double dl = dist2(further->x, pt);
-            if (dl < best_dist_l) {
-                best_dist_l = dl;
-                best_l = further;
+    if (touching == 0)
+        return;
+
+    if (level == depth) {
+        for (size_t j = begin; j < end; j++) {
+            const double point[3] = {xs[j], ys[j], zs[j]};
+            for (size_t i = 0; i < touching; i++) {
+                const double *a = &polyline[workspace[i] * size_t(3)];
+                if (segmentSquaredDistance(a, a + 3, point) <= squaredRadius) {
+                    result.push_back(j);
+                    break;
+                }
             }
         }
+        return;
     }
-
-    return best_l;
-};
-
-// default caller
-KDNodePtr KDTree::nearest_(const point_t &pt) {
-    size_t level = 0;
-    // KDNodePtr best = branch;
-    double branch_dist = dist2(point_t(*root), pt);
-    return nearest_(root,          // beginning of tree
-                    pt,            // point we are querying
-                    level,         // start from level 0
-                    root,          // best is the root
-                    branch_dist);  // best_dist = branch_dist
-};
+    size_t middle = begin + (end - begin) / 2;
+    uint32_t *next = workspace + touching;
+    corridorNode(2 * node + 1, begin, middle, level + 1, polyline, radius, workspace, touching, next, result);
+    corridorNode(2 * node + 2, middle, end, level + 1, polyline, radius, workspace, touching, next, result);
+}
 
 point_t KDTree::nearest_point(const point_t &pt) {
-    return point_t(*nearest_(pt));
-};
+    return nearest_pointIndex(pt).first;
+}
+
 size_t KDTree::nearest_index(const point_t &pt) {
-    return nearest_(pt)->index;
-};
+    return nearest(pt.data());
+}
 
 pointIndex KDTree::nearest_pointIndex(const point_t &pt) {
-    KDNodePtr Nearest = nearest_(pt);
-    return pointIndex(point_t(*Nearest), size_t(*Nearest));
+    size_t best = size();
+    double bestDistance = std::numeric_limits< double >::max();
+    if (indices.empty())
+        return pointIndex(point_t(), best);
+    nearestNode(0, 0, size(), 0, pt.data(), best, bestDistance);
+    return pointIndex(point_t({xs[best], ys[best], zs[best]}), indices[best]);
 }
 
-pointIndexArr KDTree::neighborhood_(  //
-    const KDNodePtr &branch,          //
-    const point_t &pt,                //
-    const double &rad,                //
-    const size_t &level               //
-) {
-    double d, dx, dx2;
-
-    if (!bool(*branch)) {
-        // branch has no point, means it is a leaf,
-        // no points to add
-        return pointIndexArr();
-    }
-
-    size_t dim = pt.size();
-
-    double r2 = rad * rad;
-
-    d = dist2(point_t(*branch), pt);
-    dx = point_t(*branch).at(level) - pt.at(level);
-    dx2 = dx * dx;
-
-    pointIndexArr nbh, nbh_s, nbh_o;
-    if (d <= r2) {
-        nbh.push_back(pointIndex(*branch));
-    }
-
-    //
-    KDNodePtr section;
-    KDNodePtr other;
-    if (dx > 0) {
-        section = branch->left;
-        other = branch->right;
-    } else {
-        section = branch->right;
-        other = branch->left;
-    }
-
-    nbh_s = neighborhood_(section, pt, rad, (level + 1) % dim);
-    nbh.insert(nbh.end(), nbh_s.begin(), nbh_s.end());
-    if (dx2 < r2) {
-        nbh_o = neighborhood_(other, pt, rad, (level + 1) % dim);
-        nbh.insert(nbh.end(), nbh_o.begin(), nbh_o.end());
-    }
-
-    return nbh;
-};
-
 pointIndexArr KDTree::neighborhood(  //
     const point_t &pt,               //
     const double &rad) {
-    size_t level = 0;
-    return neighborhood_(root, pt, rad, level);
+    std::vector< size_t > positions;
+    if (!indices.empty())
+        radiusNode(0, 0, size(), 0, pt.data(), rad * rad, positions);
+    pointIndexArr nbh;
+    nbh.reserve(positions.size());
+    for (auto position : positions)
+        nbh.push_back(pointIndex(point_t({xs[position], ys[position], zs[position]}), indices[position]));
+    return nbh;
 }
 
 pointVec KDTree::neighborhood_points(  //
     const point_t &pt,                 //
     const double &rad) {
-    size_t level = 0;
-    pointIndexArr nbh = neighborhood_(root, pt, rad, level);
+    pointIndexArr nbh = neighborhood(pt, rad);
     pointVec nbhp;
     nbhp.resize(nbh.size());
     std::transform(nbh.begin(), nbh.end(), nbhp.begin(),
@@ -314,11 +493,7 @@ pointVec KDTree::neighborhood_points(  //
 indexArr KDTree::neighborhood_indices(  //
     const point_t &pt,                  //
     const double &rad) {
-    size_t level = 0;
-    pointIndexArr nbh = neighborhood_(root, pt, rad, level);
     indexArr nbhi;
-    nbhi.resize(nbh.size());
-    std::transform(nbh.begin(), nbh.end(), nbhi.begin(),
-                   [](pointIndex x) { return x.second; });
+    radiusSearch(pt.data(), rad, nbhi);
     return nbhi;
 }
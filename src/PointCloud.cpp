@@ -0,0 +1,487 @@
+#include "PointCloud.hpp"
+#include "TriangleMesh.hpp"
+#include "plyformat.hpp"
+#include "threadpool.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <utils.hpp>
+
+using namespace SemantisedTriangleMesh;
+
+PointCloud::PointCloud()
+{
+    kdtree = nullptr;
+}
+
+PointCloud::PointCloud(const PointCloud &other)
+{
+    coordinates = other.coordinates;
+    for(auto channel : other.pointChannels)
+        pointChannels.push_back(channel->clone());
+    kdtree = other.kdtree;
+    min = other.min;
+    max = other.max;
+}
+
+PointCloud::PointCloud(const std::shared_ptr<TriangleMesh> &mesh)
+{
+    kdtree = nullptr;
+    updateFromMesh(mesh);
+}
+
+PointCloud::~PointCloud()
+{
+    coordinates.clear();
+    pointChannels.clear();
+}
+
+std::size_t PointCloud::getPointsNumber() const
+{
+    return coordinates.size() / 3;
+}
+
+void PointCloud::reserve(std::size_t pointsNumber)
+{
+    coordinates.reserve(pointsNumber * 3);
+}
+
+std::size_t PointCloud::addPoint(double x, double y, double z)
+{
+    coordinates.insert(coordinates.end(), {x, y, z});
+    for(auto channel : pointChannels)
+        channel->resize(getPointsNumber());
+    kdtree = nullptr;
+    return getPointsNumber() - 1;
+}
+
+std::size_t PointCloud::addPoint(const Point &p)
+{
+    return addPoint(p.getX(), p.getY(), p.getZ());
+}
+
+Point PointCloud::getPoint(std::size_t pos) const
+{
+    return Point(coordinates.at(pos * 3), coordinates.at(pos * 3 + 1), coordinates.at(pos * 3 + 2));
+}
+
+void PointCloud::setPoint(std::size_t pos, const Point &p)
+{
+    coordinates.at(pos * 3) = p.getX();
+    coordinates.at(pos * 3 + 1) = p.getY();
+    coordinates.at(pos * 3 + 2) = p.getZ();
+    kdtree = nullptr;
+}
+
+const std::vector<double> &PointCloud::getCoordinates() const
+{
+    return coordinates;
+}
+
+void PointCloud::updateFromMesh(const std::shared_ptr<TriangleMesh> &mesh)
+{
+    //clear keeps the capacity of the coordinates, so a cloud of the same size is refreshed without reallocating
+    clear();
+    coordinates.reserve(mesh->getVerticesNumber() * 3);
+    for(uint i = 0; i < mesh->getVerticesNumber(); i++)
+    {
+        auto v = mesh->getVertex(i);
+        coordinates.insert(coordinates.end(), {v->getX(), v->getY(), v->getZ()});
+    }
+    for(auto channel : mesh->getVertexChannels())
+        pointChannels.push_back(channel->clone());
+    computeProperties();
+}
+
+void PointCloud::clear()
+{
+    coordinates.clear();
+    pointChannels.clear();
+    kdtree = nullptr;
+}
+
+int PointCloud::load(std::string filename, std::size_t chunkSize)
+{
+    if(filename.compare("") == 0)
+        return -std::numeric_limits<int>::max();
+    clear();
+    std::size_t expectedPoints = 0;
+    int retValue = readPoints(filename, [this, &expectedPoints](const double* chunkCoordinates, const std::vector<std::shared_ptr<PropertyChannel> >& chunkChannels, std::size_t pointsNumber)
+    {
+        //The (estimated) total is known before the first chunk is delivered, so the coordinates are allocated once
+        if(coordinates.capacity() < expectedPoints * 3)
+            coordinates.reserve(expectedPoints * 3);
+        std::size_t offset = getPointsNumber();
+        coordinates.insert(coordinates.end(), chunkCoordinates, chunkCoordinates + pointsNumber * 3);
+        for(auto chunkChannel : chunkChannels)
+        {
+            auto channel = addPointChannel(chunkChannel->getName(), chunkChannel->getType());
+            channel->resize(getPointsNumber());
+            for(std::size_t i = 0; i < pointsNumber; i++)
+                channel->setValue(offset + i, chunkChannel->getValue(i));
+        }
+        std::cout << "Loaded " << getPointsNumber() << " points\r" << std::flush;
+    }, chunkSize, expectedPoints);
+    std::cout << std::endl;
+
+    if(retValue == 0)
+    {
+        //Trimming copies the whole array, so it is worth it only if the estimate of an xyz file was well above the actual number of points
+        if(coordinates.capacity() - coordinates.size() > coordinates.capacity() / 4)
+            coordinates.shrink_to_fit();
+        computeProperties();
+    }
+    return retValue;
+}
+
+int PointCloud::stream(std::string filename, const ChunkCallback &callback, std::size_t chunkSize)
+{
+    std::size_t expectedPoints = 0;
+    return readPoints(filename, callback, chunkSize, expectedPoints);
+}
+
+int PointCloud::save(std::string filename, unsigned int precision, bool binary)
+{
+    std::cout << "Saving " << filename << std::endl;
+    std::string format = fileExtension(filename);
+    if(format.compare("ply") != 0 && format.compare("xyz") != 0)
+        return 1;
+    std::ofstream cloudStream(filename, std::ios::binary);
+    if(!cloudStream.is_open())
+        return -1;
+    cloudStream.precision(precision);
+
+    if(format.compare("ply") == 0)
+    {
+        PLYHeader header;
+        PLYElement vertexElement;
+        header.format = binary ? PLYFormat::BINARY_LITTLE_ENDIAN : PLYFormat::ASCII;
+        vertexElement.name = "vertex";
+        vertexElement.count = getPointsNumber();
+        for(std::string coordinate : {"x", "y", "z"})
+        {
+            PLYProperty property;
+            property.name = coordinate;
+            property.type = ScalarType::FLOAT64;
+            vertexElement.properties.push_back(property);
+        }
+        for(auto channel : pointChannels)
+        {
+            PLYProperty property;
+            property.name = channel->getName();
+            property.type = channel->getType();
+            vertexElement.properties.push_back(property);
+        }
+        header.elements = {vertexElement};
+        header.write(cloudStream);
+        PLYValueWriter writer(cloudStream, header.format);
+        for(std::size_t i = 0; i < getPointsNumber(); i++)
+        {
+            if(binary)
+            {
+                for(uint j = 0; j < 3; j++)
+                    writer.write(ScalarType::FLOAT64, coordinates[i * 3 + j]);
+                for(auto channel : pointChannels)
+                    writer.write(channel->getType(), channel->getValue(i));
+            } else
+            {
+                cloudStream << coordinates[i * 3] << " " << coordinates[i * 3 + 1] << " " << coordinates[i * 3 + 2];
+                for(auto channel : pointChannels)
+                {
+                    cloudStream << " ";
+                    channel->printValue(cloudStream, i);
+                }
+                cloudStream << "\n";
+            }
+        }
+    } else
+        for(std::size_t i = 0; i < getPointsNumber(); i++)
+            cloudStream << coordinates[i * 3] << " " << coordinates[i * 3 + 1] << " " << coordinates[i * 3 + 2] << "\n";
+
+    std::cout << "Ended! Written " << getPointsNumber() << " points" << std::endl;
+    cloudStream.close();
+    return 0;
+}
+
+std::shared_ptr<PropertyChannel> PointCloud::addPointChannel(const std::string &name, ScalarType type)
+{
+    auto channel = getPointChannel(name);
+    if(channel != nullptr)
+        return channel;
+    channel = PropertyChannel::create(name, type, getPointsNumber());
+    if(channel != nullptr)
+        pointChannels.push_back(channel);
+    return channel;
+}
+
+std::shared_ptr<PropertyChannel> PointCloud::getPointChannel(const std::string &name) const
+{
+    for(auto channel : pointChannels)
+        if(channel->getName().compare(name) == 0)
+            return channel;
+    return nullptr;
+}
+
+bool PointCloud::removePointChannel(const std::string &name)
+{
+    for(auto cit = pointChannels.begin(); cit != pointChannels.end(); cit++)
+        if((*cit)->getName().compare(name) == 0)
+        {
+            pointChannels.erase(cit);
+            return true;
+        }
+    return false;
+}
+
+const std::vector<std::shared_ptr<PropertyChannel> > &PointCloud::getPointChannels() const
+{
+    return pointChannels;
+}
+
+std::vector<std::size_t> PointCloud::getNearestNeighbours(const Point &p, double radius)
+{
+    if(getPointsNumber() == 0)
+        return std::vector<std::size_t>();
+    double point[3] = {p.getX(), p.getY(), p.getZ()};
+    std::vector<std::size_t> indices;
+    getKDTree()->radiusSearch(point, radius, indices);
+    return indices;
+}
+
+std::size_t PointCloud::searchNearestNeighbours(const Point &p, std::size_t k, neighbour_t *result, double radius)
+{
+    if(getPointsNumber() == 0)
+        return 0;
+    double point[3] = {p.getX(), p.getY(), p.getZ()};
+    return getKDTree()->knnSearch(point, k, result, radius > 0 ? radius : -1.0);
+}
+
+void PointCloud::searchNearestNeighbours(const double *queries, std::size_t queriesNumber, std::size_t k, neighbour_t *results, std::size_t *counts, double radius, ThreadPool *pool)
+{
+    std::shared_ptr<KDTree> tree = getKDTree();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, queriesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+            counts[i] = tree->knnSearch(&queries[i * 3], k, &results[i * k], radius > 0 ? radius : -1.0);
+    });
+}
+
+std::size_t PointCloud::getClosestPoint(const Point &p)
+{
+    if(getPointsNumber() == 0)
+        return 0;
+    double point[3] = {p.getX(), p.getY(), p.getZ()};
+    return getKDTree()->nearest(point);
+}
+
+void PointCloud::getClosestPoints(const double *queries, std::size_t queriesNumber, std::size_t *indices, double *squaredDistances, ThreadPool *pool)
+{
+    std::shared_ptr<KDTree> tree = getKDTree();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, queriesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+            indices[i] = tree->nearest(&queries[i * 3], squaredDistances != nullptr ? &squaredDistances[i] : nullptr);
+    });
+}
+
+void PointCloud::computeProperties()
+{
+    min = Point(std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+    max = Point(-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max());
+    for(std::size_t i = 0; i < getPointsNumber(); i++)
+    {
+        const double* p = &coordinates[i * 3];
+        if(p[0] < min.getX())
+            min.setX(p[0]);
+        if(p[1] < min.getY())
+            min.setY(p[1]);
+        if(p[2] < min.getZ())
+            min.setZ(p[2]);
+        if(p[0] > max.getX())
+            max.setX(p[0]);
+        if(p[1] > max.getY())
+            max.setY(p[1]);
+        if(p[2] > max.getZ())
+            max.setZ(p[2]);
+    }
+}
+
+Point PointCloud::getMin() const
+{
+    return min;
+}
+
+Point PointCloud::getMax() const
+{
+    return max;
+}
+
+void PointCloud::initialiseKDTree()
+{
+    std::atomic_store(&kdtree, std::make_shared<KDTree>(coordinates.data(), getPointsNumber()));
+}
+
+std::shared_ptr<KDTree> PointCloud::getKDTree()
+{
+    std::shared_ptr<KDTree> tree = std::atomic_load(&kdtree);
+    if(tree == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(kdtreeMutex);
+        tree = std::atomic_load(&kdtree);
+        if(tree == nullptr)
+        {
+            initialiseKDTree();
+            tree = std::atomic_load(&kdtree);
+        }
+    }
+    return tree;
+}
+
+int PointCloud::readPoints(std::string filename, const ChunkCallback &callback, std::size_t chunkSize, std::size_t &expectedPoints)
+{
+    std::ifstream fileStream(filename, std::ios::binary);
+    if(!fileStream.is_open())
+        return -1;
+    if(chunkSize == 0)
+        chunkSize = DEFAULT_CHUNK_SIZE;
+    int retValue;
+    if(fileExtension(filename).compare("ply") == 0)
+        retValue = readPLYPoints(fileStream, callback, chunkSize, expectedPoints);
+    else
+    {
+        fileStream.seekg(0, std::ios::end);
+        std::streamoff fileSize = fileStream.tellg();
+        fileStream.seekg(0, std::ios::beg);
+        retValue = readXYZPoints(fileStream, fileSize, callback, chunkSize, expectedPoints);
+    }
+    fileStream.close();
+    return retValue;
+}
+
+int PointCloud::readPLYPoints(std::istream &stream, const ChunkCallback &callback, std::size_t chunkSize, std::size_t &expectedPoints)
+{
+    PLYHeader header;
+    int retValue = header.read(stream);
+    if(retValue != 0)
+        return retValue;
+    int vertexElementPos = header.findElement("vertex");
+    if(vertexElementPos < 0)
+    {
+        std::cerr << "File has to contain vertices specification!" << std::endl;
+        return 2;
+    }
+    const PLYElement& vertexElement = header.elements.at(static_cast<uint>(vertexElementPos));
+    int coordinatesPos[3] = {vertexElement.findProperty("x"), vertexElement.findProperty("y"), vertexElement.findProperty("z")};
+    if(coordinatesPos[0] < 0 || coordinatesPos[1] < 0 || coordinatesPos[2] < 0)
+    {
+        std::cerr << "X, Y and Z coordinates format needs to be specified!" << std::endl;
+        return 3;
+    }
+
+    //Every scalar property that is not a coordinate is stored into a channel, whose values are overwritten at each chunk
+    std::vector<std::shared_ptr<PropertyChannel> > propertiesChannels(vertexElement.properties.size(), nullptr);
+    std::vector<std::shared_ptr<PropertyChannel> > chunkChannels;
+    for(uint i = 0; i < vertexElement.properties.size(); i++)
+    {
+        auto property = vertexElement.properties.at(i);
+        if(!property.isList && static_cast<int>(i) != coordinatesPos[0] && static_cast<int>(i) != coordinatesPos[1] && static_cast<int>(i) != coordinatesPos[2])
+        {
+            propertiesChannels.at(i) = PropertyChannel::create(property.name, property.type, std::min(chunkSize, vertexElement.count));
+            chunkChannels.push_back(propertiesChannels.at(i));
+        }
+    }
+
+    PLYValueReader reader(stream, header.format);
+    for(uint e = 0; e < static_cast<uint>(vertexElementPos); e++)
+        for(std::size_t i = 0; i < header.elements.at(e).count; i++)
+            for(auto property : header.elements.at(e).properties)
+                if(!reader.skipProperty(property))
+                    return 8;
+
+    expectedPoints = vertexElement.count;
+    std::vector<double> chunk(std::min(chunkSize, vertexElement.count) * 3);
+    std::size_t chunkPoints = 0;
+    for(std::size_t i = 0; i < vertexElement.count; i++)
+    {
+        for(uint j = 0; j < vertexElement.properties.size(); j++)
+        {
+            double value = 0.0;
+            bool read;
+            if(vertexElement.properties.at(j).isList)
+                read = reader.skipProperty(vertexElement.properties.at(j));
+            else
+                read = reader.read(vertexElement.properties.at(j).type, value);
+            if(!read)
+                return 7;
+            if(static_cast<int>(j) == coordinatesPos[0])
+                chunk[chunkPoints * 3] = value;
+            else if(static_cast<int>(j) == coordinatesPos[1])
+                chunk[chunkPoints * 3 + 1] = value;
+            else if(static_cast<int>(j) == coordinatesPos[2])
+                chunk[chunkPoints * 3 + 2] = value;
+            else if(propertiesChannels.at(j) != nullptr)
+                propertiesChannels.at(j)->setValue(chunkPoints, value);
+        }
+        if(++chunkPoints == chunk.size() / 3 || i + 1 == vertexElement.count)
+        {
+            for(auto channel : chunkChannels)
+                channel->resize(chunkPoints);
+            callback(chunk.data(), chunkChannels, chunkPoints);
+            chunkPoints = 0;
+        }
+    }
+    return 0;
+}
+
+int PointCloud::readXYZPoints(std::istream &stream, std::streamoff fileSize, const ChunkCallback &callback, std::size_t chunkSize, std::size_t &expectedPoints)
+{
+    std::vector<double> chunk;
+    chunk.reserve(chunkSize * 3);
+    std::vector<std::shared_ptr<PropertyChannel> > noChannels;
+    std::size_t deliveredPoints = 0;
+    std::string line;
+    while(std::getline(stream, line))
+    {
+        //Lines not starting with three numbers (comments, headers of text exports) are only admitted before the first point
+        const char* c = line.c_str();
+        double point[3];
+        uint j = 0;
+        for(; j < 3; j++)
+        {
+            char* end;
+            point[j] = std::strtod(c, &end);
+            if(end == c)
+                break;
+            c = end;
+        }
+        if(j < 3)
+        {
+            if(line.find_first_not_of(" \t\r") == std::string::npos || deliveredPoints + chunk.size() / 3 == 0)
+                continue;
+            std::cerr << "Malformed point specification: " << line << std::endl;
+            return 7;
+        }
+        chunk.insert(chunk.end(), point, point + 3);
+        if(chunk.size() == chunkSize * 3)
+        {
+            //The total number of points is estimated from the size of the lines read so far
+            std::streamoff position = stream.tellg();
+            if(deliveredPoints == 0 && position > 0)
+                expectedPoints = static_cast<std::size_t>(static_cast<double>(fileSize) / position * chunkSize * 1.05);
+            deliveredPoints += chunkSize;
+            callback(chunk.data(), noChannels, chunkSize);
+            chunk.clear();
+        }
+    }
+    if(!chunk.empty())
+    {
+        if(deliveredPoints == 0)
+            expectedPoints = chunk.size() / 3;
+        callback(chunk.data(), noChannels, chunk.size() / 3);
+    }
+    return 0;
+}
@@ -3,17 +3,108 @@
 #include "pointannotation.hpp"
 #include "lineannotation.hpp"
 #include "trianglehelper.hpp"
+#include "plyformat.hpp"
+#include "threadpool.hpp"
+#include "trianglebvh.hpp"
+#include "trianglelocator.hpp"
+#include "geodesicsolver.hpp"
+#include "indexedheap.hpp"
 #include <fstream>
 #include <sstream>
 #include <map>
 #include <exception>
 #include <queue>
 #include <set>
+#include <unordered_map>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <random>
 #include <utils.hpp>
 
 
 using namespace SemantisedTriangleMesh;
 
+/**
+ * Size of the cells of the XY hash of the vertices: about one point per cell, but large enough to keep the cell indices of far away
+ * (e.g. geo-referenced) coordinates representable
+ */
+static double computeXYCellSize(const double* minXY, const double* maxXY, std::size_t pointsNumber)
+{
+    if(pointsNumber == 0 || minXY[0] > maxXY[0])
+        return 1.0;
+    double diagonal = std::sqrt((maxXY[0] - minXY[0]) * (maxXY[0] - minXY[0]) + (maxXY[1] - minXY[1]) * (maxXY[1] - minXY[1]));
+    double magnitude = std::max(std::max(std::abs(minXY[0]), std::abs(maxXY[0])), std::max(std::abs(minXY[1]), std::abs(maxXY[1])));
+    double cellSize = std::max(diagonal / std::sqrt(static_cast<double>(pointsNumber)), magnitude * 1e-9);
+    return cellSize > 0 ? cellSize : 1.0;
+}
+
+namespace {
+
+    //Edge weights of the shortest path search, one for each DistanceType. When UseHeight is false the vertices are projected onto the XY
+    //plane on the fly, leaving the mesh untouched. lowerBound never exceeds the weight of any path between two vertices, and satisfies the
+    //triangle inequality with respect to the edge weights, so it is a consistent A* heuristic.
+    template <bool UseHeight>
+    inline Point projectPoint(const Point& p)
+    {
+        return UseHeight ? Point(p.getX(), p.getY(), p.getZ()) : Point(p.getX(), p.getY(), 0);
+    }
+
+    template <bool UseHeight>
+    struct EuclideanPathWeight
+    {
+        double operator()(const Vertex& from, const Vertex& to) const
+        {
+            double dx = to.getX() - from.getX(), dy = to.getY() - from.getY(), dz = UseHeight ? to.getZ() - from.getZ() : 0.0;
+            return std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+
+        double lowerBound(const Vertex& from, const Vertex& to) const
+        {
+            return (*this)(from, to);
+        }
+    };
+
+    template <bool UseHeight>
+    struct SegmentPathWeight
+    {
+        Point a, b;
+
+        SegmentPathWeight(const Point& a, const Point& b) : a(projectPoint<UseHeight>(a)), b(projectPoint<UseHeight>(b)) {}
+
+        double operator()(const Vertex&, const Vertex& to) const
+        {
+            return projectPoint<UseHeight>(to).computePointSegmentDistance(a, b);
+        }
+
+        double lowerBound(const Vertex&, const Vertex&) const
+        {
+            return 0.0;
+        }
+    };
+
+    template <bool UseHeight>
+    struct CombinedPathWeight
+    {
+        EuclideanPathWeight<UseHeight> length;
+        SegmentPathWeight<UseHeight> segment;
+
+        CombinedPathWeight(const Point& a, const Point& b) : segment(a, b) {}
+
+        double operator()(const Vertex& from, const Vertex& to) const
+        {
+            return length(from, to) + segment(from, to);
+        }
+
+        double lowerBound(const Vertex& from, const Vertex& to) const
+        {
+            return length(from, to);
+        }
+    };
+
+}
+
 TriangleMesh::TriangleMesh()
 {
     relationshipsGraph = std::make_shared<GraphTemplate::Graph<std::shared_ptr<Annotation> > >();
@@ -31,6 +122,7 @@ TriangleMesh::TriangleMesh(const std::shared_ptr<TriangleMesh> &other)
         newV->setId(v->getId());
         newV->setInfo(v->getInfo());
         newV->setAssociatedFlags(v->getAssociatedFlags());
+        newV->setPositionsGeneration(positionsGeneration);
         this->vertices.push_back(newV);
     }
 
@@ -112,6 +204,10 @@ TriangleMesh::TriangleMesh(const std::shared_ptr<TriangleMesh> &other)
         }
 
     }
+    for(auto channel : other->getVertexChannels())
+        vertexChannels.push_back(channel->clone());
+    for(auto channel : other->getTriangleChannels())
+        triangleChannels.push_back(channel->clone());
     minEdgeLength = other->getMinEdgeLength();
     maxEdgeLength = other->getMaxEdgeLength();
 
@@ -148,14 +244,12 @@ unsigned int TriangleMesh::getTrianglesNumber()
 
 std::shared_ptr<Vertex> TriangleMesh::addNewVertex()
 {
-    vertices.push_back(std::make_shared<Vertex>());
-    return vertices.back();
+    return appendVertex(std::make_shared<Vertex>());
 }
 
 std::shared_ptr<Vertex> TriangleMesh::addNewVertex(double x, double y, double z)
 {
-    vertices.push_back(std::make_shared<Vertex>(x, y, z));
-    return vertices.back();
+    return appendVertex(std::make_shared<Vertex>(x, y, z));
 }
 
 std::shared_ptr<Vertex> TriangleMesh::addNewVertex(Point p)
@@ -167,18 +261,28 @@ std::shared_ptr<Vertex> TriangleMesh::addNewVertex(Point p)
 
 std::shared_ptr<Vertex> TriangleMesh::addNewVertex(std::shared_ptr<Vertex> v)
 {
-    auto it = std::find_if(vertices.begin(), vertices.end(), [v](std::shared_ptr<Vertex> v1){
-            auto p1 = *v;
-            auto p2 = *v1;
-            p1.setZ(0);
-            p2.setZ(0);
-            return p1 == p2;
-    });
-    if(it != vertices.end()) //La gestione delle strade che intersecano boundary interni dati da unione di edifici è lasciata da parte
+    int found = searchCoincidentVertex(*v, false);
+    if(found >= 0) //La gestione delle strade che intersecano boundary interni dati da unione di edifici è lasciata da parte
     {
-        return *it;
+        return vertices.at(static_cast<std::size_t>(found));
     }
+    return appendVertex(v);
+}
+
+std::shared_ptr<Vertex> TriangleMesh::appendVertex(std::shared_ptr<Vertex> v)
+{
+    bool hashUpToDate = xyHashValid && xyHashPositionsGeneration == *positionsGeneration && xyHashVerticesGeneration == verticesGeneration;
     vertices.push_back(v);
+    v->setPositionsGeneration(positionsGeneration);
+    for(auto channel : vertexChannels)
+        channel->resize(vertices.size());
+    notifyVerticesChanged();
+    if(hashUpToDate)
+    {
+        double point[2] = {v->getX(), v->getY()};
+        xyHash.insert(point);
+        xyHashVerticesGeneration = verticesGeneration;
+    }
     return vertices.back();
 }
 
@@ -197,13 +301,18 @@ std::shared_ptr<Vertex> TriangleMesh::getVertex(std::string id)
 void TriangleMesh::removeFlaggedVertices()
 {
     std::vector<std::shared_ptr<Vertex> > newVertices;
+    std::vector<std::size_t> keptPositions;
     for(auto it = vertices.begin(); it != vertices.end(); it++)
         if((*it)->searchFlag(FlagType::TO_BE_REMOVED) < 0)
         {
             newVertices.push_back((*it));
+            keptPositions.push_back(static_cast<std::size_t>(it - vertices.begin()));
         }
     vertices.clear();
     vertices = newVertices;
+    for(auto channel : vertexChannels)
+        channel->select(keptPositions);
+    notifyVerticesChanged();
 }
 
 bool TriangleMesh::removeVertex(uint pos)
@@ -212,6 +321,9 @@ bool TriangleMesh::removeVertex(uint pos)
         return false;
 
     vertices.erase(vertices.begin() + pos);
+    for(auto channel : vertexChannels)
+        channel->erase(pos);
+    notifyVerticesChanged();
     return true;
 }
 
@@ -220,7 +332,10 @@ bool TriangleMesh::removeVertex(std::string vid)
     for(auto vit = vertices.begin(); vit != vertices.end(); vit++)
         if((*vit)->getId().compare(vid) == 0)
         {
+            for(auto channel : vertexChannels)
+                channel->erase(static_cast<std::size_t>(vit - vertices.begin()));
             vit = vertices.erase(vit);
+            notifyVerticesChanged();
             return true;
         }
     return true;
@@ -287,18 +402,21 @@ std::vector<std::shared_ptr<Triangle> > TriangleMesh::getTriangles(std::vector<s
 std::shared_ptr<Edge> TriangleMesh::addNewEdge()
 {
     edges.push_back(std::make_shared<Edge>());
+    notifyTopologyChanged();
     return edges.back();
 }
 
 std::shared_ptr<Edge> TriangleMesh::addNewEdge(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2)
 {
     edges.push_back(std::make_shared<Edge>(v1, v2));
+    notifyTopologyChanged();
     return edges.back();
 }
 
 std::shared_ptr<Edge> TriangleMesh::addNewEdge(std::shared_ptr<Edge> e)
 {
     edges.push_back(std::make_shared<Edge>(e));
+    notifyTopologyChanged();
     return edges.back();
 }
 
@@ -312,6 +430,7 @@ void TriangleMesh::removeFlaggedEdges()
         }
     edges.clear();
     edges = newEdges;
+    notifyTopologyChanged();
 }
 
 bool TriangleMesh::removeEdge(uint pos)
@@ -320,6 +439,7 @@ bool TriangleMesh::removeEdge(uint pos)
         return false;
 
     edges.erase(edges.begin() + pos);
+    notifyTopologyChanged();
     return true;
 }
 
@@ -329,6 +449,7 @@ bool TriangleMesh::removeEdge(std::string eid)
         if((*eit)->getId().compare(eid) == 0)
         {
             eit = edges.erase(eit);
+            notifyTopologyChanged();
             return true;
         }
     return false;
@@ -337,18 +458,27 @@ bool TriangleMesh::removeEdge(std::string eid)
 std::shared_ptr<Triangle> TriangleMesh::addNewTriangle()
 {
     triangles.push_back(std::make_shared<Triangle>());
+    for(auto channel : triangleChannels)
+        channel->resize(triangles.size());
+    notifyTopologyChanged();
     return triangles.back();
 }
 
 std::shared_ptr<Triangle> TriangleMesh::addNewTriangle(std::shared_ptr<Edge> e1, std::shared_ptr<Edge> e2, std::shared_ptr<Edge> e3)
 {
     triangles.push_back(std::make_shared<Triangle>(e1, e2, e3));
+    for(auto channel : triangleChannels)
+        channel->resize(triangles.size());
+    notifyTopologyChanged();
     return triangles.back();
 }
 
 std::shared_ptr<Triangle> TriangleMesh::addNewTriangle(std::shared_ptr<Triangle> t)
 {
     triangles.push_back(std::make_shared<Triangle>(t));
+    for(auto channel : triangleChannels)
+        channel->resize(triangles.size());
+    notifyTopologyChanged();
     return triangles.back();
 }
 
@@ -357,6 +487,9 @@ bool TriangleMesh::removeTriangle(uint pos)
         if(pos > triangles.size())
             return false;
         triangles.erase(triangles.begin() + pos);
+        for(auto channel : triangleChannels)
+            channel->erase(pos);
+        notifyTopologyChanged();
         return true;
 }
 
@@ -365,7 +498,10 @@ bool TriangleMesh::removeTriangle(std::string tid)
     for(auto tit = triangles.begin(); tit != triangles.end(); tit++)
         if((*tit)->getId().compare(tid) == 0)
         {
+            for(auto channel : triangleChannels)
+                channel->erase(static_cast<std::size_t>(tit - triangles.begin()));
             tit = triangles.erase(tit);
+            notifyTopologyChanged();
             return true;
         }
     return false;
@@ -374,13 +510,18 @@ bool TriangleMesh::removeTriangle(std::string tid)
 void TriangleMesh::removeFlaggedTriangles()
 {
     std::vector<std::shared_ptr<Triangle> > newTriangles;
+    std::vector<std::size_t> keptPositions;
     for(auto it = triangles.begin(); it != triangles.end(); it++)
         if((*it)->searchFlag(FlagType::TO_BE_REMOVED) < 0)
         {
             newTriangles.push_back((*it));
+            keptPositions.push_back(static_cast<std::size_t>(it - triangles.begin()));
         }
     triangles.clear();
     triangles = newTriangles;
+    for(auto channel : triangleChannels)
+        channel->select(keptPositions);
+    notifyTopologyChanged();
 }
 
 bool TriangleMesh::addAnnotationsRelationship(std::shared_ptr<Annotation> a1, std::shared_ptr<Annotation> a2, std::string relationshipType, bool directed)
@@ -388,14 +529,35 @@ bool TriangleMesh::addAnnotationsRelationship(std::shared_ptr<Annotation> a1, st
 
     auto n1 = relationshipsGraph->getNodeFromData(a1);
     auto n2 = relationshipsGraph->getNodeFromData(a2);
-    char* relType = new char[relationshipType.length() + 1];
-    strcpy(relType, relationshipType.c_str());
+    if(n1 == nullptr || n2 == nullptr)
+        return false;
     auto a = new GraphTemplate::Arc<std::shared_ptr<Annotation> >(
-                n1, n2, 1, directed, static_cast<unsigned int>(relationshipsGraph->getArcs().size()), relType);
+                n1, n2, 1, directed, static_cast<unsigned int>(relationshipsGraph->getArcsNumber()), relationshipType);
     relationshipsGraph->addArc(a);
     return true;
 }
 
+bool TriangleMesh::addAnnotationsRelationships(const std::vector<std::tuple<std::shared_ptr<Annotation>, std::shared_ptr<Annotation>, std::string> > &relationships,
+                                               bool directed)
+{
+    std::vector<GraphTemplate::Node<std::shared_ptr<Annotation> >*> endpoints;
+    std::vector<std::string> types;
+    endpoints.reserve(relationships.size() * 2);
+    types.reserve(relationships.size());
+    for(auto &relationship : relationships)
+    {
+        auto n1 = relationshipsGraph->getNodeFromData(std::get<0>(relationship));
+        auto n2 = relationshipsGraph->getNodeFromData(std::get<1>(relationship));
+        if(n1 == nullptr || n2 == nullptr)
+            return false;
+        endpoints.push_back(n1);
+        endpoints.push_back(n2);
+        types.push_back(std::get<2>(relationship));
+    }
+    relationshipsGraph->addArcs(endpoints, types, 1, directed, static_cast<unsigned int>(relationshipsGraph->getArcsNumber()));
+    return true;
+}
+
 bool TriangleMesh::removeRelationship(std::shared_ptr<Annotation> a1, std::shared_ptr<Annotation> a2, std::string type)
 {
     auto n1 = relationshipsGraph->getNodeFromData(a1);
@@ -404,7 +566,9 @@ bool TriangleMesh::removeRelationship(std::shared_ptr<Annotation> a1, std::share
         return false;
     auto rels = relationshipsGraph->getArcsFromEndpoints(n1, n2, type);
     for(auto rel : rels)
-        relationshipsGraph->removeArc(rel);
+        //Pooled arcs belong to the graph
+        if(relationshipsGraph->removeArc(rel) && !rel->isPooled())
+            delete rel;
     return true;
 }
 
@@ -428,7 +592,16 @@ int TriangleMesh::load(std::string filename)
 {
     if(filename.compare("") == 0)
         return -std::numeric_limits<int>::max();
-    int retValue = loadPLY(filename);
+    std::string format = fileExtension(filename);
+    int retValue;
+    if(format.compare("obj") == 0)
+        retValue = loadOBJ(filename);
+    else if(format.compare("off") == 0)
+        retValue = loadOFF(filename);
+    else if(format.compare("stl") == 0)
+        retValue = loadSTL(filename);
+    else
+        retValue = loadPLY(filename);
     if(retValue == 0)
     {
         orientTrianglesCoherently();
@@ -439,67 +612,405 @@ int TriangleMesh::load(std::string filename)
     return retValue;
 }
 
-int TriangleMesh::save(std::string filename, unsigned int precision)
+int TriangleMesh::save(std::string filename, unsigned int precision, bool binary)
 {
 
     orientTrianglesCoherently();
     std::cout << "Saving " << filename  << std::endl;
     int return_code;
-    std::ofstream meshStream(filename);
-    std::string format = filename.substr(filename.find(".") + 1);
+    std::ofstream meshStream(filename, std::ios::binary);
+    std::string format = fileExtension(filename);
     meshStream.precision(precision);
     if(meshStream.is_open())
     {
+        return_code = 0;
         if(format.compare("ply") == 0)
         {
             std::cout << "Writing as PLY" << std::endl;
-            meshStream << "ply" << std::endl;
-            meshStream << "format ascii 1.0" << std::endl;
-            meshStream << "element vertex " << getVerticesNumber() << std::endl;
-            meshStream << "property double x" << std::endl;
-            meshStream << "property double y" << std::endl;
-            meshStream << "property double z" << std::endl;
-            meshStream << "element face " << getTrianglesNumber() << std::endl;
-            meshStream << "property list uchar int vertex_indices" << std::endl;
-            meshStream << "end_header" << std::endl;
-            std::cout << "Writing vertices:" << std::endl;
-            for(unsigned int i = 0; i < getVerticesNumber(); i++)
+            savePLY(meshStream, binary);
+        } else if(format.compare("obj") == 0)
+        {
+            std::cout << "Writing as OBJ" << std::endl;
+            saveOBJ(meshStream);
+        } else if(format.compare("off") == 0)
+        {
+            std::cout << "Writing as OFF" << std::endl;
+            saveOFF(meshStream);
+        } else if(format.compare("stl") == 0)
+        {
+            std::cout << "Writing as STL" << std::endl;
+            saveSTL(meshStream, binary);
+        } else if(format.compare("xyz") == 0)
+        {
+            std::cout << "Writing as XYZ" << std::endl;
+            saveXYZ(meshStream);
+        }else
+            return_code = 1;
+
+
+        meshStream.close();
+    } else
+        return_code = -1;
+    return return_code;
+}
+
+int TriangleMesh::buildFromArrays(const std::vector<double> &coordinates, const std::vector<unsigned int> &faces)
+{
+    std::size_t verticesOffset = vertices.size();
+    std::size_t trianglesOffset = triangles.size();
+    std::size_t verticesNumber = coordinates.size() / 3;
+    std::size_t trianglesNumber = faces.size() / 3;
+    for(auto index : faces)
+        if(index >= verticesNumber)
+        {
+            std::cerr << "Face refers to a non-existent vertex." << std::endl;
+            return 11;
+        }
+
+    //Edges are identified by the pair of their endpoints (lowest index first), so that each one is found in constant time. They are numbered
+    //and their triangles counted before touching the mesh, so that a non-manifold input is rejected leaving the mesh unchanged
+    std::unordered_map<uint64_t, std::size_t> edgesMap;
+    edgesMap.reserve(trianglesNumber * 3 / 2 + 1);
+    std::vector<std::size_t> faceEdges(trianglesNumber * 3);
+    std::vector<unsigned char> edgeTriangles;
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        const unsigned int* ids = &faces[i * 3];
+        if(ids[0] == ids[1] || ids[1] == ids[2] || ids[2] == ids[0])
+            continue;
+        for(uint j = 0; j < 3; j++)
+        {
+            uint64_t key = (static_cast<uint64_t>(std::min(ids[j], ids[(j + 1) % 3])) << 32) | std::max(ids[j], ids[(j + 1) % 3]);
+            auto it = edgesMap.insert(std::make_pair(key, edgeTriangles.size())).first;
+            if(it->second == edgeTriangles.size())
+                edgeTriangles.push_back(0);
+            faceEdges[i * 3 + j] = it->second;
+            if(++edgeTriangles[it->second] > 2)
             {
-                meshStream << vertices.at(i)->getX() << " " << vertices.at(i)->getY() << " " << vertices.at(i)->getZ() << std::endl;
-                if(i % 100 == 0)
-                    std::cout << i * 100 / getVerticesNumber() << "%\r" << std::flush;
+                std::cerr << "An edge is shared by more than two triangles." << std::endl;
+                return 9;
             }
+        }
+    }
 
-            std::cout << "Ended! Written " << getVerticesNumber() << " vertices." << std::endl << "Writing triangles:" << std::endl;
-            for(unsigned int i = 0; i < getTrianglesNumber(); i++)
+    vertices.reserve(verticesOffset + verticesNumber);
+    edges.reserve(edges.size() + edgeTriangles.size());
+    triangles.reserve(trianglesOffset + trianglesNumber);
+    for(std::size_t i = 0; i < verticesNumber; i++)
+    {
+        vertices.push_back(std::make_shared<Vertex>(coordinates[i * 3], coordinates[i * 3 + 1], coordinates[i * 3 + 2]));
+        vertices.back()->setId(std::to_string(vertices.size() - 1));
+        vertices.back()->setPositionsGeneration(positionsGeneration);
+    }
+    for(auto channel : vertexChannels)
+        channel->resize(vertices.size());
+    notifyVerticesChanged();
+
+    std::vector<std::shared_ptr<Edge> > newEdges(edgeTriangles.size());
+    std::vector<std::size_t> keptTriangles;
+    keptTriangles.reserve(trianglesOffset + trianglesNumber);
+    for(std::size_t i = 0; i < trianglesOffset; i++)
+        keptTriangles.push_back(i);
+
+    std::cout << "Building " << trianglesNumber << " triangles:" << std::endl;
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        const unsigned int* ids = &faces[i * 3];
+        if(ids[0] == ids[1] || ids[1] == ids[2] || ids[2] == ids[0])
+            continue;
+        std::shared_ptr<Edge> triangleEdges[3];
+        for(uint j = 0; j < 3; j++)
+        {
+            std::shared_ptr<Vertex> v1 = vertices[verticesOffset + ids[j]];
+            std::shared_ptr<Vertex> v2 = vertices[verticesOffset + ids[(j + 1) % 3]];
+            std::shared_ptr<Edge>& edge = newEdges[faceEdges[i * 3 + j]];
+            if(edge == nullptr)
             {
+                edge = addNewEdge(v1, v2);
+                edge->setId(std::to_string(edges.size() - 1));
+            }
+            triangleEdges[j] = edge;
+            v1->setE0(triangleEdges[j]);
+        }
+
+        triangles.push_back(std::make_shared<Triangle>(triangleEdges[0], triangleEdges[1], triangleEdges[2]));
+        triangles.back()->setId(std::to_string(triangles.size() - 1));
+        for(uint j = 0; j < 3; j++)
+            if(triangleEdges[j]->getT1() == nullptr)
+                triangleEdges[j]->setT1(triangles.back());
+            else
+                triangleEdges[j]->setT2(triangles.back());
+        keptTriangles.push_back(trianglesOffset + i);
+
+        if(i % 100 == 0)
+            std::cout << i * 100 / trianglesNumber << "%\r" << std::flush;
+    }
+
+    //Channels filled by the caller for every face are realigned to the triangles that have been actually built
+    for(auto channel : triangleChannels)
+        if(keptTriangles.size() < trianglesOffset + trianglesNumber && channel->size() == trianglesOffset + trianglesNumber)
+            channel->select(keptTriangles);
+        else
+            channel->resize(triangles.size());
 
-                auto v1 = triangles.at(i)->getV1();
-                auto v2 = triangles.at(i)->getV2();
-                auto v3 = triangles.at(i)->getV3();
-                meshStream << "3 " << v1->getId() << " " << v2->getId() << " " << v3->getId() << std::endl;
+    if(keptTriangles.size() < trianglesOffset + trianglesNumber)
+        std::cout << "Discarded " << trianglesOffset + trianglesNumber - keptTriangles.size() << " degenerate triangles." << std::endl;
+    notifyTopologyChanged();
+    std::cout << "Ended! Built " << triangles.size() - trianglesOffset << " triangles." << std::endl;
+    return 0;
+}
 
-                if(i % 100 == 0)
-                    std::cout << i * 100 / getTrianglesNumber() << "%\r" << std::flush;
+void TriangleMesh::savePLY(std::ostream &stream, bool binary)
+{
+    PLYHeader header;
+    PLYElement vertexElement, faceElement;
+    header.format = binary ? PLYFormat::BINARY_LITTLE_ENDIAN : PLYFormat::ASCII;
+    vertexElement.name = "vertex";
+    vertexElement.count = getVerticesNumber();
+    for(std::string coordinate : {"x", "y", "z"})
+    {
+        PLYProperty property;
+        property.name = coordinate;
+        property.type = ScalarType::FLOAT64;
+        vertexElement.properties.push_back(property);
+    }
+    for(auto channel : vertexChannels)
+    {
+        PLYProperty property;
+        property.name = channel->getName();
+        property.type = channel->getType();
+        vertexElement.properties.push_back(property);
+    }
+    faceElement.name = "face";
+    faceElement.count = getTrianglesNumber();
+    PLYProperty indicesProperty;
+    indicesProperty.name = "vertex_indices";
+    indicesProperty.isList = true;
+    indicesProperty.countType = ScalarType::UINT8;
+    indicesProperty.type = ScalarType::INT32;
+    faceElement.properties.push_back(indicesProperty);
+    for(auto channel : triangleChannels)
+    {
+        PLYProperty property;
+        property.name = channel->getName();
+        property.type = channel->getType();
+        faceElement.properties.push_back(property);
+    }
+    header.elements = {vertexElement, faceElement};
+    header.write(stream);
+    PLYValueWriter writer(stream, header.format);
+    std::cout << "Writing vertices:" << std::endl;
+    for(unsigned int i = 0; i < getVerticesNumber(); i++)
+    {
+        if(binary)
+        {
+            writer.write(ScalarType::FLOAT64, vertices.at(i)->getX());
+            writer.write(ScalarType::FLOAT64, vertices.at(i)->getY());
+            writer.write(ScalarType::FLOAT64, vertices.at(i)->getZ());
+            for(auto channel : vertexChannels)
+                writer.write(channel->getType(), i < channel->size() ? channel->getValue(i) : 0.0);
+        } else
+        {
+            stream << vertices.at(i)->getX() << " " << vertices.at(i)->getY() << " " << vertices.at(i)->getZ();
+            for(auto channel : vertexChannels)
+            {
+                stream << " ";
+                if(i < channel->size())
+                    channel->printValue(stream, i);
+                else
+                    stream << 0;
             }
-            std::cout << "Ended! Written " << getTrianglesNumber() << " triangles." << std::endl;
-            return_code = 0;
-        } else if(format.compare("xyz") == 0)
+            stream << std::endl;
+        }
+        if(i % 100 == 0)
+            std::cout << i * 100 / getVerticesNumber() << "%\r" << std::flush;
+    }
+
+    std::cout << "Ended! Written " << getVerticesNumber() << " vertices." << std::endl << "Writing triangles:" << std::endl;
+    for(unsigned int i = 0; i < getTrianglesNumber(); i++)
+    {
+
+        auto v1 = triangles.at(i)->getV1();
+        auto v2 = triangles.at(i)->getV2();
+        auto v3 = triangles.at(i)->getV3();
+        if(binary)
         {
-            std::cout << "Writing as XYZ" << std::endl;
+            writer.write(ScalarType::UINT8, 3);
+            writer.write(ScalarType::INT32, std::stoi(v1->getId()));
+            writer.write(ScalarType::INT32, std::stoi(v2->getId()));
+            writer.write(ScalarType::INT32, std::stoi(v3->getId()));
+            for(auto channel : triangleChannels)
+                writer.write(channel->getType(), i < channel->size() ? channel->getValue(i) : 0.0);
+        } else
+        {
+            stream << "3 " << v1->getId() << " " << v2->getId() << " " << v3->getId();
+            for(auto channel : triangleChannels)
+            {
+                stream << " ";
+                if(i < channel->size())
+                    channel->printValue(stream, i);
+                else
+                    stream << 0;
+            }
+            stream << std::endl;
+        }
 
-            for(uint i = 0; i < getVerticesNumber(); i++)
-                meshStream << getVertex(i)->getX() << " " << getVertex(i)->getY() << " " << getVertex(i)->getZ() << std::endl;
-            std::cout << "Ended! Written " << getVerticesNumber() << " points" << std::endl;
-            return_code = 0;
-        }else
-            return_code = 1;
+        if(i % 100 == 0)
+            std::cout << i * 100 / getTrianglesNumber() << "%\r" << std::flush;
+    }
+    std::cout << "Ended! Written " << getTrianglesNumber() << " triangles." << std::endl;
+}
 
+void TriangleMesh::saveOBJ(std::ostream &stream)
+{
+    for(unsigned int i = 0; i < getVerticesNumber(); i++)
+        stream << "v " << vertices.at(i)->getX() << " " << vertices.at(i)->getY() << " " << vertices.at(i)->getZ() << "\n";
+    std::cout << "Written " << getVerticesNumber() << " vertices." << std::endl;
+    for(unsigned int i = 0; i < getTrianglesNumber(); i++)
+    {
+        stream << "f " << std::stoi(triangles.at(i)->getV1()->getId()) + 1 << " " << std::stoi(triangles.at(i)->getV2()->getId()) + 1 << " " <<
+                  std::stoi(triangles.at(i)->getV3()->getId()) + 1 << "\n";
+        if(i % 100 == 0)
+            std::cout << i * 100 / getTrianglesNumber() << "%\r" << std::flush;
+    }
+    std::cout << "Ended! Written " << getTrianglesNumber() << " triangles." << std::endl;
+}
 
-        meshStream.close();
+void TriangleMesh::saveOFF(std::ostream &stream)
+{
+    stream << "OFF\n" << getVerticesNumber() << " " << getTrianglesNumber() << " " << getEdgesNumber() << "\n";
+    for(unsigned int i = 0; i < getVerticesNumber(); i++)
+        stream << vertices.at(i)->getX() << " " << vertices.at(i)->getY() << " " << vertices.at(i)->getZ() << "\n";
+    std::cout << "Written " << getVerticesNumber() << " vertices." << std::endl;
+    for(unsigned int i = 0; i < getTrianglesNumber(); i++)
+    {
+        stream << "3 " << triangles.at(i)->getV1()->getId() << " " << triangles.at(i)->getV2()->getId() << " " << triangles.at(i)->getV3()->getId() << "\n";
+        if(i % 100 == 0)
+            std::cout << i * 100 / getTrianglesNumber() << "%\r" << std::flush;
+    }
+    std::cout << "Ended! Written " << getTrianglesNumber() << " triangles." << std::endl;
+}
+
+void TriangleMesh::saveSTL(std::ostream &stream, bool binary)
+{
+    //Binary STL files are always little endian, as the binary PLY files written by savePLY
+    PLYValueWriter writer(stream, PLYFormat::BINARY_LITTLE_ENDIAN);
+    std::shared_ptr<PropertyChannel> attributes = getTriangleChannel("attribute");
+    if(binary)
+    {
+        std::string description = "Binary STL written by SemantisedTriangleMesh";
+        description.resize(80, '\0');
+        stream.write(description.data(), 80);
+        writer.write(ScalarType::UINT32, getTrianglesNumber());
     } else
-        return_code = -1;
-    return return_code;
+        stream << "solid mesh\n";
+    for(unsigned int i = 0; i < getTrianglesNumber(); i++)
+    {
+        std::shared_ptr<Triangle> t = triangles.at(i);
+        Point normal = t->computeNormal();
+        std::shared_ptr<Vertex> corners[3] = {t->getV1(), t->getV2(), t->getV3()};
+        if(binary)
+        {
+            writer.write(ScalarType::FLOAT32, normal.getX());
+            writer.write(ScalarType::FLOAT32, normal.getY());
+            writer.write(ScalarType::FLOAT32, normal.getZ());
+            for(auto v : corners)
+            {
+                writer.write(ScalarType::FLOAT32, v->getX());
+                writer.write(ScalarType::FLOAT32, v->getY());
+                writer.write(ScalarType::FLOAT32, v->getZ());
+            }
+            writer.write(ScalarType::UINT16, attributes != nullptr && i < attributes->size() ? attributes->getValue(i) : 0.0);
+        } else
+        {
+            stream << "  facet normal " << normal.getX() << " " << normal.getY() << " " << normal.getZ() << "\n    outer loop\n";
+            for(auto v : corners)
+                stream << "      vertex " << v->getX() << " " << v->getY() << " " << v->getZ() << "\n";
+            stream << "    endloop\n  endfacet\n";
+        }
+        if(i % 100 == 0)
+            std::cout << i * 100 / getTrianglesNumber() << "%\r" << std::flush;
+    }
+    if(!binary)
+        stream << "endsolid mesh\n";
+    std::cout << "Ended! Written " << getTrianglesNumber() << " triangles." << std::endl;
+}
+
+void TriangleMesh::saveXYZ(std::ostream &stream)
+{
+    for(uint i = 0; i < getVerticesNumber(); i++)
+        stream << getVertex(i)->getX() << " " << getVertex(i)->getY() << " " << getVertex(i)->getZ() << std::endl;
+    std::cout << "Ended! Written " << getVerticesNumber() << " points" << std::endl;
+}
+
+std::shared_ptr<PropertyChannel> TriangleMesh::addVertexChannel(const std::string &name, ScalarType type)
+{
+    auto channel = getVertexChannel(name);
+    if(channel != nullptr)
+        return channel;
+    channel = PropertyChannel::create(name, type, vertices.size());
+    if(channel != nullptr)
+        vertexChannels.push_back(channel);
+    return channel;
+}
+
+std::shared_ptr<PropertyChannel> TriangleMesh::getVertexChannel(const std::string &name) const
+{
+    for(auto channel : vertexChannels)
+        if(channel->getName().compare(name) == 0)
+            return channel;
+    return nullptr;
+}
+
+bool TriangleMesh::removeVertexChannel(const std::string &name)
+{
+    for(auto cit = vertexChannels.begin(); cit != vertexChannels.end(); cit++)
+        if((*cit)->getName().compare(name) == 0)
+        {
+            vertexChannels.erase(cit);
+            return true;
+        }
+    return false;
+}
+
+const std::vector<std::shared_ptr<PropertyChannel> > &TriangleMesh::getVertexChannels() const
+{
+    return vertexChannels;
+}
+
+std::shared_ptr<PropertyChannel> TriangleMesh::addTriangleChannel(const std::string &name, ScalarType type)
+{
+    auto channel = getTriangleChannel(name);
+    if(channel != nullptr)
+        return channel;
+    channel = PropertyChannel::create(name, type, triangles.size());
+    if(channel != nullptr)
+        triangleChannels.push_back(channel);
+    return channel;
+}
+
+std::shared_ptr<PropertyChannel> TriangleMesh::getTriangleChannel(const std::string &name) const
+{
+    for(auto channel : triangleChannels)
+        if(channel->getName().compare(name) == 0)
+            return channel;
+    return nullptr;
+}
+
+bool TriangleMesh::removeTriangleChannel(const std::string &name)
+{
+    for(auto cit = triangleChannels.begin(); cit != triangleChannels.end(); cit++)
+        if((*cit)->getName().compare(name) == 0)
+        {
+            triangleChannels.erase(cit);
+            return true;
+        }
+    return false;
+}
+
+const std::vector<std::shared_ptr<PropertyChannel> > &TriangleMesh::getTriangleChannels() const
+{
+    return triangleChannels;
 }
 
 unsigned int TriangleMesh::removeIsolatedVertices()
@@ -509,9 +1020,13 @@ unsigned int TriangleMesh::removeIsolatedVertices()
         if(vertices.at(i)->getE0() == nullptr)
         {
             vertices.erase(vertices.begin() + i);
+            for(auto channel : vertexChannels)
+                channel->erase(i);
             i--;
         }
     numberOfRemovedVertices -= vertices.size();
+    if(numberOfRemovedVertices > 0)
+        notifyVerticesChanged();
     return numberOfRemovedVertices;
 }
 
@@ -524,36 +1039,15 @@ std::shared_ptr<Edge> TriangleMesh::searchEdgeContainingVertex(std::vector<std::
     return nullptr;
 }
 
-int TriangleMesh::extractNearestVertex(std::vector<uint> &frontier, std::map<uint, double> distances)
-{
-
-    double minDist = std::numeric_limits<double>::max();
-    int minPos = -1;
-    for(uint i = 0; i < frontier.size(); i++){
-        if(distances.at(frontier.at(i)) < minDist){
-            minPos = i;
-            minDist = distances.at(frontier.at(i));
-        }
-    }
-
-    if(minPos == -1)
-        return minPos;
-
-    int nearest = frontier.at(minPos);
-
-    frontier.erase(frontier.begin() + minPos);
-
-    return nearest;
-
-}
-
-int TriangleMesh::extractStraightestVertex(std::vector<uint> &frontier, std::shared_ptr<Vertex> start, Vector direction)
+int TriangleMesh::extractStraightestVertex(std::vector<uint> &frontier, std::shared_ptr<Vertex> start, Vector direction, bool useHeight)
 {
     double minAngle = std::numeric_limits<double>::max();
     int minPos = -1;
     direction.normalise();
     for(unsigned int i = 0; i < frontier.size(); i++){
         auto newDirection = (*vertices.at(frontier.at(i)) ) - (*start);
+        if(!useHeight)
+            newDirection.setZ(0);
         newDirection.normalise();
         double angle = direction.computeAngle(newDirection);
         if(angle < minAngle)
@@ -573,110 +1067,385 @@ int TriangleMesh::extractStraightestVertex(std::vector<uint> &frontier, std::sha
     return nearest;
 }
 
-std::vector<std::shared_ptr<Vertex> > TriangleMesh::computeShortestPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const DistanceType metric, const bool useHeight, const bool directed, const bool avoidUsed)
+struct TriangleMesh::PathSearchWorkspace
 {
+    //Index 0 refers to the forward search (from the source), index 1 to the backward one of the bidirectional search. The distance and
+    //the parent of a vertex are valid only if its stamp equals the generation of the current search, so that starting a search costs O(1).
+    std::vector<double> distances[2];
+    std::vector<uint32_t> parents[2];
+    std::vector<uint32_t> stamps[2];
+    uint32_t generation = 0;
+    IndexedHeap frontiers[2];
+    //Frontier of the directed search
     std::vector<uint> frontier;
-    std::vector<double> heights;
-    std::map<uint, double> distances = {{std::stoi(v1->getId()), 0}};
-    std::map<uint, std::shared_ptr<Vertex> > predecessors = {{std::stoi(v1->getId()), nullptr}};
-    std::set<uint> v21RingNeighbors;
-    std::vector<std::shared_ptr<Vertex> > shortestPath;
-    std::shared_ptr<Vertex> v = nullptr;
-    bool v2visited = false;
-
-    if(((*v1) - (*v2)).norm() == 0.0)
-        return shortestPath;
-
 
-    if(!useHeight)
+    void reset(std::size_t verticesNumber)
     {
-        for_each(vertices.begin(), vertices.end(), [&heights](std::shared_ptr<Vertex>& v){
-            heights.push_back(v->getZ());
-            v->setZ(0);
-        });
-    }
-    frontier.push_back(std::stoi(v1->getId()));
-
-    do {
-        int vid;
-        if(directed && v != nullptr)
-            vid = extractStraightestVertex(frontier, v, (*v2) - (*v));
-        else
-            vid = extractNearestVertex(frontier, distances);
-
-        if(vid == -1)
+        if(stamps[0].size() != verticesNumber)
         {
-            return shortestPath;
+            for(unsigned int side = 0; side < 2; side++)
+            {
+                distances[side].resize(verticesNumber);
+                parents[side].resize(verticesNumber);
+                stamps[side].assign(verticesNumber, 0);
+                frontiers[side].resize(verticesNumber);
+            }
+            generation = 0;
         }
-
-        v = this->getVertex(vid);
-        if(v == nullptr)
+        if(++generation == 0)
         {
-            return shortestPath;
+            for(unsigned int side = 0; side < 2; side++)
+                std::fill(stamps[side].begin(), stamps[side].end(), 0);
+            generation = 1;
         }
+        frontiers[0].clear();
+        frontiers[1].clear();
+        frontier.clear();
+    }
+
+    bool reached(unsigned int side, uint32_t vid) const
+    {
+        return stamps[side][vid] == generation;
+    }
+
+    double distance(unsigned int side, uint32_t vid) const
+    {
+        return reached(side, vid) ? distances[side][vid] : std::numeric_limits<double>::max();
+    }
+
+    void set(unsigned int side, uint32_t vid, double distance, uint32_t parent)
+    {
+        stamps[side][vid] = generation;
+        distances[side][vid] = distance;
+        parents[side][vid] = parent;
+    }
+};
 
-        const auto neighbors = v->getVV();
-        for(const auto& n : neighbors){
+template <class Weight>
+bool TriangleMesh::searchShortestPath(uint32_t source, uint32_t target, const Weight &weight, bool useHeight, bool directed, bool avoidUsed, PathSearchStrategy strategy,
+                                      PathSearchWorkspace &workspace, std::vector<uint32_t> &path)
+{
+    path.clear();
+    workspace.reset(vertices.size());
+    if(!directed && strategy == PathSearchStrategy::BIDIRECTIONAL)
+        return searchBidirectionalPath(source, target, weight, avoidUsed, workspace, path);
 
-            auto vit = v21RingNeighbors.find(std::stoi(v->getId()));
-            if(n->getId().compare(v2->getId()) == 0 && vit == v21RingNeighbors.end())
-                v21RingNeighbors.insert(std::stoi(v->getId()));
+    std::shared_ptr<VertexAdjacency> graph = getVertexAdjacency();
 
-            auto pit = predecessors.find(std::stoi(n->getId()));
+    //Updates the distances of the neighbours of vid, calling discover on the ones reached for the first time and update on the ones whose
+    //distance decreased
+    auto relax = [&](uint32_t vid, auto& discover, auto& update)
+    {
+        const Vertex& v = *vertices[vid];
+        double distanceV = workspace.distances[0][vid];
+        for(uint32_t i = graph->offsets[vid]; i < graph->offsets[vid + 1]; i++)
+        {
+            uint32_t nid = graph->neighbours[i];
+            Vertex& n = *vertices[nid];
             double distanceVX;
-            if(!avoidUsed || n->searchFlag(FlagType::USED) == -1){
-                double newDistance = 0;
-                switch(metric){
-                    case DistanceType::SEGMENT_DISTANCE:
-                        newDistance = n->computePointSegmentDistance(*v1, *v2);
-                        break;
-                    case DistanceType::COMBINED_DISTANCE:
-                        newDistance = (*n - *v).norm() + n->computePointSegmentDistance(*v1, *v2);
-                        break;
-                    default:
-                        newDistance = (*n - *v).norm();
-                }
-                distanceVX = distances.at(std::stoi(v->getId())) + newDistance;
-            } else
+            if(!avoidUsed || n.searchFlag(FlagType::USED) == -1)
+                distanceVX = distanceV + weight(v, n);
+            else
                 distanceVX = std::numeric_limits<double>::max();
 
-            if(pit != predecessors.end()){
-                if(distances.at(std::stoi(n->getId())) > distanceVX){
-                    distances.at(std::stoi(n->getId())) = distanceVX;
-                    predecessors.at(std::stoi(n->getId())) = v;
+            if(workspace.reached(0, nid)){
+                if(workspace.distances[0][nid] > distanceVX){
+                    workspace.set(0, nid, distanceVX, vid);
+                    update(nid, distanceVX);
                 }
             } else {
-                distances.insert(std::make_pair(std::stoi(n->getId()), distanceVX));
-                predecessors.insert(std::make_pair(std::stoi(n->getId()), v));
-                frontier.push_back(std::stoi(n->getId()));
+                workspace.set(0, nid, distanceVX, vid);
+                discover(nid, distanceVX);
             }
         }
-        if(v->getId().compare(v2->getId()) == 0)
-            v2visited = true;
-
-    } while(!v2visited);
+    };
 
-
-    if(!useHeight)
+    workspace.set(0, source, 0, source);
+    bool found = false;
+    if(directed)
     {
-        for(uint i = 0; i < heights.size(); i++)
-            vertices.at(i)->setZ(heights.at(i));
-        heights.clear();
-    }
-    shortestPath.push_back(v2);
-    v = predecessors.at(std::stoi(v2->getId()));
-    while(v != v1){
-        shortestPath.insert(shortestPath.begin(), v);
-        v = predecessors.at(std::stoi(v->getId()));
+        //Greedy variant: after the origin, the vertex of the frontier most aligned with the direction towards the target is expanded
+        std::vector<uint>& frontier = workspace.frontier;
+        auto push = [&frontier](uint32_t nid, double){ frontier.push_back(nid); };
+        auto ignore = [](uint32_t, double){};
+        uint32_t vid = source;
+        while(true)
+        {
+            relax(vid, push, ignore);
+            if(vid == target)
+            {
+                found = true;
+                break;
+            }
+            Vector direction = (*vertices[target]) - (*vertices[vid]);
+            if(!useHeight)
+                direction.setZ(0);
+            int next = extractStraightestVertex(frontier, vertices[vid], direction, useHeight);
+            if(next == -1)
+                break;
+            vid = static_cast<uint32_t>(next);
+        }
+    } else
+    {
+        //Vertices whose distance is infinite (reachable only through used vertices) are never extracted. With A* the key is the distance
+        //plus the lower bound of the distance to the target, and a vertex whose distance decreases after its extraction is pushed again
+        //(which only happens because of rounding errors in the bounds).
+        const Vertex& t = *vertices[target];
+        const bool informed = strategy == PathSearchStrategy::A_STAR;
+        IndexedHeap& frontier = workspace.frontiers[0];
+        auto push = [&](uint32_t nid, double distance)
+        {
+            frontier.push(nid, informed && distance < std::numeric_limits<double>::max() ? distance + weight.lowerBound(*vertices[nid], t) : distance);
+        };
+        frontier.push(source, 0);
+        while(!frontier.empty() && frontier.topKey() < std::numeric_limits<double>::max())
+        {
+            uint32_t vid = frontier.pop();
+            if(vid == target)
+            {
+                found = true;
+                break;
+            }
+            relax(vid, push, push);
+        }
     }
+    if(!found)
+        return false;
 
-    return shortestPath;
+    for(uint32_t vid = target; vid != source; vid = workspace.parents[0][vid])
+        path.push_back(vid);
+    std::reverse(path.begin(), path.end());
+    return true;
 }
 
-const std::vector<std::shared_ptr<Annotation> > &TriangleMesh::getAnnotations() const
+template <class Weight>
+bool TriangleMesh::searchBidirectionalPath(uint32_t source, uint32_t target, const Weight &weight, bool avoidUsed, PathSearchWorkspace &workspace,
+                                           std::vector<uint32_t> &path)
 {
-    return annotations;
-}
+    const double INFINITE = std::numeric_limits<double>::max();
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    std::shared_ptr<VertexAdjacency> graph = getVertexAdjacency();
+    IndexedHeap* frontiers = workspace.frontiers;
+
+    //Weight of the edge from u to v, infinite if v is used and used vertices must be avoided
+    auto edgeWeight = [&](uint32_t u, uint32_t v)
+    {
+        if(avoidUsed && vertices[v]->searchFlag(FlagType::USED) != -1)
+            return INFINITE;
+        return weight(*vertices[u], *vertices[v]);
+    };
+
+    workspace.set(0, source, 0, NONE);
+    workspace.set(1, target, 0, NONE);
+    frontiers[0].push(source, 0);
+    frontiers[1].push(target, 0);
+    double best = INFINITE;
+    uint32_t meetingFrom = NONE, meetingTo = NONE;
+    while(!frontiers[0].empty() && !frontiers[1].empty() && frontiers[0].topKey() + frontiers[1].topKey() < best)
+    {
+        unsigned int side = frontiers[0].topKey() <= frontiers[1].topKey() ? 0 : 1;
+        uint32_t vid = frontiers[side].pop();
+        for(uint32_t i = graph->offsets[vid]; i < graph->offsets[vid + 1]; i++)
+        {
+            uint32_t nid = graph->neighbours[i];
+            double w = side == 0 ? edgeWeight(vid, nid) : edgeWeight(nid, vid);
+            if(w == INFINITE)
+                continue;
+            double distance = workspace.distances[side][vid] + w;
+            if(distance < workspace.distance(side, nid))
+            {
+                workspace.set(side, nid, distance, vid);
+                frontiers[side].push(nid, distance);
+            }
+            //The edge joins the two searches: it closes a path from the source to the target
+            double other = workspace.distance(1 - side, nid);
+            if(other < INFINITE && distance + other < best)
+            {
+                best = distance + other;
+                meetingFrom = side == 0 ? vid : nid;
+                meetingTo = side == 0 ? nid : vid;
+            }
+        }
+    }
+    if(best == INFINITE)
+        return false;
+
+    //Forward half up to the edge joining the searches, then backward half from the edge to the target
+    for(uint32_t vid = meetingFrom; vid != source; vid = workspace.parents[0][vid])
+        path.push_back(vid);
+    std::reverse(path.begin(), path.end());
+    for(uint32_t vid = meetingTo; vid != NONE; vid = workspace.parents[1][vid])
+        path.push_back(vid);
+    return true;
+}
+
+std::vector<std::shared_ptr<Vertex> > TriangleMesh::findShortestPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const DistanceType metric, const bool useHeight, const bool directed,
+                                                                     const bool avoidUsed, const PathSearchStrategy strategy, PathSearchWorkspace &workspace)
+{
+    std::vector<std::shared_ptr<Vertex> > shortestPath;
+    if(((*v1) - (*v2)).norm() == 0.0)
+        return shortestPath;
+
+    //Vertices which are not in the mesh cannot be reached
+    const uint32_t source = getVertexPosition(v1), target = getVertexPosition(v2);
+    if(source == std::numeric_limits<uint32_t>::max() || target == std::numeric_limits<uint32_t>::max())
+        return shortestPath;
+    std::vector<uint32_t> path;
+    bool found;
+    switch(metric){
+        case DistanceType::SEGMENT_DISTANCE:
+            found = useHeight ? searchShortestPath(source, target, SegmentPathWeight<true>(*v1, *v2), useHeight, directed, avoidUsed, strategy, workspace, path)
+                              : searchShortestPath(source, target, SegmentPathWeight<false>(*v1, *v2), useHeight, directed, avoidUsed, strategy, workspace, path);
+            break;
+        case DistanceType::COMBINED_DISTANCE:
+            found = useHeight ? searchShortestPath(source, target, CombinedPathWeight<true>(*v1, *v2), useHeight, directed, avoidUsed, strategy, workspace, path)
+                              : searchShortestPath(source, target, CombinedPathWeight<false>(*v1, *v2), useHeight, directed, avoidUsed, strategy, workspace, path);
+            break;
+        default:
+            found = useHeight ? searchShortestPath(source, target, EuclideanPathWeight<true>(), useHeight, directed, avoidUsed, strategy, workspace, path)
+                              : searchShortestPath(source, target, EuclideanPathWeight<false>(), useHeight, directed, avoidUsed, strategy, workspace, path);
+    }
+    if(!found)
+        return shortestPath;
+
+    shortestPath.reserve(path.size());
+    for(uint32_t vid : path)
+        shortestPath.push_back(vertices[vid]);
+    return shortestPath;
+}
+
+std::unique_ptr<TriangleMesh::PathSearchWorkspace> TriangleMesh::acquireWorkspace()
+{
+    std::lock_guard<std::mutex> lock(workspacesMutex);
+    if(idleWorkspaces.empty())
+        return std::make_unique<PathSearchWorkspace>();
+    std::unique_ptr<PathSearchWorkspace> workspace = std::move(idleWorkspaces.back());
+    idleWorkspaces.pop_back();
+    return workspace;
+}
+
+void TriangleMesh::releaseWorkspace(std::unique_ptr<PathSearchWorkspace> workspace)
+{
+    std::lock_guard<std::mutex> lock(workspacesMutex);
+    idleWorkspaces.push_back(std::move(workspace));
+}
+
+std::vector<std::shared_ptr<Vertex> > TriangleMesh::computeShortestPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const DistanceType metric, const bool useHeight, const bool directed, const bool avoidUsed, const PathSearchStrategy strategy)
+{
+    std::unique_ptr<PathSearchWorkspace> workspace = acquireWorkspace();
+    std::vector<std::shared_ptr<Vertex> > shortestPath = findShortestPath(v1, v2, metric, useHeight, directed, avoidUsed, strategy, *workspace);
+    releaseWorkspace(std::move(workspace));
+    return shortestPath;
+}
+
+std::vector<std::vector<std::shared_ptr<Vertex> > > TriangleMesh::computeShortestPaths(const std::vector<PathQuery> &queries, const bool useHeight, const bool directed, const bool avoidUsed,
+                                                                                       const PathSearchStrategy strategy, ThreadPool *pool)
+{
+    std::vector<std::vector<std::shared_ptr<Vertex> > > paths(queries.size());
+    if(queries.empty())
+        return paths;
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+
+    //The adjacency lists are built before the workers start, one workspace is taken for each slot of the pool
+    getVertexAdjacency();
+    std::vector<std::unique_ptr<PathSearchWorkspace> > workspaces(pool->getThreadsNumber() + 1);
+    for(auto& workspace : workspaces)
+        workspace = acquireWorkspace();
+    pool->parallelFor(0, queries.size(), [&](std::size_t begin, std::size_t end, unsigned int slot)
+    {
+        for(std::size_t i = begin; i < end; i++)
+            paths[i] = findShortestPath(queries[i].source, queries[i].target, queries[i].metric, useHeight, directed, avoidUsed, strategy, *workspaces[slot]);
+    }, 1);
+    for(auto& workspace : workspaces)
+        releaseWorkspace(std::move(workspace));
+    return paths;
+}
+
+bool TriangleMesh::computeGeodesicDistances(const std::vector<std::shared_ptr<Vertex> > &sources, double *distances, const GeodesicMethod method, const double maxDistance, ThreadPool *pool)
+{
+    std::vector<uint32_t> positions;
+    positions.reserve(sources.size());
+    for(const auto& v : sources)
+        positions.push_back(getVertexPosition(v));
+
+    std::shared_ptr<GeodesicSolver> solver = getGeodesicSolver();
+    if(method == GeodesicMethod::HEAT_METHOD)
+        return solver->heatMethod(positions, distances, pool);
+    solver->fastMarching(positions, distances, maxDistance);
+    return true;
+}
+
+bool TriangleMesh::computeGeodesicDistances(const std::shared_ptr<Annotation> &annotation, double *distances, const GeodesicMethod method, const double maxDistance, ThreadPool *pool)
+{
+    return computeGeodesicDistances(annotation->getInvolvedVertices(), distances, method, maxDistance, pool);
+}
+
+bool TriangleMesh::computeGeodesicDistances(const std::vector<std::vector<std::shared_ptr<Vertex> > > &sources, const std::vector<double *> &distances, const GeodesicMethod method, const double maxDistance, ThreadPool *pool)
+{
+    std::size_t fieldsNumber = std::min(sources.size(), distances.size());
+    if(fieldsNumber == 0)
+        return true;
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+
+    //The positions and the solver are prepared before the workers start
+    std::vector<std::vector<uint32_t> > positions(fieldsNumber);
+    for(std::size_t i = 0; i < fieldsNumber; i++)
+    {
+        positions[i].reserve(sources[i].size());
+        for(const auto& v : sources[i])
+            positions[i].push_back(getVertexPosition(v));
+    }
+    std::shared_ptr<GeodesicSolver> solver = getGeodesicSolver();
+    std::atomic<bool> solved(true);
+    pool->parallelFor(0, fieldsNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+            if(method == GeodesicMethod::HEAT_METHOD)
+            {
+                if(!solver->heatMethod(positions[i], distances[i], pool))
+                    solved = false;
+            } else
+                solver->fastMarching(positions[i], distances[i], maxDistance);
+    }, 1);
+    return solved;
+}
+
+std::vector<Point> TriangleMesh::traceStraightestGeodesic(const SurfacePoint &start, const Vector &direction, double length, double *tracedLength)
+{
+    std::vector<Point> path;
+    if(start.triangle == nullptr)
+        return path;
+    std::vector<double> points;
+    double d[3] = {direction.getX(), direction.getY(), direction.getZ()};
+    uint32_t face = getTrianglePosition(start.triangle);
+    if(face == std::numeric_limits<uint32_t>::max())
+        return path;
+    double traced = getGeodesicSolver()->traceStraightestGeodesic(face, start.barycentric, d, length, points);
+    if(tracedLength != nullptr)
+        *tracedLength = traced;
+    for(std::size_t i = 0; i < points.size(); i += 3)
+        path.emplace_back(points[i], points[i + 1], points[i + 2]);
+    return path;
+}
+
+double TriangleMesh::computeGeodesicPath(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, std::vector<Point> &path, std::size_t maxTriangles, bool *exact)
+{
+    std::vector<double> points;
+    //Vertices which are not in the mesh get a position the solver rejects
+    double length = getGeodesicSolver()->computeGeodesicPath(getVertexPosition(v1), getVertexPosition(v2),
+                                                             points, maxTriangles == 0 ? GeodesicSolver::MAX_PATH_TRIANGLES : maxTriangles, exact);
+    path.clear();
+    for(std::size_t i = 0; i < points.size(); i += 3)
+        path.emplace_back(points[i], points[i + 1], points[i + 2]);
+    return length;
+}
+
+const std::vector<std::shared_ptr<Annotation> > &TriangleMesh::getAnnotations() const
+{
+    return annotations;
+}
 
 void TriangleMesh::clearAnnotations()
 {
@@ -738,13 +1507,16 @@ bool TriangleMesh::removeAnnotation(unsigned int id)
     if(relationshipsGraph == nullptr)
         return true;
     auto n = relationshipsGraph->getNodeFromData(a);
+    if(n == nullptr)
+        return true;
     auto outgoingRelationships = relationshipsGraph->getArcsFromFletching(n);
     auto incomingRelationships = relationshipsGraph->getArcsFromTip(n);
     outgoingRelationships.insert(outgoingRelationships.end(), incomingRelationships.begin(), incomingRelationships.end());
     for(auto r : outgoingRelationships)
     {
-        relationshipsGraph->removeArc(r);
-        delete r;
+        //Loops are both outgoing and incoming: they are deleted once, and pooled arcs belong to the graph
+        if(relationshipsGraph->removeArc(r) && !r->isPooled())
+            delete r;
     }
 
     relationshipsGraph->removeNode(n);
@@ -769,6 +1541,8 @@ bool TriangleMesh::removeAnnotation(std::string id)
 
 void TriangleMesh::orientTrianglesCoherently()
 {
+    if(triangles.empty())
+        return;
     std::shared_ptr<Triangle> t = triangles[0];
     std::queue<std::shared_ptr<Triangle> > q;
     for(uint i = 0; i < triangles.size(); i++)
@@ -868,14 +1642,23 @@ double TriangleMesh::getMaxEdgeLength()
 
 std::vector<std::shared_ptr<Vertex> > TriangleMesh::getNearestNeighbours(Point queryPt, uint maxNumber, double radius)
 {
-    if(kdtree == nullptr)
-        initialiseKDTree();
-    std::vector<double> point = {queryPt.getX(), queryPt.getY(), queryPt.getZ()};
-    std::vector<std::pair<size_t, double> > neighbors_distances;
+    std::shared_ptr<KDTree> kdtree = getKDTree();
+    double point[3] = {queryPt.getX(), queryPt.getY(), queryPt.getZ()};
     std::vector<std::shared_ptr<Vertex> > neighbors;
 
-    neighbors_distances.clear();
-    std::vector<size_t> neighbors_indices = kdtree->neighborhood_indices(point, radius);
+    if(maxNumber != static_cast<uint>(-1))
+    {
+        std::vector<neighbour_t> neighbors_distances(std::min(static_cast<std::size_t>(maxNumber), vertices.size()));
+        std::size_t found = kdtree->knnSearch(point, neighbors_distances.size(), neighbors_distances.data(), radius > 0 ? radius : -1.0);
+        neighbors.reserve(found);
+        for(std::size_t i = 0; i < found; i++)
+            neighbors.push_back(vertices.at(neighbors_distances[i].first));
+        return neighbors;
+    }
+
+    std::vector<size_t> neighbors_indices;
+    kdtree->radiusSearch(point, radius, neighbors_indices);
+    neighbors.reserve(neighbors_indices.size());
     for(auto it = neighbors_indices.begin(); it != neighbors_indices.end(); it++){
         neighbors.push_back(vertices.at(*it));
     }
@@ -884,27 +1667,431 @@ std::vector<std::shared_ptr<Vertex> > TriangleMesh::getNearestNeighbours(Point q
 
 }
 
+std::size_t TriangleMesh::searchNearestNeighbours(const Point &p, std::size_t k, neighbour_t *result, double radius)
+{
+    double point[3] = {p.getX(), p.getY(), p.getZ()};
+    return getKDTree()->knnSearch(point, k, result, radius > 0 ? radius : -1.0);
+}
+
+void TriangleMesh::searchNearestNeighbours(const double *queries, std::size_t queriesNumber, std::size_t k, neighbour_t *results, std::size_t *counts, double radius, ThreadPool *pool)
+{
+    std::shared_ptr<KDTree> tree = getKDTree();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, queriesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+            counts[i] = tree->knnSearch(&queries[i * 3], k, &results[i * k], radius > 0 ? radius : -1.0);
+    });
+}
+
 std::shared_ptr<Vertex> TriangleMesh::getClosestPoint(const Point &queryPt)
 {
-    if(kdtree == nullptr)
-        initialiseKDTree();
-    std::vector<double> point = {queryPt.getX(), queryPt.getY(), queryPt.getZ()};
-    auto index = kdtree->nearest_index(point);
+    double point[3] = {queryPt.getX(), queryPt.getY(), queryPt.getZ()};
+    auto index = getKDTree()->nearest(point);
+    if(index >= vertices.size())
+        return nullptr;
     return vertices.at(index);
 }
 
+void TriangleMesh::getClosestPoints(const double *queries, std::size_t queriesNumber, std::size_t *indices, double *squaredDistances, ThreadPool *pool)
+{
+    std::shared_ptr<KDTree> tree = getKDTree();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, queriesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+            indices[i] = tree->nearest(&queries[i * 3], squaredDistances != nullptr ? &squaredDistances[i] : nullptr);
+    });
+}
+
+TriangleMesh::SurfacePoint TriangleMesh::getClosestSurfacePoint(const Point &p)
+{
+    SurfacePoint surfacePoint;
+    surfacePoint.triangle = nullptr;
+    surfacePoint.distance = std::numeric_limits<double>::max();
+    double point[3] = {p.getX(), p.getY(), p.getZ()};
+    TriangleBVH::ClosestPoint closest;
+    if(getBVH()->closestPoint(point, closest) && closest.triangle < triangles.size())
+    {
+        surfacePoint.triangle = triangles.at(closest.triangle);
+        std::copy(closest.barycentric, closest.barycentric + 3, surfacePoint.barycentric);
+        surfacePoint.point = Point(closest.point[0], closest.point[1], closest.point[2]);
+        surfacePoint.distance = std::sqrt(closest.squaredDistance);
+    }
+    return surfacePoint;
+}
+
+void TriangleMesh::getClosestSurfacePoints(const double *queries, std::size_t queriesNumber, std::size_t *trianglesPositions, double *barycentrics, double *squaredDistances, ThreadPool *pool)
+{
+    std::shared_ptr<TriangleBVH> hierarchy = getBVH();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, queriesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        TriangleBVH::ClosestPoint closest;
+        for(std::size_t i = begin; i < end; i++)
+        {
+            if(!hierarchy->closestPoint(&queries[i * 3], closest))
+            {
+                closest.triangle = hierarchy->size();
+                closest.barycentric[0] = closest.barycentric[1] = closest.barycentric[2] = 0;
+                closest.squaredDistance = std::numeric_limits<double>::max();
+            }
+            trianglesPositions[i] = closest.triangle;
+            std::copy(closest.barycentric, closest.barycentric + 3, &barycentrics[i * 3]);
+            if(squaredDistances != nullptr)
+                squaredDistances[i] = closest.squaredDistance;
+        }
+    });
+}
+
+TriangleMesh::SurfacePoint TriangleMesh::castRay(const Point &origin, const Vector &direction, double maxDistance)
+{
+    SurfacePoint surfacePoint;
+    surfacePoint.triangle = nullptr;
+    surfacePoint.distance = std::numeric_limits<double>::max();
+    Vector unit = direction;
+    double length = unit.norm();
+    if(length == 0)
+        return surfacePoint;
+    double o[3] = {origin.getX(), origin.getY(), origin.getZ()};
+    double d[3] = {direction.getX() / length, direction.getY() / length, direction.getZ() / length};
+    TriangleBVH::RayHit hit;
+    if(getBVH()->firstHit(o, d, hit, 0, maxDistance) && hit.triangle < triangles.size())
+    {
+        surfacePoint.triangle = triangles.at(hit.triangle);
+        std::copy(hit.barycentric, hit.barycentric + 3, surfacePoint.barycentric);
+        surfacePoint.point = origin + (unit / length) * hit.t;
+        surfacePoint.distance = hit.t;
+    }
+    return surfacePoint;
+}
+
+std::vector<TriangleMesh::SurfacePoint> TriangleMesh::getRayIntersections(const Point &origin, const Vector &direction, double maxDistance)
+{
+    std::vector<SurfacePoint> intersections;
+    Vector unit = direction;
+    double length = unit.norm();
+    if(length == 0)
+        return intersections;
+    double o[3] = {origin.getX(), origin.getY(), origin.getZ()};
+    double d[3] = {direction.getX() / length, direction.getY() / length, direction.getZ() / length};
+    std::vector<TriangleBVH::RayHit> hits;
+    getBVH()->allHits(o, d, hits, 0, maxDistance);
+    for(const auto& hit : hits)
+    {
+        SurfacePoint surfacePoint;
+        surfacePoint.triangle = triangles.at(hit.triangle);
+        std::copy(hit.barycentric, hit.barycentric + 3, surfacePoint.barycentric);
+        surfacePoint.point = origin + (unit / length) * hit.t;
+        surfacePoint.distance = hit.t;
+        intersections.push_back(surfacePoint);
+    }
+    return intersections;
+}
+
+bool TriangleMesh::intersectsRay(const Point &origin, const Vector &direction, double maxDistance)
+{
+    Vector unit = direction;
+    double length = unit.norm();
+    if(length == 0)
+        return false;
+    double o[3] = {origin.getX(), origin.getY(), origin.getZ()};
+    double d[3] = {direction.getX() / length, direction.getY() / length, direction.getZ() / length};
+    return getBVH()->anyHit(o, d, 0, maxDistance);
+}
+
+bool TriangleMesh::intersectsSegment(const Point &a, const Point &b)
+{
+    double o[3] = {a.getX(), a.getY(), a.getZ()};
+    double d[3] = {b.getX() - a.getX(), b.getY() - a.getY(), b.getZ() - a.getZ()};
+    return getBVH()->anyHit(o, d, 0, 1);
+}
+
+void TriangleMesh::castRays(const double *origins, const double *directions, std::size_t raysNumber, std::size_t *trianglesPositions, double *distances, double *barycentrics, double maxDistance, ThreadPool *pool)
+{
+    std::shared_ptr<TriangleBVH> hierarchy = getBVH();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, raysNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        TriangleBVH::RayHit hit;
+        for(std::size_t i = begin; i < end; i++)
+        {
+            const double* direction = &directions[i * 3];
+            double length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+            double d[3] = {direction[0] / length, direction[1] / length, direction[2] / length};
+            if(length == 0 || !hierarchy->firstHit(&origins[i * 3], d, hit, 0, maxDistance))
+            {
+                hit.triangle = hierarchy->size();
+                hit.t = std::numeric_limits<double>::max();
+                hit.barycentric[0] = hit.barycentric[1] = hit.barycentric[2] = 0;
+            }
+            trianglesPositions[i] = hit.triangle;
+            distances[i] = hit.t;
+            if(barycentrics != nullptr)
+                std::copy(hit.barycentric, hit.barycentric + 3, &barycentrics[i * 3]);
+        }
+    });
+}
+
+void TriangleMesh::intersectSegments(const double *endpoints, std::size_t segmentsNumber, unsigned char *results, ThreadPool *pool)
+{
+    std::shared_ptr<TriangleBVH> hierarchy = getBVH();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, segmentsNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+        {
+            const double* a = &endpoints[i * 6];
+            double d[3] = {endpoints[i * 6 + 3] - a[0], endpoints[i * 6 + 4] - a[1], endpoints[i * 6 + 5] - a[2]};
+            results[i] = hierarchy->anyHit(a, d, 0, 1) ? 1 : 0;
+        }
+    });
+}
+
+TriangleMesh::SurfacePoint TriangleMesh::locatePoint(const Point &p)
+{
+    SurfacePoint surfacePoint;
+    surfacePoint.triangle = nullptr;
+    surfacePoint.distance = std::numeric_limits<double>::max();
+    TriangleLocator::Location location;
+    if(getLocator()->locate(p.getX(), p.getY(), location) && location.triangle < triangles.size())
+    {
+        surfacePoint.triangle = triangles.at(location.triangle);
+        std::copy(location.barycentric, location.barycentric + 3, surfacePoint.barycentric);
+        surfacePoint.point = Point(p.getX(), p.getY(), location.z);
+        surfacePoint.distance = std::fabs(p.getZ() - location.z);
+    }
+    return surfacePoint;
+}
+
+bool TriangleMesh::interpolateHeight(double x, double y, double &z)
+{
+    TriangleLocator::Location location;
+    if(!getLocator()->locate(x, y, location))
+        return false;
+    z = location.z;
+    return true;
+}
+
+void TriangleMesh::locatePoints(const double *queries, std::size_t queriesNumber, std::size_t *trianglesPositions, double *heights, double *barycentrics, ThreadPool *pool)
+{
+    std::shared_ptr<TriangleLocator> grid = getLocator();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    pool->parallelFor(0, queriesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        TriangleLocator::Location location;
+        std::size_t hint = grid->size();
+        for(std::size_t i = begin; i < end; i++)
+        {
+            if(grid->locate(queries[i * 2], queries[i * 2 + 1], location, hint))
+            {
+                hint = location.triangle;
+            } else
+            {
+                location.triangle = grid->size();
+                location.z = std::numeric_limits<double>::quiet_NaN();
+                location.barycentric[0] = location.barycentric[1] = location.barycentric[2] = 0;
+            }
+            trianglesPositions[i] = location.triangle;
+            if(heights != nullptr)
+                heights[i] = location.z;
+            if(barycentrics != nullptr)
+                std::copy(location.barycentric, location.barycentric + 3, &barycentrics[i * 3]);
+        }
+    });
+}
+
+TriangleMesh::DistanceStatistics TriangleMesh::computeDistanceTo(const std::shared_ptr<TriangleMesh> &other, std::size_t samplesNumber, const std::string &channelName, ThreadPool *pool)
+{
+    //addVertexChannel returns the existing channel whatever its type, and the distances need doubles
+    std::shared_ptr<PropertyChannel> channel = channelName.empty() ? nullptr : addVertexChannel(channelName, ScalarType::FLOAT64);
+    if(channel != nullptr && channel->getType() != ScalarType::FLOAT64)
+    {
+        std::cerr << "Channel " << channelName << " is not FLOAT64, distances cannot be stored!" << std::endl;
+        DistanceStatistics statistics;
+        statistics.max = statistics.mean = statistics.rms = std::numeric_limits<double>::quiet_NaN();
+        statistics.samplesNumber = 0;
+        return statistics;
+    }
+
+    std::shared_ptr<TriangleBVH> hierarchy = other->getBVH();
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+    std::vector<double> coordinates = flattenCoordinates();
+    std::vector<unsigned int> faces = flattenFaces();
+    std::size_t trianglesNumber = triangles.size();
+    if(samplesNumber == 0)
+        samplesNumber = 10 * trianglesNumber;
+
+    //The samples of the i-th triangle are those from floor(S * A(i) / A) to floor(S * A(i + 1) / A), where A(i) is the area of the
+    //triangles preceding it, so that each triangle receives a number of samples proportional to its area and they sum up to S
+    std::vector<double> cumulativeAreas(trianglesNumber + 1, 0.0);
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        const double* a = &coordinates[faces[i * 3] * std::size_t(3)];
+        const double* b = &coordinates[faces[i * 3 + 1] * std::size_t(3)];
+        const double* c = &coordinates[faces[i * 3 + 2] * std::size_t(3)];
+        double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        double n[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+        cumulativeAreas[i + 1] = cumulativeAreas[i] + std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) / 2;
+    }
+    double totalArea = cumulativeAreas.back();
+    if(totalArea <= 0)
+        samplesNumber = 0;
+
+    struct Accumulator
+    {
+        double max = 0, sum = 0, squaredSum = 0;
+    };
+    std::vector<Accumulator> accumulators(pool->getThreadsNumber() + 1);
+    auto distance = [&hierarchy](const double* point)
+    {
+        TriangleBVH::ClosestPoint closest;
+        return hierarchy->closestPoint(point, closest) ? std::sqrt(closest.squaredDistance) : std::numeric_limits<double>::infinity();
+    };
+
+    if(samplesNumber > 0)
+    {
+        pool->parallelFor(0, trianglesNumber, [&](std::size_t begin, std::size_t end, unsigned int slot)
+        {
+            Accumulator& accumulator = accumulators[slot];
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            for(std::size_t i = begin; i < end; i++)
+            {
+                std::size_t first = static_cast<std::size_t>(samplesNumber * (cumulativeAreas[i] / totalArea));
+                std::size_t last = std::min(samplesNumber, static_cast<std::size_t>(samplesNumber * (cumulativeAreas[i + 1] / totalArea)));
+                if(first >= last)
+                    continue;
+                const double* a = &coordinates[faces[i * 3] * std::size_t(3)];
+                const double* b = &coordinates[faces[i * 3 + 1] * std::size_t(3)];
+                const double* c = &coordinates[faces[i * 3 + 2] * std::size_t(3)];
+                std::minstd_rand generator(static_cast<std::minstd_rand::result_type>(i + 1));
+                for(std::size_t j = first; j < last; j++)
+                {
+                    double r1 = std::sqrt(uniform(generator)), r2 = uniform(generator);
+                    double wa = 1 - r1, wb = r1 * (1 - r2), wc = r1 * r2;
+                    double point[3];
+                    for(unsigned int k = 0; k < 3; k++)
+                        point[k] = wa * a[k] + wb * b[k] + wc * c[k];
+                    double d = distance(point);
+                    accumulator.max = std::max(accumulator.max, d);
+                    accumulator.sum += d;
+                    accumulator.squaredSum += d * d;
+                }
+            }
+        });
+    }
+
+    pool->parallelFor(0, vertices.size(), [&](std::size_t begin, std::size_t end, unsigned int slot)
+    {
+        Accumulator& accumulator = accumulators[slot];
+        for(std::size_t i = begin; i < end; i++)
+        {
+            double d = distance(&coordinates[i * 3]);
+            accumulator.max = std::max(accumulator.max, d);
+            if(channel != nullptr)
+                channel->setValue(i, d);
+        }
+    });
+
+    DistanceStatistics statistics;
+    statistics.max = statistics.mean = statistics.rms = 0;
+    statistics.samplesNumber = samplesNumber;
+    double sum = 0, squaredSum = 0;
+    for(const auto& accumulator : accumulators)
+    {
+        statistics.max = std::max(statistics.max, accumulator.max);
+        sum += accumulator.sum;
+        squaredSum += accumulator.squaredSum;
+    }
+    if(samplesNumber > 0)
+    {
+        statistics.mean = sum / samplesNumber;
+        statistics.rms = std::sqrt(squaredSum / samplesNumber);
+    }
+    return statistics;
+}
+
+TriangleMesh::DistanceStatistics TriangleMesh::computeSymmetricDistance(const std::shared_ptr<TriangleMesh> &first, const std::shared_ptr<TriangleMesh> &second, std::size_t samplesNumber, const std::string &channelName, ThreadPool *pool)
+{
+    //The second mesh is checked first, so that a channel which is not FLOAT64 there does not leave the first one half updated
+    std::shared_ptr<PropertyChannel> secondChannel = channelName.empty() ? nullptr : second->getVertexChannel(channelName);
+    if(secondChannel != nullptr && secondChannel->getType() != ScalarType::FLOAT64)
+        return second->computeDistanceTo(first, samplesNumber, channelName, pool);
+    DistanceStatistics forward = first->computeDistanceTo(second, samplesNumber, channelName, pool);
+    if(std::isnan(forward.max))
+        return forward;
+    DistanceStatistics backward = second->computeDistanceTo(first, samplesNumber, channelName, pool);
+    DistanceStatistics statistics;
+    statistics.max = std::max(forward.max, backward.max);
+    statistics.samplesNumber = forward.samplesNumber + backward.samplesNumber;
+    statistics.mean = statistics.rms = 0;
+    if(statistics.samplesNumber > 0)
+    {
+        double n = static_cast<double>(statistics.samplesNumber);
+        statistics.mean = (forward.mean * forward.samplesNumber + backward.mean * backward.samplesNumber) / n;
+        statistics.rms = std::sqrt((forward.rms * forward.rms * forward.samplesNumber + backward.rms * backward.rms * backward.samplesNumber) / n);
+    }
+    return statistics;
+}
+
 std::vector<std::shared_ptr<Vertex> > TriangleMesh::getVerticesCloseToLine(const Point &a, const Point &b, double threshold)
 {
     double lineLength = (a - b).norm();
     if(threshold == 0)
         threshold = lineLength / 10;
     std::vector<std::shared_ptr<Vertex> > list;
-    auto vertices = getNearestNeighbours((a + b) / 2, -1, lineLength);
-    for(const auto& v : vertices)
-        if(v->distanceFromLine(a,b) < threshold)
+    //The candidates lie in the sphere of radius lineLength around the midpoint and close to the line, so in the capsule around ab extended
+    //by half of its length on both sides
+    Point middle = (a + b) / 2;
+    double point[3] = {middle.getX(), middle.getY(), middle.getZ()};
+    double start[3] = {middle.getX() - (b.getX() - a.getX()), middle.getY() - (b.getY() - a.getY()), middle.getZ() - (b.getZ() - a.getZ())};
+    double end[3] = {middle.getX() + (b.getX() - a.getX()), middle.getY() + (b.getY() - a.getY()), middle.getZ() + (b.getZ() - a.getZ())};
+    std::vector<std::size_t> candidates;
+    //(slightly enlarged, since the distance from the line is computed differently by distanceFromLine)
+    getKDTree()->capsuleSearch(start, end, threshold * (1 + 1e-9), candidates);
+    for(auto position : candidates)
+    {
+        auto v = vertices.at(position);
+        double d[3] = {v->getX() - point[0], v->getY() - point[1], v->getZ() - point[2]};
+        if(d[0] * d[0] + d[1] * d[1] + d[2] * d[2] <= lineLength * lineLength && v->distanceFromLine(a,b) < threshold)
             list.push_back(v);
+    }
+    return list;
+
+}
+
+std::vector<std::shared_ptr<Vertex> > TriangleMesh::getVerticesInCapsule(const Point &a, const Point &b, double radius)
+{
+    double start[3] = {a.getX(), a.getY(), a.getZ()}, end[3] = {b.getX(), b.getY(), b.getZ()};
+    std::vector<std::size_t> positions;
+    getKDTree()->capsuleSearch(start, end, radius, positions);
+    std::vector<std::shared_ptr<Vertex> > list;
+    list.reserve(positions.size());
+    for(auto position : positions)
+        list.push_back(vertices.at(position));
     return list;
+}
 
+std::vector<std::shared_ptr<Vertex> > TriangleMesh::getVerticesInCorridor(const std::vector<Point> &polyline, double radius)
+{
+    std::vector<double> coordinates;
+    coordinates.reserve(polyline.size() * 3);
+    for(const auto& p : polyline)
+        coordinates.insert(coordinates.end(), {p.getX(), p.getY(), p.getZ()});
+    std::vector<std::size_t> positions;
+    getKDTree()->corridorSearch(coordinates.data(), polyline.size(), radius, positions);
+    std::vector<std::shared_ptr<Vertex> > list;
+    list.reserve(positions.size());
+    for(auto position : positions)
+        list.push_back(vertices.at(position));
+    return list;
 }
 
 
@@ -1114,6 +2301,7 @@ void TriangleMesh::smooth(WeightType type, uint k, double t)
         for(uint i = 0; i < vertices.size(); i++)
             vertices[i]->setPosition(newPositions[i]);
     }
+    notifyPositionsChanged();
 
 }
 
@@ -1132,6 +2320,34 @@ int TriangleMesh::triangulate(std::vector<std::vector<std::vector<std::shared_pt
     if(boundaries.size() < 1)
         return -1;
 
+    //The hash used for detecting repeated vertices is sized on all the points that may be inserted
+    double minXY[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    double maxXY[2] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+    std::size_t pointsNumber = vertices.size();
+    auto extendXY = [&](const std::shared_ptr<Vertex>& v)
+    {
+        minXY[0] = std::min(minXY[0], v->getX());
+        minXY[1] = std::min(minXY[1], v->getY());
+        maxXY[0] = std::max(maxXY[0], v->getX());
+        maxXY[1] = std::max(maxXY[1], v->getY());
+    };
+    for(const auto& v : vertices)
+        extendXY(v);
+    for(const auto& boundary : boundaries)
+        for(const auto& outline : boundary)
+        {
+            for(const auto& v : outline)
+                extendXY(v);
+            pointsNumber += outline.size();
+        }
+    for(const auto& constraint : constraints)
+    {
+        for(const auto& v : constraint)
+            extendXY(v);
+        pointsNumber += constraint.size();
+    }
+    initialiseXYHash(computeXYCellSize(minXY, maxXY, pointsNumber));
+
     std::vector<double*> points;
     std::vector<std::vector<unsigned int> > polylines;
     std::map<std::shared_ptr<Vertex>, std::vector<std::shared_ptr<Edge> > > vertices_edges;
@@ -1178,27 +2394,19 @@ int TriangleMesh::triangulate(std::vector<std::vector<std::vector<std::shared_pt
             std::vector<unsigned int> polyline;
             for(unsigned int k = 0; k < boundaries.at(i).at(j).size() - 1; k++)
             {
-                std::vector<std::shared_ptr<Vertex> >::iterator it = std::find_if(vertices.begin(), vertices.end(),
-                          [boundaries, i, j, k](std::shared_ptr<Vertex> p)
-                {
-                    auto p1 = *boundaries.at(i).at(j).at(k);
-                    auto p2 = *p;
-                    p1.setZ(0);
-                    p2.setZ(0);
-
-                    return  p1 == p2;
-                });
+                int found = searchCoincidentVertex(*boundaries.at(i).at(j).at(k), false);
 
-                if(it != vertices.end())
+                if(found >= 0)
                 {
                     counter++;
-                    *boundaries.at(i).at(j).at(k) = **it;
+                    *boundaries.at(i).at(j).at(k) = *vertices.at(static_cast<std::size_t>(found));
                 }
 
-                if(it == vertices.end())
+                if(found < 0)
                 {
+                    //The lookup has just failed, so the vertex is appended without searching it again
                     std::vector<std::shared_ptr<Edge> > incident;
-                    addNewVertex(boundaries.at(i).at(j).at(k));
+                    appendVertex(boundaries.at(i).at(j).at(k));
                     points.push_back(boundaries.at(i).at(j).at(k)->toDoubleArray());
                     boundaries.at(i).at(j).at(k)->setId(std::to_string(vertices_id++));
                     vertices_edges.insert(std::make_pair(boundaries.at(i).at(j).at(k), incident));
@@ -1224,27 +2432,19 @@ int TriangleMesh::triangulate(std::vector<std::vector<std::vector<std::shared_pt
         std::vector<unsigned int> polyline;
         for(unsigned int j = 0; j < constraints.at(i).size(); j++)
         {
-            std::vector<std::shared_ptr<Vertex> >::iterator it = std::find_if(vertices.begin(), vertices.end(),
-                      [constraints, i, j](std::shared_ptr<Vertex> p)
-            {
-                auto p1 = *constraints.at(i).at(j);
-                auto p2 = *p;
-                p1.setZ(0);
-                p2.setZ(0);
-                return *constraints.at(i).at(j) == *p;
-            });
-
-            if(it != vertices.end())
+            int found = searchCoincidentVertex(*constraints.at(i).at(j), true);
+
+            if(found >= 0)
             {
                 std::shared_ptr<Vertex> tmp = constraints.at(i).at(j);
-                *constraints.at(i).at(j) = **it;
+                *constraints.at(i).at(j) = *vertices.at(static_cast<std::size_t>(found));
                 tmp.reset();
             }
 
-            if(it == vertices.end())
+            if(found < 0)
             {
                 std::vector<std::shared_ptr<Edge> > incident;
-                addNewVertex(constraints.at(i).at(j));
+                appendVertex(constraints.at(i).at(j));
                 points.push_back(constraints.at(i).at(j)->toDoubleArray());
                 constraints.at(i).at(j)->setId(std::to_string(vertices_id++));
                 vertices_edges.insert(std::make_pair(constraints.at(i).at(j), incident));
@@ -1257,7 +2457,7 @@ int TriangleMesh::triangulate(std::vector<std::vector<std::vector<std::shared_pt
     for(auto v : constraintVertices)
     {
         std::vector<std::shared_ptr<Edge> > incident;
-        vertices.push_back(v);
+        appendVertex(v);
         v->setId(std::to_string(vertices_id++));
         vertices_edges.insert(std::make_pair(v, incident));
         points.push_back(v->toDoubleArray());
@@ -1353,219 +2553,746 @@ int TriangleMesh::triangulate(std::vector<std::vector<std::vector<std::shared_pt
 
 int TriangleMesh::loadPLY(std::string filename)
 {
-    std::ifstream fileStream(filename);
+    std::ifstream fileStream(filename, std::ios::binary);
 
     if(fileStream.is_open())
     {
         unsigned int vertices_number = 0;
-        unsigned int triangles_number = 0;
-        unsigned int reached_vertex_id = 0;
-        unsigned int reached_edge_id = 0;
-        unsigned int reached_triangle_id = 0;
-        std::map<std::shared_ptr<Vertex>, std::vector<std::shared_ptr<Edge> > > vertices_edges;
-        std::string line;
-        std::getline(fileStream, line);
-        if(line.compare("ply") != 0)
-        {
-            std::cerr << "Current implementation only deals with PLY file format!" << std::endl;
+        PLYHeader header;
+        int retValue = header.read(fileStream);
+        switch(retValue)
+        {
+            case 0: break;
+            case 1: std::cerr << "Current implementation only deals with PLY file format!" << std::endl; break;
+            case 3: std::cerr << "Properties must have one of the PLY scalar types!" << std::endl; break;
+            case 10: std::cerr << "This file format is currently not supported" << std::endl; break;
+            default: std::cerr << "The header is not correctly closed." << std::endl;
+        }
+        if(retValue != 0)
+        {
             fileStream.close();
-            return 1;
+            return retValue;
         }
-        std::getline(fileStream, line);
-        if(line.compare("format ascii 1.0") == 0)
+
+        int vertexElementPos = header.findElement("vertex");
+        if(vertexElementPos < 0)
         {
-            while(std::getline(fileStream, line) && line.substr(0, 7).compare("comment") == 0); //removing all comments
-            if(line.substr(0, 14).compare("element vertex") != 0)
-            {
-                std::cerr << "File has to start with vertices specification!" << std::endl;
-                fileStream.close();
-                return 2;
-            }
-            vertices_number = stoi(line.substr(15, line.size() - 15));
-            while(std::getline(fileStream, line) && line.substr(0, 7).compare("comment") == 0); //removing all comments
-            if(line.substr(0, 8).compare("property") != 0)
-            {
-                std::cerr << "X coordinate format needs to be specified!" << std::endl;
-                fileStream.close();
-                return 3;
-            }
-            while(std::getline(fileStream, line) && line.substr(0, 7).compare("comment") == 0); //removing all comments
-            if(line.substr(0, 8).compare("property") != 0)
+            std::cerr << "File has to contain vertices specification!" << std::endl;
+            fileStream.close();
+            return 2;
+        }
+        const PLYElement& vertexElement = header.elements.at(static_cast<uint>(vertexElementPos));
+        int coordinatesPos[3] = {vertexElement.findProperty("x"), vertexElement.findProperty("y"), vertexElement.findProperty("z")};
+        if(coordinatesPos[0] < 0 || coordinatesPos[1] < 0 || coordinatesPos[2] < 0)
+        {
+            std::cerr << "X, Y and Z coordinates format needs to be specified!" << std::endl;
+            fileStream.close();
+            return 3;
+        }
+        int faceElementPos = header.findElement("face");
+        if(faceElementPos < 0)
+        {
+            std::cerr << "After vertices specification there must be faces specification!" << std::endl;
+            fileStream.close();
+            return 4;
+        }
+        const PLYElement& faceElement = header.elements.at(static_cast<uint>(faceElementPos));
+        int indicesPos = faceElement.findProperty("vertex_indices");
+        if(indicesPos < 0)
+            indicesPos = faceElement.findProperty("vertex_index");
+        if(indicesPos < 0 || !faceElement.properties.at(static_cast<uint>(indicesPos)).isList)
+        {
+            std::cerr << "Faces have to be defined by a list of vertex indices" << std::endl;
+            fileStream.close();
+            return 5;
+        }
+
+        //Every scalar property that is not a coordinate nor the list of indices is stored into a channel
+        std::vector<std::shared_ptr<PropertyChannel> > vertexPropertiesChannels(vertexElement.properties.size(), nullptr);
+        std::vector<std::shared_ptr<PropertyChannel> > facePropertiesChannels(faceElement.properties.size(), nullptr);
+        vertexChannels.clear();
+        triangleChannels.clear();
+        for(uint i = 0; i < vertexElement.properties.size(); i++)
+        {
+            auto property = vertexElement.properties.at(i);
+            if(!property.isList && static_cast<int>(i) != coordinatesPos[0] && static_cast<int>(i) != coordinatesPos[1] && static_cast<int>(i) != coordinatesPos[2])
             {
-                std::cerr << "Y coordinate format needs to be specified!" << std::endl;
-                fileStream.close();
-                return 3;
+                vertexPropertiesChannels.at(i) = PropertyChannel::create(property.name, property.type, vertexElement.count);
+                vertexChannels.push_back(vertexPropertiesChannels.at(i));
             }
-            while(std::getline(fileStream, line) && line.substr(0, 7).compare("comment") == 0); //removing all comments
-            if(line.substr(0, 8).compare("property") != 0)
+        }
+        for(uint i = 0; i < faceElement.properties.size(); i++)
+        {
+            auto property = faceElement.properties.at(i);
+            if(!property.isList)
             {
-                std::cerr << "Z coordinate format needs to be specified!" << std::endl;
-                fileStream.close();
-                return 3;
+                facePropertiesChannels.at(i) = PropertyChannel::create(property.name, property.type);
+                triangleChannels.push_back(facePropertiesChannels.at(i));
             }
-            while(std::getline(fileStream, line) &&
-                  (line.substr(0, 7).compare("comment") == 0 ||
-                   line.compare("property uchar red") == 0 ||
-                   line.compare("property uchar green") == 0 ||
-                   line.compare("property uchar blue") == 0 ||
-                   line.compare("property uchar alpha") == 0)); //removing all comments and unuseful things
-            if(line.substr(0, 12).compare("element face") != 0)
+        }
+
+        vertices_number = static_cast<unsigned int>(vertexElement.count);
+        std::vector<double> coordinates(vertexElement.count * 3);
+        std::vector<unsigned int> faces;
+        PLYValueReader reader(fileStream, header.format);
+        for(uint e = 0; e < header.elements.size(); e++)
+        {
+            const PLYElement& element = header.elements.at(e);
+            if(static_cast<int>(e) == vertexElementPos)
             {
-                std::cerr << "After vertices specification there must be faces specification!" << std::endl;
-                fileStream.close();
-                return 4;
-            }
-            triangles_number = stoi(line.substr(13, line.size() - 13));
-            while(std::getline(fileStream, line) && line.substr(0, 7).compare("comment") == 0); //removing all comments
-            if(line.compare("property list uchar int vertex_indices") != 0)
+                std::cout << "Loading vertices: " << std::endl;
+                for(unsigned int i = 0; i < vertices_number; i++)
+                {
+                    for(uint j = 0; j < element.properties.size(); j++)
+                    {
+                        double value = 0.0;
+                        bool read;
+                        if(element.properties.at(j).isList)
+                            read = reader.skipProperty(element.properties.at(j));
+                        else
+                            read = reader.read(element.properties.at(j).type, value);
+                        if(!read)
+                        {
+                            fileStream.close();
+                            return 7;
+                        }
+                        if(static_cast<int>(j) == coordinatesPos[0])
+                            coordinates.at(i * 3) = value;
+                        else if(static_cast<int>(j) == coordinatesPos[1])
+                            coordinates.at(i * 3 + 1) = value;
+                        else if(static_cast<int>(j) == coordinatesPos[2])
+                            coordinates.at(i * 3 + 2) = value;
+                        else if(vertexPropertiesChannels.at(j) != nullptr)
+                            vertexPropertiesChannels.at(j)->setValue(i, value);
+                    }
+                    if(i % 100 == 0)
+                        std::cout << i * 100 / vertices_number << "%\r" << std::flush;
+                }
+                std::cout << "Ended! Loaded " << vertices_number << " vertices." << std::endl;
+            } else if(static_cast<int>(e) == faceElementPos)
             {
-                std::cerr << "Current implementation only manages faces defined as \"property list uchar int vertex_indices\"" << std::endl;
-                fileStream.close();
-                return 5;
-            }
-            while(std::getline(fileStream, line) &&
-                  (line.substr(0, 7).compare("comment") == 0 ||
-                   line.compare("property list uchar float texcoord") == 0 ||
-                   line.compare("property uchar red") == 0 ||
-                   line.compare("property uchar green") == 0 ||
-                   line.compare("property uchar blue") == 0 ||
-                   line.compare("property uchar alpha") == 0)); //removing all comments
-            if(line.compare("end_header") != 0)
+                std::cout << "Loading faces: " << std::endl;
+                std::vector<unsigned int> polygon;
+                std::vector<double> faceValues(element.properties.size(), 0.0);
+                faces.reserve(element.count * 3);
+                for(unsigned int i = 0; i < element.count; i++)
+                {
+                    for(uint j = 0; j < element.properties.size(); j++)
+                    {
+                        bool read = true;
+                        if(static_cast<int>(j) == indicesPos)
+                        {
+                            double value;
+                            read = reader.read(element.properties.at(j).countType, value);
+                            polygon.resize(read ? static_cast<std::size_t>(value) : 0);
+                            for(uint k = 0; read && k < polygon.size(); k++)
+                            {
+                                //A failed read leaves value stale: it is reported as the end of the file, not as a wrong index
+                                read = reader.read(element.properties.at(j).type, value);
+                                if(!read)
+                                    break;
+                                if(value < 0 || value >= vertices_number)
+                                {
+                                    std::cerr << "Face refers to a non-existent vertex." << std::endl;
+                                    fileStream.close();
+                                    return 11;
+                                }
+                                polygon.at(k) = static_cast<unsigned int>(value);
+                            }
+                        } else if(element.properties.at(j).isList)
+                            read = reader.skipProperty(element.properties.at(j));
+                        else
+                            read = reader.read(element.properties.at(j).type, faceValues.at(j));
+                        if(!read)
+                        {
+                            std::cerr << "Unexpected end of file." << std::endl;
+                            fileStream.close();
+                            return 8;
+                        }
+                    }
+
+                    //Polygons are split in fans of triangles, each one inheriting the properties of the polygon
+                    for(uint k = 2; k < polygon.size(); k++)
+                    {
+                        faces.insert(faces.end(), {polygon.at(0), polygon.at(k - 1), polygon.at(k)});
+                        for(uint j = 0; j < facePropertiesChannels.size(); j++)
+                            if(facePropertiesChannels.at(j) != nullptr)
+                            {
+                                facePropertiesChannels.at(j)->resize(faces.size() / 3);
+                                facePropertiesChannels.at(j)->setValue(faces.size() / 3 - 1, faceValues.at(j));
+                            }
+                    }
+                }
+                std::cout << "Ended! Loaded " << element.count << " faces." << std::endl;
+            } else
             {
-                std::cerr << "At this point the header must be closed." << std::endl;
-                fileStream.close();
-                return 6;
+                for(unsigned int i = 0; i < element.count; i++)
+                    for(auto property : element.properties)
+                        if(!reader.skipProperty(property))
+                        {
+                            std::cerr << "Unexpected end of file." << std::endl;
+                            fileStream.close();
+                            return 8;
+                        }
             }
-            std::cout << "Loading vertices: " << std::endl;
-            for(unsigned int i = 0; i < vertices_number; i++)
+        }
+        fileStream.close();
+
+        return buildFromArrays(coordinates, faces);
+    }
+    else
+        return -1;
+
+}
+
+int TriangleMesh::loadOBJ(std::string filename)
+{
+    std::ifstream fileStream(filename);
+    if(!fileStream.is_open())
+        return -1;
+
+    std::vector<double> coordinates;
+    std::vector<unsigned int> faces;
+    std::vector<unsigned int> polygon;
+    std::string line;
+    std::cout << "Loading OBJ file:" << std::endl;
+    while(std::getline(fileStream, line))
+    {
+        if(line.size() < 2 || !std::isspace(static_cast<unsigned char>(line[1])))
+            continue;
+        if(line[0] == 'v')
+        {
+            const char* c = line.c_str() + 1;
+            for(uint i = 0; i < 3; i++)
             {
-                if(!std::getline(fileStream, line))
+                char* end;
+                coordinates.push_back(std::strtod(c, &end));
+                if(end == c)
                 {
+                    std::cerr << "Malformed vertex specification: " << line << std::endl;
                     fileStream.close();
                     return 7;
                 }
-                std::stringstream sstream(line);
-                double x, y, z;
-                sstream >> x;
-                sstream >> y;
-                sstream >> z;
-                std::shared_ptr<Vertex> v = addNewVertex(x, y, z);
-                v->setId(std::to_string(reached_vertex_id++));
-                std::vector<std::shared_ptr<Edge> > incident;
-                vertices_edges.insert(std::make_pair(v, incident));
-                if(i % 100 == 0)
-                    std::cout << i * 100 / vertices_number << "%\r" << std::flush;
+                c = end;
             }
-            std::cout << "Ended! Loaded " << vertices_number << " vertices." << std::endl << "Loading triangles:" << std::endl;
-            for(unsigned int i = 0; i < triangles_number; i++)
+        } else if(line[0] == 'f')
+        {
+            //Each corner has the form v, v/vt, v//vn or v/vt/vn: only v is considered, negative values are relative to the last vertex
+            polygon.clear();
+            const char* c = line.c_str() + 1;
+            while(true)
             {
-                if(!std::getline(fileStream, line))
+                while(*c != '\0' && std::isspace(static_cast<unsigned char>(*c)))
+                    c++;
+                if(*c == '\0')
+                    break;
+                char* end;
+                long index = std::strtol(c, &end, 10);
+                long verticesNumber = static_cast<long>(coordinates.size() / 3);
+                if(end == c || index == 0 || index < -verticesNumber)
                 {
-                    std::cerr << "Unexpected end of file." << std::endl;
+                    std::cerr << "Malformed face specification: " << line << std::endl;
                     fileStream.close();
                     return 8;
                 }
-                std::stringstream sstream(line);
-                unsigned int polyVertNum;
-                unsigned int v1, v2, v3;
-                std::shared_ptr<Edge> e1, e2, e3;
-                sstream >> polyVertNum;
-                sstream >> v1;
-                sstream >> v2;
-                sstream >> v3;
-
-                e1 = searchEdgeContainingVertex(vertices_edges.at(vertices.at(v1)), vertices.at(v2));
-                if(e1 == nullptr)
-                    e1 = searchEdgeContainingVertex(vertices_edges.at(vertices.at(v2)), vertices.at(v1));
-                if(e1 == nullptr)
-                {
-                    addNewEdge(vertices.at(v1), vertices.at(v2));
-                    e1 = edges.back();
-                    e1->setId(std::to_string(reached_edge_id++));
-                    vertices_edges.at(vertices.at(v1)).push_back(e1);
-                }
-                vertices.at(v1)->setE0(e1);
-                e2 = searchEdgeContainingVertex(vertices_edges.at(vertices.at(v2)), vertices.at(v3));
-                if(e2 == nullptr)
-                    e2 = searchEdgeContainingVertex(vertices_edges.at(vertices.at(v3)), vertices.at(v2));
-                if(e2 == nullptr)
-                {
-                    addNewEdge(vertices.at(v2), vertices.at(v3));
-                    e2 = edges.back();
-                    e2->setId(std::to_string(reached_edge_id++));
-                    vertices_edges.at(vertices.at(v2)).push_back(e2);
-                }
-                vertices.at(v2)->setE0(e2);
-                e3 = searchEdgeContainingVertex(vertices_edges.at(vertices.at(v3)), vertices.at(v1));
-                if(e3 == nullptr)
-                    e3 = searchEdgeContainingVertex(vertices_edges.at(vertices.at(v1)), vertices.at(v3));
-                if(e3 == nullptr)
-                {
-                    addNewEdge(vertices.at(v3), vertices.at(v1));
-                    e3 = edges.back();
-                    e3->setId(std::to_string(reached_edge_id++));
-                    vertices_edges.at(vertices.at(v3)).push_back(e3);
-                }
-                vertices.at(v3)->setE0(e3);
-
-                addNewTriangle(e1, e2, e3);
-                triangles.back()->setId(std::to_string(reached_triangle_id++));
-                if(e1->getT1() == nullptr)
-                   e1->setT1(triangles.back());
-                else if(e1->getT2() == nullptr)
-                    e1->setT2(triangles.back());
-                else
-                {
-                    fileStream.close();
-                    return 9;
-                }
-                if(e2->getT1() == nullptr)
-                    e2->setT1(triangles.back());
-                else if(e2->getT2() == nullptr)
-                    e2->setT2(triangles.back());
-                else
-                {
-                    fileStream.close();
-                    return 9;
-                }
-                if(e3->getT1() == nullptr)
-                    e3->setT1(triangles.back());
-                else if(e3->getT2() == nullptr)
-                    e3->setT2(triangles.back());
-                else
-                {
-                    fileStream.close();
-                    return 9;
-                }
+                polygon.push_back(static_cast<unsigned int>(index > 0 ? index - 1 : verticesNumber + index));
+                c = end;
+                while(*c != '\0' && !std::isspace(static_cast<unsigned char>(*c)))
+                    c++;
+            }
+            for(uint k = 2; k < polygon.size(); k++)
+                faces.insert(faces.end(), {polygon.at(0), polygon.at(k - 1), polygon.at(k)});
+        }
+    }
+    fileStream.close();
+    std::cout << "Ended! Loaded " << coordinates.size() / 3 << " vertices." << std::endl;
 
-                if(i % 100 == 0)
-                    std::cout << i * 100 / triangles_number << "%\r" << std::flush;;
+    return buildFromArrays(coordinates, faces);
+}
 
-            }
-            std::cout << "Ended! Loaded " << triangles_number << " triangles." << std::endl;
+int TriangleMesh::loadOFF(std::string filename)
+{
+    std::ifstream fileStream(filename);
+    if(!fileStream.is_open())
+        return -1;
 
-        } else
+    //Comments start with '#' and blank lines are ignored
+    std::string line;
+    auto nextLine = [&fileStream, &line]()
+    {
+        while(std::getline(fileStream, line))
         {
-            std::cerr << "This file format is currently not supported" << std::endl;
-            return 10;
+            std::size_t commentPos = line.find('#');
+            if(commentPos != std::string::npos)
+                line.erase(commentPos);
+            if(line.find_first_not_of(" \t\r") != std::string::npos)
+                return true;
         }
+        return false;
+    };
+
+    std::string keyword;
+    std::stringstream sstream;
+    if(nextLine())
+    {
+        sstream.str(line);
+        sstream >> keyword;
+    }
+    if(keyword.size() < 3 || keyword.compare(keyword.size() - 3, 3, "OFF") != 0)
+    {
+        std::cerr << "The file is not in OFF format!" << std::endl;
         fileStream.close();
-        return 0;
+        return 1;
     }
-    else
+    std::string binaryKeyword;
+    if(sstream >> binaryKeyword && binaryKeyword.compare("BINARY") == 0)
+    {
+        std::cerr << "This file format is currently not supported" << std::endl;
+        fileStream.close();
+        return 10;
+    }
+    //The counters may follow the keyword on the same line
+    std::size_t verticesNumber = 0, facesNumber = 0;
+    sstream.clear();
+    sstream.str(line.substr(line.find(keyword) + keyword.size()));
+    if(!(sstream >> verticesNumber >> facesNumber))
+    {
+        if(!nextLine())
+        {
+            fileStream.close();
+            return 6;
+        }
+        sstream.clear();
+        sstream.str(line);
+        if(!(sstream >> verticesNumber >> facesNumber))
+        {
+            std::cerr << "The header is not correctly closed." << std::endl;
+            fileStream.close();
+            return 6;
+        }
+    }
+
+    std::vector<double> coordinates(verticesNumber * 3);
+    std::vector<unsigned int> faces;
+    faces.reserve(facesNumber * 3);
+    std::cout << "Loading vertices: " << std::endl;
+    for(std::size_t i = 0; i < verticesNumber; i++)
+    {
+        const char* c = nextLine() ? line.c_str() : nullptr;
+        for(uint j = 0; c != nullptr && j < 3; j++)
+        {
+            char* end;
+            coordinates[i * 3 + j] = std::strtod(c, &end);
+            c = end == c ? nullptr : end;
+        }
+        if(c == nullptr)
+        {
+            std::cerr << "Unexpected end of file." << std::endl;
+            fileStream.close();
+            return 7;
+        }
+        if(i % 100 == 0)
+            std::cout << i * 100 / verticesNumber << "%\r" << std::flush;
+    }
+    std::cout << "Ended! Loaded " << verticesNumber << " vertices." << std::endl;
+
+    std::cout << "Loading faces: " << std::endl;
+    std::vector<unsigned int> polygon;
+    for(std::size_t i = 0; i < facesNumber; i++)
+    {
+        std::size_t cornersNumber = 0;
+        bool read = nextLine();
+        if(read)
+        {
+            sstream.clear();
+            sstream.str(line);
+            read = static_cast<bool>(sstream >> cornersNumber);
+            polygon.resize(read ? cornersNumber : 0);
+            for(std::size_t k = 0; read && k < cornersNumber; k++)
+                read = static_cast<bool>(sstream >> polygon[k]);
+        }
+        if(!read)
+        {
+            std::cerr << "Unexpected end of file." << std::endl;
+            fileStream.close();
+            return 8;
+        }
+        for(uint k = 2; k < polygon.size(); k++)
+            faces.insert(faces.end(), {polygon.at(0), polygon.at(k - 1), polygon.at(k)});
+        if(i % 100 == 0)
+            std::cout << i * 100 / facesNumber << "%\r" << std::flush;
+    }
+    std::cout << "Ended! Loaded " << facesNumber << " faces." << std::endl;
+    fileStream.close();
+
+    return buildFromArrays(coordinates, faces);
+}
+
+int TriangleMesh::loadSTL(std::string filename)
+{
+    std::ifstream fileStream(filename, std::ios::binary);
+    if(!fileStream.is_open())
         return -1;
 
+    //A file is binary if its size matches the number of triangles declared after the 80 bytes of the header (ascii files may also start with "solid")
+    fileStream.seekg(0, std::ios::end);
+    std::streamoff fileSize = fileStream.tellg();
+    fileStream.seekg(0, std::ios::beg);
+    char description[80] = {0};
+    fileStream.read(description, 80);
+    PLYValueReader reader(fileStream, PLYFormat::BINARY_LITTLE_ENDIAN);
+    double declaredTriangles = 0;
+    bool binary = fileSize >= 84 && reader.read(ScalarType::UINT32, declaredTriangles) &&
+                  fileSize == 84 + 50 * static_cast<std::streamoff>(declaredTriangles);
+
+    //Triangle soup: nine coordinates for each triangle
+    std::vector<double> soup;
+    std::vector<double> attributes;
+    bool hasAttributes = false;
+    if(binary)
+    {
+        std::size_t trianglesNumber = static_cast<std::size_t>(declaredTriangles);
+        soup.resize(trianglesNumber * 9);
+        attributes.resize(trianglesNumber);
+        std::cout << "Loading binary STL triangles: " << std::endl;
+        for(std::size_t i = 0; i < trianglesNumber; i++)
+        {
+            double value;
+            bool read = true;
+            for(uint j = 0; read && j < 3; j++)
+                read = reader.read(ScalarType::FLOAT32, value);
+            for(uint j = 0; read && j < 9; j++)
+                read = reader.read(ScalarType::FLOAT32, soup[i * 9 + j]);
+            if(!read || !reader.read(ScalarType::UINT16, attributes[i]))
+            {
+                std::cerr << "Unexpected end of file." << std::endl;
+                fileStream.close();
+                return 8;
+            }
+            hasAttributes = hasAttributes || attributes[i] != 0.0;
+            if(i % 100 == 0)
+                std::cout << i * 100 / trianglesNumber << "%\r" << std::flush;
+        }
+    } else
+    {
+        fileStream.clear();
+        fileStream.seekg(0, std::ios::beg);
+        std::string keyword;
+        fileStream >> keyword;
+        if(keyword.compare("solid") != 0)
+        {
+            std::cerr << "The file is not in STL format!" << std::endl;
+            fileStream.close();
+            return 1;
+        }
+        std::cout << "Loading ascii STL triangles: " << std::endl;
+        while(fileStream >> keyword)
+        {
+            if(keyword.compare("vertex") != 0)
+                continue;
+            double x, y, z;
+            if(!(fileStream >> x >> y >> z))
+            {
+                std::cerr << "Malformed vertex specification." << std::endl;
+                fileStream.close();
+                return 7;
+            }
+            soup.insert(soup.end(), {x, y, z});
+        }
+        if(soup.size() % 9 != 0)
+        {
+            std::cerr << "Facets have to be triangles." << std::endl;
+            fileStream.close();
+            return 8;
+        }
+    }
+    fileStream.close();
+
+    //Corners are welded through a spatial hash whose cells are comparable with the average edge length
+    std::size_t trianglesNumber = soup.size() / 9;
+    double averageLength = 0.0;
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+        for(uint j = 0; j < 3; j++)
+        {
+            const double* p = &soup[i * 9 + j * 3];
+            const double* q = &soup[i * 9 + ((j + 1) % 3) * 3];
+            averageLength += std::sqrt((p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) + (p[2] - q[2]) * (p[2] - q[2]));
+        }
+    if(trianglesNumber > 0)
+        averageLength /= 3 * trianglesNumber;
+    SpatialHash<3> weldingHash(std::max(averageLength / 2, Point::EPSILON));
+    weldingHash.reserve(trianglesNumber / 2 + 3);
+    std::vector<unsigned int> faces(trianglesNumber * 3);
+    for(std::size_t i = 0; i < trianglesNumber * 3; i++)
+        faces[i] = weldingHash.findOrInsert(&soup[i * 3], Point::EPSILON);
+    std::vector<double> coordinates(weldingHash.size() * 3);
+    for(std::size_t i = 0; i < weldingHash.size(); i++)
+        std::copy(weldingHash.getPoint(static_cast<unsigned int>(i)), weldingHash.getPoint(static_cast<unsigned int>(i)) + 3, &coordinates[i * 3]);
+    std::cout << "Ended! Welded " << trianglesNumber * 3 << " corners into " << weldingHash.size() << " vertices." << std::endl;
+
+    if(hasAttributes)
+    {
+        std::shared_ptr<PropertyChannel> channel = addTriangleChannel("attribute", ScalarType::UINT16);
+        channel->resize(triangles.size() + trianglesNumber);
+        for(std::size_t i = 0; i < trianglesNumber; i++)
+            channel->setValue(triangles.size() + i, attributes[i]);
+    }
+
+    return buildFromArrays(coordinates, faces);
 }
 
 void TriangleMesh::initialiseKDTree()
 {
-    if(kdtree != nullptr)
-        kdtree.reset();
-    std::vector<std::vector<double> > pointsVector;
-    for(auto v : vertices)
+    kdtree.reset();
+    getKDTree();
+}
+
+std::shared_ptr<KDTree> TriangleMesh::getKDTree()
+{
+    auto current = [this]() { return MeshCache<KDTree, 2>::Generations{{positionsGeneration->load(), verticesGeneration.load()}}; };
+    return kdtree.update(current, [this, &current](std::shared_ptr<KDTree> tree, MeshCache<KDTree, 2>::Generations treeGenerations)
+    {
+        MeshCache<KDTree, 2>::Generations generations = current();
+
+        //A background rebuild is adopted once completed, unless vertices have been added or removed meanwhile (edges and triangles are not indexed)
+        if(kdtreeRebuild.valid())
+        {
+            if(kdtreeRebuildGenerations[1] != generations[1])
+                kdtreeRebuild = std::future<std::shared_ptr<KDTree> >();
+            else if(tree == nullptr || treeGenerations[1] != generations[1] ||
+                    kdtreeRebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                tree = kdtreeRebuild.get();
+                treeGenerations = kdtreeRebuildGenerations;
+            }
+        }
+
+        if(tree == nullptr || treeGenerations[1] != generations[1])
+        {
+            kdtreeRebuild = std::future<std::shared_ptr<KDTree> >();
+            std::vector<double> coordinates = flattenCoordinates();
+            return std::make_shared<KDTree>(coordinates.data(), vertices.size());
+        }
+
+        if(treeGenerations[0] != generations[0])
+        {
+            std::vector<double> coordinates = flattenCoordinates();
+            //The published tree may still be searched by threads which loaded it from the fast path: a copy is refitted and published instead
+            tree = std::make_shared<KDTree>(*tree);
+            double looseness = tree->refit(coordinates.data());
+            if(looseness > KDTREE_REBUILD_RATIO && !kdtreeRebuild.valid())
+            {
+                std::size_t verticesNumber = vertices.size();
+                kdtreeRebuildGenerations = generations;
+                kdtreeRebuild = ThreadPool::getDefault().submit([coordinates, verticesNumber]()
+                {
+                    return std::make_shared<KDTree>(coordinates.data(), verticesNumber);
+                });
+            }
+        }
+        return tree;
+    });
+}
+
+std::shared_ptr<TriangleBVH> TriangleMesh::getBVH()
+{
+    return bvh.get([this]() { return MeshCache<TriangleBVH, 3>::Generations{{positionsGeneration->load(), verticesGeneration.load(), topologyGeneration.load()}}; }, [this]()
+    {
+        std::vector<unsigned int> faces = flattenFaces();
+        std::vector<double> coordinates = flattenCoordinates();
+        return std::make_shared<TriangleBVH>(coordinates.data(), faces.data(), triangles.size());
+    });
+}
+
+std::shared_ptr<TriangleLocator> TriangleMesh::getLocator()
+{
+    return locator.get([this]() { return MeshCache<TriangleLocator, 3>::Generations{{positionsGeneration->load(), verticesGeneration.load(), topologyGeneration.load()}}; }, [this]()
+    {
+        std::vector<unsigned int> faces = flattenFaces();
+        std::vector<double> coordinates = flattenCoordinates();
+        return std::make_shared<TriangleLocator>(coordinates.data(), faces.data(), triangles.size());
+    });
+}
+
+void TriangleMesh::initialiseXYHash(double cellSize)
+{
+    if(cellSize <= 0)
     {
-        std::vector<double> point = {v->getX(), v->getY(), v->getZ()};
-        pointsVector.push_back(point);
+        double minXY[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+        double maxXY[2] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+        for(const auto& v : vertices)
+        {
+            minXY[0] = std::min(minXY[0], v->getX());
+            minXY[1] = std::min(minXY[1], v->getY());
+            maxXY[0] = std::max(maxXY[0], v->getX());
+            maxXY[1] = std::max(maxXY[1], v->getY());
+        }
+        cellSize = computeXYCellSize(minXY, maxXY, vertices.size());
     }
-    kdtree = std::make_shared<KDTree>(pointsVector);
+    xyHash = SpatialHash<2>(cellSize);
+    xyHash.reserve(vertices.size());
+    for(const auto& v : vertices)
+    {
+        double point[2] = {v->getX(), v->getY()};
+        xyHash.insert(point);
+    }
+    xyHashValid = true;
+    xyHashPositionsGeneration = *positionsGeneration;
+    xyHashVerticesGeneration = verticesGeneration;
+}
+
+int TriangleMesh::searchCoincidentVertex(const Point &p, bool compareZ)
+{
+    if(!xyHashValid || xyHashPositionsGeneration != *positionsGeneration || xyHashVerticesGeneration != verticesGeneration)
+        initialiseXYHash();
+    //Candidates are the vertices close in the XY plane, then the same comparison of Point::operator== is applied (on XY or in 3D)
+    int found = -1;
+    double point[2] = {p.getX(), p.getY()};
+    xyHash.visitNeighbours(point, Point::EPSILON, [&](unsigned int position)
+    {
+        if(found >= 0 && static_cast<int>(position) > found)
+            return;
+        const auto& v = vertices.at(position);
+        bool coincident;
+        if(compareZ)
+            coincident = p == *v;
+        else
+        {
+            Point p1(p.getX(), p.getY(), 0), p2(v->getX(), v->getY(), 0);
+            coincident = p1 == p2;
+        }
+        if(coincident)
+            found = static_cast<int>(position);
+    });
+    return found;
+}
+
+std::vector<double> TriangleMesh::flattenCoordinates() const
+{
+    std::vector<double> coordinates;
+    coordinates.reserve(vertices.size() * 3);
+    for(auto v : vertices)
+        coordinates.insert(coordinates.end(), {v->getX(), v->getY(), v->getZ()});
+    return coordinates;
+}
+
+std::shared_ptr<TriangleMesh::VertexAdjacency> TriangleMesh::getVertexAdjacency()
+{
+    return adjacency.get([this]() { return MeshCache<VertexAdjacency, 2>::Generations{{verticesGeneration.load(), topologyGeneration.load()}}; }, [this]()
+    {
+        //Walking around the vertices is the expensive part, so the lists of the single vertices are collected in parallel and then concatenated
+        std::vector<std::vector<uint32_t> > neighbourhoods(vertices.size());
+        ThreadPool::getDefault().parallelFor(0, vertices.size(), [&](std::size_t begin, std::size_t end, unsigned int)
+        {
+            for(std::size_t i = begin; i < end; i++)
+                for(const auto& n : vertices[i]->getVV())
+                    neighbourhoods[i].push_back(getVertexPosition(n));
+        });
+        std::shared_ptr<VertexAdjacency> lists = std::make_shared<VertexAdjacency>();
+        lists->offsets.reserve(vertices.size() + 1);
+        lists->neighbours.reserve(edges.size() * 2);
+        lists->offsets.push_back(0);
+        for(const auto& neighbourhood : neighbourhoods)
+        {
+            lists->neighbours.insert(lists->neighbours.end(), neighbourhood.begin(), neighbourhood.end());
+            lists->offsets.push_back(static_cast<uint32_t>(lists->neighbours.size()));
+        }
+        return lists;
+    });
+}
+
+//Position of an element (vertex or triangle) in its list: the id is tried first, then the cached map from the elements to their positions,
+//(re)built if the generation returned by current changed since its construction
+template <class Element, class Current>
+static uint32_t elementPosition(const std::vector<std::shared_ptr<Element> > &list, const std::shared_ptr<Element> &element,
+                                MeshCache<std::unordered_map<const Element*, uint32_t>, 1> &cache, Current current)
+{
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    if(element == nullptr)
+        return NONE;
+    //The ids match the positions unless elements have been removed
+    unsigned long id = std::strtoul(element->getId().c_str(), nullptr, 10);
+    if(id < list.size() && list[id] == element)
+        return static_cast<uint32_t>(id);
+
+    std::shared_ptr<std::unordered_map<const Element*, uint32_t> > positions = cache.get(current, [&list]()
+    {
+        std::shared_ptr<std::unordered_map<const Element*, uint32_t> > map = std::make_shared<std::unordered_map<const Element*, uint32_t> >();
+        map->reserve(list.size());
+        for(uint32_t i = 0; i < list.size(); i++)
+            map->insert(std::make_pair(list[i].get(), i));
+        return map;
+    });
+    auto it = positions->find(element.get());
+    return it != positions->end() ? it->second : NONE;
+}
+
+uint32_t TriangleMesh::getVertexPosition(const std::shared_ptr<Vertex> &v)
+{
+    return elementPosition(vertices, v, vertexPositions, [this]()
+    {
+        return MeshCache<std::unordered_map<const Vertex*, uint32_t>, 1>::Generations{{verticesGeneration.load()}};
+    });
+}
+
+uint32_t TriangleMesh::getTrianglePosition(const std::shared_ptr<Triangle> &t)
+{
+    return elementPosition(triangles, t, trianglePositions, [this]()
+    {
+        return MeshCache<std::unordered_map<const Triangle*, uint32_t>, 1>::Generations{{topologyGeneration.load()}};
+    });
+}
+
+std::shared_ptr<GeodesicSolver> TriangleMesh::getGeodesicSolver()
+{
+    return geodesicSolver.get([this]() { return MeshCache<GeodesicSolver, 3>::Generations{{positionsGeneration->load(), verticesGeneration.load(), topologyGeneration.load()}}; },
+                              [this]()
+    {
+        std::vector<unsigned int> faces = flattenFaces();
+        std::vector<double> coordinates = flattenCoordinates();
+        return std::make_shared<GeodesicSolver>(coordinates.data(), vertices.size(), faces.data(), triangles.size());
+    });
+}
+
+std::vector<unsigned int> TriangleMesh::flattenFaces() const
+{
+    std::unordered_map<const Vertex*, unsigned int> positionsMap;
+    positionsMap.reserve(vertices.size());
+    for(unsigned int i = 0; i < vertices.size(); i++)
+        positionsMap.insert(std::make_pair(vertices[i].get(), i));
+    std::vector<unsigned int> faces;
+    faces.reserve(triangles.size() * 3);
+    for(auto t : triangles)
+        faces.insert(faces.end(), {positionsMap.at(t->getV1().get()), positionsMap.at(t->getV2().get()), positionsMap.at(t->getV3().get())});
+    return faces;
+}
+
+void TriangleMesh::notifyPositionsChanged()
+{
+    (*positionsGeneration)++;
+}
+
+void TriangleMesh::notifyVerticesChanged()
+{
+    verticesGeneration++;
+}
+
+void TriangleMesh::notifyTopologyChanged()
+{
+    topologyGeneration++;
+}
+
+std::size_t TriangleMesh::getPositionsGeneration() const
+{
+    return positionsGeneration->load();
+}
+
+std::size_t TriangleMesh::getVerticesGeneration() const
+{
+    return verticesGeneration.load();
+}
+
+std::size_t TriangleMesh::getTopologyGeneration() const
+{
+    return topologyGeneration.load();
 }
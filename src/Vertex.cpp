@@ -226,6 +226,39 @@ void Vertex::setId(std::string newId)
     id = newId;
 }
 
+void Vertex::setPosition(const Point &p)
+{
+    Point::setPosition(p);
+    if(positionsGeneration != nullptr)
+        (*positionsGeneration)++;
+}
+
+void Vertex::setX(const double &newX)
+{
+    Point::setX(newX);
+    if(positionsGeneration != nullptr)
+        (*positionsGeneration)++;
+}
+
+void Vertex::setY(const double &newY)
+{
+    Point::setY(newY);
+    if(positionsGeneration != nullptr)
+        (*positionsGeneration)++;
+}
+
+void Vertex::setZ(const double &newZ)
+{
+    Point::setZ(newZ);
+    if(positionsGeneration != nullptr)
+        (*positionsGeneration)++;
+}
+
+void Vertex::setPositionsGeneration(const std::shared_ptr<std::atomic<std::size_t> > &newPositionsGeneration)
+{
+    positionsGeneration = newPositionsGeneration;
+}
+
 void Vertex::print(std::ostream &stream)
 {
     stream << "Vertex with id: " << id << " and coordinates: ";
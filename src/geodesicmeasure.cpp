@@ -1,4 +1,6 @@
 #include "geodesicmeasure.hpp"
+#include "TriangleMesh.hpp"
+#include <limits>
 
 using namespace SemantisedTriangleMesh;
 GeodesicMeasure::GeodesicMeasure()
@@ -16,6 +18,36 @@ void GeodesicMeasure::setPoints(const std::vector<std::shared_ptr<SemantisedTria
     points = newPoints;
 }
 
+double GeodesicMeasure::computeMeasure(const std::shared_ptr<TriangleMesh> &mesh, std::size_t maxTriangles)
+{
+    std::vector<std::shared_ptr<Vertex> > measurePoints = points;
+    if(measurePoints.empty())
+        for(unsigned int id : getMeasurePointsID())
+            measurePoints.push_back(mesh->getVertex(id));
+
+    double length = 0;
+    path.clear();
+    for(unsigned int i = 1; i < measurePoints.size(); i++)
+    {
+        std::vector<Point> segment;
+        double segmentLength = mesh->computeGeodesicPath(measurePoints[i - 1], measurePoints[i], segment, maxTriangles);
+        if(segment.empty())
+        {
+            length = std::numeric_limits<double>::infinity();
+            path.clear();
+            break;
+        }
+        length += segmentLength;
+        path.insert(path.end(), path.empty() ? segment.begin() : segment.begin() + 1, segment.end());
+    }
+    setValue(length);
+    return length;
+}
+
+const std::vector<Point> &GeodesicMeasure::getPath() const
+{
+    return path;
+}
 
 void GeodesicMeasure::print(std::ostream &writer)
 {
@@ -0,0 +1,1195 @@
+#include "geodesicsolver.hpp"
+#include "indexedheap.hpp"
+#include "threadpool.hpp"
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/SparseCholesky>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+using namespace SemantisedTriangleMesh;
+
+struct GeodesicSolver::HeatSystems
+{
+    //Factorisations of the heat flow system (M + tL) and of the Poisson system (L, slightly regularised)
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > heat, poisson;
+    //Cotangents of the angles at the three corners of each triangle
+    std::vector<double> cotangents;
+    bool valid = false;
+};
+
+namespace {
+
+    inline double distance(const double* a, const double* b)
+    {
+        double dx = b[0] - a[0], dy = b[1] - a[1], dz = b[2] - a[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    //Distance of c from the front known at the other corners a and b of a triangle (distances da and db), assuming it is planar inside
+    //the triangle. If the front does not reach c across the edge ab, the distance is measured along the edges ac and bc.
+    double triangleUpdate(const double* a, const double* b, const double* c, double da, double db)
+    {
+        double best = std::min(da + distance(a, c), db + distance(b, c));
+        double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        double abLength = std::sqrt(ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2]);
+        if(abLength == 0.0)
+            return best;
+
+        //Triangle unfolded in the plane, with a in the origin, b on the positive X axis and c above it
+        double cx = (ac[0] * ab[0] + ac[1] * ab[1] + ac[2] * ab[2]) / abLength;
+        double cy = std::sqrt(std::max(0.0, ac[0] * ac[0] + ac[1] * ac[1] + ac[2] * ac[2] - cx * cx));
+        if(cy == 0.0)
+            return best;
+
+        //Virtual source at distance da from a and db from b, on the other side of ab
+        double sx = (da * da - db * db + abLength * abLength) / (2 * abLength);
+        double sy2 = da * da - sx * sx;
+        if(sy2 < 0)
+            return best;
+        double sy = -std::sqrt(sy2);
+
+        //The straight ray from the source to c must cross the edge ab
+        double crossing = sx + (cx - sx) * (-sy) / (cy - sy);
+        if(crossing < 0 || crossing > abLength)
+            return best;
+        return std::min(best, std::hypot(cx - sx, cy - sy));
+    }
+
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    inline double dot(const double* a, const double* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    inline void cross(const double* a, const double* b, double* result)
+    {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline void subtract(const double* a, const double* b, double* result)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+            result[k] = a[k] - b[k];
+    }
+
+    //Normalises v, returning its original length
+    inline double normalise(double* v)
+    {
+        double length = std::sqrt(dot(v, v));
+        if(length > 0)
+            for(unsigned int k = 0; k < 3; k++)
+                v[k] /= length;
+        return length;
+    }
+
+    //The triangle sharing the edge ab with f (NONE if the edge is on the boundary)
+    uint32_t neighbourFace(const std::vector<uint32_t>& faces, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& vertexTriangles,
+                           uint32_t f, uint32_t a, uint32_t b)
+    {
+        for(uint32_t i = offsets[a]; i < offsets[a + 1]; i++)
+        {
+            uint32_t t = vertexTriangles[i];
+            const uint32_t* corners = &faces[t * std::size_t(3)];
+            if(t != f && (corners[0] == b || corners[1] == b || corners[2] == b))
+                return t;
+        }
+        return NONE;
+    }
+
+    /**
+     * Window propagation from a source vertex to a target vertex over a region of the mesh. A window is an interval of an edge reached by
+     * straight lines from a pseudo-source (the source or a vertex where paths bend), unfolded in the plane of the triangle the window
+     * enters: the edge lies on the X axis, from its first vertex in the origin, the triangle above it and the pseudo-source below.
+     * Windows and pseudo-sources are processed in order of increasing distance, so the search stops when the closest event is farther than
+     * the target. Useless windows are discarded by comparing them with the distances of the vertices at their endpoints.
+     */
+    class WindowPropagation
+    {
+    public:
+        WindowPropagation(const std::vector<double>& coordinates, const std::vector<uint32_t>& faces, const std::vector<uint32_t>& offsets,
+                          const std::vector<uint32_t>& vertexTriangles) :
+            coordinates(coordinates), faces(faces), offsets(offsets), vertexTriangles(vertexTriangles) {}
+
+        double run(uint32_t source, uint32_t target, std::vector<double>& path, std::size_t maxTriangles, bool& exact)
+        {
+            path.clear();
+            exact = false;
+            start();
+            std::vector<uint32_t> edgePath;
+            bool cut;
+            double bound = searchEdgePath(source, target, maxTriangles, edgePath, cut);
+            if(bound == std::numeric_limits<double>::infinity() && !cut)
+                return bound;
+            if(source == target)
+            {
+                path.insert(path.end(), point(source), point(source) + 3);
+                exact = true;
+                return 0;
+            }
+
+            //If the region has been cut before reaching the target, the path along the edges is returned. If the search along the edges
+            //has been cut as well, there is no bound: the region grows towards the target up to maxTriangles, and the path is found only
+            //if the target is in it.
+            bool complete = buildRegion(source, target, bound, maxTriangles);
+            if(localVertex(target) != NONE)
+            {
+                bool finished = propagate(source, target, (regionFaces.size() + 10) * MAX_WINDOWS_PER_TRIANGLE);
+                double length = distances[localVertex(target)];
+                if(length <= bound && length < std::numeric_limits<double>::infinity())
+                {
+                    tracePath(source, target, path);
+                    exact = complete && finished && !cut;
+                    return length;
+                }
+            }
+
+            for(auto it = edgePath.rbegin(); it != edgePath.rend(); it++)
+                path.insert(path.end(), point(*it), point(*it) + 3);
+            return bound;
+        }
+
+    protected:
+        struct Window
+        {
+            //The edge, from the vertex in the origin to the one on the X axis, and the triangle the window enters
+            uint32_t from, to, face;
+            double length;
+            //The interval of the edge
+            double b0, b1;
+            //The unfolded pseudo-source (sy <= 0) and its distance from the source
+            double sx, sy, sigma;
+            uint32_t pseudoSource;
+            //The window this one was propagated from (NONE if it was generated by the pseudo-source)
+            uint32_t parent;
+        };
+
+        struct Event
+        {
+            double key;
+            uint32_t index;
+            bool vertex;
+            bool operator>(const Event& other) const
+            {
+                return key > other.key;
+            }
+        };
+
+        //Bound of the windows generated per triangle of the region, against degenerate configurations
+        static constexpr std::size_t MAX_WINDOWS_PER_TRIANGLE = 100;
+        static constexpr double TOLERANCE = 1e-12;
+
+        const std::vector<double>& coordinates;
+        const std::vector<uint32_t>& faces;
+        const std::vector<uint32_t>& offsets;
+        const std::vector<uint32_t>& vertexTriangles;
+
+        //Dense arrays over the mesh, allocated once per workspace: the entries of a vertex (or triangle) are valid only if its stamp equals the
+        //generation of the current path, so that starting a path costs O(1). The vertices reached by the search along the edges have their
+        //distance and parent, the vertices of the region their position in it.
+        uint32_t generation = 0;
+        std::vector<uint32_t> searchStamps, searchParents, vertexStamps, localVertices, faceStamps;
+        std::vector<double> searchDistances;
+        std::vector<std::pair<double, uint32_t> > searchFrontier;
+
+        std::vector<uint32_t> regionFaces, regionVertices, parents;
+        std::vector<double> distances;
+        //For each vertex of the region: 1 if paths may bend there, 0 if not, 2 if not yet known
+        std::vector<unsigned char> bending;
+        std::vector<Window> windows;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+
+        const double* point(uint32_t v) const
+        {
+            return &coordinates[v * std::size_t(3)];
+        }
+
+        const uint32_t* face(uint32_t f) const
+        {
+            return &faces[f * std::size_t(3)];
+        }
+
+        uint32_t thirdVertex(uint32_t f, uint32_t a, uint32_t b) const
+        {
+            const uint32_t* t = face(f);
+            return t[0] != a && t[0] != b ? t[0] : (t[1] != a && t[1] != b ? t[1] : t[2]);
+        }
+
+        uint32_t neighbourFace(uint32_t f, uint32_t a, uint32_t b) const
+        {
+            return ::neighbourFace(faces, offsets, vertexTriangles, f, a, b);
+        }
+
+        //Prepares the workspace for a new path, (re)allocating the arrays over the mesh only if its size changed
+        void start()
+        {
+            std::size_t verticesNumber = offsets.size() - 1, trianglesNumber = faces.size() / 3;
+            if(vertexStamps.size() != verticesNumber || faceStamps.size() != trianglesNumber)
+            {
+                searchStamps.assign(verticesNumber, 0);
+                vertexStamps.assign(verticesNumber, 0);
+                faceStamps.assign(trianglesNumber, 0);
+                searchParents.resize(verticesNumber);
+                searchDistances.resize(verticesNumber);
+                localVertices.resize(verticesNumber);
+                generation = 0;
+            }
+            if(++generation == 0)
+            {
+                std::fill(searchStamps.begin(), searchStamps.end(), 0);
+                std::fill(vertexStamps.begin(), vertexStamps.end(), 0);
+                std::fill(faceStamps.begin(), faceStamps.end(), 0);
+                generation = 1;
+            }
+            regionFaces.clear();
+            regionVertices.clear();
+            windows.clear();
+            events = decltype(events)();
+        }
+
+        //Position of a vertex in the region (NONE if it is not in it)
+        uint32_t localVertex(uint32_t v) const
+        {
+            return vertexStamps[v] == generation ? localVertices[v] : NONE;
+        }
+
+        bool inRegion(uint32_t f) const
+        {
+            return faceStamps[f] == generation;
+        }
+
+        //Shortest path along the edges (A*), bounding the length of the geodesic; the path is stored from the target to the source. As the
+        //region, the search is bounded: if more than maxVertices vertices are expanded, it is cut and returns infinity.
+        double searchEdgePath(uint32_t source, uint32_t target, std::size_t maxVertices, std::vector<uint32_t>& edgePath, bool& cut)
+        {
+            cut = false;
+            std::greater<std::pair<double, uint32_t> > compare;
+            searchFrontier.clear();
+            searchStamps[source] = generation;
+            searchDistances[source] = 0;
+            searchParents[source] = NONE;
+            searchFrontier.push_back({distance(point(source), point(target)), source});
+            std::size_t expanded = 0;
+            while(!searchFrontier.empty())
+            {
+                std::pop_heap(searchFrontier.begin(), searchFrontier.end(), compare);
+                double key = searchFrontier.back().first;
+                uint32_t v = searchFrontier.back().second;
+                searchFrontier.pop_back();
+                double d = searchDistances[v];
+                if(key > d + distance(point(v), point(target)))
+                    continue;
+                if(v == target)
+                {
+                    for(uint32_t u = target; u != NONE; u = searchParents[u])
+                        edgePath.push_back(u);
+                    return d;
+                }
+                if(++expanded > maxVertices)
+                {
+                    cut = true;
+                    return std::numeric_limits<double>::infinity();
+                }
+                for(uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+                    for(unsigned int j = 0; j < 3; j++)
+                    {
+                        uint32_t w = face(vertexTriangles[i])[j];
+                        double candidate = d + distance(point(v), point(w));
+                        if(w != v && (searchStamps[w] != generation || candidate < searchDistances[w]))
+                        {
+                            searchStamps[w] = generation;
+                            searchDistances[w] = candidate;
+                            searchParents[w] = v;
+                            searchFrontier.push_back({candidate + distance(point(w), point(target)), w});
+                            std::push_heap(searchFrontier.begin(), searchFrontier.end(), compare);
+                        }
+                    }
+            }
+            return std::numeric_limits<double>::infinity();
+        }
+
+        //Region of the triangles that may be crossed by a path not longer than bound, grown from the source in order of increasing lower
+        //bound of the length of the paths through them. Returns false if it has been cut by maxTriangles.
+        bool buildRegion(uint32_t source, uint32_t target, double bound, std::size_t maxTriangles)
+        {
+            auto lowerBound = [&](uint32_t f)
+            {
+                const uint32_t* t = face(f);
+                double centre[3];
+                for(unsigned int k = 0; k < 3; k++)
+                    centre[k] = (point(t[0])[k] + point(t[1])[k] + point(t[2])[k]) / 3;
+                double radius = std::max(std::max(distance(centre, point(t[0])), distance(centre, point(t[1]))), distance(centre, point(t[2])));
+                return distance(centre, point(source)) + distance(centre, point(target)) - 2 * radius;
+            };
+            double limit = bound * (1 + 1e-9);
+            std::priority_queue<std::pair<double, uint32_t>, std::vector<std::pair<double, uint32_t> >, std::greater<std::pair<double, uint32_t> > > frontier;
+            for(uint32_t i = offsets[source]; i < offsets[source + 1]; i++)
+                frontier.push({lowerBound(vertexTriangles[i]), vertexTriangles[i]});
+            while(!frontier.empty())
+            {
+                uint32_t f = frontier.top().second;
+                frontier.pop();
+                if(inRegion(f))
+                    continue;
+                if(regionFaces.size() >= maxTriangles)
+                    break;
+                faceStamps[f] = generation;
+                regionFaces.push_back(f);
+                const uint32_t* t = face(f);
+                for(unsigned int j = 0; j < 3; j++)
+                {
+                    if(localVertex(t[j]) == NONE)
+                    {
+                        vertexStamps[t[j]] = generation;
+                        localVertices[t[j]] = static_cast<uint32_t>(regionVertices.size());
+                        regionVertices.push_back(t[j]);
+                    }
+                    uint32_t neighbour = neighbourFace(f, t[j], t[(j + 1) % 3]);
+                    if(neighbour != NONE && !inRegion(neighbour))
+                    {
+                        double key = lowerBound(neighbour);
+                        if(key <= limit)
+                            frontier.push({key, neighbour});
+                    }
+                }
+            }
+            distances.assign(regionVertices.size(), std::numeric_limits<double>::infinity());
+            parents.assign(regionVertices.size(), NONE);
+            bending.assign(regionVertices.size(), 2);
+            return frontier.empty();
+        }
+
+        //Paths may bend at saddle vertices (total angle greater than 2 pi), at the boundary of the mesh and at the boundary of the region
+        bool isBendingVertex(uint32_t local)
+        {
+            if(bending[local] == 2)
+            {
+                uint32_t v = regionVertices[local];
+                double angle = 0;
+                bool boundary = false;
+                for(uint32_t i = offsets[v]; i < offsets[v + 1] && !boundary; i++)
+                {
+                    uint32_t f = vertexTriangles[i];
+                    const uint32_t* t = face(f);
+                    unsigned int j = t[0] == v ? 0 : (t[1] == v ? 1 : 2);
+                    uint32_t b = t[(j + 1) % 3], c = t[(j + 2) % 3];
+                    double u[3], w[3];
+                    for(unsigned int k = 0; k < 3; k++)
+                    {
+                        u[k] = point(b)[k] - point(v)[k];
+                        w[k] = point(c)[k] - point(v)[k];
+                    }
+                    double cross[3] = {u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0]};
+                    angle += std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), u[0] * w[0] + u[1] * w[1] + u[2] * w[2]);
+                    boundary = !inRegion(f) || neighbourFace(f, v, b) == NONE || neighbourFace(f, v, c) == NONE;
+                }
+                bending[local] = boundary || angle > 2 * M_PI + 1e-9;
+            }
+            return bending[local] == 1;
+        }
+
+        void updateVertex(uint32_t v, double d, uint32_t window)
+        {
+            uint32_t local = localVertex(v);
+            if(local == NONE)
+                return;
+            if(d < distances[local])
+            {
+                distances[local] = d;
+                parents[local] = window;
+                if(isBendingVertex(local))
+                    events.push({d, local, true});
+            }
+        }
+
+        double vertexDistance(uint32_t v) const
+        {
+            uint32_t local = localVertex(v);
+            return local == NONE ? std::numeric_limits<double>::infinity() : distances[local];
+        }
+
+        //Stores a window, updating the vertices at its ends, and queues it unless it cannot improve the distances of the region. The third
+        //vertex of the triangle it comes from (at (rx, ry) in the frame of the window) is used by the filter as well.
+        void addWindow(Window w, uint32_t third, double rx, double ry)
+        {
+            w.b0 = std::max(0.0, std::min(w.b0, w.length));
+            w.b1 = std::max(w.b0, std::min(w.b1, w.length));
+            double d0 = w.sigma + std::hypot(w.b0 - w.sx, w.sy), d1 = w.sigma + std::hypot(w.b1 - w.sx, w.sy);
+            uint32_t index = static_cast<uint32_t>(windows.size());
+            windows.push_back(w);
+            if(w.b0 <= TOLERANCE * w.length)
+                updateVertex(w.from, d0, index);
+            if(w.b1 >= (1 - TOLERANCE) * w.length)
+                updateVertex(w.to, d1, index);
+            if(w.face == NONE || !inRegion(w.face) || w.b1 - w.b0 <= TOLERANCE * w.length || w.sy > -TOLERANCE * w.length)
+                return;
+
+            double slack = 1 + 1e-10;
+            if(d1 > (vertexDistance(w.from) + w.b1) * slack || d0 > (vertexDistance(w.to) + w.length - w.b0) * slack)
+                return;
+            if(third != NONE)
+            {
+                double dr = vertexDistance(third);
+                if(d0 > (dr + std::hypot(w.b0 - rx, ry)) * slack && d1 > (dr + std::hypot(w.b1 - rx, ry)) * slack)
+                    return;
+            }
+            double closest = w.sx < w.b0 ? std::hypot(w.b0 - w.sx, w.sy) : (w.sx > w.b1 ? std::hypot(w.b1 - w.sx, w.sy) : -w.sy);
+            events.push({w.sigma + closest, index, false});
+        }
+
+        //Parameter along PQ of the intersection with the line from the pseudo-source through (x, 0)
+        static double intersect(double sx, double sy, double x, double px, double py, double qx, double qy)
+        {
+            double dx = x - sx, dy = -sy, ex = qx - px, ey = qy - py, rx = px - sx, ry = py - sy;
+            double determinant = ex * dy - dx * ey;
+            if(determinant == 0.0)
+                return 0.0;
+            return std::max(0.0, std::min(1.0, (dx * ry - dy * rx) / determinant));
+        }
+
+        //Creates the window on the edge PQ of the triangle entered by w, given the corners in the frame of w (R is the third corner)
+        void addChild(uint32_t parent, uint32_t p, uint32_t q, uint32_t r, const double* P, const double* Q, const double* R, double t0, double t1)
+        {
+            const Window& w = windows[parent];
+            double ex = Q[0] - P[0], ey = Q[1] - P[1], length = std::hypot(ex, ey);
+            if(length == 0.0)
+                return;
+            ex /= length;
+            ey /= length;
+            //The Y axis of the child points away from the triangle of w
+            double nx = -ey, ny = ex;
+            if((R[0] - P[0]) * nx + (R[1] - P[1]) * ny > 0)
+            {
+                nx = -nx;
+                ny = -ny;
+            }
+            Window child;
+            child.from = p;
+            child.to = q;
+            child.face = neighbourFace(w.face, p, q);
+            child.length = length;
+            child.b0 = t0 * length;
+            child.b1 = t1 * length;
+            child.sx = (w.sx - P[0]) * ex + (w.sy - P[1]) * ey;
+            child.sy = (w.sx - P[0]) * nx + (w.sy - P[1]) * ny;
+            child.sigma = w.sigma;
+            child.pseudoSource = w.pseudoSource;
+            child.parent = parent;
+            addWindow(child, r, (R[0] - P[0]) * ex + (R[1] - P[1]) * ey, (R[0] - P[0]) * nx + (R[1] - P[1]) * ny);
+        }
+
+        //Coordinates of the point c in the frame of the edge from a to b, on the positive side of the Y axis
+        void unfold(const double* a, const double* b, const double* c, double length, double& x, double& y) const
+        {
+            double dir[3], offset[3];
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                dir[k] = (b[k] - a[k]) / length;
+                offset[k] = c[k] - a[k];
+            }
+            x = offset[0] * dir[0] + offset[1] * dir[1] + offset[2] * dir[2];
+            y = std::sqrt(std::max(0.0, offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] - x * x));
+        }
+
+        void propagateWindow(uint32_t index)
+        {
+            Window w = windows[index];
+            uint32_t c = thirdVertex(w.face, w.from, w.to);
+            double cx, cy;
+            unfold(point(w.from), point(w.to), point(c), w.length, cx, cy);
+            if(cy <= TOLERANCE * w.length)
+                return;
+            double A[2] = {0, 0}, B[2] = {w.length, 0}, C[2] = {cx, cy};
+            //Crossing of the X axis by the line from the pseudo-source to c
+            double xc = w.sx + (cx - w.sx) * (-w.sy) / (cy - w.sy);
+            if(xc >= w.b0 && xc <= w.b1)
+            {
+                updateVertex(c, w.sigma + std::hypot(cx - w.sx, cy - w.sy), index);
+                addChild(index, w.from, c, w.to, A, C, B, intersect(w.sx, w.sy, w.b0, A[0], A[1], C[0], C[1]), 1.0);
+                addChild(index, c, w.to, w.from, C, B, A, 0.0, intersect(w.sx, w.sy, w.b1, C[0], C[1], B[0], B[1]));
+            } else if(xc > w.b1)
+                addChild(index, w.from, c, w.to, A, C, B, intersect(w.sx, w.sy, w.b0, A[0], A[1], C[0], C[1]),
+                         intersect(w.sx, w.sy, w.b1, A[0], A[1], C[0], C[1]));
+            else
+                addChild(index, c, w.to, w.from, C, B, A, intersect(w.sx, w.sy, w.b0, C[0], C[1], B[0], B[1]),
+                         intersect(w.sx, w.sy, w.b1, C[0], C[1], B[0], B[1]));
+        }
+
+        //Windows generated by a pseudo-source on the edges opposite to it
+        void propagateVertex(uint32_t local)
+        {
+            uint32_t v = regionVertices[local];
+            for(uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+            {
+                uint32_t f = vertexTriangles[i];
+                if(!inRegion(f))
+                    continue;
+                const uint32_t* t = face(f);
+                unsigned int j = t[0] == v ? 0 : (t[1] == v ? 1 : 2);
+                Window w;
+                w.from = t[(j + 1) % 3];
+                w.to = t[(j + 2) % 3];
+                w.face = neighbourFace(f, w.from, w.to);
+                w.length = distance(point(w.from), point(w.to));
+                if(w.length == 0.0)
+                    continue;
+                w.b0 = 0;
+                w.b1 = w.length;
+                unfold(point(w.from), point(w.to), point(v), w.length, w.sx, w.sy);
+                w.sy = -w.sy;
+                w.sigma = distances[local];
+                w.pseudoSource = v;
+                w.parent = NONE;
+                addWindow(w, NONE, 0, 0);
+            }
+        }
+
+        //Returns false if the search has been stopped by the bound on the number of windows
+        bool propagate(uint32_t source, uint32_t target, std::size_t maxWindows)
+        {
+            uint32_t localSource = localVertex(source), localTarget = localVertex(target);
+            distances[localSource] = 0;
+            events.push({0.0, localSource, true});
+            while(!events.empty())
+            {
+                Event event = events.top();
+                events.pop();
+                if(event.key >= distances[localTarget])
+                    return true;
+                if(windows.size() > maxWindows)
+                    return false;
+                if(event.vertex)
+                {
+                    if(event.key == distances[event.index])
+                        propagateVertex(event.index);
+                } else
+                    propagateWindow(event.index);
+            }
+            return true;
+        }
+
+        //Follows the windows back from the target: each chain of windows is crossed by a straight line from its pseudo-source
+        void tracePath(uint32_t source, uint32_t target, std::vector<double>& path) const
+        {
+            std::vector<double> reversed(point(target), point(target) + 3);
+            uint32_t v = target;
+            for(std::size_t steps = 0; v != source && steps < regionVertices.size(); steps++)
+            {
+                double q[3] = {point(v)[0], point(v)[1], point(v)[2]};
+                uint32_t index = parents[localVertex(v)];
+                if(index == NONE)
+                    break;
+                while(true)
+                {
+                    const Window& w = windows[index];
+                    double qx, qy;
+                    unfold(point(w.from), point(w.to), q, w.length, qx, qy);
+                    if(qy > TOLERANCE * w.length)
+                    {
+                        double x = std::max(w.b0, std::min(w.b1, w.sx + (qx - w.sx) * (-w.sy) / (qy - w.sy)));
+                        for(unsigned int k = 0; k < 3; k++)
+                            q[k] = point(w.from)[k] + (point(w.to)[k] - point(w.from)[k]) * x / w.length;
+                        reversed.insert(reversed.end(), q, q + 3);
+                    }
+                    if(w.parent == NONE)
+                        break;
+                    index = w.parent;
+                }
+                v = windows[index].pseudoSource;
+                reversed.insert(reversed.end(), point(v), point(v) + 3);
+            }
+            for(std::size_t i = reversed.size() / 3; i-- > 0;)
+                path.insert(path.end(), &reversed[i * 3], &reversed[i * 3] + 3);
+        }
+    };
+
+}
+
+struct GeodesicSolver::PathWorkspace
+{
+    WindowPropagation propagation;
+
+    PathWorkspace(const GeodesicSolver& solver) :
+        propagation(solver.coordinates, solver.faces, solver.vertexTrianglesOffsets, solver.vertexTriangles) {}
+};
+
+GeodesicSolver::GeodesicSolver() = default;
+
+GeodesicSolver::GeodesicSolver(const double *coordinates, std::size_t verticesNumber, const unsigned int *faces, std::size_t trianglesNumber)
+{
+    build(coordinates, verticesNumber, faces, trianglesNumber);
+}
+
+GeodesicSolver::~GeodesicSolver() = default;
+
+void GeodesicSolver::build(const double *coordinates, std::size_t verticesNumber, const unsigned int *faces, std::size_t trianglesNumber)
+{
+    std::lock_guard<std::mutex> lock(heatMutex);
+    heatSystems = nullptr;
+    this->coordinates.assign(coordinates, coordinates + verticesNumber * 3);
+    this->faces.assign(faces, faces + trianglesNumber * 3);
+
+    vertexTrianglesOffsets.assign(verticesNumber + 1, 0);
+    for(std::size_t i = 0; i < trianglesNumber * 3; i++)
+        vertexTrianglesOffsets[faces[i] + 1]++;
+    for(std::size_t i = 0; i < verticesNumber; i++)
+        vertexTrianglesOffsets[i + 1] += vertexTrianglesOffsets[i];
+    vertexTriangles.resize(trianglesNumber * 3);
+    std::vector<uint32_t> fill(vertexTrianglesOffsets.begin(), vertexTrianglesOffsets.end() - 1);
+    for(std::size_t i = 0; i < trianglesNumber * 3; i++)
+        vertexTriangles[fill[faces[i]]++] = static_cast<uint32_t>(i / 3);
+
+    double total = 0;
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+        for(unsigned int j = 0; j < 3; j++)
+            total += distance(&coordinates[faces[i * 3 + j] * std::size_t(3)], &coordinates[faces[i * 3 + (j + 1) % 3] * std::size_t(3)]);
+    meanEdgeLength = trianglesNumber > 0 ? total / (trianglesNumber * 3) : 0;
+}
+
+std::size_t GeodesicSolver::getVerticesNumber() const
+{
+    return coordinates.size() / 3;
+}
+
+void GeodesicSolver::fastMarching(const std::vector<uint32_t> &sources, double *distances, double maxDistance) const
+{
+    enum State : unsigned char {FAR, TRIAL, ALIVE};
+    std::size_t verticesNumber = getVerticesNumber();
+    std::vector<unsigned char> states(verticesNumber, FAR);
+    std::fill(distances, distances + verticesNumber, std::numeric_limits<double>::infinity());
+    IndexedHeap front(verticesNumber);
+    for(uint32_t source : sources)
+    {
+        if(source >= verticesNumber)
+            continue;
+        distances[source] = 0;
+        states[source] = TRIAL;
+        front.push(source, 0);
+    }
+
+    while(!front.empty())
+    {
+        if(front.topKey() > maxDistance)
+            break;
+        uint32_t v = front.pop();
+        states[v] = ALIVE;
+        const double* pv = &coordinates[v * std::size_t(3)];
+        for(uint32_t i = vertexTrianglesOffsets[v]; i < vertexTrianglesOffsets[v + 1]; i++)
+        {
+            const uint32_t* face = &faces[vertexTriangles[i] * std::size_t(3)];
+            for(unsigned int j = 0; j < 3; j++)
+            {
+                uint32_t updated = face[j];
+                if(updated == v || states[updated] == ALIVE)
+                    continue;
+                //The third corner contributes to the update only if its distance is final
+                uint32_t other = face[0] == v || face[0] == updated ? (face[1] == v || face[1] == updated ? face[2] : face[1]) : face[0];
+                const double* pu = &coordinates[updated * std::size_t(3)];
+                double candidate = states[other] == ALIVE ?
+                            triangleUpdate(pv, &coordinates[other * std::size_t(3)], pu, distances[v], distances[other]) :
+                            distances[v] + distance(pv, pu);
+                if(candidate < distances[updated])
+                {
+                    distances[updated] = candidate;
+                    states[updated] = TRIAL;
+                    front.push(updated, candidate);
+                }
+            }
+        }
+    }
+
+    //Tentative distances left in the front exceed maxDistance
+    for(std::size_t i = 0; i < verticesNumber; i++)
+        if(states[i] != ALIVE)
+            distances[i] = std::numeric_limits<double>::infinity();
+}
+
+std::shared_ptr<GeodesicSolver::HeatSystems> GeodesicSolver::getHeatSystems()
+{
+    std::lock_guard<std::mutex> lock(heatMutex);
+    if(heatSystems != nullptr)
+        return heatSystems;
+
+    std::size_t verticesNumber = getVerticesNumber(), trianglesNumber = faces.size() / 3;
+    std::shared_ptr<HeatSystems> systems = std::make_shared<HeatSystems>();
+    systems->cotangents.assign(trianglesNumber * 3, 0.0);
+    std::vector<Eigen::Triplet<double> > laplacianEntries;
+    laplacianEntries.reserve(trianglesNumber * 12);
+    Eigen::VectorXd masses = Eigen::VectorXd::Zero(static_cast<Eigen::Index>(verticesNumber));
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        const uint32_t* face = &faces[i * 3];
+        const double* p[3] = {&coordinates[face[0] * std::size_t(3)], &coordinates[face[1] * std::size_t(3)], &coordinates[face[2] * std::size_t(3)]};
+        double doubleArea = 0;
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            //Angle at the j-th corner, between the edges towards the other two
+            const double* a = p[j], *b = p[(j + 1) % 3], *c = p[(j + 2) % 3];
+            double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, w[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            double cross[3] = {u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0]};
+            doubleArea = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+            if(doubleArea > 0)
+                systems->cotangents[i * 3 + j] = (u[0] * w[0] + u[1] * w[1] + u[2] * w[2]) / doubleArea;
+        }
+        if(!(doubleArea > 0))
+            continue;
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            //The cotangent of the angle at the j-th corner weights the opposite edge
+            double weight = 0.5 * systems->cotangents[i * 3 + j];
+            Eigen::Index a = face[(j + 1) % 3], b = face[(j + 2) % 3];
+            laplacianEntries.emplace_back(a, b, -weight);
+            laplacianEntries.emplace_back(b, a, -weight);
+            laplacianEntries.emplace_back(a, a, weight);
+            laplacianEntries.emplace_back(b, b, weight);
+            masses[face[j]] += doubleArea / 6;
+        }
+    }
+
+    //Vertices used by no triangle (or only by degenerate ones) would leave empty rows, making both systems singular: they get a unit
+    //diagonal, which decouples them from the rest of the mesh
+    for(Eigen::Index i = 0; i < masses.size(); i++)
+        if(!(masses[i] > 0))
+        {
+            masses[i] = 1;
+            laplacianEntries.emplace_back(i, i, 1.0);
+        }
+    Eigen::SparseMatrix<double> laplacian(static_cast<Eigen::Index>(verticesNumber), static_cast<Eigen::Index>(verticesNumber));
+    laplacian.setFromTriplets(laplacianEntries.begin(), laplacianEntries.end());
+    Eigen::SparseMatrix<double> mass(laplacian.rows(), laplacian.cols());
+    std::vector<Eigen::Triplet<double> > massEntries;
+    massEntries.reserve(verticesNumber);
+    for(Eigen::Index i = 0; i < masses.size(); i++)
+        massEntries.emplace_back(i, i, masses[i]);
+    mass.setFromTriplets(massEntries.begin(), massEntries.end());
+
+    double time = HEAT_TIME_FACTOR * meanEdgeLength * meanEdgeLength;
+    systems->heat.compute(mass + time * laplacian);
+    //The laplacian is singular (constants are in its kernel): a tiny multiple of the mass matrix makes it definite
+    systems->poisson.compute(laplacian + (1e-8 / std::max(time, std::numeric_limits<double>::min())) * mass);
+    systems->valid = systems->heat.info() == Eigen::Success && systems->poisson.info() == Eigen::Success;
+    heatSystems = systems;
+    return systems;
+}
+
+bool GeodesicSolver::heatMethod(const std::vector<uint32_t> &sources, double *distances, ThreadPool *pool)
+{
+    std::size_t verticesNumber = getVerticesNumber(), trianglesNumber = faces.size() / 3;
+    std::fill(distances, distances + verticesNumber, std::numeric_limits<double>::infinity());
+    std::vector<uint32_t> validSources;
+    for(uint32_t source : sources)
+        if(source < verticesNumber)
+            validSources.push_back(source);
+    if(validSources.empty())
+        return true;
+    std::shared_ptr<HeatSystems> systems = getHeatSystems();
+    if(!systems->valid)
+        return false;
+    if(pool == nullptr)
+        pool = &ThreadPool::getDefault();
+
+    //Heat flow from the sources
+    Eigen::VectorXd heat = Eigen::VectorXd::Zero(static_cast<Eigen::Index>(verticesNumber));
+    for(uint32_t source : validSources)
+        heat[source] = 1.0;
+    Eigen::VectorXd u = systems->heat.solve(heat);
+
+    //Normalised (negated) gradient of the heat on each triangle, pointing away from the sources
+    std::vector<double> field(trianglesNumber * 3, 0.0);
+    pool->parallelFor(0, trianglesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t i = begin; i < end; i++)
+        {
+            const uint32_t* face = &faces[i * 3];
+            const double* p[3] = {&coordinates[face[0] * std::size_t(3)], &coordinates[face[1] * std::size_t(3)], &coordinates[face[2] * std::size_t(3)]};
+            double e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+            double e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+            double normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            double doubleArea = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if(!(doubleArea > 0))
+                continue;
+            for(double& c : normal)
+                c /= doubleArea;
+            //Gradient = sum over the corners of u * (N x opposite edge) / (2 * area)
+            double gradient[3] = {0, 0, 0};
+            for(unsigned int j = 0; j < 3; j++)
+            {
+                const double* a = p[(j + 1) % 3], *b = p[(j + 2) % 3];
+                double edge[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                double rotated[3] = {normal[1] * edge[2] - normal[2] * edge[1], normal[2] * edge[0] - normal[0] * edge[2], normal[0] * edge[1] - normal[1] * edge[0]};
+                double value = u[face[j]];
+                for(unsigned int k = 0; k < 3; k++)
+                    gradient[k] += value * rotated[k];
+            }
+            double length = std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+            if(length > 0)
+                for(unsigned int k = 0; k < 3; k++)
+                    field[i * 3 + k] = -gradient[k] / length;
+        }
+    });
+
+    //Divergence of the field at each vertex, gathered from its triangles
+    Eigen::VectorXd divergence(static_cast<Eigen::Index>(verticesNumber));
+    pool->parallelFor(0, verticesNumber, [&](std::size_t begin, std::size_t end, unsigned int)
+    {
+        for(std::size_t v = begin; v < end; v++)
+        {
+            double sum = 0;
+            const double* pv = &coordinates[v * 3];
+            for(uint32_t i = vertexTrianglesOffsets[v]; i < vertexTrianglesOffsets[v + 1]; i++)
+            {
+                uint32_t t = vertexTriangles[i];
+                const uint32_t* face = &faces[t * std::size_t(3)];
+                unsigned int j = face[0] == v ? 0 : (face[1] == v ? 1 : 2);
+                uint32_t b = face[(j + 1) % 3], c = face[(j + 2) % 3];
+                const double* pb = &coordinates[b * std::size_t(3)], *pc = &coordinates[c * std::size_t(3)];
+                const double* x = &field[t * std::size_t(3)];
+                //Edge towards b is opposite to the corner c, edge towards c is opposite to the corner b
+                double toB = (pb[0] - pv[0]) * x[0] + (pb[1] - pv[1]) * x[1] + (pb[2] - pv[2]) * x[2];
+                double toC = (pc[0] - pv[0]) * x[0] + (pc[1] - pv[1]) * x[1] + (pc[2] - pv[2]) * x[2];
+                sum += systems->cotangents[t * 3 + (j + 2) % 3] * toB + systems->cotangents[t * 3 + (j + 1) % 3] * toC;
+            }
+            divergence[static_cast<Eigen::Index>(v)] = 0.5 * sum;
+        }
+    });
+
+    //Vertices not connected to any source receive no heat, and keep an infinite distance
+    std::vector<unsigned char> reached(verticesNumber, 0);
+    std::vector<uint32_t> stack(validSources);
+    for(uint32_t source : validSources)
+        reached[source] = 1;
+    while(!stack.empty())
+    {
+        uint32_t v = stack.back();
+        stack.pop_back();
+        for(uint32_t i = vertexTrianglesOffsets[v]; i < vertexTrianglesOffsets[v + 1]; i++)
+            for(unsigned int j = 0; j < 3; j++)
+            {
+                uint32_t w = faces[vertexTriangles[i] * std::size_t(3) + j];
+                if(!reached[w])
+                {
+                    reached[w] = 1;
+                    stack.push_back(w);
+                }
+            }
+    }
+
+    //The distance solves Delta phi = divergence, up to a constant (L, positive semi-definite, is minus the Laplace-Beltrami operator)
+    Eigen::VectorXd phi = systems->poisson.solve(-divergence);
+    //Sources used by no triangle are decoupled from the mesh: they are at distance 0, but they do not contribute to the shift
+    double shift = 0;
+    std::size_t shiftSources = 0;
+    for(uint32_t source : validSources)
+        if(vertexTrianglesOffsets[source] < vertexTrianglesOffsets[source + 1])
+        {
+            shift += phi[source];
+            shiftSources++;
+        }
+    if(shiftSources > 0)
+        shift /= shiftSources;
+    for(std::size_t v = 0; v < verticesNumber; v++)
+        if(reached[v])
+            distances[v] = vertexTrianglesOffsets[v] < vertexTrianglesOffsets[v + 1] ? std::max(0.0, phi[static_cast<Eigen::Index>(v)] - shift) : 0.0;
+    return true;
+}
+
+double GeodesicSolver::computeGeodesicPath(uint32_t source, uint32_t target, std::vector<double> &path, std::size_t maxTriangles, bool *exact) const
+{
+    path.clear();
+    bool isExact = false;
+    double length = std::numeric_limits<double>::infinity();
+    if(source < getVerticesNumber() && target < getVerticesNumber())
+    {
+        std::unique_ptr<PathWorkspace> workspace = acquireWorkspace();
+        length = workspace->propagation.run(source, target, path, maxTriangles, isExact);
+        releaseWorkspace(std::move(workspace));
+    }
+    if(exact != nullptr)
+        *exact = isExact;
+    return length;
+}
+
+std::unique_ptr<GeodesicSolver::PathWorkspace> GeodesicSolver::acquireWorkspace() const
+{
+    std::lock_guard<std::mutex> lock(workspacesMutex);
+    if(idleWorkspaces.empty())
+        return std::make_unique<PathWorkspace>(*this);
+    std::unique_ptr<PathWorkspace> workspace = std::move(idleWorkspaces.back());
+    idleWorkspaces.pop_back();
+    return workspace;
+}
+
+void GeodesicSolver::releaseWorkspace(std::unique_ptr<PathWorkspace> workspace) const
+{
+    std::lock_guard<std::mutex> lock(workspacesMutex);
+    idleWorkspaces.push_back(std::move(workspace));
+}
+
+double GeodesicSolver::cornerAngle(uint32_t face, uint32_t vertex, uint32_t &next, uint32_t &previous) const
+{
+    const uint32_t* t = &faces[face * std::size_t(3)];
+    unsigned int j = t[0] == vertex ? 0 : (t[1] == vertex ? 1 : 2);
+    next = t[(j + 1) % 3];
+    previous = t[(j + 2) % 3];
+    double u[3], w[3], normal[3];
+    subtract(&coordinates[next * std::size_t(3)], &coordinates[vertex * std::size_t(3)], u);
+    subtract(&coordinates[previous * std::size_t(3)], &coordinates[vertex * std::size_t(3)], w);
+    cross(u, w, normal);
+    return std::atan2(std::sqrt(dot(normal, normal)), dot(u, w));
+}
+
+uint32_t GeodesicSolver::searchFaceAroundVertex(uint32_t vertex, const double *direction) const
+{
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    const double* v = &coordinates[vertex * std::size_t(3)];
+    uint32_t best = NONE;
+    double bestAlignment = -std::numeric_limits<double>::max();
+    bool boundary = false;
+    for(uint32_t i = vertexTrianglesOffsets[vertex]; i < vertexTrianglesOffsets[vertex + 1]; i++)
+    {
+        uint32_t f = vertexTriangles[i], next, previous;
+        cornerAngle(f, vertex, next, previous);
+        boundary = boundary || neighbourFace(faces, vertexTrianglesOffsets, vertexTriangles, f, vertex, next) == NONE;
+        double u[3], w[3], normal[3], projected[3], side[3];
+        subtract(&coordinates[next * std::size_t(3)], v, u);
+        subtract(&coordinates[previous * std::size_t(3)], v, w);
+        cross(u, w, normal);
+        if(normalise(normal) == 0.0)
+            continue;
+        double offset = dot(direction, normal);
+        for(unsigned int k = 0; k < 3; k++)
+            projected[k] = direction[k] - offset * normal[k];
+        //Inside the corner if it lies between u and w
+        cross(u, projected, side);
+        double first = dot(side, normal);
+        cross(projected, w, side);
+        double second = dot(side, normal);
+        if(first >= 0 && second >= 0)
+            return f;
+        //If no corner contains it (because of rounding), the triangle whose bisector is the closest to the direction is chosen
+        normalise(u);
+        normalise(w);
+        double bisector[3] = {u[0] + w[0], u[1] + w[1], u[2] + w[2]};
+        normalise(bisector);
+        normalise(projected);
+        if(dot(bisector, projected) > bestAlignment)
+        {
+            bestAlignment = dot(bisector, projected);
+            best = f;
+        }
+    }
+    //On the boundary, the direction may point outside the mesh
+    return boundary ? NONE : best;
+}
+
+uint32_t GeodesicSolver::straightestDirection(uint32_t vertex, uint32_t face, double *direction) const
+{
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    const double* v = &coordinates[vertex * std::size_t(3)];
+
+    //Total angle around the vertex, walking from face across the edges; vertices on the boundary have no straightest continuation
+    double total = 0;
+    uint32_t f = face, next, previous;
+    std::size_t valence = vertexTrianglesOffsets[vertex + 1] - vertexTrianglesOffsets[vertex];
+    for(std::size_t i = 0; i < valence; i++)
+    {
+        total += cornerAngle(f, vertex, next, previous);
+        f = neighbourFace(faces, vertexTrianglesOffsets, vertexTriangles, f, vertex, previous);
+        if(f == NONE)
+            return NONE;
+        if(f == face)
+            break;
+    }
+    if(f != face)
+        return NONE;
+
+    //Walking around the vertex from the incoming path (reversed), the outgoing one is at half the total angle
+    auto rotate = [&](const double* from, const double* towards, double angle, double* result)
+    {
+        double u[3] = {from[0], from[1], from[2]}, w[3] = {towards[0], towards[1], towards[2]};
+        normalise(u);
+        double offset = dot(w, u);
+        for(unsigned int k = 0; k < 3; k++)
+            w[k] -= offset * u[k];
+        normalise(w);
+        for(unsigned int k = 0; k < 3; k++)
+            result[k] = std::cos(angle) * u[k] + std::sin(angle) * w[k];
+    };
+    double half = total / 2;
+    double incoming[3] = {-direction[0], -direction[1], -direction[2]};
+    cornerAngle(face, vertex, next, previous);
+    double edge[3];
+    subtract(&coordinates[previous * std::size_t(3)], v, edge);
+    double u[3] = {incoming[0], incoming[1], incoming[2]};
+    normalise(u);
+    double w[3] = {edge[0], edge[1], edge[2]};
+    normalise(w);
+    double walked = std::acos(std::max(-1.0, std::min(1.0, dot(u, w))));
+    if(walked >= half)
+    {
+        rotate(incoming, edge, half, direction);
+        return face;
+    }
+    f = face;
+    for(std::size_t i = 0; i < valence; i++)
+    {
+        uint32_t entering = previous;
+        f = neighbourFace(faces, vertexTrianglesOffsets, vertexTriangles, f, vertex, entering);
+        double angle = cornerAngle(f, vertex, next, previous);
+        //The corner is entered through the edge towards the vertex shared with the previous triangle
+        uint32_t leaving = next == entering ? previous : next;
+        if(walked + angle >= half || i + 1 == valence)
+        {
+            double from[3], towards[3];
+            subtract(&coordinates[entering * std::size_t(3)], v, from);
+            subtract(&coordinates[leaving * std::size_t(3)], v, towards);
+            rotate(from, towards, std::max(0.0, std::min(angle, half - walked)), direction);
+            return f;
+        }
+        walked += angle;
+        previous = leaving;
+    }
+    return NONE;
+}
+
+double GeodesicSolver::traceStraightestGeodesic(uint32_t face, const double *barycentric, const double *direction, double length, std::vector<double> &path,
+                                                std::vector<uint32_t> *crossedFaces) const
+{
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    const double TOLERANCE = 1e-9;
+    path.clear();
+    if(crossedFaces != nullptr)
+        crossedFaces->clear();
+    if(face >= faces.size() / 3)
+        return 0;
+
+    const uint32_t* corners = &faces[face * std::size_t(3)];
+    double p[3] = {0, 0, 0}, d[3] = {direction[0], direction[1], direction[2]};
+    uint32_t atVertex = NONE;
+    for(unsigned int j = 0; j < 3; j++)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+            p[k] += barycentric[j] * coordinates[corners[j] * std::size_t(3) + k];
+        if(barycentric[j] >= 1 - TOLERANCE)
+            atVertex = corners[j];
+    }
+    path.insert(path.end(), p, p + 3);
+    if(atVertex != NONE)
+    {
+        std::copy(&coordinates[atVertex * std::size_t(3)], &coordinates[atVertex * std::size_t(3)] + 3, p);
+        face = searchFaceAroundVertex(atVertex, d);
+        if(face == NONE)
+            return 0;
+    }
+
+    double remaining = length;
+    //Bound on the steps, against loops caused by degenerate triangles
+    std::size_t steps = 0, maxSteps = 4 * faces.size() + 16;
+    while(remaining > 0 && steps++ < maxSteps)
+    {
+        corners = &faces[face * std::size_t(3)];
+        const double* a = &coordinates[corners[0] * std::size_t(3)], *b = &coordinates[corners[1] * std::size_t(3)], *c = &coordinates[corners[2] * std::size_t(3)];
+        double e1[3], e2[3], normal[3];
+        subtract(b, a, e1);
+        subtract(c, a, e2);
+        cross(e1, e2, normal);
+        if(normalise(normal) == 0.0)
+            break;
+        double offset = dot(d, normal);
+        for(unsigned int k = 0; k < 3; k++)
+            d[k] -= offset * normal[k];
+        if(normalise(d) == 0.0)
+            break;
+
+        //Exit edge: the first one crossed by the ray among those it is heading out of (the ones through the current vertex are skipped)
+        double exit = std::numeric_limits<double>::max(), exitNormal[3] = {0, 0, 0};
+        int exitEdge = -1;
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            uint32_t from = corners[j], to = corners[(j + 1) % 3], opposite = corners[(j + 2) % 3];
+            if(from == atVertex || to == atVertex)
+                continue;
+            const double* pf = &coordinates[from * std::size_t(3)];
+            double edge[3], outward[3], inner[3];
+            subtract(&coordinates[to * std::size_t(3)], pf, edge);
+            cross(edge, normal, outward);
+            subtract(&coordinates[opposite * std::size_t(3)], pf, inner);
+            if(dot(outward, inner) > 0)
+                for(double& x : outward)
+                    x = -x;
+            if(normalise(outward) == 0.0)
+                continue;
+            double speed = dot(d, outward);
+            if(speed <= 0)
+                continue;
+            double toEdge[3];
+            subtract(pf, p, toEdge);
+            double t = std::max(0.0, dot(toEdge, outward) / speed);
+            if(t < exit)
+            {
+                exit = t;
+                exitEdge = static_cast<int>(j);
+                std::copy(outward, outward + 3, exitNormal);
+            }
+        }
+        if(exitEdge == -1)
+            break;
+        if(crossedFaces != nullptr)
+            crossedFaces->push_back(face);
+        if(exit >= remaining)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+                p[k] += remaining * d[k];
+            path.insert(path.end(), p, p + 3);
+            remaining = 0;
+            break;
+        }
+
+        remaining -= exit;
+        for(unsigned int k = 0; k < 3; k++)
+            p[k] += exit * d[k];
+        uint32_t from = corners[exitEdge], to = corners[(exitEdge + 1) % 3];
+        const double* pf = &coordinates[from * std::size_t(3)], *pt = &coordinates[to * std::size_t(3)];
+        double edge[3], toPoint[3];
+        subtract(pt, pf, edge);
+        subtract(p, pf, toPoint);
+        double edgeLength = normalise(edge);
+        double s = dot(toPoint, edge) / edgeLength;
+        if(s <= TOLERANCE || s >= 1 - TOLERANCE)
+        {
+            //Through a vertex
+            atVertex = s <= TOLERANCE ? from : to;
+            std::copy(&coordinates[atVertex * std::size_t(3)], &coordinates[atVertex * std::size_t(3)] + 3, p);
+            path.insert(path.end(), p, p + 3);
+            face = straightestDirection(atVertex, face, d);
+            if(face == NONE)
+                break;
+            continue;
+        }
+
+        //Across an edge: the component of the direction along the edge is kept, the one across it is rotated onto the next triangle
+        path.insert(path.end(), p, p + 3);
+        atVertex = NONE;
+        uint32_t next = neighbourFace(faces, vertexTrianglesOffsets, vertexTriangles, face, from, to);
+        if(next == NONE)
+            break;
+        const uint32_t* nextCorners = &faces[next * std::size_t(3)];
+        uint32_t opposite = nextCorners[0] != from && nextCorners[0] != to ? nextCorners[0] : (nextCorners[1] != from && nextCorners[1] != to ? nextCorners[1] : nextCorners[2]);
+        double inward[3];
+        subtract(&coordinates[opposite * std::size_t(3)], pf, inward);
+        double along = dot(inward, edge);
+        for(unsigned int k = 0; k < 3; k++)
+            inward[k] -= along * edge[k];
+        if(normalise(inward) == 0.0)
+            break;
+        double tangential = dot(d, edge), normalComponent = dot(d, exitNormal);
+        for(unsigned int k = 0; k < 3; k++)
+            d[k] = tangential * edge[k] + normalComponent * inward[k];
+        face = next;
+    }
+    return length - remaining;
+}
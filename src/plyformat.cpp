@@ -0,0 +1,219 @@
+#include "plyformat.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+using namespace SemantisedTriangleMesh;
+
+static bool isLittleEndianHost()
+{
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+int PLYElement::findProperty(const std::string &propertyName) const
+{
+    for(unsigned int i = 0; i < properties.size(); i++)
+        if(properties.at(i).name.compare(propertyName) == 0)
+            return static_cast<int>(i);
+    return -1;
+}
+
+PLYHeader::PLYHeader()
+{
+    format = PLYFormat::ASCII;
+}
+
+int PLYHeader::read(std::istream &stream)
+{
+    std::string line;
+    elements.clear();
+    comments.clear();
+    if(!std::getline(stream, line))
+        return 1;
+    if(!line.empty() && line.back() == '\r')
+        line.pop_back();
+    if(line.compare("ply") != 0)
+        return 1;
+
+    bool formatFound = false;
+    while(std::getline(stream, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        std::stringstream sstream(line);
+        std::string keyword;
+        sstream >> keyword;
+        if(keyword.compare("") == 0 || keyword.compare("obj_info") == 0)
+            continue;
+        else if(keyword.compare("comment") == 0)
+            comments.push_back(line.size() > 8 ? line.substr(8) : "");
+        else if(keyword.compare("format") == 0)
+        {
+            std::string formatName, version;
+            sstream >> formatName >> version;
+            if(formatName.compare("ascii") == 0)
+                format = PLYFormat::ASCII;
+            else if(formatName.compare("binary_little_endian") == 0)
+                format = PLYFormat::BINARY_LITTLE_ENDIAN;
+            else if(formatName.compare("binary_big_endian") == 0)
+                format = PLYFormat::BINARY_BIG_ENDIAN;
+            else
+                return 10;
+            formatFound = true;
+        } else if(keyword.compare("element") == 0)
+        {
+            PLYElement element;
+            sstream >> element.name >> element.count;
+            if(sstream.fail())
+                return 6;
+            elements.push_back(element);
+        } else if(keyword.compare("property") == 0)
+        {
+            if(elements.empty())
+                return 6;
+            PLYProperty property;
+            std::string typeName;
+            sstream >> typeName;
+            if(typeName.compare("list") == 0)
+            {
+                std::string countTypeName;
+                sstream >> countTypeName >> typeName;
+                property.isList = true;
+                property.countType = scalarTypeFromString(countTypeName);
+                if(property.countType == ScalarType::UNKNOWN)
+                    return 3;
+            }
+            property.type = scalarTypeFromString(typeName);
+            sstream >> property.name;
+            if(property.type == ScalarType::UNKNOWN || property.name.compare("") == 0)
+                return 3;
+            elements.back().properties.push_back(property);
+        } else if(keyword.compare("end_header") == 0)
+            return formatFound ? 0 : 10;
+        else
+            return 6;
+    }
+
+    return 6;
+}
+
+void PLYHeader::write(std::ostream &stream) const
+{
+    stream << "ply" << std::endl;
+    switch(format)
+    {
+        case PLYFormat::ASCII: stream << "format ascii 1.0" << std::endl; break;
+        case PLYFormat::BINARY_LITTLE_ENDIAN: stream << "format binary_little_endian 1.0" << std::endl; break;
+        case PLYFormat::BINARY_BIG_ENDIAN: stream << "format binary_big_endian 1.0" << std::endl; break;
+    }
+    for(auto comment : comments)
+        stream << "comment " << comment << std::endl;
+    for(auto element : elements)
+    {
+        stream << "element " << element.name << " " << element.count << std::endl;
+        for(auto property : element.properties)
+        {
+            stream << "property ";
+            if(property.isList)
+                stream << "list " << scalarTypeToString(property.countType) << " ";
+            stream << scalarTypeToString(property.type) << " " << property.name << std::endl;
+        }
+    }
+    stream << "end_header" << std::endl;
+}
+
+int PLYHeader::findElement(const std::string &elementName) const
+{
+    for(unsigned int i = 0; i < elements.size(); i++)
+        if(elements.at(i).name.compare(elementName) == 0)
+            return static_cast<int>(i);
+    return -1;
+}
+
+PLYValueReader::PLYValueReader(std::istream &stream, PLYFormat format) : stream(stream), format(format)
+{
+    swapBytes = (format == PLYFormat::BINARY_LITTLE_ENDIAN && !isLittleEndianHost()) ||
+                (format == PLYFormat::BINARY_BIG_ENDIAN && isLittleEndianHost());
+}
+
+bool PLYValueReader::read(ScalarType type, double &value)
+{
+    if(format == PLYFormat::ASCII)
+    {
+        stream >> value;
+        return !stream.fail();
+    }
+
+    unsigned int size = scalarTypeSize(type);
+    char buffer[8];
+    if(size == 0 || !stream.read(buffer, size))
+        return false;
+    if(swapBytes)
+        std::reverse(buffer, buffer + size);
+
+    switch(type)
+    {
+        case ScalarType::INT8: { int8_t v; std::memcpy(&v, buffer, size); value = v; break; }
+        case ScalarType::UINT8: { uint8_t v; std::memcpy(&v, buffer, size); value = v; break; }
+        case ScalarType::INT16: { int16_t v; std::memcpy(&v, buffer, size); value = v; break; }
+        case ScalarType::UINT16: { uint16_t v; std::memcpy(&v, buffer, size); value = v; break; }
+        case ScalarType::INT32: { int32_t v; std::memcpy(&v, buffer, size); value = v; break; }
+        case ScalarType::UINT32: { uint32_t v; std::memcpy(&v, buffer, size); value = v; break; }
+        case ScalarType::FLOAT32: { float v; std::memcpy(&v, buffer, size); value = static_cast<double>(v); break; }
+        case ScalarType::FLOAT64: { std::memcpy(&value, buffer, size); break; }
+        default: return false;
+    }
+    return true;
+}
+
+bool PLYValueReader::skipProperty(const PLYProperty &property)
+{
+    double value;
+    if(!property.isList)
+        return read(property.type, value);
+    if(!read(property.countType, value))
+        return false;
+    std::size_t count = static_cast<std::size_t>(value);
+    for(std::size_t i = 0; i < count; i++)
+        if(!read(property.type, value))
+            return false;
+    return true;
+}
+
+PLYValueWriter::PLYValueWriter(std::ostream &stream, PLYFormat format) : stream(stream), format(format)
+{
+    swapBytes = (format == PLYFormat::BINARY_LITTLE_ENDIAN && !isLittleEndianHost()) ||
+                (format == PLYFormat::BINARY_BIG_ENDIAN && isLittleEndianHost());
+}
+
+void PLYValueWriter::write(ScalarType type, double value)
+{
+    if(format == PLYFormat::ASCII)
+    {
+        if(type == ScalarType::FLOAT32 || type == ScalarType::FLOAT64)
+            stream << value;
+        else
+            stream << static_cast<long long>(value);
+        return;
+    }
+
+    unsigned int size = scalarTypeSize(type);
+    char buffer[8];
+    switch(type)
+    {
+        case ScalarType::INT8: { int8_t v = static_cast<int8_t>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::UINT8: { uint8_t v = static_cast<uint8_t>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::INT16: { int16_t v = static_cast<int16_t>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::UINT16: { uint16_t v = static_cast<uint16_t>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::INT32: { int32_t v = static_cast<int32_t>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::UINT32: { uint32_t v = static_cast<uint32_t>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::FLOAT32: { float v = static_cast<float>(value); std::memcpy(buffer, &v, size); break; }
+        case ScalarType::FLOAT64: { std::memcpy(buffer, &value, size); break; }
+        default: return;
+    }
+    if(swapBytes)
+        std::reverse(buffer, buffer + size);
+    stream.write(buffer, size);
+}
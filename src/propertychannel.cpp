@@ -0,0 +1,72 @@
+#include "propertychannel.hpp"
+
+using namespace SemantisedTriangleMesh;
+
+ScalarType SemantisedTriangleMesh::scalarTypeFromString(const std::string &name)
+{
+    if(name.compare("char") == 0 || name.compare("int8") == 0)
+        return ScalarType::INT8;
+    if(name.compare("uchar") == 0 || name.compare("uint8") == 0)
+        return ScalarType::UINT8;
+    if(name.compare("short") == 0 || name.compare("int16") == 0)
+        return ScalarType::INT16;
+    if(name.compare("ushort") == 0 || name.compare("uint16") == 0)
+        return ScalarType::UINT16;
+    if(name.compare("int") == 0 || name.compare("int32") == 0)
+        return ScalarType::INT32;
+    if(name.compare("uint") == 0 || name.compare("uint32") == 0)
+        return ScalarType::UINT32;
+    if(name.compare("float") == 0 || name.compare("float32") == 0)
+        return ScalarType::FLOAT32;
+    if(name.compare("double") == 0 || name.compare("float64") == 0)
+        return ScalarType::FLOAT64;
+    return ScalarType::UNKNOWN;
+}
+
+std::string SemantisedTriangleMesh::scalarTypeToString(ScalarType type)
+{
+    switch(type)
+    {
+        case ScalarType::INT8: return "char";
+        case ScalarType::UINT8: return "uchar";
+        case ScalarType::INT16: return "short";
+        case ScalarType::UINT16: return "ushort";
+        case ScalarType::INT32: return "int";
+        case ScalarType::UINT32: return "uint";
+        case ScalarType::FLOAT32: return "float";
+        case ScalarType::FLOAT64: return "double";
+        default: return "unknown";
+    }
+}
+
+unsigned int SemantisedTriangleMesh::scalarTypeSize(ScalarType type)
+{
+    switch(type)
+    {
+        case ScalarType::INT8:
+        case ScalarType::UINT8: return 1;
+        case ScalarType::INT16:
+        case ScalarType::UINT16: return 2;
+        case ScalarType::INT32:
+        case ScalarType::UINT32:
+        case ScalarType::FLOAT32: return 4;
+        case ScalarType::FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+std::shared_ptr<PropertyChannel> PropertyChannel::create(const std::string &name, ScalarType type, std::size_t size)
+{
+    switch(type)
+    {
+        case ScalarType::INT8: return std::make_shared<TypedPropertyChannel<int8_t> >(name, type, size);
+        case ScalarType::UINT8: return std::make_shared<TypedPropertyChannel<uint8_t> >(name, type, size);
+        case ScalarType::INT16: return std::make_shared<TypedPropertyChannel<int16_t> >(name, type, size);
+        case ScalarType::UINT16: return std::make_shared<TypedPropertyChannel<uint16_t> >(name, type, size);
+        case ScalarType::INT32: return std::make_shared<TypedPropertyChannel<int32_t> >(name, type, size);
+        case ScalarType::UINT32: return std::make_shared<TypedPropertyChannel<uint32_t> >(name, type, size);
+        case ScalarType::FLOAT32: return std::make_shared<TypedPropertyChannel<float> >(name, type, size);
+        case ScalarType::FLOAT64: return std::make_shared<TypedPropertyChannel<double> >(name, type, size);
+        default: return nullptr;
+    }
+}
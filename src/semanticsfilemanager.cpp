@@ -477,6 +477,8 @@ bool SemanticsFileManager::readRelationships(std::string fileName)
                 if(!(document.ParseStream(frs).HasParseError())){
                     if(document.HasMember("relationships") && document["relationships"].IsArray()){
                         rapidjson::Value& relationshipsList = document["relationships"];
+                        std::vector<std::tuple<std::shared_ptr<Annotation>, std::shared_ptr<Annotation>, std::string> > relationships;
+                        relationships.reserve(relationshipsList.Size());
                         for (rapidjson::SizeType i = 0; i < relationshipsList.Size(); i++) // rapidjson uses SizeType instead of size_t.
                         {
                             rapidjson::Value& jsonRelationship = relationshipsList[i];
@@ -496,7 +498,7 @@ bool SemanticsFileManager::readRelationships(std::string fileName)
                                 auto a2 = mesh->getAnnotation(std::stoi(n2));
 
                                 if(a1 != nullptr && a2 != nullptr)
-                                    mesh->addAnnotationsRelationship(a1, a2, type, false);
+                                    relationships.push_back(std::make_tuple(a1, a2, type));
                                 else
                                 {
                                     mesh->clearRelationships();
@@ -508,6 +510,12 @@ bool SemanticsFileManager::readRelationships(std::string fileName)
                                 return false;
                             }
                         }
+                        //All the relationships are added at once, with pooled arcs
+                        if(!mesh->addAnnotationsRelationships(relationships, false))
+                        {
+                            mesh->clearRelationships();
+                            return false;
+                        }
                     } else return false;
                 } else return false;
             } else return false;
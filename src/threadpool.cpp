@@ -0,0 +1,119 @@
+#include "threadpool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+using namespace SemantisedTriangleMesh;
+
+ThreadPool::ThreadPool(unsigned int threadsNumber)
+{
+    stopping = false;
+    if(threadsNumber == 0)
+        threadsNumber = std::max(std::thread::hardware_concurrency(), 1u);
+    for(unsigned int i = 0; i < threadsNumber; i++)
+        workers.emplace_back([this]()
+        {
+            while(true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(tasksMutex);
+                    tasksCondition.wait(lock, [this](){ return stopping || !tasks.empty(); });
+                    if(tasks.empty())
+                        return;
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksCondition.notify_all();
+    for(auto& worker : workers)
+        worker.join();
+}
+
+ThreadPool &ThreadPool::getDefault()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned int ThreadPool::getThreadsNumber() const
+{
+    return static_cast<unsigned int>(workers.size());
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.push(std::move(task));
+    }
+    tasksCondition.notify_one();
+}
+
+void ThreadPool::parallelFor(std::size_t begin, std::size_t end, const std::function<void (std::size_t, std::size_t, unsigned int)> &body, std::size_t grain)
+{
+    if(end <= begin)
+        return;
+    std::size_t length = end - begin;
+    if(grain == 0)
+        grain = std::max<std::size_t>(1, length / (4 * (workers.size() + 1)));
+    std::size_t chunksNumber = (length + grain - 1) / grain;
+    if(chunksNumber == 1 || workers.empty())
+    {
+        body(begin, end, 0);
+        return;
+    }
+
+    //Chunks are taken from a shared counter by the calling thread and by the helpers, so nobody waits for a busy worker
+    struct State
+    {
+        std::atomic<std::size_t> nextChunk{0};
+        std::atomic<std::size_t> completedChunks{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    auto work = [state, begin, end, grain, chunksNumber, &body](unsigned int slot)
+    {
+        std::size_t chunk;
+        while((chunk = state->nextChunk.fetch_add(1)) < chunksNumber)
+        {
+            std::size_t chunkBegin = begin + chunk * grain;
+            try
+            {
+                body(chunkBegin, std::min(chunkBegin + grain, end), slot);
+            } catch(...)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if(state->error == nullptr)
+                    state->error = std::current_exception();
+            }
+            if(state->completedChunks.fetch_add(1) + 1 == chunksNumber)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    unsigned int helpers = static_cast<unsigned int>(std::min<std::size_t>(workers.size(), chunksNumber - 1));
+    for(unsigned int i = 0; i < helpers; i++)
+        enqueue([work, i](){ work(i + 1); });
+    work(0);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state, chunksNumber](){ return state->completedChunks.load() == chunksNumber; });
+    if(state->error != nullptr)
+        std::rethrow_exception(state->error);
+}
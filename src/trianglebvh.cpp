@@ -0,0 +1,587 @@
+#include "trianglebvh.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace SemantisedTriangleMesh;
+
+//Squared distance between a point and the closest point of a box
+template <class Node>
+static inline double boxSquaredDistance(const Node& node, const double* point)
+{
+    double d = 0;
+    for(unsigned int i = 0; i < 3; i++)
+    {
+        double delta = std::max(std::max(node.min[i] - point[i], point[i] - node.max[i]), 0.0);
+        d += delta * delta;
+    }
+    return d;
+}
+
+//Half of the surface area of a box
+static inline double halfArea(const double* min, const double* max)
+{
+    double dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+    if(dx < 0 || dy < 0 || dz < 0)
+        return 0;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/**
+ * Closest point of the triangle (a, b, c) to p, expressed by its barycentric coordinates (from Ericson, Real-Time Collision Detection)
+ */
+static inline void closestPointOnTriangle(const double* p, const double* a, const double* b, const double* c, double* barycentric)
+{
+    double ab[3], ac[3], ap[3], bp[3], cp[3];
+    for(unsigned int i = 0; i < 3; i++)
+    {
+        ab[i] = b[i] - a[i];
+        ac[i] = c[i] - a[i];
+        ap[i] = p[i] - a[i];
+        bp[i] = p[i] - b[i];
+        cp[i] = p[i] - c[i];
+    }
+    auto dot = [](const double* u, const double* v){ return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; };
+
+    double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if(d1 <= 0 && d2 <= 0)
+    {
+        barycentric[0] = 1; barycentric[1] = 0; barycentric[2] = 0;
+        return;
+    }
+    double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if(d3 >= 0 && d4 <= d3)
+    {
+        barycentric[0] = 0; barycentric[1] = 1; barycentric[2] = 0;
+        return;
+    }
+    double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0 && d1 >= 0 && d3 <= 0)
+    {
+        double v = d1 / (d1 - d3);
+        barycentric[0] = 1 - v; barycentric[1] = v; barycentric[2] = 0;
+        return;
+    }
+    double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if(d6 >= 0 && d5 <= d6)
+    {
+        barycentric[0] = 0; barycentric[1] = 0; barycentric[2] = 1;
+        return;
+    }
+    double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0 && d2 >= 0 && d6 <= 0)
+    {
+        double w = d2 / (d2 - d6);
+        barycentric[0] = 1 - w; barycentric[1] = 0; barycentric[2] = w;
+        return;
+    }
+    double va = d3 * d6 - d5 * d4;
+    if(va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+    {
+        double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        barycentric[0] = 0; barycentric[1] = 1 - w; barycentric[2] = w;
+        return;
+    }
+    double sum = va + vb + vc;
+    if(sum <= 0)
+    {
+        //Degenerate triangle: the point falls on one of its (coincident) corners
+        barycentric[0] = 1; barycentric[1] = 0; barycentric[2] = 0;
+        return;
+    }
+    double v = vb / sum, w = vc / sum;
+    barycentric[0] = 1 - v - w; barycentric[1] = v; barycentric[2] = w;
+}
+
+/**
+ * Parameter of the entry point of a ray into a box, false if the ray misses the box within [tMin, tMax]
+ */
+template <class Node>
+static inline bool rayBox(const Node& node, const double* origin, const double* direction, const double* inverse, double tMin, double tMax,
+                          double& entry)
+{
+    for(unsigned int i = 0; i < 3; i++)
+    {
+        if(direction[i] == 0)
+        {
+            if(origin[i] < node.min[i] || origin[i] > node.max[i])
+                return false;
+            continue;
+        }
+        double t1 = (node.min[i] - origin[i]) * inverse[i];
+        double t2 = (node.max[i] - origin[i]) * inverse[i];
+        tMin = std::max(tMin, std::min(t1, t2));
+        tMax = std::min(tMax, std::max(t1, t2));
+        if(tMin > tMax)
+            return false;
+    }
+    entry = tMin;
+    return true;
+}
+
+/**
+ * Möller-Trumbore intersection between a ray and count triangles stored as separate coordinate arrays, several triangles at once when SIMD
+ * instructions are available. Missed triangles get an infinite parameter: degenerate and parallel cases produce non-finite values that fail
+ * the (ordered) comparisons, so they need no special handling.
+ */
+static inline void intersectTriangles(const double* const* corners, std::size_t count, const double* origin, const double* direction,
+                                      double tMin, double tMax, double* ts, double* us, double* vs)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double *ax = corners[0], *ay = corners[1], *az = corners[2], *bx = corners[3], *by = corners[4], *bz = corners[5];
+    const double *cx = corners[6], *cy = corners[7], *cz = corners[8];
+    std::size_t i = 0;
+#if defined(__AVX__)
+    const __m256d ox = _mm256_set1_pd(origin[0]), oy = _mm256_set1_pd(origin[1]), oz = _mm256_set1_pd(origin[2]);
+    const __m256d dx = _mm256_set1_pd(direction[0]), dy = _mm256_set1_pd(direction[1]), dz = _mm256_set1_pd(direction[2]);
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0), inf = _mm256_set1_pd(infinity);
+    const __m256d lower = _mm256_set1_pd(tMin), upper = _mm256_set1_pd(tMax);
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256d vax = _mm256_loadu_pd(ax + i), vay = _mm256_loadu_pd(ay + i), vaz = _mm256_loadu_pd(az + i);
+        __m256d e1x = _mm256_sub_pd(_mm256_loadu_pd(bx + i), vax), e1y = _mm256_sub_pd(_mm256_loadu_pd(by + i), vay);
+        __m256d e1z = _mm256_sub_pd(_mm256_loadu_pd(bz + i), vaz);
+        __m256d e2x = _mm256_sub_pd(_mm256_loadu_pd(cx + i), vax), e2y = _mm256_sub_pd(_mm256_loadu_pd(cy + i), vay);
+        __m256d e2z = _mm256_sub_pd(_mm256_loadu_pd(cz + i), vaz);
+        __m256d px = _mm256_sub_pd(_mm256_mul_pd(dy, e2z), _mm256_mul_pd(dz, e2y));
+        __m256d py = _mm256_sub_pd(_mm256_mul_pd(dz, e2x), _mm256_mul_pd(dx, e2z));
+        __m256d pz = _mm256_sub_pd(_mm256_mul_pd(dx, e2y), _mm256_mul_pd(dy, e2x));
+        __m256d det = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e1x, px), _mm256_mul_pd(e1y, py)), _mm256_mul_pd(e1z, pz));
+        __m256d inverse = _mm256_div_pd(one, det);
+        __m256d sx = _mm256_sub_pd(ox, vax), sy = _mm256_sub_pd(oy, vay), sz = _mm256_sub_pd(oz, vaz);
+        __m256d u = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(sx, px), _mm256_mul_pd(sy, py)), _mm256_mul_pd(sz, pz)), inverse);
+        __m256d qx = _mm256_sub_pd(_mm256_mul_pd(sy, e1z), _mm256_mul_pd(sz, e1y));
+        __m256d qy = _mm256_sub_pd(_mm256_mul_pd(sz, e1x), _mm256_mul_pd(sx, e1z));
+        __m256d qz = _mm256_sub_pd(_mm256_mul_pd(sx, e1y), _mm256_mul_pd(sy, e1x));
+        __m256d v = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, qx), _mm256_mul_pd(dy, qy)), _mm256_mul_pd(dz, qz)), inverse);
+        __m256d t = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e2x, qx), _mm256_mul_pd(e2y, qy)), _mm256_mul_pd(e2z, qz)), inverse);
+        __m256d mask = _mm256_and_pd(_mm256_cmp_pd(u, zero, _CMP_GE_OQ), _mm256_cmp_pd(v, zero, _CMP_GE_OQ));
+        mask = _mm256_and_pd(mask, _mm256_cmp_pd(_mm256_add_pd(u, v), one, _CMP_LE_OQ));
+        mask = _mm256_and_pd(mask, _mm256_and_pd(_mm256_cmp_pd(t, lower, _CMP_GE_OQ), _mm256_cmp_pd(t, upper, _CMP_LE_OQ)));
+        _mm256_storeu_pd(ts + i, _mm256_blendv_pd(inf, t, mask));
+        _mm256_storeu_pd(us + i, u);
+        _mm256_storeu_pd(vs + i, v);
+    }
+#elif defined(__SSE2__)
+    const __m128d ox = _mm_set1_pd(origin[0]), oy = _mm_set1_pd(origin[1]), oz = _mm_set1_pd(origin[2]);
+    const __m128d dx = _mm_set1_pd(direction[0]), dy = _mm_set1_pd(direction[1]), dz = _mm_set1_pd(direction[2]);
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0), inf = _mm_set1_pd(infinity);
+    const __m128d lower = _mm_set1_pd(tMin), upper = _mm_set1_pd(tMax);
+    for(; i + 2 <= count; i += 2)
+    {
+        __m128d vax = _mm_loadu_pd(ax + i), vay = _mm_loadu_pd(ay + i), vaz = _mm_loadu_pd(az + i);
+        __m128d e1x = _mm_sub_pd(_mm_loadu_pd(bx + i), vax), e1y = _mm_sub_pd(_mm_loadu_pd(by + i), vay);
+        __m128d e1z = _mm_sub_pd(_mm_loadu_pd(bz + i), vaz);
+        __m128d e2x = _mm_sub_pd(_mm_loadu_pd(cx + i), vax), e2y = _mm_sub_pd(_mm_loadu_pd(cy + i), vay);
+        __m128d e2z = _mm_sub_pd(_mm_loadu_pd(cz + i), vaz);
+        __m128d px = _mm_sub_pd(_mm_mul_pd(dy, e2z), _mm_mul_pd(dz, e2y));
+        __m128d py = _mm_sub_pd(_mm_mul_pd(dz, e2x), _mm_mul_pd(dx, e2z));
+        __m128d pz = _mm_sub_pd(_mm_mul_pd(dx, e2y), _mm_mul_pd(dy, e2x));
+        __m128d det = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e1x, px), _mm_mul_pd(e1y, py)), _mm_mul_pd(e1z, pz));
+        __m128d inverse = _mm_div_pd(one, det);
+        __m128d sx = _mm_sub_pd(ox, vax), sy = _mm_sub_pd(oy, vay), sz = _mm_sub_pd(oz, vaz);
+        __m128d u = _mm_mul_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(sx, px), _mm_mul_pd(sy, py)), _mm_mul_pd(sz, pz)), inverse);
+        __m128d qx = _mm_sub_pd(_mm_mul_pd(sy, e1z), _mm_mul_pd(sz, e1y));
+        __m128d qy = _mm_sub_pd(_mm_mul_pd(sz, e1x), _mm_mul_pd(sx, e1z));
+        __m128d qz = _mm_sub_pd(_mm_mul_pd(sx, e1y), _mm_mul_pd(sy, e1x));
+        __m128d v = _mm_mul_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, qx), _mm_mul_pd(dy, qy)), _mm_mul_pd(dz, qz)), inverse);
+        __m128d t = _mm_mul_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(e2x, qx), _mm_mul_pd(e2y, qy)), _mm_mul_pd(e2z, qz)), inverse);
+        __m128d mask = _mm_and_pd(_mm_cmpge_pd(u, zero), _mm_cmpge_pd(v, zero));
+        mask = _mm_and_pd(mask, _mm_cmple_pd(_mm_add_pd(u, v), one));
+        mask = _mm_and_pd(mask, _mm_and_pd(_mm_cmpge_pd(t, lower), _mm_cmple_pd(t, upper)));
+        _mm_storeu_pd(ts + i, _mm_or_pd(_mm_and_pd(mask, t), _mm_andnot_pd(mask, inf)));
+        _mm_storeu_pd(us + i, u);
+        _mm_storeu_pd(vs + i, v);
+    }
+#endif
+    for(; i < count; i++)
+    {
+        double e1[3] = {bx[i] - ax[i], by[i] - ay[i], bz[i] - az[i]};
+        double e2[3] = {cx[i] - ax[i], cy[i] - ay[i], cz[i] - az[i]};
+        double p[3] = {direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2],
+                       direction[0] * e2[1] - direction[1] * e2[0]};
+        double inverse = 1.0 / (e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2]);
+        double s[3] = {origin[0] - ax[i], origin[1] - ay[i], origin[2] - az[i]};
+        double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+        double q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+        double v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+        double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+        bool hit = u >= 0 && v >= 0 && u + v <= 1 && t >= tMin && t <= tMax;
+        ts[i] = hit ? t : infinity;
+        us[i] = u;
+        vs[i] = v;
+    }
+}
+
+TriangleBVH::TriangleBVH() = default;
+
+TriangleBVH::TriangleBVH(const double *coordinates, const unsigned int *faces, std::size_t trianglesNumber)
+{
+    build(coordinates, faces, trianglesNumber);
+}
+
+void TriangleBVH::build(const double *coordinates, const unsigned int *faces, std::size_t trianglesNumber)
+{
+    nodes.clear();
+    depth = 0;
+    std::vector<double> centroids(trianglesNumber * 3), bounds(trianglesNumber * 6);
+    std::vector<uint32_t> order(trianglesNumber);
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        order[i] = static_cast<uint32_t>(i);
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            double c0 = coordinates[faces[i * 3] * std::size_t(3) + j];
+            double c1 = coordinates[faces[i * 3 + 1] * std::size_t(3) + j];
+            double c2 = coordinates[faces[i * 3 + 2] * std::size_t(3) + j];
+            bounds[i * 6 + j] = std::min(std::min(c0, c1), c2);
+            bounds[i * 6 + 3 + j] = std::max(std::max(c0, c1), c2);
+            centroids[i * 3 + j] = (bounds[i * 6 + j] + bounds[i * 6 + 3 + j]) / 2;
+        }
+    }
+    if(trianglesNumber > 0)
+    {
+        nodes.reserve(2 * (trianglesNumber / LEAF_SIZE) + 1);
+        buildNode(order, centroids, bounds, 0, trianglesNumber, 0);
+    }
+
+    std::vector<double>* corners[9] = {&ax, &ay, &az, &bx, &by, &bz, &cx, &cy, &cz};
+    for(unsigned int j = 0; j < 9; j++)
+        corners[j]->resize(trianglesNumber);
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+        for(unsigned int k = 0; k < 3; k++)
+            for(unsigned int j = 0; j < 3; j++)
+                (*corners[k * 3 + j])[i] = coordinates[faces[order[i] * std::size_t(3) + k] * std::size_t(3) + j];
+    indices.swap(order);
+}
+
+std::size_t TriangleBVH::buildNode(std::vector<uint32_t> &order, const std::vector<double> &centroids, const std::vector<double> &bounds,
+                                   std::size_t begin, std::size_t end, unsigned int level)
+{
+    depth = std::max(depth, level);
+    std::size_t index = nodes.size();
+    nodes.push_back(Node());
+    Node node;
+    double centroidMin[3], centroidMax[3];
+    for(unsigned int j = 0; j < 3; j++)
+    {
+        node.min[j] = centroidMin[j] = std::numeric_limits<double>::max();
+        node.max[j] = centroidMax[j] = -std::numeric_limits<double>::max();
+    }
+    for(std::size_t i = begin; i < end; i++)
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            node.min[j] = std::min(node.min[j], bounds[order[i] * std::size_t(6) + j]);
+            node.max[j] = std::max(node.max[j], bounds[order[i] * std::size_t(6) + 3 + j]);
+            centroidMin[j] = std::min(centroidMin[j], centroids[order[i] * std::size_t(3) + j]);
+            centroidMax[j] = std::max(centroidMax[j], centroids[order[i] * std::size_t(3) + j]);
+        }
+    node.offset = static_cast<uint32_t>(begin);
+    node.count = static_cast<uint32_t>(end - begin);
+
+    unsigned int axis = 0;
+    for(unsigned int j = 1; j < 3; j++)
+        if(centroidMax[j] - centroidMin[j] > centroidMax[axis] - centroidMin[axis])
+            axis = j;
+    double extent = centroidMax[axis] - centroidMin[axis];
+    //Small nodes and nodes whose centroids coincide are leaves
+    if(end - begin <= LEAF_SIZE || extent <= 0)
+    {
+        nodes[index] = node;
+        return index;
+    }
+
+    //Triangles are binned by centroid, then the SAH cost of the planes between the bins is evaluated with a sweep in each direction
+    struct Bin
+    {
+        double min[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+        double max[3] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+        std::size_t count = 0;
+    };
+    Bin bins[BINS_NUMBER];
+    auto binOf = [&](uint32_t t)
+    {
+        auto b = static_cast<unsigned int>((centroids[t * std::size_t(3) + axis] - centroidMin[axis]) / extent * BINS_NUMBER);
+        return std::min(b, BINS_NUMBER - 1);
+    };
+    for(std::size_t i = begin; i < end; i++)
+    {
+        Bin& bin = bins[binOf(order[i])];
+        bin.count++;
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            bin.min[j] = std::min(bin.min[j], bounds[order[i] * std::size_t(6) + j]);
+            bin.max[j] = std::max(bin.max[j], bounds[order[i] * std::size_t(6) + 3 + j]);
+        }
+    }
+
+    double rightCosts[BINS_NUMBER];
+    Bin accumulated;
+    for(unsigned int b = BINS_NUMBER - 1; b > 0; b--)
+    {
+        accumulated.count += bins[b].count;
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            accumulated.min[j] = std::min(accumulated.min[j], bins[b].min[j]);
+            accumulated.max[j] = std::max(accumulated.max[j], bins[b].max[j]);
+        }
+        rightCosts[b] = halfArea(accumulated.min, accumulated.max) * accumulated.count;
+    }
+    accumulated = Bin();
+    unsigned int bestSplit = 0;
+    double bestCost = std::numeric_limits<double>::max();
+    for(unsigned int b = 0; b < BINS_NUMBER - 1; b++)
+    {
+        accumulated.count += bins[b].count;
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            accumulated.min[j] = std::min(accumulated.min[j], bins[b].min[j]);
+            accumulated.max[j] = std::max(accumulated.max[j], bins[b].max[j]);
+        }
+        if(accumulated.count == 0 || accumulated.count == end - begin)
+            continue;
+        double cost = halfArea(accumulated.min, accumulated.max) * accumulated.count + rightCosts[b + 1];
+        if(cost < bestCost)
+        {
+            bestCost = cost;
+            bestSplit = b + 1;
+        }
+    }
+
+    //Splitting is kept only if cheaper than scanning all the triangles, unless the leaf would be too large
+    double leafCost = halfArea(node.min, node.max) * (end - begin);
+    if(bestSplit == 0 || (bestCost >= leafCost && end - begin <= 4 * LEAF_SIZE))
+    {
+        nodes[index] = node;
+        return index;
+    }
+
+    auto middle = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t t){ return binOf(t) < bestSplit; });
+    std::size_t split = static_cast<std::size_t>(middle - order.begin());
+    buildNode(order, centroids, bounds, begin, split, level + 1);
+    node.offset = static_cast<uint32_t>(buildNode(order, centroids, bounds, split, end, level + 1));
+    node.count = 0;
+    nodes[index] = node;
+    return index;
+}
+
+std::size_t TriangleBVH::size() const
+{
+    return indices.size();
+}
+
+bool TriangleBVH::closestPoint(const double *point, ClosestPoint &result, double maxDistance) const
+{
+    if(nodes.empty())
+        return false;
+    double bestDistance = maxDistance < std::sqrt(std::numeric_limits<double>::max()) ? maxDistance * maxDistance : std::numeric_limits<double>::max();
+    std::size_t best = indices.size();
+
+    //Depth-first traversal visiting the closer child first and skipping nodes farther than the best point found so far. The stack never
+    //holds more than depth + 1 nodes, so it is allocated only for unusually deep hierarchies.
+    uint32_t localStack[64];
+    std::vector<uint32_t> deepStack;
+    uint32_t* stack = localStack;
+    if(depth + 1 > 64)
+    {
+        deepStack.resize(depth + 1);
+        stack = deepStack.data();
+    }
+    std::size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        if(boxSquaredDistance(node, point) >= bestDistance)
+            continue;
+        if(node.count > 0)
+        {
+            for(std::size_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const double a[3] = {ax[i], ay[i], az[i]}, b[3] = {bx[i], by[i], bz[i]}, c[3] = {cx[i], cy[i], cz[i]};
+                double barycentric[3];
+                closestPointOnTriangle(point, a, b, c, barycentric);
+                double closest[3], d = 0;
+                for(unsigned int j = 0; j < 3; j++)
+                {
+                    closest[j] = barycentric[0] * a[j] + barycentric[1] * b[j] + barycentric[2] * c[j];
+                    d += (closest[j] - point[j]) * (closest[j] - point[j]);
+                }
+                if(d < bestDistance)
+                {
+                    bestDistance = d;
+                    best = i;
+                    std::copy(barycentric, barycentric + 3, result.barycentric);
+                    std::copy(closest, closest + 3, result.point);
+                }
+            }
+            continue;
+        }
+        uint32_t left = static_cast<uint32_t>(&node - nodes.data()) + 1, right = node.offset;
+        if(boxSquaredDistance(nodes[left], point) <= boxSquaredDistance(nodes[right], point))
+        {
+            stack[stackSize++] = right;
+            stack[stackSize++] = left;
+        } else
+        {
+            stack[stackSize++] = left;
+            stack[stackSize++] = right;
+        }
+    }
+
+    if(best == indices.size())
+        return false;
+    result.triangle = indices[best];
+    result.squaredDistance = bestDistance;
+    return true;
+}
+
+template <class Visitor>
+void TriangleBVH::traverseRay(const double *origin, const double *direction, double tMin, double &tMax, Visitor visit) const
+{
+    if(nodes.empty())
+        return;
+    double inverse[3];
+    for(unsigned int i = 0; i < 3; i++)
+        inverse[i] = direction[i] != 0 ? 1.0 / direction[i] : 0.0;
+
+    uint32_t localStack[64];
+    std::vector<uint32_t> deepStack;
+    uint32_t* stack = localStack;
+    if(depth + 1 > 64)
+    {
+        deepStack.resize(depth + 1);
+        stack = deepStack.data();
+    }
+    std::size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        double entry;
+        if(!rayBox(node, origin, direction, inverse, tMin, tMax, entry))
+            continue;
+        if(node.count > 0)
+        {
+            if(visit(static_cast<std::size_t>(node.offset), static_cast<std::size_t>(node.count)))
+                return;
+            continue;
+        }
+        //The child entered first is visited first, so that tMax shrinks as soon as possible
+        uint32_t left = static_cast<uint32_t>(&node - nodes.data()) + 1, right = node.offset;
+        double leftEntry, rightEntry;
+        bool hitsLeft = rayBox(nodes[left], origin, direction, inverse, tMin, tMax, leftEntry);
+        bool hitsRight = rayBox(nodes[right], origin, direction, inverse, tMin, tMax, rightEntry);
+        if(hitsLeft && hitsRight)
+        {
+            if(leftEntry <= rightEntry)
+            {
+                stack[stackSize++] = right;
+                stack[stackSize++] = left;
+            } else
+            {
+                stack[stackSize++] = left;
+                stack[stackSize++] = right;
+            }
+        } else if(hitsLeft)
+            stack[stackSize++] = left;
+        else if(hitsRight)
+            stack[stackSize++] = right;
+    }
+}
+
+void TriangleBVH::intersectLeaf(std::size_t first, std::size_t count, const double *origin, const double *direction, double tMin, double tMax,
+                                double *ts, double *us, double *vs) const
+{
+    const double* corners[9] = {&ax[first], &ay[first], &az[first], &bx[first], &by[first], &bz[first], &cx[first], &cy[first], &cz[first]};
+    intersectTriangles(corners, count, origin, direction, tMin, tMax, ts, us, vs);
+}
+
+bool TriangleBVH::firstHit(const double *origin, const double *direction, RayHit &hit, double tMin, double tMax) const
+{
+    //Missed triangles have an infinite parameter, so the range must be finite
+    tMax = std::min(tMax, std::numeric_limits<double>::max());
+    std::size_t best = indices.size();
+    double bestU = 0, bestV = 0;
+    traverseRay(origin, direction, tMin, tMax, [&](std::size_t first, std::size_t count)
+    {
+        //Leaves are processed in blocks, since leaves of coincident triangles may exceed LEAF_SIZE
+        double ts[4 * LEAF_SIZE], us[4 * LEAF_SIZE], vs[4 * LEAF_SIZE];
+        for(std::size_t block = first; block < first + count; block += 4 * LEAF_SIZE)
+        {
+            std::size_t blockSize = std::min<std::size_t>(4 * LEAF_SIZE, first + count - block);
+            intersectLeaf(block, blockSize, origin, direction, tMin, tMax, ts, us, vs);
+            for(std::size_t i = 0; i < blockSize; i++)
+                if(ts[i] <= tMax && (ts[i] < tMax || best == indices.size()))
+                {
+                    tMax = ts[i];
+                    best = block + i;
+                    bestU = us[i];
+                    bestV = vs[i];
+                }
+        }
+        return false;
+    });
+    if(best == indices.size())
+        return false;
+    hit.triangle = indices[best];
+    hit.t = tMax;
+    hit.barycentric[0] = 1 - bestU - bestV;
+    hit.barycentric[1] = bestU;
+    hit.barycentric[2] = bestV;
+    return true;
+}
+
+bool TriangleBVH::anyHit(const double *origin, const double *direction, double tMin, double tMax) const
+{
+    //Missed triangles have an infinite parameter, so the range must be finite
+    tMax = std::min(tMax, std::numeric_limits<double>::max());
+    bool found = false;
+    traverseRay(origin, direction, tMin, tMax, [&](std::size_t first, std::size_t count)
+    {
+        double ts[4 * LEAF_SIZE], us[4 * LEAF_SIZE], vs[4 * LEAF_SIZE];
+        for(std::size_t block = first; block < first + count && !found; block += 4 * LEAF_SIZE)
+        {
+            std::size_t blockSize = std::min<std::size_t>(4 * LEAF_SIZE, first + count - block);
+            intersectLeaf(block, blockSize, origin, direction, tMin, tMax, ts, us, vs);
+            for(std::size_t i = 0; i < blockSize && !found; i++)
+                found = ts[i] <= tMax;
+        }
+        return found;
+    });
+    return found;
+}
+
+void TriangleBVH::allHits(const double *origin, const double *direction, std::vector<RayHit> &hits, double tMin, double tMax) const
+{
+    //Missed triangles have an infinite parameter, so the range must be finite
+    tMax = std::min(tMax, std::numeric_limits<double>::max());
+    hits.clear();
+    traverseRay(origin, direction, tMin, tMax, [&](std::size_t first, std::size_t count)
+    {
+        double ts[4 * LEAF_SIZE], us[4 * LEAF_SIZE], vs[4 * LEAF_SIZE];
+        for(std::size_t block = first; block < first + count; block += 4 * LEAF_SIZE)
+        {
+            std::size_t blockSize = std::min<std::size_t>(4 * LEAF_SIZE, first + count - block);
+            intersectLeaf(block, blockSize, origin, direction, tMin, tMax, ts, us, vs);
+            for(std::size_t i = 0; i < blockSize; i++)
+                if(ts[i] <= tMax)
+                {
+                    RayHit hit;
+                    hit.triangle = indices[block + i];
+                    hit.t = ts[i];
+                    hit.barycentric[0] = 1 - us[i] - vs[i];
+                    hit.barycentric[1] = us[i];
+                    hit.barycentric[2] = vs[i];
+                    hits.push_back(hit);
+                }
+        }
+        return false;
+    });
+    std::sort(hits.begin(), hits.end(), [](const RayHit& a, const RayHit& b){ return a.t < b.t; });
+}
@@ -0,0 +1,166 @@
+#include "trianglelocator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace SemantisedTriangleMesh;
+
+TriangleLocator::TriangleLocator() = default;
+
+TriangleLocator::TriangleLocator(const double *coordinates, const unsigned int *faces, std::size_t trianglesNumber)
+{
+    build(coordinates, faces, trianglesNumber);
+}
+
+void TriangleLocator::build(const double *coordinates, const unsigned int *faces, std::size_t trianglesNumber)
+{
+    data.resize(trianglesNumber);
+    cellStart.clear();
+    cellTriangles.clear();
+    columns = rows = 0;
+
+    std::vector<double> bounds(trianglesNumber * 4);
+    std::vector<unsigned char> valid(trianglesNumber, 0);
+    double maxX = -std::numeric_limits<double>::max(), maxY = -std::numeric_limits<double>::max();
+    minX = minY = std::numeric_limits<double>::max();
+    std::size_t validNumber = 0;
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        const double* a = &coordinates[faces[i * 3] * std::size_t(3)];
+        const double* b = &coordinates[faces[i * 3 + 1] * std::size_t(3)];
+        const double* c = &coordinates[faces[i * 3 + 2] * std::size_t(3)];
+        TriangleData& t = data[i];
+        t.ox = a[0];
+        t.oy = a[1];
+        t.e1x = b[0] - a[0];
+        t.e1y = b[1] - a[1];
+        t.e2x = c[0] - a[0];
+        t.e2y = c[1] - a[1];
+        t.z[0] = a[2];
+        t.z[1] = b[2];
+        t.z[2] = c[2];
+        double area = t.e1x * t.e2y - t.e1y * t.e2x;
+        //Projections whose area is negligible with respect to their edges (vertical or degenerate triangles) are not indexed
+        double scale = std::max(std::max(std::fabs(t.e1x), std::fabs(t.e1y)), std::max(std::fabs(t.e2x), std::fabs(t.e2y)));
+        t.inverseArea = std::fabs(area) > scale * scale * 1e-14 ? 1.0 / area : 0.0;
+        if(t.inverseArea == 0.0)
+            continue;
+        valid[i] = 1;
+        validNumber++;
+        double* box = &bounds[i * 4];
+        box[0] = std::min(std::min(a[0], b[0]), c[0]);
+        box[1] = std::min(std::min(a[1], b[1]), c[1]);
+        box[2] = std::max(std::max(a[0], b[0]), c[0]);
+        box[3] = std::max(std::max(a[1], b[1]), c[1]);
+        minX = std::min(minX, box[0]);
+        minY = std::min(minY, box[1]);
+        maxX = std::max(maxX, box[2]);
+        maxY = std::max(maxY, box[3]);
+    }
+    if(validNumber == 0)
+        return;
+
+    //Cells are square, and as many as needed for having about TRIANGLES_PER_CELL triangles each over the bounding box
+    double width = maxX - minX, height = maxY - minY;
+    double cells = std::max(1.0, static_cast<double>(validNumber) / TRIANGLES_PER_CELL);
+    cellSize = std::sqrt(width * height / cells);
+    if(!(cellSize > 0))
+        cellSize = std::max(width, height) / cells;
+    if(!(cellSize > 0))
+        cellSize = 1;
+    columns = std::max<std::size_t>(1, static_cast<std::size_t>(std::min(std::ceil(width / cellSize), cells)));
+    rows = std::max<std::size_t>(1, static_cast<std::size_t>(std::min(std::ceil(height / cellSize), cells)));
+    //Rounding (or very elongated boxes) may produce slightly more cells than requested, which is harmless, but a huge grid is not
+    while(static_cast<double>(columns) * static_cast<double>(rows) > 4 * cells + 4)
+    {
+        cellSize *= 1.5;
+        columns = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(width / cellSize)));
+        rows = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(height / cellSize)));
+    }
+
+    auto column = [this](double x){ return std::min(columns - 1, static_cast<std::size_t>(std::max(0.0, (x - minX) / cellSize))); };
+    auto row = [this](double y){ return std::min(rows - 1, static_cast<std::size_t>(std::max(0.0, (y - minY) / cellSize))); };
+
+    //Counting pass, then filling pass over the cells overlapped by the bounding box of each triangle
+    cellStart.assign(columns * rows + 1, 0);
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        if(!valid[i])
+            continue;
+        const double* box = &bounds[i * 4];
+        std::size_t c0 = column(box[0]), c1 = column(box[2]), r0 = row(box[1]), r1 = row(box[3]);
+        for(std::size_t r = r0; r <= r1; r++)
+            for(std::size_t c = c0; c <= c1; c++)
+                cellStart[r * columns + c + 1]++;
+    }
+    for(std::size_t i = 0; i < columns * rows; i++)
+        cellStart[i + 1] += cellStart[i];
+    cellTriangles.resize(cellStart.back());
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        if(!valid[i])
+            continue;
+        const double* box = &bounds[i * 4];
+        std::size_t c0 = column(box[0]), c1 = column(box[2]), r0 = row(box[1]), r1 = row(box[3]);
+        for(std::size_t r = r0; r <= r1; r++)
+            for(std::size_t c = c0; c <= c1; c++)
+                cellTriangles[fill[r * columns + c]++] = static_cast<uint32_t>(i);
+    }
+}
+
+std::size_t TriangleLocator::size() const
+{
+    return data.size();
+}
+
+double TriangleLocator::barycentric(std::size_t triangle, double x, double y, double *coordinates) const
+{
+    const TriangleData& t = data[triangle];
+    double px = x - t.ox, py = y - t.oy;
+    double u = (px * t.e2y - py * t.e2x) * t.inverseArea;
+    double v = (t.e1x * py - t.e1y * px) * t.inverseArea;
+    coordinates[0] = 1.0 - u - v;
+    coordinates[1] = u;
+    coordinates[2] = v;
+    return std::min(std::min(coordinates[0], u), v);
+}
+
+bool TriangleLocator::locate(double x, double y, Location &location, std::size_t hint) const
+{
+    if(columns == 0 || !(x >= minX && y >= minY && x <= minX + columns * cellSize && y <= minY + rows * cellSize))
+        return false;
+
+    double coordinates[3];
+    if(hint < data.size() && data[hint].inverseArea != 0.0 && barycentric(hint, x, y, coordinates) >= 0)
+    {
+        location.triangle = hint;
+    } else
+    {
+        std::size_t c = std::min(columns - 1, static_cast<std::size_t>((x - minX) / cellSize));
+        std::size_t r = std::min(rows - 1, static_cast<std::size_t>((y - minY) / cellSize));
+        std::size_t cell = r * columns + c;
+        double best = -TOLERANCE;
+        location.triangle = SIZE_MAX;
+        for(uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+        {
+            double candidate[3];
+            double lowest = barycentric(cellTriangles[i], x, y, candidate);
+            if(lowest >= best)
+            {
+                best = lowest;
+                location.triangle = cellTriangles[i];
+                std::copy(candidate, candidate + 3, coordinates);
+                if(lowest >= 0)
+                    break;
+            }
+        }
+        if(location.triangle == SIZE_MAX)
+            return false;
+    }
+
+    const TriangleData& t = data[location.triangle];
+    std::copy(coordinates, coordinates + 3, location.barycentric);
+    location.z = coordinates[0] * t.z[0] + coordinates[1] * t.z[1] + coordinates[2] * t.z[2];
+    return true;
+}
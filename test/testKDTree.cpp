@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <KDTree.hpp>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message)
+{
+    if(!condition)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static double squaredDistance(const double* p, const double* q)
+{
+    double dx = p[0] - q[0], dy = p[1] - q[1], dz = p[2] - q[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+static double squaredSegmentDistance(const double* p, const double* a, const double* b)
+{
+    double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double length = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+    double t = length > 0 ? ((p[0] - a[0]) * ab[0] + (p[1] - a[1]) * ab[1] + (p[2] - a[2]) * ab[2]) / length : 0;
+    t = std::max(0.0, std::min(1.0, t));
+    double closest[3] = {a[0] + t * ab[0], a[1] + t * ab[1], a[2] + t * ab[2]};
+    return squaredDistance(p, closest);
+}
+
+//Points within a squared distance, the ones at the boundary (up to a relative tolerance) being optional
+static bool sameSelection(std::vector<size_t> found, const std::vector<double>& distances, double limit)
+{
+    std::sort(found.begin(), found.end());
+    if(std::adjacent_find(found.begin(), found.end()) != found.end())
+        return false;
+    std::vector<bool> isFound(distances.size(), false);
+    for(auto i : found)
+    {
+        if(i >= distances.size())
+            return false;
+        isFound[i] = true;
+    }
+    double tolerance = 1e-12 * (1 + limit);
+    for(size_t i = 0; i < distances.size(); i++)
+        if((distances[i] < limit - tolerance && !isFound[i]) || (distances[i] > limit + tolerance && isFound[i]))
+            return false;
+    return true;
+}
+
+//Random points, with clusters and duplicates, so that leaves and boxes of any shape are covered
+static std::vector<double> generatePoints(size_t pointsNumber, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> coordinate(-10, 10), cluster(-0.05, 0.05);
+    std::vector<double> coordinates;
+    for(size_t i = 0; i < pointsNumber; i++)
+    {
+        if(i > 0 && i % 10 == 0)
+        {
+            size_t other = (generator() % i) * 3;
+            double spread = i % 20 == 0 ? 0 : 1;
+            for(unsigned int j = 0; j < 3; j++)
+                coordinates.push_back(coordinates[other + j] + spread * cluster(generator));
+        } else
+            for(unsigned int j = 0; j < 3; j++)
+                coordinates.push_back(coordinate(generator));
+    }
+    return coordinates;
+}
+
+static void testQueries(size_t pointsNumber, unsigned int seed)
+{
+    std::string name = std::to_string(pointsNumber) + " points";
+    std::vector<double> coordinates = generatePoints(pointsNumber, seed);
+    KDTree tree(coordinates.data(), pointsNumber);
+    check(tree.size() == pointsNumber, name + ": size");
+
+    std::mt19937 generator(seed + 1);
+    std::uniform_real_distribution<double> coordinate(-12, 12), radius(0, 4);
+    std::vector<double> distances(pointsNumber);
+    std::vector<size_t> found;
+    std::vector<neighbour_t> neighbours;
+    for(unsigned int query = 0; query < 50; query++)
+    {
+        std::string queryName = name + ", query " + std::to_string(query);
+        double point[3] = {coordinate(generator), coordinate(generator), coordinate(generator)};
+        //Half of the queries start from an input point
+        if(query % 2 && pointsNumber > 0)
+        {
+            size_t start = (generator() % pointsNumber) * 3;
+            std::copy(coordinates.begin() + start, coordinates.begin() + start + 3, point);
+        }
+        for(size_t i = 0; i < pointsNumber; i++)
+            distances[i] = squaredDistance(point, &coordinates[i * 3]);
+        std::vector<double> sorted = distances;
+        std::sort(sorted.begin(), sorted.end());
+
+        double nearestDistance = -1;
+        size_t nearest = tree.nearest(point, &nearestDistance);
+        if(pointsNumber == 0)
+            check(nearest == 0, queryName + ": nearest in an empty tree");
+        else
+            check(nearest < pointsNumber && distances[nearest] == sorted[0] && nearestDistance == sorted[0], queryName + ": nearest");
+
+        double r = radius(generator);
+        tree.radiusSearch(point, r, found);
+        check(sameSelection(found, distances, r * r), queryName + ": radius search");
+
+        for(size_t k : {static_cast<size_t>(1), static_cast<size_t>(5), KDTree::LEAF_SIZE + 1, static_cast<size_t>(40)})
+            for(double limit : {-1.0, r})
+            {
+                std::string knnName = queryName + ", " + std::to_string(k) + " neighbours" + (limit < 0 ? "" : " within the radius");
+                neighbours.assign(k, neighbour_t(0, 0));
+                size_t count = tree.knnSearch(point, k, neighbours.data(), limit);
+                size_t expected = std::min(k, pointsNumber);
+                if(limit >= 0)
+                    expected = std::min(expected, static_cast<size_t>(std::upper_bound(sorted.begin(), sorted.end(), limit * limit) - sorted.begin()));
+                check(count == expected, knnName + ": count");
+                bool correct = true;
+                for(size_t i = 0; i < count && i < expected; i++)
+                {
+                    size_t index = neighbours[i].first;
+                    //The distances match the sorted ones, whatever the order of the points at the same distance
+                    correct = correct && index < pointsNumber && neighbours[i].second == distances[index] && distances[index] == sorted[i];
+                    for(size_t j = 0; j < i; j++)
+                        correct = correct && neighbours[j].first != index;
+                }
+                check(correct, knnName + ": neighbours");
+            }
+
+        //Capsules along a random segment, degenerate ones included
+        double a[3] = {point[0], point[1], point[2]};
+        double b[3] = {coordinate(generator), coordinate(generator), coordinate(generator)};
+        if(query % 5 == 0)
+            std::copy(a, a + 3, b);
+        for(size_t i = 0; i < pointsNumber; i++)
+            distances[i] = squaredSegmentDistance(&coordinates[i * 3], a, b);
+        tree.capsuleSearch(a, b, r, found);
+        check(sameSelection(found, distances, r * r), queryName + ": capsule search");
+
+        //Corridor along a random polyline of up to five vertices, compared with the distance from its closest segment
+        std::vector<double> polyline(a, a + 3);
+        size_t verticesNumber = 1 + query % 5;
+        for(size_t i = 1; i < verticesNumber; i++)
+            for(unsigned int j = 0; j < 3; j++)
+                polyline.push_back(polyline[(i - 1) * 3 + j] + radius(generator) - 2);
+        for(size_t i = 0; i < pointsNumber; i++)
+        {
+            distances[i] = squaredDistance(&coordinates[i * 3], polyline.data());
+            for(size_t j = 1; j < verticesNumber; j++)
+                distances[i] = std::min(distances[i], squaredSegmentDistance(&coordinates[i * 3], &polyline[(j - 1) * 3], &polyline[j * 3]));
+        }
+        tree.corridorSearch(polyline.data(), verticesNumber, r, found);
+        check(sameSelection(found, distances, r * r), queryName + ": corridor search");
+    }
+}
+
+//After a refit the queries are answered on the moved points
+static void testRefit()
+{
+    const size_t pointsNumber = 500;
+    std::vector<double> coordinates = generatePoints(pointsNumber, 3);
+    KDTree tree(coordinates.data(), pointsNumber);
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> displacement(-3, 3);
+    for(auto& c : coordinates)
+        c += displacement(generator);
+    double ratio = tree.refit(coordinates.data());
+    check(ratio > 0, "refit: looseness ratio");
+    std::vector<size_t> found;
+    std::vector<double> distances(pointsNumber);
+    for(unsigned int query = 0; query < 20; query++)
+    {
+        const double* point = &coordinates[(generator() % pointsNumber) * 3];
+        for(size_t i = 0; i < pointsNumber; i++)
+            distances[i] = squaredDistance(point, &coordinates[i * 3]);
+        double nearestDistance = -1;
+        tree.nearest(point, &nearestDistance);
+        check(nearestDistance == 0, "refit: nearest");
+        tree.radiusSearch(point, 2, found);
+        check(sameSelection(found, distances, 4), "refit: radius search");
+    }
+}
+
+int main()
+{
+    for(size_t pointsNumber : {0, 1, 7, 100, 5000})
+        testQueries(pointsNumber, static_cast<unsigned int>(pointsNumber) + 1);
+    testRefit();
+    if(failures > 0)
+    {
+        std::cerr << failures << " kd-tree tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All kd-tree tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <TriangleMesh.hpp>
+#include <plyformat.hpp>
+
+using namespace SemantisedTriangleMesh;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message)
+{
+    if(!condition)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static const std::size_t TYPES_NUMBER = 8;
+static const ScalarType TYPES[TYPES_NUMBER] = {ScalarType::INT8, ScalarType::UINT8, ScalarType::INT16, ScalarType::UINT16, ScalarType::INT32,
+                                               ScalarType::UINT32, ScalarType::FLOAT32, ScalarType::FLOAT64};
+
+//Values representable by each type, extremes included, used cyclically for filling the channels
+static double sampleValue(ScalarType type, std::size_t position)
+{
+    static const std::vector<double> int8Values = {-128, 127, 0, -1, 42};
+    static const std::vector<double> uint8Values = {0, 255, 1, 128, 200};
+    static const std::vector<double> int16Values = {-32768, 32767, -300, 0, 1234};
+    static const std::vector<double> uint16Values = {0, 65535, 300, 40000, 7};
+    static const std::vector<double> int32Values = {-2147483648.0, 2147483647.0, -70000, 0, 123456789};
+    static const std::vector<double> uint32Values = {0, 4294967295.0, 70000, 3000000000.0, 1};
+    static const std::vector<double> float32Values = {-1.5, static_cast<float>(3.25e-5), static_cast<float>(1e30), 0, static_cast<float>(0.1)};
+    static const std::vector<double> float64Values = {-1.5, 0.1, 1e-300, 1e300, 2.0 / 3};
+    const std::vector<double>* values;
+    switch(type)
+    {
+        case ScalarType::INT8: values = &int8Values; break;
+        case ScalarType::UINT8: values = &uint8Values; break;
+        case ScalarType::INT16: values = &int16Values; break;
+        case ScalarType::UINT16: values = &uint16Values; break;
+        case ScalarType::INT32: values = &int32Values; break;
+        case ScalarType::UINT32: values = &uint32Values; break;
+        case ScalarType::FLOAT32: values = &float32Values; break;
+        default: values = &float64Values;
+    }
+    return values->at((position + static_cast<std::size_t>(type)) % values->size());
+}
+
+//Grid of size x size squares split in two triangles each, with a vertex channel and a triangle channel for each scalar type
+static std::shared_ptr<TriangleMesh> buildMesh(unsigned int size)
+{
+    std::vector<double> coordinates;
+    std::vector<unsigned int> faces;
+    for(unsigned int j = 0; j <= size; j++)
+        for(unsigned int i = 0; i <= size; i++)
+            coordinates.insert(coordinates.end(), {i / 3.0, j * 0.7, 0.1 * i * j});
+    for(unsigned int j = 0; j < size; j++)
+        for(unsigned int i = 0; i < size; i++)
+        {
+            unsigned int a = j * (size + 1) + i, b = a + 1, c = a + size + 1, d = c + 1;
+            faces.insert(faces.end(), {a, b, d, a, d, c});
+        }
+    auto mesh = std::make_shared<TriangleMesh>();
+    mesh->buildFromArrays(coordinates, faces);
+    for(auto type : TYPES)
+    {
+        auto vertexChannel = mesh->addVertexChannel("vertex_" + scalarTypeToString(type), type);
+        auto triangleChannel = mesh->addTriangleChannel("face_" + scalarTypeToString(type), type);
+        for(std::size_t i = 0; i < vertexChannel->size(); i++)
+            vertexChannel->setValue(i, sampleValue(type, i));
+        for(std::size_t i = 0; i < triangleChannel->size(); i++)
+            triangleChannel->setValue(i, sampleValue(type, i));
+    }
+    return mesh;
+}
+
+//The channel exists, it is stored with its own type and it holds exactly the original values (each one shared by elementsPerValue elements)
+template <class T>
+static void checkTypedChannel(std::shared_ptr<PropertyChannel> channel, std::size_t size, std::size_t elementsPerValue, const std::string& name)
+{
+    auto typedChannel = std::dynamic_pointer_cast<TypedPropertyChannel<T> >(channel);
+    check(typedChannel != nullptr, name + ": channel class");
+    if(typedChannel == nullptr)
+        return;
+    bool equal = typedChannel->getValues().size() == size;
+    for(std::size_t i = 0; equal && i < size; i++)
+        equal = typedChannel->getValues().at(i) == static_cast<T>(sampleValue(channel->getType(), i / elementsPerValue));
+    check(equal, name + ": values");
+}
+
+static void checkChannel(std::shared_ptr<PropertyChannel> channel, ScalarType type, std::size_t size, std::size_t elementsPerValue,
+                         const std::string& name)
+{
+    check(channel != nullptr && channel->getType() == type, name + ": type");
+    if(channel == nullptr || channel->getType() != type)
+        return;
+    switch(type)
+    {
+        case ScalarType::INT8: checkTypedChannel<int8_t>(channel, size, elementsPerValue, name); break;
+        case ScalarType::UINT8: checkTypedChannel<uint8_t>(channel, size, elementsPerValue, name); break;
+        case ScalarType::INT16: checkTypedChannel<int16_t>(channel, size, elementsPerValue, name); break;
+        case ScalarType::UINT16: checkTypedChannel<uint16_t>(channel, size, elementsPerValue, name); break;
+        case ScalarType::INT32: checkTypedChannel<int32_t>(channel, size, elementsPerValue, name); break;
+        case ScalarType::UINT32: checkTypedChannel<uint32_t>(channel, size, elementsPerValue, name); break;
+        case ScalarType::FLOAT32: checkTypedChannel<float>(channel, size, elementsPerValue, name); break;
+        default: checkTypedChannel<double>(channel, size, elementsPerValue, name);
+    }
+}
+
+//The loaded mesh has the vertices, the triangles and the channels of the saved one (whose triangle values may be shared by pairs of triangles)
+static void checkMesh(std::shared_ptr<TriangleMesh> original, std::shared_ptr<TriangleMesh> loaded, std::size_t trianglesPerValue,
+                      const std::string& name)
+{
+    check(loaded->getVerticesNumber() == original->getVerticesNumber(), name + ": vertices number");
+    check(loaded->getTrianglesNumber() == original->getTrianglesNumber(), name + ": triangles number");
+    if(loaded->getVerticesNumber() != original->getVerticesNumber() || loaded->getTrianglesNumber() != original->getTrianglesNumber())
+        return;
+    bool equal = true;
+    for(unsigned int i = 0; i < original->getVerticesNumber(); i++)
+    {
+        auto v = original->getVertex(i), w = loaded->getVertex(i);
+        equal = equal && v->getX() == w->getX() && v->getY() == w->getY() && v->getZ() == w->getZ();
+    }
+    check(equal, name + ": coordinates");
+    for(unsigned int i = 0; i < original->getTrianglesNumber(); i++)
+    {
+        auto t = original->getTriangle(i), u = loaded->getTriangle(i);
+        std::vector<std::string> originalIds = {t->getV1()->getId(), t->getV2()->getId(), t->getV3()->getId()};
+        std::vector<std::string> loadedIds = {u->getV1()->getId(), u->getV2()->getId(), u->getV3()->getId()};
+        std::sort(originalIds.begin(), originalIds.end());
+        std::sort(loadedIds.begin(), loadedIds.end());
+        equal = equal && originalIds == loadedIds;
+    }
+    check(equal, name + ": triangles");
+    check(loaded->getVertexChannels().size() == TYPES_NUMBER && loaded->getTriangleChannels().size() == TYPES_NUMBER, name + ": channels number");
+    for(auto type : TYPES)
+    {
+        checkChannel(loaded->getVertexChannel("vertex_" + scalarTypeToString(type)), type, original->getVerticesNumber(), 1,
+                     name + ", vertex " + scalarTypeToString(type));
+        checkChannel(loaded->getTriangleChannel("face_" + scalarTypeToString(type)), type, original->getTrianglesNumber(), trianglesPerValue,
+                     name + ", face " + scalarTypeToString(type));
+    }
+}
+
+//Channels of every type survive saving and loading the mesh, both as ascii and binary
+static void testRoundTrip()
+{
+    auto mesh = buildMesh(4);
+    for(bool binary : {false, true})
+    {
+        std::string name = binary ? "binary round trip" : "ascii round trip";
+        std::string filename = binary ? "testPLY_binary.ply" : "testPLY_ascii.ply";
+        check(mesh->save(filename, std::numeric_limits<double>::max_digits10, binary) == 0, name + ": save");
+        auto loaded = std::make_shared<TriangleMesh>();
+        check(loaded->load(filename) == 0, name + ": load");
+        checkMesh(mesh, loaded, 1, name);
+        std::remove(filename.c_str());
+    }
+}
+
+//Writes the mesh (with its channels) in any encoding, splitting pairs of triangles into quads and adding an element that must be skipped
+static void writeQuadsFile(std::shared_ptr<TriangleMesh> mesh, const std::string& filename, PLYFormat format)
+{
+    std::ofstream stream(filename, std::ios::binary);
+    stream.precision(std::numeric_limits<double>::max_digits10);
+    PLYHeader header;
+    header.format = format;
+    PLYElement vertexElement, faceElement, otherElement;
+    vertexElement.name = "vertex";
+    vertexElement.count = mesh->getVerticesNumber();
+    faceElement.name = "face";
+    faceElement.count = mesh->getTrianglesNumber() / 2;
+    otherElement.name = "camera";
+    otherElement.count = 2;
+    PLYProperty property;
+    for(std::string coordinate : {"x", "y", "z"})
+    {
+        property.name = coordinate;
+        property.type = ScalarType::FLOAT64;
+        vertexElement.properties.push_back(property);
+    }
+    property.name = "vertex_index";
+    property.isList = true;
+    property.countType = ScalarType::UINT8;
+    property.type = ScalarType::UINT32;
+    faceElement.properties.push_back(property);
+    otherElement.properties.push_back(property);
+    property.isList = false;
+    for(auto type : TYPES)
+    {
+        property.type = type;
+        property.name = "vertex_" + scalarTypeToString(type);
+        vertexElement.properties.push_back(property);
+        property.name = "face_" + scalarTypeToString(type);
+        faceElement.properties.push_back(property);
+        otherElement.properties.push_back(property);
+    }
+    header.elements = {vertexElement, otherElement, faceElement};
+    header.write(stream);
+
+    PLYValueWriter writer(stream, format);
+    auto separator = [&](bool last){ if(format == PLYFormat::ASCII) stream << (last ? "\n" : " "); };
+    for(unsigned int i = 0; i < mesh->getVerticesNumber(); i++)
+    {
+        auto v = mesh->getVertex(i);
+        for(double coordinate : {v->getX(), v->getY(), v->getZ()})
+        {
+            writer.write(ScalarType::FLOAT64, coordinate);
+            separator(false);
+        }
+        for(std::size_t j = 0; j < TYPES_NUMBER; j++)
+        {
+            writer.write(TYPES[j], sampleValue(TYPES[j], i));
+            separator(j + 1 == TYPES_NUMBER);
+        }
+    }
+    for(unsigned int i = 0; i < otherElement.count; i++)
+    {
+        for(double value : {2, 0, 1})
+        {
+            writer.write(value == 2 ? ScalarType::UINT8 : ScalarType::UINT32, value);
+            separator(false);
+        }
+        for(std::size_t j = 0; j < TYPES_NUMBER; j++)
+        {
+            writer.write(TYPES[j], sampleValue(TYPES[j], i));
+            separator(j + 1 == TYPES_NUMBER);
+        }
+    }
+    //The triangles of buildMesh come in pairs (a, b, d) and (a, d, c), that is the fan of the quad (a, b, d, c)
+    for(unsigned int i = 0; i < faceElement.count; i++)
+    {
+        auto t = mesh->getTriangle(i * 2), u = mesh->getTriangle(i * 2 + 1);
+        writer.write(ScalarType::UINT8, 4);
+        separator(false);
+        for(auto v : {t->getV1(), t->getV2(), t->getV3(), u->getV3()})
+        {
+            writer.write(ScalarType::UINT32, std::stod(v->getId()));
+            separator(false);
+        }
+        for(std::size_t j = 0; j < TYPES_NUMBER; j++)
+        {
+            writer.write(TYPES[j], sampleValue(TYPES[j], i));
+            separator(j + 1 == TYPES_NUMBER);
+        }
+    }
+}
+
+//Files written in each encoding (big endian included) by a different writer, with polygonal faces and unknown elements
+static void testEncodings()
+{
+    auto mesh = buildMesh(3);
+    const PLYFormat formats[] = {PLYFormat::ASCII, PLYFormat::BINARY_LITTLE_ENDIAN, PLYFormat::BINARY_BIG_ENDIAN};
+    for(auto format : formats)
+    {
+        std::string name = "encoding " + std::to_string(static_cast<int>(format));
+        writeQuadsFile(mesh, "testPLY_quads.ply", format);
+        auto loaded = std::make_shared<TriangleMesh>();
+        check(loaded->load("testPLY_quads.ply") == 0, name + ": load");
+        //Each quad is split into two triangles inheriting its properties
+        checkMesh(mesh, loaded, 2, name);
+        std::remove("testPLY_quads.ply");
+    }
+}
+
+//Malformed bodies are reported with their own error codes
+static void testErrors()
+{
+    const std::string header = "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+                               "element face 1\nproperty list uchar int vertex_indices\nend_header\n0 0 0\n1 0 0\n0 1 0\n";
+    const std::pair<std::string, int> bodies[] = {{"3 0 1 2\n", 0}, {"3 0 1 5\n", 11}, {"3 0 -1 2\n", 11}, {"3 0 1", 8}, {"3 0 1 x\n", 8}};
+    for(const auto& body : bodies)
+    {
+        {
+            std::ofstream stream("testPLY_errors.ply", std::ios::binary);
+            stream << header << body.first;
+        }
+        auto mesh = std::make_shared<TriangleMesh>();
+        check(mesh->load("testPLY_errors.ply") == body.second, "error code of \"" + body.first + "\"");
+        std::remove("testPLY_errors.ply");
+    }
+
+    //A binary file ending right after the counter of a face: the missing index is not checked against the vertices
+    {
+        std::ofstream stream("testPLY_errors.ply", std::ios::binary);
+        stream << "ply\nformat binary_little_endian 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+                  "element face 1\nproperty list uchar int vertex_indices\nend_header\n";
+        PLYValueWriter writer(stream, PLYFormat::BINARY_LITTLE_ENDIAN);
+        for(double coordinate : {0, 0, 0, 1, 0, 0, 0, 1, 0})
+            writer.write(ScalarType::FLOAT32, coordinate);
+        writer.write(ScalarType::UINT8, 200);
+    }
+    auto mesh = std::make_shared<TriangleMesh>();
+    check(mesh->load("testPLY_errors.ply") == 8, "error code of a truncated binary face");
+    std::remove("testPLY_errors.ply");
+
+    //Three triangles sharing an edge are rejected before building anything
+    {
+        std::ofstream stream("testPLY_errors.ply", std::ios::binary);
+        stream << "ply\nformat ascii 1.0\nelement vertex 5\nproperty float x\nproperty float y\nproperty float z\nelement face 3\n"
+                  "property list uchar int vertex_indices\nend_header\n0 0 0\n1 0 0\n0 1 0\n0 -1 0\n0 0 1\n3 0 1 2\n3 1 0 3\n3 0 1 4\n";
+    }
+    mesh = std::make_shared<TriangleMesh>();
+    check(mesh->load("testPLY_errors.ply") == 9, "error code of a non-manifold edge");
+    check(mesh->getVerticesNumber() == 0 && mesh->getTrianglesNumber() == 0 && mesh->getEdgesNumber() == 0, "mesh left empty by a non-manifold edge");
+    std::remove("testPLY_errors.ply");
+}
+
+int main()
+{
+    testRoundTrip();
+    testEncodings();
+    testErrors();
+    if(failures > 0)
+    {
+        std::cerr << failures << " ply tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All ply tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <TriangleMesh.hpp>
+
+using namespace SemantisedTriangleMesh;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message)
+{
+    if(!condition)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+//Grid of size x size squares, split along alternating diagonals. If jitter is not 0, inner vertices are moved randomly in the XY plane
+//and all vertices get a random height; otherwise the grid is flat and regular, with many shortest paths of equal length.
+static std::shared_ptr<TriangleMesh> buildGrid(unsigned int size, double jitter, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> offset(-jitter, jitter), height(0, 3 * jitter);
+    std::vector<double> coordinates;
+    std::vector<unsigned int> faces;
+    for(unsigned int j = 0; j <= size; j++)
+        for(unsigned int i = 0; i <= size; i++)
+        {
+            bool inner = i > 0 && i < size && j > 0 && j < size;
+            coordinates.push_back(i + (inner ? offset(generator) : 0));
+            coordinates.push_back(j + (inner ? offset(generator) : 0));
+            coordinates.push_back(jitter > 0 ? height(generator) : 0);
+        }
+    for(unsigned int j = 0; j < size; j++)
+        for(unsigned int i = 0; i < size; i++)
+        {
+            unsigned int a = j * (size + 1) + i, b = a + 1, c = a + size + 1, d = c + 1;
+            if((i + j) % 2)
+                faces.insert(faces.end(), {a, b, d, a, d, c});
+            else
+                faces.insert(faces.end(), {a, b, c, b, d, c});
+        }
+    auto mesh = std::make_shared<TriangleMesh>();
+    mesh->buildFromArrays(coordinates, faces);
+    return mesh;
+}
+
+//Length of a path from v1 (excluded from the path), measured as computeShortestPath does. It is negative if the path does not follow the edges of the mesh.
+static double getLength(std::shared_ptr<Vertex> v1, std::shared_ptr<Vertex> v2, const std::vector<std::shared_ptr<Vertex> >& path,
+                        DistanceType metric, bool useHeight)
+{
+    double length = 0;
+    Point a = *v1, b = *v2;
+    if(!useHeight)
+    {
+        a.setZ(0);
+        b.setZ(0);
+    }
+    std::shared_ptr<Vertex> previous = v1;
+    for(auto v : path)
+    {
+        if(previous->getCommonEdge(v) == nullptr)
+            return -1;
+        Point p = *previous, q = *v;
+        if(!useHeight)
+        {
+            p.setZ(0);
+            q.setZ(0);
+        }
+        double edgeLength = (q - p).norm(), segmentDistance = q.computePointSegmentDistance(a, b);
+        if(metric == DistanceType::EUCLIDEAN_DISTANCE)
+            length += edgeLength;
+        else if(metric == DistanceType::SEGMENT_DISTANCE)
+            length += segmentDistance;
+        else
+            length += edgeLength + segmentDistance;
+        previous = v;
+    }
+    return length;
+}
+
+//The three strategies find paths of the same length, for every metric, with and without heights and used vertices
+static void testStrategies()
+{
+    auto mesh = buildGrid(30, 0.3, 7);
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<unsigned int> vertex(0, mesh->getVerticesNumber() - 1);
+    for(unsigned int i = 0; i < 40; i++)
+        mesh->getVertex(vertex(generator))->addFlag(FlagType::USED);
+
+    const DistanceType metrics[] = {DistanceType::EUCLIDEAN_DISTANCE, DistanceType::SEGMENT_DISTANCE, DistanceType::COMBINED_DISTANCE};
+    const PathSearchStrategy strategies[] = {PathSearchStrategy::A_STAR, PathSearchStrategy::BIDIRECTIONAL};
+    for(unsigned int query = 0; query < 25; query++)
+    {
+        auto v1 = mesh->getVertex(vertex(generator)), v2 = mesh->getVertex(vertex(generator));
+        for(auto metric : metrics)
+            for(bool useHeight : {false, true})
+                for(bool avoidUsed : {false, true})
+                {
+                    std::string name = "query " + std::to_string(query) + ", metric " + std::to_string(static_cast<int>(metric)) +
+                            (useHeight ? ", height" : "") + (avoidUsed ? ", avoid used" : "");
+                    auto reference = mesh->computeShortestPath(v1, v2, metric, useHeight, false, avoidUsed, PathSearchStrategy::DIJKSTRA);
+                    double referenceLength = getLength(v1, v2, reference, metric, useHeight);
+                    check(reference.empty() || (reference.back() == v2 && referenceLength >= 0), name + ": Dijkstra path");
+                    for(auto strategy : strategies)
+                    {
+                        std::string strategyName = name + ", strategy " + std::to_string(static_cast<int>(strategy));
+                        auto path = mesh->computeShortestPath(v1, v2, metric, useHeight, false, avoidUsed, strategy);
+                        check(path.empty() == reference.empty(), strategyName + ": reachability");
+                        if(path.empty() || reference.empty())
+                            continue;
+                        double length = getLength(v1, v2, path, metric, useHeight);
+                        check(path.back() == v2 && length >= 0, strategyName + ": path");
+                        check(std::fabs(length - referenceLength) <= 1e-9 * (1 + referenceLength), strategyName + ": length " +
+                              std::to_string(length) + " instead of " + std::to_string(referenceLength));
+                    }
+                }
+    }
+}
+
+//On a regular grid most queries have several shortest paths: every strategy must return one of them, always the same one
+static void testTies()
+{
+    auto mesh = buildGrid(12, 0, 0);
+    const PathSearchStrategy strategies[] = {PathSearchStrategy::DIJKSTRA, PathSearchStrategy::A_STAR, PathSearchStrategy::BIDIRECTIONAL};
+    const unsigned int queries[][2] = {{0, 168}, {0, 12}, {14, 100}, {168, 0}, {30, 123}, {84, 90}};
+    for(auto query : queries)
+    {
+        auto v1 = mesh->getVertex(query[0]), v2 = mesh->getVertex(query[1]);
+        std::string name = "tie " + std::to_string(query[0]) + " -> " + std::to_string(query[1]);
+        auto reference = mesh->computeShortestPath(v1, v2, DistanceType::EUCLIDEAN_DISTANCE, true, false, false, PathSearchStrategy::DIJKSTRA);
+        double referenceLength = getLength(v1, v2, reference, DistanceType::EUCLIDEAN_DISTANCE, true);
+        check(!reference.empty() && referenceLength >= 0, name + ": Dijkstra path");
+        for(auto strategy : strategies)
+        {
+            std::string strategyName = name + ", strategy " + std::to_string(static_cast<int>(strategy));
+            auto path = mesh->computeShortestPath(v1, v2, DistanceType::EUCLIDEAN_DISTANCE, true, false, false, strategy);
+            double length = getLength(v1, v2, path, DistanceType::EUCLIDEAN_DISTANCE, true);
+            check(!path.empty() && path.back() == v2 && length >= 0, strategyName + ": path");
+            check(std::fabs(length - referenceLength) <= 1e-9 * (1 + referenceLength), strategyName + ": length");
+            //Ties are broken by discovery order, so the same query gives the same path
+            auto repeated = mesh->computeShortestPath(v1, v2, DistanceType::EUCLIDEAN_DISTANCE, true, false, false, strategy);
+            check(repeated == path, strategyName + ": repeated query");
+        }
+    }
+
+    //A path to the origin itself is empty
+    auto v = mesh->getVertex(20);
+    for(auto strategy : strategies)
+        check(mesh->computeShortestPath(v, v, DistanceType::EUCLIDEAN_DISTANCE, true, false, false, strategy).empty(),
+              "empty path, strategy " + std::to_string(static_cast<int>(strategy)));
+}
+
+int main()
+{
+    testStrategies();
+    testTies();
+    if(failures > 0)
+    {
+        std::cerr << failures << " shortest path tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All shortest path tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <trianglebvh.hpp>
+
+using namespace SemantisedTriangleMesh;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message)
+{
+    if(!condition)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+//Hits of the triangles closer to an edge than this (in barycentric coordinates), or whose ray parameter is this close to the limits of
+//the range (relatively), may be reported or not, depending on rounding
+static const double MARGIN = 1e-7;
+
+struct BruteForceHit
+{
+    std::size_t triangle;
+    double t;
+    //Smallest barycentric coordinate: negative if the ray misses the triangle
+    double inside;
+};
+
+//Intersections of the line of a ray with every triangle, by the plain Möller-Trumbore test
+static std::vector<BruteForceHit> bruteForceHits(const std::vector<double>& coordinates, const std::vector<unsigned int>& faces,
+                                                 const double* origin, const double* direction)
+{
+    std::vector<BruteForceHit> hits;
+    for(std::size_t i = 0; i < faces.size() / 3; i++)
+    {
+        const double *a = &coordinates[faces[i * 3] * 3], *b = &coordinates[faces[i * 3 + 1] * 3], *c = &coordinates[faces[i * 3 + 2] * 3];
+        double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        double p[3] = {direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2],
+                       direction[0] * e2[1] - direction[1] * e2[0]};
+        double determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if(std::fabs(determinant) < 1e-12)
+            continue;
+        double s[3] = {origin[0] - a[0], origin[1] - a[1], origin[2] - a[2]};
+        double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / determinant;
+        double q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+        double v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) / determinant;
+        double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / determinant;
+        hits.push_back({i, t, std::min(std::min(u, v), 1 - u - v)});
+    }
+    return hits;
+}
+
+//Random triangles of various sizes in a box, overlapping each other, with some degenerate ones
+static void generateTriangles(std::size_t trianglesNumber, unsigned int seed, std::vector<double>& coordinates, std::vector<unsigned int>& faces)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> position(-10, 10), size(0.1, 3);
+    coordinates.clear();
+    faces.clear();
+    for(std::size_t i = 0; i < trianglesNumber; i++)
+    {
+        double center[3] = {position(generator), position(generator), position(generator)}, extent = size(generator);
+        std::uniform_real_distribution<double> offset(-extent, extent);
+        for(unsigned int j = 0; j < 3; j++)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+                coordinates.push_back(center[k] + offset(generator));
+            faces.push_back(static_cast<unsigned int>(i * 3 + j));
+        }
+        //Collapse some triangles onto a segment (they are never hit, apart from rays lying on the segment)
+        if(i % 17 == 0)
+            std::copy(coordinates.end() - 6, coordinates.end() - 3, coordinates.end() - 3);
+    }
+}
+
+static void testRays(std::size_t trianglesNumber, unsigned int seed)
+{
+    std::string name = std::to_string(trianglesNumber) + " triangles";
+    std::vector<double> coordinates;
+    std::vector<unsigned int> faces;
+    generateTriangles(trianglesNumber, seed, coordinates, faces);
+    TriangleBVH bvh(coordinates.data(), faces.data(), trianglesNumber);
+    check(bvh.size() == trianglesNumber, name + ": size");
+
+    std::mt19937 generator(seed + 1);
+    std::uniform_real_distribution<double> position(-12, 12), weight(0, 1), scale(0.5, 3);
+    std::vector<TriangleBVH::RayHit> hits;
+    for(unsigned int query = 0; query < 200; query++)
+    {
+        std::string queryName = name + ", ray " + std::to_string(query);
+        double origin[3] = {position(generator), position(generator), position(generator)};
+        double target[3] = {position(generator), position(generator), position(generator)};
+        //Most rays aim at a point inside a (non-degenerate) triangle, so that they hit something
+        if(query % 4 != 0 && trianglesNumber > 1)
+        {
+            std::size_t triangle = generator() % trianglesNumber;
+            if(triangle % 17 == 0)
+                triangle = triangle + 1 < trianglesNumber ? triangle + 1 : triangle - 1;
+            double u = weight(generator), v = weight(generator) * (1 - u);
+            for(unsigned int k = 0; k < 3; k++)
+                target[k] = (1 - u - v) * coordinates[faces[triangle * 3] * 3 + k] + u * coordinates[faces[triangle * 3 + 1] * 3 + k] +
+                        v * coordinates[faces[triangle * 3 + 2] * 3 + k];
+        }
+        double factor = scale(generator);
+        double direction[3] = {(target[0] - origin[0]) * factor, (target[1] - origin[1]) * factor, (target[2] - origin[2]) * factor};
+        //Rays, then segments ending at the target and rays starting past some of the triangles
+        double ranges[3][2] = {{0, std::numeric_limits<double>::max()}, {0, 1 / factor}, {0.3 / factor, std::numeric_limits<double>::max()}};
+        for(auto range : ranges)
+        {
+            std::string rangeName = queryName + (range == ranges[0] ? "" : range == ranges[1] ? " (segment)" : " (from 0.3)");
+            std::vector<BruteForceHit> expected = bruteForceHits(coordinates, faces, origin, direction);
+            std::vector<bool> required(trianglesNumber, false), allowed(trianglesNumber, false);
+            bool anyRequired = false, anyAllowed = false;
+            double firstRequired = std::numeric_limits<double>::infinity(), firstAllowed = std::numeric_limits<double>::infinity();
+            for(const auto& h : expected)
+            {
+                double tolerance = MARGIN * (1 + std::fabs(h.t));
+                if(h.inside > MARGIN && h.t > range[0] + tolerance && h.t < range[1] - tolerance)
+                {
+                    required[h.triangle] = anyRequired = true;
+                    firstRequired = std::min(firstRequired, h.t);
+                }
+                if(h.inside > -MARGIN && h.t > range[0] - tolerance && h.t < range[1] + tolerance)
+                {
+                    allowed[h.triangle] = anyAllowed = true;
+                    firstAllowed = std::min(firstAllowed, h.t);
+                }
+            }
+
+            bvh.allHits(origin, direction, hits, range[0], range[1]);
+            bool correct = std::is_sorted(hits.begin(), hits.end(), [](const TriangleBVH::RayHit& a, const TriangleBVH::RayHit& b){ return a.t < b.t; });
+            std::vector<bool> found(trianglesNumber, false);
+            for(const auto& h : hits)
+            {
+                correct = correct && h.triangle < trianglesNumber && allowed[h.triangle] && !found[h.triangle];
+                if(h.triangle < trianglesNumber)
+                    found[h.triangle] = true;
+            }
+            for(std::size_t i = 0; i < trianglesNumber; i++)
+                correct = correct && (!required[i] || found[i]);
+            check(correct, rangeName + ": all hits");
+
+            TriangleBVH::RayHit first;
+            bool hit = bvh.firstHit(origin, direction, first, range[0], range[1]);
+            check(!anyRequired || hit, rangeName + ": first hit missed");
+            if(hit)
+            {
+                bool valid = first.triangle < trianglesNumber && allowed[first.triangle] && first.t >= range[0] && first.t <= range[1];
+                //It is the closest hit, up to the hits at the boundary of some triangle
+                valid = valid && first.t <= firstRequired + MARGIN * (1 + firstRequired) && first.t >= firstAllowed - MARGIN * (1 + firstAllowed);
+                if(valid)
+                {
+                    //The barycentric coordinates give back the hit point
+                    for(unsigned int k = 0; k < 3; k++)
+                    {
+                        double point = origin[k] + first.t * direction[k], corners = 0;
+                        for(unsigned int j = 0; j < 3; j++)
+                            corners += first.barycentric[j] * coordinates[faces[first.triangle * 3 + j] * 3 + k];
+                        valid = valid && std::fabs(point - corners) <= 1e-6 * (1 + std::fabs(point));
+                    }
+                }
+                check(valid, rangeName + ": first hit");
+            }
+
+            bool any = bvh.anyHit(origin, direction, range[0], range[1]);
+            check((!anyRequired || any) && (anyAllowed || !any), rangeName + ": any hit");
+        }
+    }
+}
+
+int main()
+{
+    //A few triangles fill a single leaf partially, so that the SIMD loops and their scalar remainder are both used
+    for(std::size_t trianglesNumber : {0, 1, 3, 5, 9, 200, 3000})
+        testRays(trianglesNumber, static_cast<unsigned int>(trianglesNumber) + 1);
+    if(failures > 0)
+    {
+        std::cerr << failures << " bvh tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All bvh tests passed" << std::endl;
+    return 0;
+}